@@ -1,10 +1,12 @@
 #!/bin/bash
 
 MCPERF=./mcperf
+MCPERF_MERGE=./mcperf-merge
 
 CLIENTS=16
 
 LOG=mcperf.log
+RESULT=mcperf.result
 
 HOST=localhost
 PORT=11211
@@ -18,12 +20,15 @@ CALL_RATE=0
 for i in `seq $CLIENTS`
 do
     printf "Cleaning up existing log file at %s\n" $LOG.$i
-    rm -f $LOG.$i
+    rm -f $LOG.$i $RESULT.$i
     printf "starting client %s\n" $i
-    $MCPERF --server=$HOST --port=$PORT --client=$i/$CLIENTS --num-conns=$NUM_CONNS --conn-rate=$CONN_RATE --num-calls=$NUM_CALLS --call-rate=$CONN_RATE >> $LOG.$i 2>&1 &
+    $MCPERF --server=$HOST --port=$PORT --client=$i/$CLIENTS --num-conns=$NUM_CONNS --conn-rate=$CONN_RATE --num-calls=$NUM_CALLS --call-rate=$CONN_RATE --result-file=$RESULT.$i >> $LOG.$i 2>&1 &
 done
 
 
 printf "Waiting for all clients to finish...."
 wait
 printf "done.\n"
+
+printf "Merging results of all clients\n"
+$MCPERF_MERGE `seq -f "$RESULT.%g" $CLIENTS`
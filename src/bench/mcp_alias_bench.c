@@ -0,0 +1,61 @@
+/*
+ *  twemperf - a tool for measuring memcached server performance.
+ *  Copyright (C) 2011 Twitter, Inc.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <stdlib.h>
+
+#include <bench/mcp_bench.h>
+
+/*
+ * Pick the request type of every call from a read mostly mix, the way
+ * call_make_req does for -m get:90,set:9,delete:1.
+ */
+void
+bench_alias_next(uint64_t n)
+{
+    struct alias a;
+    double weight[REQ_MAX_TYPES];
+    uint64_t count[REQ_MAX_TYPES], i;
+    rstatus_t status;
+    double start;
+
+    for (i = 0; i < REQ_MAX_TYPES; i++) {
+        weight[i] = 0.0;
+        count[i] = 0;
+    }
+    weight[REQ_GET] = 90.0;
+    weight[REQ_SET] = 9.0;
+    weight[REQ_DELETE] = 1.0;
+
+    status = alias_init(&a, weight, REQ_MAX_TYPES, 0);
+    if (status != MCP_OK) {
+        log_stderr("mcpbench: alias init failed");
+        exit(1);
+    }
+
+    start = bench_now();
+    for (i = 0; i < n; i++) {
+        count[alias_next(&a)]++;
+    }
+    bench_report("alias_next", n, bench_now() - start);
+
+    log_debug(LOG_VERB, "get %"PRIu64" set %"PRIu64" delete %"PRIu64"",
+              count[REQ_GET], count[REQ_SET], count[REQ_DELETE]);
+
+    alias_deinit(&a);
+}
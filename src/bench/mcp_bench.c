@@ -0,0 +1,153 @@
+/*
+ *  twemperf - a tool for measuring memcached server performance.
+ *  Copyright (C) 2011 Twitter, Inc.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <getopt.h>
+
+#include <bench/mcp_bench.h>
+
+#define BENCH_NOPS  (1000 * 1000)
+
+struct bench {
+    char *name;                 /* benchmark name */
+    char *desc;                 /* benchmark description */
+    void (*run)(uint64_t n);    /* run benchmark n times */
+};
+
+#define DEFINE_ACTION(_name, _desc) { #_name, _desc, bench_##_name },
+static struct bench benches[] = {
+    BENCH_CODEC( DEFINE_ACTION )
+    { NULL, NULL, NULL }
+};
+#undef DEFINE_ACTION
+
+static struct option long_options[] = {
+    { "help",   no_argument,        NULL,   'h' },
+    { "ops",    required_argument,  NULL,   'n' },
+    { NULL,     0,                  NULL,    0  }
+};
+
+static char short_options[] = "hn:";
+
+static void
+bench_show_usage(void)
+{
+    struct bench *b;
+
+    log_stderr(
+        "Usage: mcpbench [-h] [-n ops] [benchmark...]" CRLF
+        "" CRLF
+        "Options:" CRLF
+        "  -h, --help    : this help" CRLF
+        "  -n, --ops=N   : set the # operations per benchmark (default: %d)" CRLF
+        "" CRLF
+        "Benchmarks:",
+        BENCH_NOPS);
+
+    for (b = benches; b->name != NULL; b++) {
+        log_stderr("  %-17s : %s", b->name, b->desc);
+    }
+}
+
+double
+bench_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+void
+bench_report(char *name, uint64_t nop, double elapsed)
+{
+    log_stderr("%-17s %12"PRIu64" ops %10.3f s %10.2f ns/op", name, nop,
+               elapsed, nop == 0 ? 0.0 : elapsed * 1e9 / (double)nop);
+}
+
+int
+main(int argc, char **argv)
+{
+    struct bench *b;
+    uint64_t n;
+    int c, i;
+
+    n = BENCH_NOPS;
+
+    opterr = 0;
+    for (;;) {
+        c = getopt_long(argc, argv, short_options, long_options, NULL);
+        if (c == -1) {
+            break;
+        }
+
+        switch (c) {
+        case 'h':
+            bench_show_usage();
+            exit(0);
+
+        case 'n':
+            if (mcp_atoi(optarg) <= 0) {
+                log_stderr("mcpbench: option -n requires a positive number");
+                exit(1);
+            }
+            n = (uint64_t)mcp_atoi(optarg);
+            break;
+
+        default:
+            bench_show_usage();
+            exit(1);
+        }
+    }
+
+    for (i = optind; i < argc; i++) {
+        for (b = benches; b->name != NULL; b++) {
+            if (strcmp(argv[i], b->name) == 0) {
+                break;
+            }
+        }
+        if (b->name == NULL) {
+            log_stderr("mcpbench: unknown benchmark '%s'", argv[i]);
+            exit(1);
+        }
+    }
+
+    scan_init(scan_best());
+    timer_init(TIMER_INTERVAL);
+
+    for (b = benches; b->name != NULL; b++) {
+        if (optind < argc) {
+            for (i = optind; i < argc; i++) {
+                if (strcmp(argv[i], b->name) == 0) {
+                    break;
+                }
+            }
+            if (i == argc) {
+                continue;
+            }
+        }
+
+        b->run(n);
+    }
+
+    return 0;
+}
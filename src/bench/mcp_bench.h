@@ -0,0 +1,52 @@
+/*
+ *  twemperf - a tool for measuring memcached server performance.
+ *  Copyright (C) 2011 Twitter, Inc.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _MCP_BENCH_H_
+#define _MCP_BENCH_H_
+
+#include <mcp_core.h>
+
+/*
+ * mcpbench runs microbenchmarks of the hot paths of mcperf in isolation.
+ * Every benchmark runs its operation n times and reports the cost per
+ * operation with bench_report.
+ */
+#define BENCH_CODEC(ACTION)                                         \
+    ACTION( parse,          "parse responses, many per read"       )\
+    ACTION( parse_split,    "parse responses, 7 bytes per read"    )\
+    ACTION( parse_bin,      "parse binary responses, many per read")\
+    ACTION( parse_meta,     "parse meta responses, many per read"  )\
+    ACTION( scan,           "parse value responses, per scanner"   )\
+    ACTION( timer_schedule, "schedule timers, 100k live"           )\
+    ACTION( timer_cancel,   "cancel timers, 100k live"             )\
+    ACTION( timer_expire,   "expire timers, 100k live"             )\
+    ACTION( hist_record,    "record latencies, 3 digits"           )\
+    ACTION( hist_query,     "query percentiles, 3 digits"          )\
+    ACTION( alias_next,     "pick methods, get:90,set:9,delete:1"  )\
+    ACTION( key_zipf,       "pick keys, zipf 0.99 over 10M keys"   )\
+    ACTION( key_hotspot,    "pick keys, hotspot 20,80 over 10M"    )\
+
+#define DEFINE_ACTION(_name, _desc) void bench_##_name(uint64_t n);
+BENCH_CODEC( DEFINE_ACTION )
+#undef DEFINE_ACTION
+
+double bench_now(void);
+void bench_report(char *name, uint64_t nop, double elapsed);
+
+#endif
@@ -0,0 +1,107 @@
+/*
+ *  twemperf - a tool for measuring memcached server performance.
+ *  Copyright (C) 2011 Twitter, Inc.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <stdlib.h>
+
+#include <bench/mcp_bench.h>
+
+#define HIST_NVALUE     4096            /* # precomputed values */
+
+/*
+ * Record response times in usec spread over 10 usec to 100 msec, as a
+ * latency histogram of 1 usec to 100 sec at 3 significant digits sees
+ * them, and query their percentiles.
+ */
+static uint64_t *
+hist_values(void)
+{
+    uint64_t *values;
+    uint32_t i;
+
+    values = mcp_alloc(sizeof(*values) * HIST_NVALUE);
+    if (values == NULL) {
+        log_stderr("mcpbench: alloc of %d values failed", HIST_NVALUE);
+        exit(1);
+    }
+
+    srandom(0);
+    for (i = 0; i < HIST_NVALUE; i++) {
+        values[i] = (uint64_t)(10.0 * pow(1e4, (double)random() / RAND_MAX));
+    }
+
+    return values;
+}
+
+static void
+hist_init(struct histogram *h)
+{
+    rstatus_t status;
+
+    status = histogram_init(h, (uint64_t)(HIST_MAX_TIME / HIST_UNIT), 3);
+    if (status != MCP_OK) {
+        log_stderr("mcpbench: histogram init failed");
+        exit(1);
+    }
+}
+
+void
+bench_hist_record(uint64_t n)
+{
+    struct histogram h;
+    uint64_t *values, i;
+    double start;
+
+    values = hist_values();
+    hist_init(&h);
+
+    start = bench_now();
+    for (i = 0; i < n; i++) {
+        histogram_record(&h, values[i & (HIST_NVALUE - 1)]);
+    }
+    bench_report("hist_record", n, bench_now() - start);
+
+    histogram_deinit(&h);
+    mcp_free(values);
+}
+
+void
+bench_hist_query(uint64_t n)
+{
+    struct histogram h;
+    uint64_t *values, i, sum;
+    double start;
+
+    values = hist_values();
+    hist_init(&h);
+
+    for (i = 0; i < 1000 * HIST_NVALUE; i++) {
+        histogram_record(&h, values[i & (HIST_NVALUE - 1)]);
+    }
+
+    start = bench_now();
+    for (i = 0, sum = 0; i < n; i++) {
+        sum += histogram_percentile(&h, (double)(i % 1000) / 1000);
+    }
+    bench_report("hist_query", n, bench_now() - start);
+
+    log_debug(LOG_VERB, "percentile sum %"PRIu64"", sum);
+
+    histogram_deinit(&h);
+    mcp_free(values);
+}
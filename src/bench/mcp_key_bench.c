@@ -0,0 +1,63 @@
+/*
+ *  twemperf - a tool for measuring memcached server performance.
+ *  Copyright (C) 2011 Twitter, Inc.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <bench/mcp_bench.h>
+
+#define KEY_NKEY    (10 * 1000 * 1000)  /* # keys */
+
+/*
+ * Pick the keys of n requests out of a large key space, the way
+ * call_make_req does with -K and -k.
+ */
+static void
+key_bench(char *name, key_dist_type_t type, uint64_t n)
+{
+    struct key_opt kopt;
+    struct key_dist kd;
+    uint64_t i, sum;
+    double start;
+
+    kopt.type = type;
+    kopt.nkey = KEY_NKEY;
+    kopt.theta = KEY_ZIPF_THETA;
+    kopt.hot_keys = KEY_HOT_KEYS;
+    kopt.hot_ops = KEY_HOT_OPS;
+
+    key_dist_init(&kd, &kopt, 0);
+
+    start = bench_now();
+    for (i = 0, sum = 0; i < n; i++) {
+        sum += key_next(&kd, false);
+    }
+    bench_report(name, n, bench_now() - start);
+
+    log_debug(LOG_VERB, "key sum %"PRIu64"", sum);
+}
+
+void
+bench_key_zipf(uint64_t n)
+{
+    key_bench("key_zipf", KEY_DIST_ZIPF, n);
+}
+
+void
+bench_key_hotspot(uint64_t n)
+{
+    key_bench("key_hotspot", KEY_DIST_HOTSPOT, n);
+}
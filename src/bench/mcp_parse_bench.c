@@ -0,0 +1,246 @@
+/*
+ *  twemperf - a tool for measuring memcached server performance.
+ *  Copyright (C) 2011 Twitter, Inc.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <stdlib.h>
+
+#include <bench/mcp_bench.h>
+
+#define PARSE_BUF_NRSP  1024    /* # responses in the parse buffer */
+#define PARSE_SPLIT     7       /* bytes per read in parse_split */
+
+static char *rsps[] = {
+    "STORED\r\n",
+    "VALUE mcp:0000000001 0 100\r\n"
+        "0123456789012345678901234567890123456789"
+        "0123456789012345678901234567890123456789"
+        "01234567890123456789\r\n"
+        "END\r\n",
+    "END\r\n",
+    "NOT_FOUND\r\n",
+    "DELETED\r\n",
+    "12345\r\n",
+    "SERVER_ERROR out of memory storing object\r\n",
+};
+
+#define PARSE_NRSPS     (sizeof(rsps) / sizeof(rsps[0]))
+
+/* the meta responses to the same requests */
+static char *meta_rsps[] = {
+    "HD O1f\r\n",
+    "VA 100 O20\r\n"
+        "0123456789012345678901234567890123456789"
+        "0123456789012345678901234567890123456789"
+        "01234567890123456789\r\n",
+    "EN O21\r\n",
+    "NF O22\r\n",
+    "HD O23\r\n",
+    "HD O24\r\n",
+    "SERVER_ERROR out of memory storing object\r\n",
+};
+
+#define PARSE_NMETA_RSPS (sizeof(meta_rsps) / sizeof(meta_rsps[0]))
+
+/*
+ * The binary responses to the same requests: opcode, status, extras, key
+ * and value lengths of each.
+ */
+static struct {
+    uint8_t  opcode;
+    uint16_t status;
+    uint8_t  extlen;
+    uint32_t vlen;
+} bin_rsps[] = {
+    { 0x01, 0x0000, 0, 0 },     /* set: stored */
+    { 0x00, 0x0000, 4, 100 },   /* get: hit */
+    { 0x00, 0x0001, 0, 9 },     /* get: miss, "Not found" */
+    { 0x04, 0x0001, 0, 9 },     /* delete: "Not found" */
+    { 0x04, 0x0000, 0, 0 },     /* delete: deleted */
+    { 0x05, 0x0000, 0, 8 },     /* incr: 64-bit value */
+    { 0x01, 0x0082, 0, 13 },    /* set: "Out of memory" */
+};
+
+#define PARSE_NBIN_RSPS (sizeof(bin_rsps) / sizeof(bin_rsps[0]))
+
+typedef rstatus_t (*parse_t)(struct rsp_parser *, char *, char *, size_t *);
+
+/*
+ * Lay out PARSE_BUF_NRSP responses, cycling through the nrsp sample
+ * responses in samples, back to back in one buffer.
+ */
+static char *
+parse_buf(char **samples, uint32_t nrsp, size_t *len)
+{
+    char *buf, *p;
+    size_t size;
+    uint32_t i;
+
+    size = 0;
+    for (i = 0; i < PARSE_BUF_NRSP; i++) {
+        size += strlen(samples[i % nrsp]);
+    }
+
+    buf = mcp_alloc(size);
+    if (buf == NULL) {
+        log_stderr("mcpbench: alloc of %zu bytes failed", size);
+        exit(1);
+    }
+
+    for (p = buf, i = 0; i < PARSE_BUF_NRSP; i++) {
+        size_t rlen = strlen(samples[i % nrsp]);
+
+        mcp_memcpy(p, samples[i % nrsp], rlen);
+        p += rlen;
+    }
+
+    *len = size;
+
+    return buf;
+}
+
+/*
+ * Lay out PARSE_BUF_NRSP binary responses, cycling through the sample
+ * responses, back to back in one buffer.
+ */
+static char *
+parse_bin_buf(size_t *len)
+{
+    uint8_t *buf, *p;
+    size_t size;
+    uint32_t i, blen;
+
+    size = 0;
+    for (i = 0; i < PARSE_BUF_NRSP; i++) {
+        size += BIN_HEADER_LEN + bin_rsps[i % PARSE_NBIN_RSPS].extlen +
+                bin_rsps[i % PARSE_NBIN_RSPS].vlen;
+    }
+
+    buf = mcp_alloc(size);
+    if (buf == NULL) {
+        log_stderr("mcpbench: alloc of %zu bytes failed", size);
+        exit(1);
+    }
+    memset(buf, '0', size);
+
+    for (p = buf, i = 0; i < PARSE_BUF_NRSP; i++) {
+        uint8_t opcode = bin_rsps[i % PARSE_NBIN_RSPS].opcode;
+        uint16_t status = bin_rsps[i % PARSE_NBIN_RSPS].status;
+        uint8_t extlen = bin_rsps[i % PARSE_NBIN_RSPS].extlen;
+
+        blen = extlen + bin_rsps[i % PARSE_NBIN_RSPS].vlen;
+
+        memset(p, 0, BIN_HEADER_LEN);
+        p[0] = BIN_RSP_MAGIC;
+        p[1] = opcode;
+        p[4] = extlen;
+        p[6] = (uint8_t)(status >> 8);
+        p[7] = (uint8_t)status;
+        p[8] = (uint8_t)(blen >> 24);
+        p[9] = (uint8_t)(blen >> 16);
+        p[10] = (uint8_t)(blen >> 8);
+        p[11] = (uint8_t)blen;
+        p += BIN_HEADER_LEN + blen;
+    }
+
+    *len = size;
+
+    return (char *)buf;
+}
+
+static void
+parse_run(char *name, uint64_t n, size_t split, char *buf, size_t len,
+          parse_t parse)
+{
+    struct rsp_parser rp;
+    rstatus_t status;
+    char *p, *end, *last;
+    size_t nparsed;
+    uint64_t nrsp;
+    double start;
+
+    end = buf + len;
+
+    rsp_parser_init(&rp);
+    nrsp = 0;
+    p = buf;
+
+    start = bench_now();
+
+    while (nrsp < n) {
+        last = (split == 0) ? end : MIN(p + split, end);
+
+        status = parse(&rp, p, last, &nparsed);
+        p += nparsed;
+
+        if (status == MCP_OK) {
+            rsp_parser_init(&rp);
+            nrsp++;
+        } else if (status != MCP_EAGAIN) {
+            log_stderr("mcpbench: parse error at offset %zu", p - buf);
+            exit(1);
+        }
+
+        if (p == end) {
+            p = buf;
+        }
+    }
+
+    bench_report(name, nrsp, bench_now() - start);
+
+    mcp_free(buf);
+}
+
+void
+bench_parse(uint64_t n)
+{
+    char *buf;
+    size_t len;
+
+    buf = parse_buf(rsps, PARSE_NRSPS, &len);
+    parse_run("parse", n, 0, buf, len, rsp_parse);
+}
+
+void
+bench_parse_split(uint64_t n)
+{
+    char *buf;
+    size_t len;
+
+    buf = parse_buf(rsps, PARSE_NRSPS, &len);
+    parse_run("parse_split", n, PARSE_SPLIT, buf, len, rsp_parse);
+}
+
+void
+bench_parse_bin(uint64_t n)
+{
+    char *buf;
+    size_t len;
+
+    buf = parse_bin_buf(&len);
+    parse_run("parse_bin", n, 0, buf, len, rsp_parse_bin);
+}
+
+void
+bench_parse_meta(uint64_t n)
+{
+    char *buf;
+    size_t len;
+
+    buf = parse_buf(meta_rsps, PARSE_NMETA_RSPS, &len);
+    parse_run("parse_meta", n, 0, buf, len, rsp_parse_meta);
+}
@@ -0,0 +1,158 @@
+/*
+ *  twemperf - a tool for measuring memcached server performance.
+ *  Copyright (C) 2011 Twitter, Inc.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <stdlib.h>
+
+#include <bench/mcp_bench.h>
+
+#define TIMER_NLIVE     (100 * 1000)    /* # live timers */
+#define TIMER_BATCH     1024            /* # timers scheduled or cancelled per batch */
+#define TIMER_SPAN      (60 * 1000)     /* max timer delay in ticks */
+
+static uint64_t nfired; /* # timers fired */
+
+static void
+timer_bench_timeout(struct timer *t, void *arg)
+{
+    nfired++;
+}
+
+/* delay of 1 to TIMER_SPAN ticks, so that every wheel level is used */
+static double
+timer_delay(void)
+{
+    return (double)(1 + random() % TIMER_SPAN) * TIMER_INTERVAL;
+}
+
+static struct timer **
+timer_alloc(uint32_t ntimer)
+{
+    struct timer **timers;
+
+    timers = mcp_alloc(sizeof(*timers) * ntimer);
+    if (timers == NULL) {
+        log_stderr("mcpbench: alloc of %"PRIu32" timers failed", ntimer);
+        exit(1);
+    }
+
+    return timers;
+}
+
+static void
+timer_schedule_all(struct timer **timers, uint32_t ntimer)
+{
+    uint32_t i;
+
+    for (i = 0; i < ntimer; i++) {
+        timers[i] = timer_schedule(timer_bench_timeout, NULL, timer_delay());
+        if (timers[i] == NULL) {
+            log_stderr("mcpbench: timer schedule failed");
+            exit(1);
+        }
+    }
+}
+
+static void
+timer_cancel_all(struct timer **timers, uint32_t ntimer)
+{
+    uint32_t i;
+
+    for (i = 0; i < ntimer; i++) {
+        timer_cancel(timers[i]);
+    }
+}
+
+/*
+ * Schedule and cancel batches of timers on top of TIMER_NLIVE live timers,
+ * timing only one of the two operations.
+ */
+static void
+timer_run(char *name, uint64_t n, bool schedule)
+{
+    struct timer **live, **batch;
+    uint64_t nop;
+    double start, elapsed;
+
+    srandom(0);
+
+    live = timer_alloc(TIMER_NLIVE);
+    batch = timer_alloc(TIMER_BATCH);
+
+    timer_schedule_all(live, TIMER_NLIVE);
+
+    for (nop = 0, elapsed = 0.0; nop < n; nop += TIMER_BATCH) {
+        start = bench_now();
+        timer_schedule_all(batch, TIMER_BATCH);
+        if (schedule) {
+            elapsed += bench_now() - start;
+        }
+
+        start = bench_now();
+        timer_cancel_all(batch, TIMER_BATCH);
+        if (!schedule) {
+            elapsed += bench_now() - start;
+        }
+    }
+
+    bench_report(name, nop, elapsed);
+
+    timer_cancel_all(live, TIMER_NLIVE);
+
+    mcp_free(batch);
+    mcp_free(live);
+}
+
+void
+bench_timer_schedule(uint64_t n)
+{
+    timer_run("timer_schedule", n, true);
+}
+
+void
+bench_timer_cancel(uint64_t n)
+{
+    timer_run("timer_cancel", n, false);
+}
+
+/*
+ * Schedule TIMER_NLIVE timers and advance the wheel until all of them
+ * have fired, including the cost of cascading them down the levels.
+ */
+void
+bench_timer_expire(uint64_t n)
+{
+    struct timer **live;
+    double start, elapsed;
+
+    srandom(0);
+
+    live = timer_alloc(TIMER_NLIVE);
+
+    for (nfired = 0, elapsed = 0.0; nfired < n;) {
+        timer_schedule_all(live, TIMER_NLIVE);
+
+        start = bench_now();
+        timer_advance(TIMER_SPAN + 1);
+        elapsed += bench_now() - start;
+    }
+
+    bench_report("timer_expire", nfired, elapsed);
+
+    mcp_free(live);
+}
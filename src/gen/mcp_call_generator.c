@@ -19,12 +19,17 @@
 #include <mcp_core.h>
 
 /*
- * Return true if we are done issuing calls, otherwise
- * return false
+ * Return true if we are done issuing calls, either because all of them
+ * were issued or because the test duration elapsed, otherwise return
+ * false
  */
 static bool
 issue_call_done(struct context *ctx, struct conn *conn)
 {
+    if (ctx->expired) {
+        return true;
+    }
+
     if ((conn->ncall_created + conn->ncall_create_failed) ==
         ctx->opt.num_calls) {
         return true;
@@ -50,11 +55,14 @@ issue_call(struct context *ctx, void *arg)
     call_make_req(ctx, call);
 
     /*
-     * Enqueue call into sendq so that it can be sent later on
+     * Enqueue call into the sendq of the conn to the server of its key, so
+     * that it can be sent later when the pending conns are flushed, or on
      * an out event
      */
-    STAILQ_INSERT_TAIL(&conn->call_sendq, call, call_tqe);
-    conn->ncall_sendq++;
+    call->conn = conn->pool[call->req.server];
+    STAILQ_INSERT_TAIL(&call->conn->call_sendq, call, call_tqe);
+    call->conn->ncall_sendq++;
+    core_pend_send(ctx, call->conn);
 
     conn->ncall_created++;
 
@@ -82,7 +90,7 @@ static void
 destroyed(struct context *ctx, event_type_t type, void *rarg, void *carg)
 {
     struct call *call = carg;
-    struct conn *conn = call->conn;
+    struct conn *conn = call->conn->lead;
     struct gen *g = &conn->call_gen;
 
     ASSERT(type == EVENT_CALL_DESTROYED);
@@ -117,16 +125,35 @@ trigger(struct context *ctx, event_type_t type, void *rarg, void *carg)
     struct dist_info *di = &ctx->call_dist;
     event_type_t firing_event = (di->type == DIST_NONE) ? EVENT_GEN_CALL_FIRE :
                                 EVENT_INVALID;
+    uint32_t i;
 
     ASSERT(type == EVENT_GEN_CALL_TRIGGER);
     ASSERT(conn->ctx == ctx);
 
+    /* calls are issued on the lead of a pool */
+    if (conn->lead != conn) {
+        return;
+    }
+
     gen_start(g, ctx, di, issue_call, conn, firing_event);
+
+    /*
+     * A one-shot generator issues a call whenever one completes, so the
+     * calls it issues at the start are the ones it keeps in flight
+     */
+    for (i = 1; g->oneshot && i < ctx->opt.pipeline && !g->done; i++) {
+        ecb_signal(ctx, EVENT_GEN_CALL_FIRE, g);
+    }
 }
 
 static void
 init(struct context *ctx, void *arg)
 {
+    /* the calls of a replay are issued by the replay generator */
+    if (ctx->opt.replay_filename != NULL) {
+        return;
+    }
+
     ecb_register(ctx, EVENT_CALL_DESTROYED, destroyed, NULL);
     ecb_register(ctx, EVENT_GEN_CALL_TRIGGER, trigger, NULL);
 }
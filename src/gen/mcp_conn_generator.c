@@ -19,12 +19,17 @@
 #include <mcp_core.h>
 
 /*
- * Return true if we are done making connections, otherwise
- * return false
+ * Return true if we are done making connections, either because all of
+ * them were made or because the test duration elapsed, otherwise return
+ * false
  */
 static bool
 make_conn_done(struct context *ctx)
 {
+    if (ctx->expired) {
+        return true;
+    }
+
     if ((ctx->nconn_created + ctx->nconn_create_failed) ==
         ctx->opt.num_conns) {
         return true;
@@ -33,11 +38,49 @@ make_conn_done(struct context *ctx)
     return false;
 }
 
+/*
+ * Return true if some server of the pool led by conn has not failed,
+ * otherwise return false
+ */
+static bool
+pool_live(struct context *ctx, struct conn *conn)
+{
+    uint32_t i;
+
+    for (i = 0; i < ctx->opt.pool.nserver; i++) {
+        if (!conn->pool[i]->failed) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static void
+pool_fail_log(struct context *ctx, struct conn *conn)
+{
+    log_debug(LOG_NOTICE, "server %s failed on c %"PRIu64", failing its calls",
+              ctx->opt.pool.server[conn->server].name, conn->lead->id);
+}
+
+/* Close the conns of a pool none of whose servers could be connected */
+static void
+make_conn_fail(struct context *ctx, struct conn *conn)
+{
+    uint32_t i;
+
+    conn->closing = 1;
+    for (i = 0; i < ctx->opt.pool.nserver; i++) {
+        core_close(ctx, conn->pool[i]);
+    }
+}
+
 static int
 make_conn(struct context *ctx, void *arg)
 {
     rstatus_t status;
     struct conn *conn;
+    uint32_t i;
 
     ASSERT(!make_conn_done(ctx));
 
@@ -47,15 +90,47 @@ make_conn(struct context *ctx, void *arg)
         goto done;
     }
 
-    status = core_connect(ctx, conn);
+    status = conn_get_pool(ctx, conn);
     if (status != MCP_OK) {
+        conn_put(conn);
         ctx->nconn_create_failed++;
-        ecb_signal(ctx, EVENT_CONN_FAILED, conn);
+        goto done;
+    }
+
+    /*
+     * Connect the lead last, as a connected lead triggers the call
+     * generator that issues calls on every conn of the pool. A pool
+     * carries on without the servers it fails to connect to, and fails
+     * the calls to them, as long as it connects to one of its servers.
+     */
+    for (i = ctx->opt.pool.nserver; i-- > 0;) {
+        status = core_connect(ctx, conn->pool[i]);
+        if (status != MCP_OK) {
+            ecb_signal(ctx, EVENT_CONN_FAILED, conn->pool[i]);
+            core_fail(ctx, conn->pool[i]);
+        }
+    }
+
+    if (!pool_live(ctx, conn)) {
+        ctx->nconn_create_failed++;
+        make_conn_fail(ctx, conn);
         goto done;
     }
 
     ctx->nconn_created++;
-    ecb_signal(ctx, EVENT_CONN_CREATED, conn);
+    TAILQ_INSERT_TAIL(&ctx->live_connq, conn, live_tqe);
+    for (i = 0; i < ctx->opt.pool.nserver; i++) {
+        if (conn->pool[i]->failed) {
+            pool_fail_log(ctx, conn->pool[i]);
+            continue;
+        }
+        ecb_signal(ctx, EVENT_CONN_CREATED, conn->pool[i]);
+    }
+
+    /* the calls of a pool whose lead failed are issued all the same */
+    if (conn->failed) {
+        ecb_signal(ctx, EVENT_GEN_CALL_TRIGGER, conn);
+    }
 
 done:
     if (make_conn_done(ctx)) {
@@ -79,11 +154,57 @@ static void
 destroyed(struct context *ctx, event_type_t type, void *rarg, void *carg)
 {
     struct conn *conn = carg;
+    struct conn *lead = conn->lead;
     struct gen *g = &ctx->conn_gen;
+    bool connected;
+    uint32_t i;
 
     ASSERT(type == EVENT_CONN_DESTROYED);
     ASSERT(conn->ctx == ctx);
 
+    /*
+     * The server of a conn of a pool failed; the pool carries on with its
+     * other servers, failing the calls to this one, until none is left
+     */
+    if (conn->failed && conn->sd >= 0 && !lead->closing &&
+        ctx->opt.pool.nserver > 1) {
+        connected = conn->connected;
+        core_fail(ctx, conn);
+
+        if (pool_live(ctx, lead)) {
+            pool_fail_log(ctx, conn);
+            if (conn == lead && !connected) {
+                /* issue the calls of the pool all the same */
+                ecb_signal(ctx, EVENT_GEN_CALL_TRIGGER, lead);
+            }
+            return;
+        }
+
+        if (conn != lead) {
+            ecb_signal(ctx, EVENT_CONN_DESTROYED, lead);
+            return;
+        }
+    }
+
+    /* a conn of a pool is destroyed along with its lead */
+    if (conn->lead != conn) {
+        core_close(ctx, conn);
+        if (!conn->lead->closing) {
+            ecb_signal(ctx, EVENT_CONN_DESTROYED, conn->lead);
+        }
+        return;
+    }
+
+    conn->closing = 1;
+    TAILQ_REMOVE(&ctx->live_connq, conn, live_tqe);
+    for (i = 1; i < ctx->opt.pool.nserver; i++) {
+        if (conn->pool[i]->sd >= 0) {
+            ecb_signal(ctx, EVENT_CONN_DESTROYED, conn->pool[i]);
+        } else {
+            core_close(ctx, conn->pool[i]);
+        }
+    }
+
     core_close(ctx, conn);
 
     ctx->nconn_destroyed++;
@@ -133,8 +254,8 @@ no_op(struct context *ctx, void *arg)
 
 /*
  * Conn generator is responsible for creating and destroying connections
- * to a given server. A given server can have multiple connections
- * outstanding on it.
+ * to a given server, or pools of connections to a list of servers. A
+ * given server can have multiple connections outstanding on it.
  */
 struct load_generator conn_generator = {
     "creates connections to a server at a given rate",
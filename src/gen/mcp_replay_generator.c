@@ -0,0 +1,250 @@
+/*
+ *  twemperf - a tool for measuring memcached server performance.
+ *  Copyright (C) 2011 Twitter, Inc.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <mcp_core.h>
+
+/*
+ * The records of a trace are dealt out to the client instances, then to
+ * the workers of an instance and then to the connections of a worker in
+ * turn, so that every connection of the pool replays a fair share of the
+ * trace. The k-th connection of a worker replays every stride-th record
+ * from its first one.
+ */
+static uint64_t
+replay_stride(struct context *ctx)
+{
+    struct opt *opt = &ctx->opt;
+
+    return (uint64_t)opt->client.n * opt->num_threads * opt->num_conns;
+}
+
+static uint64_t
+replay_first(struct context *ctx, uint32_t k)
+{
+    struct opt *opt = &ctx->opt;
+
+    return opt->client.id + (uint64_t)opt->client.n *
+           (ctx->id + (uint64_t)opt->num_threads * k);
+}
+
+/*
+ * Return true if we are done replaying the share of the trace of a
+ * connection, or if the test duration elapsed, otherwise return false
+ */
+static bool
+replay_done(struct context *ctx, struct conn *conn)
+{
+    return ctx->expired || conn->trace_next >= ctx->opt.trace.nrec;
+}
+
+/*
+ * Return the time at which the next record of a connection is due, at
+ * the offset of the record from the start of the trace, scaled by the
+ * replay speed, from the start of the test. Every connection of the pool
+ * shares that epoch, whenever it was created, so that the records keep
+ * their relative times across the pool.
+ */
+static double
+replay_next_time(struct context *ctx, struct conn *conn)
+{
+    struct opt *opt = &ctx->opt;
+    struct trace_rec *rec = &opt->trace.rec[conn->trace_next];
+
+    return ctx->start_time + (double)rec->time / 1e6 / opt->replay_speed;
+}
+
+static void
+replay_call(struct context *ctx, struct conn *conn)
+{
+    struct opt *opt = &ctx->opt;
+    struct trace_rec *rec = &opt->trace.rec[conn->trace_next];
+    struct call *call;
+    uint32_t vlen;
+
+    conn->trace_next += replay_stride(ctx);
+
+    call = call_get(conn);
+    if (call == NULL) {
+        conn->ncall_create_failed++;
+        return;
+    }
+
+    vlen = MIN(trace_rec_vlen(rec), sizeof(ctx->buf1m));
+    call_make_key_req(ctx, call, (req_type_t)rec->method, rec->key,
+                      (long int)vlen);
+
+    call->conn = conn->pool[call->req.server];
+    STAILQ_INSERT_TAIL(&call->conn->call_sendq, call, call_tqe);
+    call->conn->ncall_sendq++;
+    core_pend_send(ctx, call->conn);
+
+    conn->ncall_created++;
+
+    ecb_signal(ctx, EVENT_CALL_ISSUE_START, call);
+}
+
+/*
+ * Issue the calls of every record of a connection that is due, and
+ * schedule a tick for the next one.
+ */
+static void
+replay_tick(struct timer *t, void *arg)
+{
+    struct conn *conn = arg;
+    struct context *ctx = conn->ctx;
+    struct gen *g = &conn->call_gen;
+    double now;
+
+    ASSERT(g->timer == t);
+
+    /* timer are freed by the timeout handler */
+    g->timer = NULL;
+
+    now = timer_now();
+
+    while (!replay_done(ctx, conn) && now >= g->next_time) {
+        g->tick_time = g->next_time;
+        replay_call(ctx, conn);
+        if (!replay_done(ctx, conn)) {
+            g->next_time = replay_next_time(ctx, conn);
+        }
+    }
+
+    if (replay_done(ctx, conn)) {
+        log_debug(LOG_DEBUG, "replayed %"PRIu32" %"PRIu32" calls on c "
+                  "%"PRIu64"", conn->ncall_create_failed,
+                  conn->ncall_created, conn->id);
+        g->done = 1;
+        if (conn->ncall_completed == conn->ncall_created) {
+            ecb_signal(ctx, EVENT_CONN_DESTROYED, conn);
+        }
+        return;
+    }
+
+    g->timer = timer_schedule(replay_tick, conn, g->next_time - now);
+}
+
+static void
+created(struct context *ctx, event_type_t type, void *rarg, void *carg)
+{
+    struct conn *conn = carg;
+
+    ASSERT(type == EVENT_CONN_CREATED);
+
+    if (conn->lead != conn) {
+        return;
+    }
+
+    conn->trace_next = replay_first(ctx, ctx->nconn_created +
+                                    ctx->nconn_create_failed - 1);
+}
+
+static void
+destroyed(struct context *ctx, event_type_t type, void *rarg, void *carg)
+{
+    struct call *call = carg;
+    struct conn *conn = call->conn->lead;
+
+    ASSERT(type == EVENT_CALL_DESTROYED);
+
+    conn->ncall_completed++;
+
+    if (replay_done(ctx, conn) &&
+        (conn->ncall_completed == conn->ncall_created)) {
+
+        log_debug(LOG_DEBUG, "completed %"PRIu32" of %"PRIu32" replayed "
+                  "calls on c %"PRIu64"", conn->ncall_completed,
+                  conn->ncall_created, conn->id);
+
+        ecb_signal(ctx, EVENT_CONN_DESTROYED, conn);
+    }
+}
+
+/*
+ * Start the replay of the share of the trace of a connection. The replay
+ * is paced by the times of the records alone, like a call generator of a
+ * given rate, and the response time is measured from the time at which a
+ * record was due. The records that fell due before the connection came up
+ * are issued at once, and their lateness is counted as pacing error.
+ */
+static void
+trigger(struct context *ctx, event_type_t type, void *rarg, void *carg)
+{
+    struct conn *conn = carg;
+    struct gen *g = &conn->call_gen;
+
+    ASSERT(type == EVENT_GEN_CALL_TRIGGER);
+    ASSERT(conn->ctx == ctx);
+
+    /* a pool replays its share of the trace on its lead */
+    if (conn->lead != conn) {
+        return;
+    }
+
+    g->ctx = ctx;
+    g->di = NULL;
+    g->timer = NULL;
+    g->tickname = "replay_tick";
+    g->tick = NULL;
+    g->arg = conn;
+    g->start_time = timer_now();
+    g->tick_time = g->start_time;
+    g->oneshot = 0;
+    g->done = 0;
+
+    if (replay_done(ctx, conn)) {
+        g->done = 1;
+        ecb_signal(ctx, EVENT_CONN_DESTROYED, conn);
+        return;
+    }
+
+    g->next_time = replay_next_time(ctx, conn);
+    g->timer = timer_schedule(replay_tick, conn,
+                              MAX(g->next_time - timer_now(), 0.0));
+}
+
+static void
+init(struct context *ctx, void *arg)
+{
+    if (ctx->opt.replay_filename == NULL) {
+        return;
+    }
+
+    ecb_register(ctx, EVENT_CONN_CREATED, created, NULL);
+    ecb_register(ctx, EVENT_CALL_DESTROYED, destroyed, NULL);
+    ecb_register(ctx, EVENT_GEN_CALL_TRIGGER, trigger, NULL);
+}
+
+static void
+no_op(struct context *ctx, void *arg)
+{
+    /* do nothing */
+}
+
+/*
+ * Replay generator issues the calls of the records of a trace on a given
+ * connection, in place of the call generator, at the times at which they
+ * were captured.
+ */
+struct load_generator replay_generator = {
+    "replay the calls of a trace on a connection",
+    init,
+    no_op,
+    no_op,
+    no_op
+};
@@ -35,30 +35,74 @@ static int show_version;
 #define MCP_SERVER           "localhost"
 #define MCP_PORT             11211
 
+#define MCP_SERVER_DIST_STR  "ketama"
+#define MCP_SERVER_DIST      SERVER_DIST_KETAMA
+
 #define MCP_CLIENT_ID        0
 #define MCP_CLIENT_N         1
 
 #define MCP_METHOD_STR       "set"
 #define MCP_METHOD           REQ_SET
 
+#define MCP_PROTOCOL_STR     "ascii"
+#define MCP_PROTOCOL         PROTOCOL_ASCII
+
 #define MCP_EXPIRY_STR       "0"
 #define MCP_EXPIRY           0
 
+#define MCP_NUM_KEYS         0
+#define MCP_NUM_KEYS_STR     "unbounded"
+
+#define MCP_KEY_DIST_STR     "sequential"
+#define MCP_KEY_DIST         KEY_DIST_SEQUENTIAL
+
+#define MCP_MULTIGET_STR     "1"
+#define MCP_MULTIGET         DIST_DETERMINISTIC
+#define MCP_MULTIGET_MIN     1.0
+#define MCP_MULTIGET_MAX     1.0
+
+#define MCP_RECORD_SAMPLE    1.0
+#define MCP_RECORD_SAMPLE_STR "1"
+
+#define MCP_REPLAY_SPEED     1.0
+#define MCP_REPLAY_SPEED_STR "1"
+
 #define MCP_PREFIX           "mcp:"
 #define MCP_PREFIX_LEN       CALL_PREFIX_LEN
 
+#define MCP_HIST_DIGITS      3
+
+#define MCP_OUTPUT_FORMAT_STR "human"
+#define MCP_OUTPUT_FORMAT    OUTPUT_FORMAT_HUMAN
+
 #define MCP_TIMEOUT          0.0
 #define MCP_TIMEOUT_STR      "0.0"
 
+#define MCP_REPORT_INTERVAL  0.0
+#define MCP_REPORT_INTERVAL_STR "off"
+
+#define MCP_DURATION         0.0
+#define MCP_DURATION_STR     "off"
+
+#define MCP_WARMUP           0.0
+#define MCP_WARMUP_STR       "off"
+
 #define MCP_LINGER_STR       "off"
 #define MCP_LINGER           0
 
 #define MCP_SEND_BUFSIZE     4096
 #define MCP_RECV_BUFSIZE     16384
 
+#define MCP_EVENT_ENGINE_STR "epoll"
+#define MCP_EVENT_ENGINE     EVENT_ENGINE_EPOLL
+
+#define MCP_NUM_THREADS      1
+
 #define MCP_NUM_CONNS        1
 #define MCP_NUM_CALLS        1
 
+#define MCP_PIPELINE         1
+
 #define MCP_CONN_DIST_STR    "0"
 #define MCP_CONN_DIST        DIST_NONE
 #define MCP_CONN_DIST_MIN    0.0
@@ -83,81 +127,136 @@ static struct option long_options[] = {
     { "output",             required_argument,  NULL,   'o' },
     { "server",             required_argument,  NULL,   's' },
     { "port",               required_argument,  NULL,   'p' },
+    { "distribution",       required_argument,  NULL,   'd' },
     { "print-histogram",    no_argument,        NULL,   'H' },
+    { "hist-digits",        required_argument,  NULL,   'g' },
+    { "output-format",      required_argument,  NULL,   'f' },
+    { "result-file",        required_argument,  NULL,   'w' },
+    { "record",             required_argument,  NULL,   'L' },
+    { "record-sample",      required_argument,  NULL,   'Z' },
     { "timeout",            required_argument,  NULL,   't' },
+    { "report-interval",    required_argument,  NULL,   'i' },
+    { "duration",           required_argument,  NULL,   'T' },
+    { "warmup",             required_argument,  NULL,   'W' },
     { "linger",             required_argument,  NULL,   'l' },
     { "send-buffer",        required_argument,  NULL,   'b' },
     { "recv-buffer",        required_argument,  NULL,   'B' },
     { "disable-nodelay",    no_argument,        NULL,   'D' },
+    { "event-engine",       required_argument,  NULL,   'E' },
+    { "hires-pacing",       no_argument,        NULL,   'X' },
     { "method",             required_argument,  NULL,   'm' },
+    { "protocol",           required_argument,  NULL,   'y' },
     { "expiry",             required_argument,  NULL,   'e' },
     { "use-noreply",        no_argument,        NULL,   'q' },
+    { "multiget",           required_argument,  NULL,   'M' },
     { "prefix",             required_argument,  NULL,   'P' },
+    { "keys",               required_argument,  NULL,   'K' },
+    { "key-dist",           required_argument,  NULL,   'k' },
+    { "replay",             required_argument,  NULL,   'F' },
+    { "replay-speed",       required_argument,  NULL,   'S' },
     { "client",             required_argument,  NULL,   'c' },
+    { "threads",            required_argument,  NULL,   'j' },
     { "num-conns",          required_argument,  NULL,   'n' },
     { "num-calls",          required_argument,  NULL,   'N' },
+    { "pipeline",           required_argument,  NULL,   'O' },
     { "conn-rate",          required_argument,  NULL,   'r' },
     { "call-rate",          required_argument,  NULL,   'R' },
     { "sizes",              required_argument,  NULL,   'z' },
     { NULL,                 0,                  NULL,    0  }
 };
 
-static char short_options[] = "hVv:o:s:p:Ht:l:b:B:Dm:e:qP:c:n:N:r:R:z:";
+static char short_options[] = "hVv:o:s:p:d:Hg:f:w:L:Z:t:i:T:W:l:b:B:DE:Xm:y:e:qM:P:K:k:F:S:c:j:n:N:O:r:R:z:";
 
 static void
 mcp_show_usage(void)
 {
     log_stderr(
         "Usage: mcperf [-?hV] [-v verbosity level] [-o output file]" CRLF
-        "              [-s server] [-p port] [-H] [-t timeout] [-l linger]" CRLF
-        "              [-b send-buffer] [-B recv-buffer] [-D]" CRLF
-        "              [-m method] [-e expiry] [-q] [-P prefix]" CRLF
-        "              [-c client] [-n num-conns] [-N num-calls]" CRLF
-        "              [-r conn-rate] [-R call-rate] [-z sizes]" CRLF
+        "              [-s server] [-p port] [-d distribution] [-H]" CRLF
+        "              [-g hist-digits] [-f output-format] [-w result-file]" CRLF
+        "              [-L record] [-Z record-sample] [-t timeout]" CRLF
+        "              [-i report-interval] [-T duration] [-W warmup]" CRLF
+        "              [-l linger] [-b send-buffer] [-B recv-buffer] [-D]" CRLF
+        "              [-E event-engine] [-X] [-m method]" CRLF
+        "              [-y protocol] [-e expiry] [-q] [-M multiget] [-P prefix]" CRLF
+        "              [-K keys] [-k key-dist] [-F replay] [-S replay-speed]" CRLF
+        "              [-c client] [-j threads] [-n num-conns] [-N num-calls]" CRLF
+        "              [-O pipeline] [-r conn-rate] [-R call-rate] [-z sizes]" CRLF
         "" CRLF
         "Options:" CRLF
         "  -h, --help            : this help" CRLF
         "  -V, --version         : show version and exit" CRLF
         "  -v, --verbosity=N     : set logging level (default: %d, min: %d, max: %d)" CRLF
         "  -o, --output=S        : set logging file (default: %s)" CRLF
-        "  -s, --server=S        : set the hostname of the server (default: %s)" CRLF
-        "  -p, --port=N          : set the port number of the server (default: %d)" CRLF
+        "  ...",
+        MCP_LOG_DEFAULT, MCP_LOG_MIN, MCP_LOG_MAX, MCP_LOG_PATH);
+
+    log_stderr(
+        "  -s, --server=S        : set the hostname of the server, or a list of servers written as host[:port[:weight]][,...] (default: %s)" CRLF
+        "  -p, --port=N          : set the port number of the servers listed without one (default: %d)" CRLF
+        "  -d, --distribution=S  : set the distribution of the keys over the servers to 'ketama', 'modula' or 'random' (default: %s)" CRLF
         "  -H, --print-histogram : print response time histogram" CRLF
+        "  -g, --hist-digits=N   : set the significant digits of the time histograms (default: %d, min: %d, max: %d)" CRLF
+        "  -f, --output-format=S : print stats as 'human' text on stderr, or as 'json' or 'csv' records on stdout (default: %s)" CRLF
+        "  -w, --result-file=S   : write the stats to a result file for mcperf-merge (default: off)" CRLF
+        "  -L, --record=S        : write a record of every sampled call to a record file for mcperf-tail (default: off)" CRLF
+        "  -Z, --record-sample=X : set the fraction of calls recorded with -L (default: %s)" CRLF
         "  ...",
-        MCP_LOG_DEFAULT, MCP_LOG_MIN, MCP_LOG_MAX, MCP_LOG_PATH,
-        MCP_SERVER, MCP_PORT);
+        MCP_SERVER, MCP_PORT, MCP_SERVER_DIST_STR,
+        MCP_HIST_DIGITS, HIST_MIN_DIGITS, HIST_MAX_DIGITS,
+        MCP_OUTPUT_FORMAT_STR, MCP_RECORD_SAMPLE_STR);
 
     log_stderr(
         "  -t, --timeout=X       : set the connection and response timeout in sec (default: %s sec)" CRLF
+        "  -i, --report-interval=X : print rates, errors and response time percentiles every X sec (default: %s)" CRLF
+        "  -T, --duration=X      : stop making connections and calls after X sec, and end the test once the calls in flight drain (default: %s)" CRLF
+        "  -W, --warmup=X        : discard the stats gathered in the first X sec of the test (default: %s)" CRLF
         "  -l, --linger=N        : set the linger timeout in sec, when closing TCP connections (default: %s)" CRLF
         "  -b, --send-buffer=N   : set socket send buffer size (default: %d bytes)" CRLF
         "  -B, --recv-buffer=N   : set socket recv buffer size (default: %d bytes)" CRLF
         "  -D, --disable-nodelay : disable tcp nodelay" CRLF
+        "  -E, --event-engine=S  : set the event engine to 'epoll', 'uring' or 'uring-sqpoll' (default: %s)" CRLF
+        "  -X, --hires-pacing    : pace the connection and call rates with usec timers, spinning before each tick" CRLF
         "  ...",
-        MCP_TIMEOUT_STR, MCP_LINGER_STR,
-        MCP_SEND_BUFSIZE, MCP_RECV_BUFSIZE
+        MCP_TIMEOUT_STR, MCP_REPORT_INTERVAL_STR, MCP_DURATION_STR,
+        MCP_WARMUP_STR, MCP_LINGER_STR,
+        MCP_SEND_BUFSIZE, MCP_RECV_BUFSIZE,
+        MCP_EVENT_ENGINE_STR
         );
 
     log_stderr(
-        "  -m, --method=M        : set the method to use when issuing memcached request (default: %s)" CRLF
+        "  -m, --method=M        : set the method, or the weighted mix of methods, to use when issuing memcached request (default: %s)" CRLF
+        "  -y, --protocol=S      : set the protocol to 'ascii', 'binary' or 'meta' (default: %s)" CRLF
         "  -e, --expiry=N        : set the expiry value in sec for generated requests (default: %s sec)" CRLF
         "  -q, --use-noreply     : set noreply for generated requests" CRLF
+        "  -M, --multiget=R      : set the distribution for the number of keys of get and gets requests (default: %s keys)" CRLF
         "  -P, --prefix=S        : set the prefix of generated keys (default: %s)" CRLF
+        "  -K, --keys=N          : set the number of distinct keys to generate (default: %s)" CRLF
+        "  -k, --key-dist=K      : set the distribution of the keys over the key space (default: %s)" CRLF
+        "  ...",
+        MCP_METHOD_STR, MCP_PROTOCOL_STR, MCP_EXPIRY_STR, MCP_MULTIGET_STR,
+        MCP_PREFIX, MCP_NUM_KEYS_STR, MCP_KEY_DIST_STR
+        );
+
+    log_stderr(
+        "  -F, --replay=S        : replay the requests of a trace file written by mcperf-klog (default: off)" CRLF
+        "  -S, --replay-speed=X  : set the speed up of the replay of a trace (default: %sx)" CRLF
         "  ...",
-        MCP_METHOD_STR, MCP_EXPIRY_STR,
-        MCP_PREFIX
+        MCP_REPLAY_SPEED_STR
         );
 
     log_stderr(
         "  -c, --client=I/N      : set mcperf instance to be I out of total N instances (default: %d/%d)" CRLF
+        "  -j, --threads=N       : set the number of worker threads to split the connections over (default: %d)" CRLF
         "  -n, --num-conns=N     : set the number of connections to create (default: %d)" CRLF
         "  -N, --num-calls=N     : set the number of calls to create on each connection (default: %d)" CRLF
+        "  -O, --pipeline=N      : keep N calls in flight on each connection, issuing a call as soon as one completes (default: %d)" CRLF
         "  -r, --conn-rate=R     : set the connection creation rate (default: %s conns/sec) "CRLF
         "  -R, --call-rate=R     : set the call creation rate (default: %s calls/sec)" CRLF
         "  -z, --sizes=R         : set the distribution for item sizes (default: %s bytes)" CRLF
         "  ...",
-        MCP_CLIENT_ID, MCP_CLIENT_N, MCP_NUM_CONNS, MCP_NUM_CALLS,
-        MCP_CONN_DIST_STR, MCP_CALL_DIST_STR, MCP_SIZE_DIST_STR
+        MCP_CLIENT_ID, MCP_CLIENT_N, MCP_NUM_THREADS, MCP_NUM_CONNS, MCP_NUM_CALLS,
+        MCP_PIPELINE, MCP_CONN_DIST_STR, MCP_CALL_DIST_STR, MCP_SIZE_DIST_STR
         );
 
     log_stderr(
@@ -166,7 +265,8 @@ mcp_show_usage(void)
         "  X is a real" CRLF
         "  S is a string" CRLF
         "  M is a method string and is either a 'get', 'gets', 'delete', 'cas', 'set', 'add', 'replace'" CRLF
-        "  'append', 'prepend', 'incr', 'decr'" CRLF
+        "  'append', 'prepend', 'incr', 'decr', or a mix of methods written as M1:W1[,M2:W2]... where" CRLF
+        "  W is the relative weight of the method, e.g. get:90,set:9,delete:1" CRLF
         "  R is the rate written as [D]R1[,R2] where:" CRLF
         "  D is the distribution type and is either deterministic 'd', uniform 'u', or exponential 'e' and if:" CRLF
         "  D is ommited or set to 'd', a deterministic interval specified by parameter R1 is used" CRLF
@@ -175,12 +275,22 @@ mcp_show_usage(void)
         "  R is 0, the next request or connection is created after the previous one completes" CRLF
         "  "
         );
+
+    log_stderr(
+        "  K is the key distribution and is either 'sequential', 'uniform', 'zipf[:T]', 'hotspot[:X,Y]'" CRLF
+        "  or 'latest[:T]' where:" CRLF
+        "  T is the zipf exponent (default: 0.99)" CRLF
+        "  X is the percentage of hot keys that take Y percent of the requests (default: 20,80)" CRLF
+        "  latest reads the keys most recently written by set and add requests, with zipf popularity" CRLF
+        "  "
+        );
 }
 
 static void
 mcp_set_default_options(struct context *ctx)
 {
     struct opt *opt = &ctx->opt;
+    uint32_t i;
 
     opt->log_level = MCP_LOG_DEFAULT;
     opt->log_filename = NULL;
@@ -188,27 +298,60 @@ mcp_set_default_options(struct context *ctx)
     /* default server info */
     opt->server = MCP_SERVER;
     opt->port = MCP_PORT;
-    memset(&opt->si, 0, sizeof(opt->si));
+    opt->server_dist = MCP_SERVER_DIST;
+    memset(&opt->pool, 0, sizeof(opt->pool));
 
     opt->print_histogram = 0;
+    opt->hist_digits = MCP_HIST_DIGITS;
+    opt->output_format = MCP_OUTPUT_FORMAT;
+    opt->result_filename = NULL;
 
     opt->timeout = MCP_TIMEOUT;
+    opt->report_interval = MCP_REPORT_INTERVAL;
+    opt->duration = MCP_DURATION;
+    opt->warmup = MCP_WARMUP;
     /* opt->linger_timeout is don't-care when lingering is off */
     opt->linger = MCP_LINGER;
     opt->send_buf_size = MCP_SEND_BUFSIZE;
     opt->recv_buf_size = MCP_RECV_BUFSIZE;
     opt->disable_nodelay = 0;
+    opt->engine = MCP_EVENT_ENGINE;
+    opt->hires_pacing = 0;
 
     opt->method = MCP_METHOD;
+    opt->protocol = MCP_PROTOCOL;
+    opt->nmethod = 1;
+    for (i = 0; i < REQ_MAX_TYPES; i++) {
+        opt->method_weight[i] = 0.0;
+    }
+    opt->method_weight[MCP_METHOD] = 1.0;
     opt->expiry = MCP_EXPIRY;
     opt->use_noreply = 0;
+    opt->multiget = 0;
+    opt->mget_dopt.type = MCP_MULTIGET;
+    opt->mget_dopt.min = MCP_MULTIGET_MIN;
+    opt->mget_dopt.max = MCP_MULTIGET_MAX;
+    opt->key_opt.type = MCP_KEY_DIST;
+    opt->key_opt.nkey = MCP_NUM_KEYS;
+    opt->key_opt.theta = KEY_ZIPF_THETA;
+    opt->key_opt.hot_keys = KEY_HOT_KEYS;
+    opt->key_opt.hot_ops = KEY_HOT_OPS;
     opt->prefix.data = MCP_PREFIX;
     opt->prefix.len = sizeof(MCP_PREFIX) - 1;
+    opt->record_filename = NULL;
+    opt->record_sample = MCP_RECORD_SAMPLE;
+    opt->record.fd = -1;
+    opt->replay_filename = NULL;
+    opt->replay_speed = MCP_REPLAY_SPEED;
+    opt->trace.fd = -1;
 
     /* default client id */
     opt->client.id = MCP_CLIENT_ID;
     opt->client.n = MCP_CLIENT_N;
 
+    /* default worker threads */
+    opt->num_threads = MCP_NUM_THREADS;
+
     /* default connection generator */
     opt->num_conns = MCP_NUM_CONNS;
     opt->conn_dopt.type = MCP_CONN_DIST;
@@ -217,6 +360,7 @@ mcp_set_default_options(struct context *ctx)
 
     /* default call generator */
     opt->num_calls = MCP_NUM_CALLS;
+    opt->pipeline = MCP_PIPELINE;
     opt->call_dopt.type = MCP_CALL_DIST;
     opt->call_dopt.min = MCP_CALL_DIST_MIN;
     opt->call_dopt.max = MCP_CALL_DIST_MAX;
@@ -327,26 +471,193 @@ mcp_get_dist_opt(struct dist_opt *dopt, char *line)
     return MCP_OK;
 }
 
+static req_type_t
+mcp_get_method_type(char *name)
+{
+    size_t namelen = strlen(name);
+    struct string *str;
+
+    for (str = req_strings; str->data != NULL; str++) {
+        if ((str->len - 1 == namelen) &&
+            strncmp(str->data, name, namelen) == 0) {
+            return (req_type_t)(str - req_strings);
+        }
+    }
+
+    return REQ_MAX_TYPES;
+}
+
 static rstatus_t
 mcp_get_method(struct context *ctx, char *line)
 {
     struct opt *opt = &ctx->opt;
-    size_t linelen = strlen(line);
-    struct string *str;
+    char *name, *pos, *weight;
+    req_type_t type;
+    double value;
+    uint32_t i;
 
-    for (str = req_strings; str->data != NULL; str++) {
-        if ((str->len - 1 == linelen) &&
-            strncmp(str->data, line, linelen) == 0) {
-            opt->method = str - req_strings;
-            return MCP_OK;
+    for (i = 0; i < REQ_MAX_TYPES; i++) {
+        opt->method_weight[i] = 0.0;
+    }
+    opt->nmethod = 0;
+
+    /*
+     * Parse a method, or a mix of methods with their weights, specified as:
+     *   --method M1[:W1][,M2:W2]...
+     */
+    for (name = line; name != NULL; name = pos) {
+        pos = strchr(name, ',');
+        if (pos != NULL) {
+            *pos++ = '\0';
+        }
+
+        weight = strchr(name, ':');
+        if (weight != NULL) {
+            *weight++ = '\0';
+        }
+
+        type = mcp_get_method_type(name);
+        if (type == REQ_MAX_TYPES) {
+            log_stderr("mcperf: '%s' is an invalid method; valid methods are "
+                       "get, gets, delete, cas, set, add, replace, prepend, "
+                       "incr and decr", name);
+            return MCP_ERROR;
+        }
+
+        if (opt->method_weight[type] > 0.0) {
+            log_stderr("mcperf: method '%s' is repeated in the mix", name);
+            return MCP_ERROR;
+        }
+
+        value = weight != NULL ? mcp_atod(weight) : 1.0;
+        if (value <= 0.0) {
+            log_stderr("mcperf: invalid weight '%s' of method '%s'", weight,
+                       name);
+            return MCP_ERROR;
+        }
+
+        if (opt->nmethod == 0) {
+            opt->method = type;
+        }
+        opt->method_weight[type] = value;
+        opt->nmethod++;
+    }
+
+    return MCP_OK;
+}
+
+static rstatus_t
+mcp_get_multiget_opt(struct opt *opt, char *line)
+{
+    struct dist_opt *dopt = &opt->mget_dopt;
+    rstatus_t status;
+    int value;
+
+    /*
+     * Parse the # keys of a multiget specified either as a plain number
+     * of keys or as a distribution:
+     *   --multiget N
+     *   --multiget [d|u|e]N1[,N2]
+     */
+    value = mcp_atoi(line);
+    if (value > 0) {
+        dopt->type = DIST_DETERMINISTIC;
+        dopt->min = value;
+        dopt->max = value;
+    } else {
+        status = mcp_get_dist_opt(dopt, line);
+        if (status != MCP_OK) {
+            return status;
+        }
+        if (dopt->type == DIST_NONE) {
+            log_stderr("mcperf: invalid number of multiget keys '%s'", line);
+            return MCP_ERROR;
         }
     }
 
-    log_stderr("mcperf: '%s' is an invalid method; valid methods are get, "
-               "gets, delete, cas, set, add, replace, prepend, incr and "
-               "decr", line);
+    /* exponential and sequential values are capped instead */
+    if ((dopt->type == DIST_DETERMINISTIC || dopt->type == DIST_UNIFORM) &&
+        dopt->max > CALL_MULTIGET_MAX) {
+        log_stderr("mcperf: multiget cannot exceed %d keys",
+                   CALL_MULTIGET_MAX);
+        return MCP_ERROR;
+    }
+
+    opt->multiget = (dopt->type != DIST_DETERMINISTIC || dopt->min != 1.0);
+
+    return MCP_OK;
+}
+
+static rstatus_t
+mcp_get_key_opt(struct key_opt *kopt, char *line)
+{
+    char *arg, *pos;
+
+    /*
+     * Parse the key distribution specified as:
+     *   --key-dist name[:A1[,A2]]
+     */
+    arg = strchr(line, ':');
+    if (arg != NULL) {
+        *arg++ = '\0';
+    }
+
+    kopt->type = key_dist_type(line);
+
+    switch (kopt->type) {
+    case KEY_DIST_SEQUENTIAL:
+    case KEY_DIST_UNIFORM:
+        if (arg != NULL) {
+            log_stderr("mcperf: key distribution '%s' takes no parameters",
+                       line);
+            return MCP_ERROR;
+        }
+        break;
+
+    case KEY_DIST_ZIPF:
+    case KEY_DIST_LATEST:
+        if (arg == NULL) {
+            break;
+        }
+        kopt->theta = mcp_atod(arg);
+        if (kopt->theta <= 0.0) {
+            log_stderr("mcperf: invalid zipf exponent '%s'", arg);
+            return MCP_ERROR;
+        }
+        break;
+
+    case KEY_DIST_HOTSPOT:
+        if (arg == NULL) {
+            break;
+        }
+        pos = strchr(arg, ',');
+        if (pos == NULL) {
+            log_stderr("mcperf: invalid hotspot value '%s'", arg);
+            return MCP_ERROR;
+        }
+        *pos++ = '\0';
+
+        kopt->hot_keys = mcp_atod(arg) / 100.0;
+        if (kopt->hot_keys <= 0.0 || kopt->hot_keys > 1.0) {
+            log_stderr("mcperf: invalid percentage of hot keys '%s'", arg);
+            return MCP_ERROR;
+        }
+
+        kopt->hot_ops = mcp_atod(pos) / 100.0;
+        if (kopt->hot_ops < 0.0 || kopt->hot_ops > 1.0) {
+            log_stderr("mcperf: invalid percentage of hot requests '%s'", pos);
+            return MCP_ERROR;
+        }
+        break;
+
+    default:
+        log_stderr("mcperf: '%s' is an invalid key distribution; valid key "
+                   "distributions are sequential, uniform, zipf, hotspot and "
+                   "latest", line);
+        return MCP_ERROR;
+    }
 
-    return MCP_ERROR;
+    return MCP_OK;
 }
 
 static rstatus_t
@@ -411,19 +722,89 @@ mcp_get_options(struct context *ctx, int argc, char **argv)
             opt->port = (uint16_t)value;
             break;
 
+        case 'd':
+            opt->server_dist = server_dist_type(optarg);
+            if (opt->server_dist == SERVER_DIST_SENTINEL) {
+                log_stderr("mcperf: invalid server distribution '%s'", optarg);
+                return MCP_ERROR;
+            }
+            break;
+
         case 'H':
             opt->print_histogram = 1;
             break;
 
+        case 'g':
+            value = mcp_atoi(optarg);
+            if (value < HIST_MIN_DIGITS || value > HIST_MAX_DIGITS) {
+                log_stderr("mcperf: option -g requires a number between %d "
+                           "and %d", HIST_MIN_DIGITS, HIST_MAX_DIGITS);
+                return MCP_ERROR;
+            }
+            opt->hist_digits = (uint32_t)value;
+            break;
+
+        case 'f':
+            opt->output_format = output_format_type(optarg);
+            if (opt->output_format == OUTPUT_FORMAT_SENTINEL) {
+                log_stderr("mcperf: invalid output format '%s'", optarg);
+                return MCP_ERROR;
+            }
+            break;
+
+        case 'w':
+            opt->result_filename = optarg;
+            break;
+
+        case 'L':
+            opt->record_filename = optarg;
+            break;
+
+        case 'Z':
+            real = mcp_atod(optarg);
+            if (real <= 0.0 || real > 1.0) {
+                log_stderr("mcperf: option -Z requires a real number in (0, 1]");
+                return MCP_ERROR;
+            }
+            opt->record_sample = real;
+            break;
+
         case 't':
             real = mcp_atod(optarg);
             if (real < 0.0) {
-                log_stderr("mcperf: option -T requires a real number");
+                log_stderr("mcperf: option -t requires a real number");
                 return MCP_ERROR;
             }
             opt->timeout = real;
             break;
 
+        case 'i':
+            real = mcp_atod(optarg);
+            if (real < 0.0) {
+                log_stderr("mcperf: option -i requires a real number");
+                return MCP_ERROR;
+            }
+            opt->report_interval = real;
+            break;
+
+        case 'T':
+            real = mcp_atod(optarg);
+            if (real < 0.0) {
+                log_stderr("mcperf: option -T requires a real number");
+                return MCP_ERROR;
+            }
+            opt->duration = real;
+            break;
+
+        case 'W':
+            real = mcp_atod(optarg);
+            if (real < 0.0) {
+                log_stderr("mcperf: option -W requires a real number");
+                return MCP_ERROR;
+            }
+            opt->warmup = real;
+            break;
+
         case 'l':
             value = mcp_atoi(optarg);
             if (value < 0) {
@@ -459,6 +840,14 @@ mcp_get_options(struct context *ctx, int argc, char **argv)
             }
             break;
 
+        case 'y':
+            opt->protocol = protocol_type(optarg);
+            if (opt->protocol == PROTOCOL_SENTINEL) {
+                log_stderr("mcperf: invalid protocol '%s'", optarg);
+                return MCP_ERROR;
+            }
+            break;
+
         case 'e':
             value = mcp_atoi(optarg);
             if (value < 0) {
@@ -472,6 +861,13 @@ mcp_get_options(struct context *ctx, int argc, char **argv)
             opt->use_noreply = 1;
             break;
 
+        case 'M':
+            status = mcp_get_multiget_opt(opt, optarg);
+            if (status != MCP_OK) {
+                return status;
+            }
+            break;
+
         case 'P':
             size = strlen(optarg);
             if (size > MCP_PREFIX_LEN) {
@@ -483,6 +879,35 @@ mcp_get_options(struct context *ctx, int argc, char **argv)
             opt->prefix.len = size;
             break;
 
+        case 'K':
+            value = mcp_atoi(optarg);
+            if (value <= 0) {
+                log_stderr("mcperf: option -K requires a non-zero number");
+                return MCP_ERROR;
+            }
+            opt->key_opt.nkey = (uint32_t)value;
+            break;
+
+        case 'k':
+            status = mcp_get_key_opt(&opt->key_opt, optarg);
+            if (status != MCP_OK) {
+                return status;
+            }
+            break;
+
+        case 'F':
+            opt->replay_filename = optarg;
+            break;
+
+        case 'S':
+            real = mcp_atod(optarg);
+            if (real <= 0.0) {
+                log_stderr("mcperf: option -S requires a positive real number");
+                return MCP_ERROR;
+            }
+            opt->replay_speed = real;
+            break;
+
         case 'c':
             pos = strchr(optarg, '/');
             if (pos == NULL) {
@@ -509,6 +934,15 @@ mcp_get_options(struct context *ctx, int argc, char **argv)
             opt->client.n = (uint32_t)value;
             break;
 
+        case 'j':
+            value = mcp_atoi(optarg);
+            if (value <= 0) {
+                log_stderr("mcperf: option -j requires a positive number");
+                return MCP_ERROR;
+            }
+            opt->num_threads = (uint32_t)value;
+            break;
+
         case 'n':
             value = mcp_atoi(optarg);
             if (value < 0) {
@@ -527,6 +961,15 @@ mcp_get_options(struct context *ctx, int argc, char **argv)
             opt->num_calls = (uint32_t)value;
             break;
 
+        case 'O':
+            value = mcp_atoi(optarg);
+            if (value <= 0) {
+                log_stderr("mcperf: option -O requires a number");
+                return MCP_ERROR;
+            }
+            opt->pipeline = (uint32_t)value;
+            break;
+
         case 'r':
             status = mcp_get_dist_opt(&opt->conn_dopt, optarg);
             if (status != MCP_OK) {
@@ -545,6 +988,18 @@ mcp_get_options(struct context *ctx, int argc, char **argv)
             opt->disable_nodelay = 1;
             break;
 
+        case 'E':
+            opt->engine = event_engine_type(optarg);
+            if (opt->engine == EVENT_ENGINE_SENTINEL) {
+                log_stderr("mcperf: invalid event engine '%s'", optarg);
+                return MCP_ERROR;
+            }
+            break;
+
+        case 'X':
+            opt->hires_pacing = 1;
+            break;
+
         case 'z':
             status = mcp_get_dist_opt(&opt->size_dopt, optarg);
             if (status != MCP_OK) {
@@ -560,12 +1015,20 @@ mcp_get_options(struct context *ctx, int argc, char **argv)
         case '?':
             switch (optopt) {
             case 'o':
+            case 'w':
+            case 'L':
+            case 'F':
                 log_stderr("mcperf: option -%c requires a file name", optopt);
                 break;
 
             case 's':
+            case 'd':
+            case 'f':
+            case 'E':
             case 'm':
+            case 'y':
             case 'P':
+            case 'k':
             case 'c':
                 log_stderr("mcperf: option -%c requires a string", optopt);
                 break;
@@ -576,18 +1039,28 @@ mcp_get_options(struct context *ctx, int argc, char **argv)
             case 'b':
             case 'B':
             case 'e':
+            case 'g':
+            case 'K':
+            case 'j':
             case 'n':
             case 'N':
+            case 'O':
                 log_stderr("mcperf: option -%c requires a number", optopt);
                 break;
 
             case 't':
+            case 'i':
+            case 'T':
+            case 'W':
+            case 'Z':
+            case 'S':
                 log_stderr("mcperf: option -%c requires a real number", optopt);
                 break;
 
             case 'r':
             case 'R':
             case 'z':
+            case 'M':
                 log_stderr("mcperf: option -%c requires a distribution", optopt);
                 break;
 
@@ -603,6 +1076,44 @@ mcp_get_options(struct context *ctx, int argc, char **argv)
         }
     }
 
+    if (opt->duration > 0.0 && opt->warmup >= opt->duration) {
+        log_stderr("mcperf: warmup of %g sec leaves nothing of the test "
+                   "duration of %g sec", opt->warmup, opt->duration);
+        return MCP_ERROR;
+    }
+
+    /*
+     * A pipeline is a closed loop that issues a call whenever one completes,
+     * which neither a call rate nor the times of a trace leave room for
+     */
+    if (opt->pipeline > 1 && (opt->call_dopt.type != DIST_NONE ||
+                              opt->replay_filename != NULL)) {
+        log_stderr("mcperf: pipeline of %"PRIu32" calls requires a call rate "
+                   "of 0 and no replay", opt->pipeline);
+        return MCP_ERROR;
+    }
+
+    /*
+     * The requests of a replay are single key requests of the trace, that
+     * are dealt out to the whole connection pool, so the pool is opened at
+     * once unless a conn rate is given
+     */
+    if (opt->replay_filename != NULL) {
+        opt->multiget = 0;
+        if (opt->conn_dopt.type == DIST_NONE) {
+            opt->conn_dopt.type = DIST_DETERMINISTIC;
+            opt->conn_dopt.min = 0.0;
+            opt->conn_dopt.max = 0.0;
+        }
+        return MCP_OK;
+    }
+
+    if (opt->key_opt.type != KEY_DIST_SEQUENTIAL && opt->key_opt.nkey == 0) {
+        log_stderr("mcperf: key distribution '%s' requires the number of "
+                   "keys set with -K", key_dist_name(opt->key_opt.type));
+        return MCP_ERROR;
+    }
+
     return MCP_OK;
 }
 
@@ -618,56 +1129,71 @@ mcp_pre_run(struct context *ctx)
         return status;
     }
 
-    /* initialize buffer */
-    memset(ctx->buf1m, '0', sizeof(ctx->buf1m));
-
-    /* resolve server info */
-    status = mcp_resolve_addr(opt->server, opt->port, &opt->si);
+    /* pick the widest response scanner the cpu supports */
+    status = scan_init(scan_best());
     if (status != MCP_OK) {
         return status;
     }
 
-    /*
-     * Initialize distribution for {conn, call, size} load generators with
-     * either default or user-supplied values.
-     */
-    dist_init(&ctx->conn_dist, opt->conn_dopt.type, opt->conn_dopt.min,
-              opt->conn_dopt.max, opt->client.id);
-
-    dist_init(&ctx->call_dist, opt->call_dopt.type, opt->call_dopt.min,
-              opt->call_dopt.max, opt->client.id);
-
-    dist_init(&ctx->size_dist, opt->size_dopt.type, opt->size_dopt.min,
-              opt->size_dopt.max, opt->client.id);
+    /* map the trace to replay */
+    if (opt->replay_filename != NULL) {
+        status = trace_open(&opt->trace, opt->replay_filename);
+        if (status != MCP_OK) {
+            return status;
+        }
+    }
 
-    /* initialize stats subsystem */
-    stats_init(ctx);
+    /* map the file to record the calls into */
+    if (opt->record_filename != NULL) {
+        status = record_open(&opt->record, opt->record_filename,
+                             opt->num_threads, opt->record_sample);
+        if (status != MCP_OK) {
+            return status;
+        }
+    }
 
-    /* initialize timer */
-    timer_init();
+    /* resolve the servers and map the keys on them */
+    status = server_pool_init(&opt->pool, opt->server, opt->port,
+                              opt->server_dist, &opt->prefix);
+    if (status != MCP_OK) {
+        return status;
+    }
 
-    /* initialize core */
-    status = core_init(ctx);
+    /*
+     * Initialize the stats subsystem and timer of the main context; these
+     * aggregate the statistics of the workers and measure the test duration.
+     * Every worker initializes its own core when it starts.
+     */
+    status = stats_init(ctx);
     if (status != MCP_OK) {
         return status;
     }
 
+    timer_init(TIMER_INTERVAL);
+
     return MCP_OK;
 }
 
-static void
+static rstatus_t
 mcp_run(struct context *ctx)
 {
     rstatus_t status;
 
-    core_start(ctx);
+    status = core_run(ctx);
 
-    for (;;) {
-        status = core_loop(ctx);
-        if (status != MCP_OK) {
-            break;
-        }
+    stats_dump(ctx);
+
+    if (ctx->opt.record_filename != NULL && record_close(ctx) != MCP_OK) {
+        status = MCP_ERROR;
     }
+
+    if (ctx->opt.replay_filename != NULL) {
+        trace_close(&ctx->opt.trace);
+    }
+
+    server_pool_deinit(&ctx->opt.pool);
+
+    return status;
 }
 
 int
@@ -697,7 +1223,10 @@ main(int argc, char **argv)
         exit(1);
     }
 
-    mcp_run(&ctx);
+    status = mcp_run(&ctx);
+    if (status != MCP_OK) {
+        exit(1);
+    }
 
     return 0;
 }
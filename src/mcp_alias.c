@@ -0,0 +1,120 @@
+/*
+ *  twemperf - a tool for measuring memcached server performance.
+ *  Copyright (C) 2011 Twitter, Inc.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <stdlib.h>
+
+#include <mcp_core.h>
+
+/*
+ * Build the alias table of the n outcomes with the given weights, at
+ * least one of which is positive, with Vose's method: the columns that
+ * are under full are topped up from the ones that are over full, in a
+ * single pass over both lists.
+ */
+rstatus_t
+alias_init(struct alias *a, double *weight, uint32_t n, uint32_t id)
+{
+    uint32_t *small, *large;
+    uint32_t nsmall, nlarge;
+    uint32_t i, s, l;
+    double sum;
+
+    ASSERT(n > 0);
+
+    a->n = n;
+    a->xsubi[0] = (uint16_t)(0x330e ^ id);
+    a->xsubi[1] = (uint16_t)(0xabcd ^ (id << 8));
+    a->xsubi[2] = (uint16_t)(0x4321 ^ ~id);
+
+    a->prob = mcp_alloc(sizeof(*a->prob) * n);
+    a->alias = mcp_alloc(sizeof(*a->alias) * n);
+    if (a->prob == NULL || a->alias == NULL) {
+        alias_deinit(a);
+        return MCP_ENOMEM;
+    }
+
+    /* work lists of the under and over full columns */
+    small = mcp_alloc(sizeof(*small) * 2 * n);
+    if (small == NULL) {
+        alias_deinit(a);
+        return MCP_ENOMEM;
+    }
+    large = small + n;
+
+    for (sum = 0.0, i = 0; i < n; i++) {
+        ASSERT(weight[i] >= 0.0);
+        sum += weight[i];
+    }
+    ASSERT(sum > 0.0);
+
+    nsmall = nlarge = 0;
+    for (i = 0; i < n; i++) {
+        a->prob[i] = weight[i] * n / sum;
+        a->alias[i] = i;
+        if (a->prob[i] < 1.0) {
+            small[nsmall++] = i;
+        } else {
+            large[nlarge++] = i;
+        }
+    }
+
+    while (nsmall > 0 && nlarge > 0) {
+        s = small[--nsmall];
+        l = large[nlarge - 1];
+
+        a->alias[s] = l;
+        a->prob[l] -= 1.0 - a->prob[s];
+        if (a->prob[l] < 1.0) {
+            nlarge--;
+            small[nsmall++] = l;
+        }
+    }
+
+    /* what is left over is full, up to rounding errors */
+    while (nlarge > 0) {
+        a->prob[large[--nlarge]] = 1.0;
+    }
+    while (nsmall > 0) {
+        a->prob[small[--nsmall]] = 1.0;
+    }
+
+    mcp_free(small);
+
+    return MCP_OK;
+}
+
+void
+alias_deinit(struct alias *a)
+{
+    if (a->prob != NULL) {
+        mcp_free(a->prob);
+    }
+    if (a->alias != NULL) {
+        mcp_free(a->alias);
+    }
+}
+
+uint32_t
+alias_next(struct alias *a)
+{
+    double u = erand48(a->xsubi) * a->n;
+    uint32_t i = MIN((uint32_t)u, a->n - 1);
+
+    return (u - i) < a->prob[i] ? i : a->alias[i];
+}
@@ -0,0 +1,41 @@
+/*
+ *  twemperf - a tool for measuring memcached server performance.
+ *  Copyright (C) 2011 Twitter, Inc.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _MCP_ALIAS_H_
+#define _MCP_ALIAS_H_
+
+/*
+ * An alias table samples one of n outcomes with arbitrary weights in
+ * constant time (Walker's alias method). Each outcome owns a column of
+ * probability 1/n, which is split between the outcome itself and one
+ * alias outcome. A uniform variate picks a column by its integer part
+ * and, by its fraction, either the column or its alias.
+ */
+struct alias {
+    uint32_t    n;          /* # outcomes */
+    double      *prob;      /* probability of keeping a column */
+    uint32_t    *alias;     /* alias outcome of a column */
+    uint16_t    xsubi[3];   /* erand48 seed */
+};
+
+rstatus_t alias_init(struct alias *a, double *weight, uint32_t n, uint32_t id);
+void alias_deinit(struct alias *a);
+uint32_t alias_next(struct alias *a);
+
+#endif
@@ -16,11 +16,16 @@
  *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <limits.h>
+#include <sys/uio.h>
+
 #include <mcp_core.h>
 
-static int nfree_callq;            /* # free call q */
-static struct call_tqh free_callq; /* free call q */
-static uint64_t id;                /* call id counter */
+/* calls are owned by the worker thread that created them */
+static __thread int nfree_callq;                /* # free call q */
+static __thread struct call_tqh free_callq;     /* free call q */
+static __thread uint64_t id;                    /* call id counter */
+static __thread struct iovec send_iov[IOV_MAX]; /* send q iovec */
 
 #define DEFINE_ACTION(_type, _name) { _name, sizeof(_name) - 1 },
 struct string req_strings[] = {
@@ -45,6 +50,65 @@ struct string msg_strings[] = {
 };
 #undef DEFINE_ACTION
 
+#define DEFINE_ACTION(_type, _op, _opq) { _op, _opq },
+static struct {
+    uint8_t op;                                 /* opcode */
+    uint8_t opq;                                /* quiet opcode */
+} bin_opcodes[] = {
+    BIN_CODEC( DEFINE_ACTION )
+};
+#undef DEFINE_ACTION
+
+#define DEFINE_ACTION(_type, _name, _mode) { _name, sizeof(_name) - 1 },
+static struct string meta_strings[] = {
+    META_CODEC( DEFINE_ACTION )
+    { NULL, 0 }
+};
+#undef DEFINE_ACTION
+
+#define DEFINE_ACTION(_type, _name, _mode) _mode,
+static char meta_modes[] = {
+    META_CODEC( DEFINE_ACTION )
+};
+#undef DEFINE_ACTION
+
+#define DEFINE_ACTION(_type, _name) { _name, sizeof(_name) - 1 },
+static struct string meta_rsp_strings[] = {
+    META_RSP_CODEC( DEFINE_ACTION )
+    { NULL, 0 }
+};
+#undef DEFINE_ACTION
+
+static char *protocol_names[] = {               /* protocol names */
+    "ascii",                                    /* PROTOCOL_ASCII */
+    "binary",                                   /* PROTOCOL_BINARY */
+    "meta",                                     /* PROTOCOL_META */
+    NULL
+};
+
+char *
+protocol_name(protocol_type_t protocol)
+{
+    ASSERT(protocol >= PROTOCOL_ASCII && protocol < PROTOCOL_SENTINEL);
+
+    return protocol_names[protocol];
+}
+
+protocol_type_t
+protocol_type(char *name)
+{
+    protocol_type_t protocol;
+
+    for (protocol = PROTOCOL_ASCII; protocol < PROTOCOL_SENTINEL;
+         protocol++) {
+        if (strcmp(name, protocol_names[protocol]) == 0) {
+            break;
+        }
+    }
+
+    return protocol;
+}
+
 struct call *
 call_get(struct conn *conn)
 {
@@ -63,15 +127,29 @@ call_get(struct conn *conn)
         if (call == NULL) {
             return NULL;
         }
+        call->req.keys = NULL;
+    }
+
+    /*
+     * call->req.keys is preserved across reuse; it fits the keys of a
+     * multiget in any protocol
+     */
+    if (conn->ctx->opt.multiget && call->req.keys == NULL) {
+        call->req.keys = mcp_alloc(CALL_MULTIGET_MAX * CALL_MULTIGET_KEY_LEN);
+        if (call->req.keys == NULL) {
+            call_put(call);
+            return NULL;
+        }
     }
 
     STAILQ_NEXT(call, call_tqe) = NULL;
     call->id = ++id;
     call->conn = conn;
 
-    /* keyname, expiry and keylen are initialized later */
+    /* method, nkey, keyname, expiry and keylen are initialized later */
     call->req.send = 0;
     call->req.sent = 0;
+    call->req.intended_start = 0.0;
     call->req.issue_start = 0.0;
     call->req.send_start = 0.0;
     call->req.send_stop = 0.0;
@@ -80,19 +158,15 @@ call_get(struct conn *conn)
         call->req.iov[i].iov_len = 0;
     }
     call->req.noreply = 0;
+    call->req.quiet = 0;
+    call->req.fenced = 0;
     call->req.sending = 0;
 
     call->rsp.recv_start = 0.0;
     call->rsp.rcvd = 0;
-    call->rsp.rcurr = conn->buf;
-    call->rsp.rsize = sizeof(conn->buf);
-    call->rsp.pcurr = call->rsp.rcurr;
-    call->rsp.start = NULL;
-    call->rsp.end = NULL;
     call->rsp.type = 0;
-    call->rsp.vlen = 0;
-    call->rsp.parsed_line = 0;
-    call->rsp.parsed_vlen = 0;
+    rsp_parser_init(&call->rsp.parser);
+    call->rsp.receiving = 0;
 
     log_debug(LOG_VVERB, "get call %p id %"PRIu64"", call, call->id);
 
@@ -112,6 +186,9 @@ static void
 call_free(struct call *call)
 {
     log_debug(LOG_VVERB, "free call %p id %"PRIu64"", call, call->id);
+    if (call->req.keys != NULL) {
+        mcp_free(call->req.keys);
+    }
     mcp_free(call);
 }
 
@@ -197,6 +274,76 @@ call_reset_timer(struct context *ctx, struct call *call)
     return call_start_timer(ctx, STAILQ_FIRST(&conn->call_recvq));
 }
 
+/*
+ * Draw the id of a further key of a multiget. A multiget is sent to one
+ * server, so with a pool of servers its keys are drawn again until they
+ * map to the server of its first key; after a bounded number of draws,
+ * the first key is repeated.
+ */
+static uint32_t
+call_make_multiget_key_id(struct context *ctx, struct call *call)
+{
+    struct server_pool *pool = &ctx->opt.pool;
+    uint32_t i, key_id;
+
+    key_id = key_next(&ctx->key_dist, false);
+    if (pool->nserver == 1 || pool->type == SERVER_DIST_RANDOM) {
+        return key_id;
+    }
+
+    for (i = 1; server_pool_key(pool, key_id) != call->req.server; i++) {
+        if (i == CALL_MULTIGET_TRIES * pool->nserver) {
+            return call->req.key_id;
+        }
+        key_id = key_next(&ctx->key_dist, false);
+    }
+
+    return key_id;
+}
+
+/*
+ * Write the names of the nkey keys of a multiget into the key buffer of
+ * call, separated by spaces, and return their length.
+ */
+static size_t
+call_make_multiget_keys(struct context *ctx, struct call *call,
+                        uint32_t key_id, uint32_t nkey)
+{
+    struct opt *opt = &ctx->opt;
+    char *p = call->req.keys;
+    uint32_t i;
+
+    ASSERT(nkey <= CALL_MULTIGET_MAX);
+
+    for (i = 0; i < nkey; i++) {
+        if (i != 0) {
+            key_id = call_make_multiget_key_id(ctx, call);
+            *p++ = ' ';
+        }
+        p += mcp_scnprintf(p, CALL_KEYNAME_LEN, "%.*s%08"PRIx32,
+                           opt->prefix.len, opt->prefix.data, key_id);
+    }
+
+    return (size_t)(p - call->req.keys);
+}
+
+/*
+ * Draw the # keys of a get or gets request from the multiget distribution.
+ */
+static uint32_t
+call_make_nkey(struct context *ctx)
+{
+    struct dist_info *di = &ctx->mget_dist;
+
+    if (!ctx->opt.multiget) {
+        return 1;
+    }
+
+    di->next(di);
+
+    return (uint32_t)MIN(MAX(lrint(di->next_val), 1), CALL_MULTIGET_MAX);
+}
+
 static void
 call_make_retrieval_req(struct context *ctx, struct call *call,
                         uint32_t key_id)
@@ -208,16 +355,24 @@ call_make_retrieval_req(struct context *ctx, struct call *call,
     /* retrieval request are never a noreply */
     call->req.noreply = 0;
 
+    call->req.nkey = call_make_nkey(ctx);
+
     for (i = 0; i < REQ_IOV_LEN; i++) {
         struct iovec *iov = &call->req.iov[i];
 
         switch (i) {
         case REQ_IOV_METHOD:
-            iov->iov_base = req_strings[opt->method].data;
-            iov->iov_len = req_strings[opt->method].len;
+            iov->iov_base = req_strings[call->req.method].data;
+            iov->iov_len = req_strings[call->req.method].len;
             break;
 
         case REQ_IOV_KEY:
+            if (call->req.nkey > 1) {
+                iov->iov_base = call->req.keys;
+                iov->iov_len = call_make_multiget_keys(ctx, call, key_id,
+                                                       call->req.nkey);
+                break;
+            }
             len = mcp_scnprintf(call->req.keyname, sizeof(call->req.keyname),
                                 "%.*s%08"PRIx32, opt->prefix.len,
                                 opt->prefix.data, key_id);
@@ -237,6 +392,7 @@ call_make_retrieval_req(struct context *ctx, struct call *call,
         case REQ_IOV_NOREPLY:
         case REQ_IOV_VALUE:
         case REQ_IOV_CRLF2:
+        case REQ_IOV_FENCE:
             iov->iov_base = NULL;
             iov->iov_len = 0;
             break;
@@ -260,8 +416,8 @@ call_make_delete_req(struct context *ctx, struct call *call, uint32_t key_id)
 
         switch (i) {
         case REQ_IOV_METHOD:
-            iov->iov_base = req_strings[opt->method].data;
-            iov->iov_len = req_strings[opt->method].len;
+            iov->iov_base = req_strings[call->req.method].data;
+            iov->iov_len = req_strings[call->req.method].len;
             break;
 
         case REQ_IOV_KEY:
@@ -299,6 +455,7 @@ call_make_delete_req(struct context *ctx, struct call *call, uint32_t key_id)
 
         case REQ_IOV_VALUE:
         case REQ_IOV_CRLF2:
+        case REQ_IOV_FENCE:
             iov->iov_base = NULL;
             iov->iov_len = 0;
             break;
@@ -323,8 +480,8 @@ call_make_storage_req(struct context *ctx, struct call *call, uint32_t key_id,
 
         switch (i) {
         case REQ_IOV_METHOD:
-            iov->iov_base = req_strings[opt->method].data;
-            iov->iov_len = req_strings[opt->method].len;
+            iov->iov_base = req_strings[call->req.method].data;
+            iov->iov_len = req_strings[call->req.method].len;
             break;
 
         case REQ_IOV_KEY:
@@ -355,7 +512,7 @@ call_make_storage_req(struct context *ctx, struct call *call, uint32_t key_id,
             break;
 
         case REQ_IOV_CAS:
-            if (opt->method == REQ_CAS) {
+            if (call->req.method == REQ_CAS) {
                 iov->iov_base = "1 ";
                 iov->iov_len = 2;
             } else {
@@ -392,6 +549,11 @@ call_make_storage_req(struct context *ctx, struct call *call, uint32_t key_id,
             iov->iov_len = msg_strings[MSG_CRLF].len;
             break;
 
+        case REQ_IOV_FENCE:
+            iov->iov_base = NULL;
+            iov->iov_len = 0;
+            break;
+
         default:
             NOT_REACHED();
         }
@@ -412,8 +574,8 @@ call_make_arithmetic_req(struct context *ctx, struct call *call,
 
         switch (i) {
         case REQ_IOV_METHOD:
-            iov->iov_base = req_strings[opt->method].data;
-            iov->iov_len = req_strings[opt->method].len;
+            iov->iov_base = req_strings[call->req.method].data;
+            iov->iov_len = req_strings[call->req.method].len;
             break;
 
         case REQ_IOV_KEY:
@@ -462,6 +624,7 @@ call_make_arithmetic_req(struct context *ctx, struct call *call,
 
         case REQ_IOV_VALUE:
         case REQ_IOV_CRLF2:
+        case REQ_IOV_FENCE:
             iov->iov_base = NULL;
             iov->iov_len = 0;
             break;
@@ -473,337 +636,1766 @@ call_make_arithmetic_req(struct context *ctx, struct call *call,
     }
 }
 
-void
-call_make_req(struct context *ctx, struct call *call)
+static void
+bin_put16(uint8_t *p, uint16_t v)
 {
-    struct opt *opt = &ctx->opt;
-    struct dist_info *di = &ctx->size_dist;
-    uint32_t key_id;
-    long int key_vlen;
-
-    call->req.send = 0;
-    call->req.sent = 0;
-
-    /*
-     * Get the current item id and size from the distribution, and
-     * call into the size generator to move to the next value
-     */
-    key_id = di->next_id;
-    key_vlen = lrint(di->next_val);
-    ecb_signal(ctx, EVENT_GEN_SIZE_FIRE, &ctx->size_gen);
+    p[0] = (uint8_t)(v >> 8);
+    p[1] = (uint8_t)v;
+}
 
-    switch (opt->method) {
-    case REQ_GET:
-    case REQ_GETS:
-        call_make_retrieval_req(ctx, call, key_id);
-        break;
+static void
+bin_put32(uint8_t *p, uint32_t v)
+{
+    bin_put16(p, (uint16_t)(v >> 16));
+    bin_put16(p + 2, (uint16_t)v);
+}
 
-    case REQ_DELETE:
-        call_make_delete_req(ctx, call, key_id);
-        break;
+static void
+bin_put64(uint8_t *p, uint64_t v)
+{
+    bin_put32(p, (uint32_t)(v >> 32));
+    bin_put32(p + 4, (uint32_t)v);
+}
 
-    case REQ_CAS:
-    case REQ_SET:
-    case REQ_ADD:
-    case REQ_REPLACE:
-    case REQ_APPEND:
-    case REQ_PREPEND:
-    case REQ_XXX:
-        call_make_storage_req(ctx, call, key_id, key_vlen);
-        break;
+static uint16_t
+bin_get16(const uint8_t *p)
+{
+    return (uint16_t)((p[0] << 8) | p[1]);
+}
 
-    case REQ_INCR:
-    case REQ_DECR:
-        call_make_arithmetic_req(ctx, call, key_id, key_vlen);
-        break;
+static uint32_t
+bin_get32(const uint8_t *p)
+{
+    return ((uint32_t)bin_get16(p) << 16) | bin_get16(p + 2);
+}
 
-    default:
-        NOT_REACHED();
-    }
+/*
+ * Write the header of a binary request with a body of extlen extras,
+ * keylen key and vlen value bytes into p. The opaque of a request is the
+ * id of its call, and comes back in the header of every response.
+ */
+static void
+call_make_bin_header(uint8_t *p, uint8_t opcode, uint16_t keylen,
+                     uint8_t extlen, uint32_t vlen, uint32_t opaque,
+                     uint64_t cas)
+{
+    p[0] = BIN_REQ_MAGIC;
+    p[1] = opcode;
+    bin_put16(p + 2, keylen);
+    p[4] = extlen;
+    p[5] = 0;                                   /* data type */
+    bin_put16(p + 6, 0);                        /* vbucket id */
+    bin_put32(p + 8, (uint32_t)extlen + keylen + vlen);
+    bin_put32(p + 12, opaque);
+    bin_put64(p + 16, cas);
 }
 
-rstatus_t
-call_send(struct context *ctx, struct call *call)
+/*
+ * Lay out a binary request, a header and its extras followed by the key
+ * and the value, in the iovs of call.
+ */
+static void
+call_make_bin_iov(struct call *call, void *header, size_t hlen, void *key,
+                  size_t keylen, void *value, size_t vlen)
 {
-    struct conn *conn = call->conn;
-    size_t sent;
-    ssize_t n;
     uint32_t i;
 
-    ASSERT(call->req.send != 0);
-
-    if (!call->req.sending) {
-        /*
-         * We might need multiple write events to send a call completely.
-         * Signal the first time we start sending a given call.
-         */
-        ecb_signal(ctx, EVENT_CALL_SEND_START, call);
-        call->req.sending = 1;
-    }
-
-    n = conn_sendv(conn, call->req.iov, REQ_IOV_LEN, call->req.send);
-
-    sent = n > 0 ? (size_t)n : 0;
-
-    log_debug(LOG_VERB, "send call %"PRIu64" on c %"PRIu64" sd %d %zu of %zu "
-              "bytes", call->id, conn->id, conn->sd, sent, call->req.send);
-
-    call->req.send -= sent;
-    call->req.sent += sent;
-
     for (i = 0; i < REQ_IOV_LEN; i++) {
         struct iovec *iov = &call->req.iov[i];
 
-        if (sent == 0) {
+        switch (i) {
+        case REQ_IOV_METHOD:
+            iov->iov_base = header;
+            iov->iov_len = hlen;
             break;
-        }
 
-        if (sent < iov->iov_len) {
-            /* iov element was sent partially; send remaining bytes later */
-            iov->iov_base = (char *)iov->iov_base + sent;
-            iov->iov_len -= sent;
-            sent = 0;
+        case REQ_IOV_KEY:
+            iov->iov_base = key;
+            iov->iov_len = keylen;
             break;
-        }
-
-        /* iov element was sent completely; mark it empty */
-        sent -= iov->iov_len;
-        iov->iov_base = NULL;
-        iov->iov_len = 0;
-    }
 
-    if (call->req.send == 0) {
-        ecb_signal(ctx, EVENT_CALL_SEND_STOP, call);
+        case REQ_IOV_VALUE:
+            iov->iov_base = value;
+            iov->iov_len = vlen;
+            break;
 
-        /*
-         * Call has been sent completely; move the call from sendq
-         * to recvq unless it has been marked as noreply.
-         */
-        conn->ncall_sendq--;
-        STAILQ_REMOVE(&conn->call_sendq, call, call, call_tqe);
+        case REQ_IOV_FLAG:
+        case REQ_IOV_EXPIRY:
+        case REQ_IOV_VLEN:
+        case REQ_IOV_CAS:
+        case REQ_IOV_NOREPLY:
+        case REQ_IOV_CRLF:
+        case REQ_IOV_CRLF2:
+        case REQ_IOV_FENCE:
+            iov->iov_base = NULL;
+            iov->iov_len = 0;
+            break;
 
-        if (call->req.noreply) {
-            ecb_signal(ctx, EVENT_CALL_DESTROYED, call);
-            call_put(call);
-        } else {
-            STAILQ_INSERT_TAIL(&conn->call_recvq, call, call_tqe);
-            conn->ncall_recvq++;
-            call_start_timer(ctx, call);
+        default:
+            NOT_REACHED();
         }
+        call->req.send += iov->iov_len;
     }
+}
 
-    if (n > 0) {
-        return MCP_OK;
-    }
+/*
+ * Pick the binary opcode of a request. With noreply, the quiet variant is
+ * used; the server then only responds to a quiet request that failed, and
+ * the request is completed by the response to a later request or by the
+ * noop that fences it, so that its response time is still measured.
+ */
+static uint8_t
+call_make_bin_opcode(struct context *ctx, struct call *call)
+{
+    req_type_t method = call->req.method;
 
-    return (n == MCP_EAGAIN) ? MCP_OK : MCP_ERROR;
+    call->req.noreply = 0;
+    call->req.quiet = ctx->opt.use_noreply &&
+                      bin_opcodes[method].opq != bin_opcodes[method].op;
+
+    return call->req.quiet ? bin_opcodes[method].opq : bin_opcodes[method].op;
 }
 
-static rstatus_t
-call_parse_rsp_line(struct context *ctx, struct call *call)
+static int
+call_make_bin_key(struct context *ctx, char *buf, uint32_t key_id)
 {
-    char *p, *q;
-    int size;
-    struct string *str;
+    struct opt *opt = &ctx->opt;
 
-    if (call->rsp.parsed_line) {
-        return MCP_OK;
-    }
+    return mcp_scnprintf(buf, CALL_KEYNAME_LEN, "%.*s%08"PRIx32,
+                         opt->prefix.len, opt->prefix.data, key_id);
+}
 
-    ASSERT(call->rsp.rcurr > call->rsp.pcurr);
+static void
+call_make_bin_retrieval_req(struct context *ctx, struct call *call,
+                            uint32_t key_id)
+{
+    uint8_t op = bin_opcodes[call->req.method].op;
+    uint8_t opq = bin_opcodes[call->req.method].opq;
+    uint32_t opaque = (uint32_t)call->id;
+    uint8_t *p;
+    int len;
+    uint32_t i;
 
-    size = call->rsp.rcurr - call->rsp.pcurr;
+    /* retrieval request are never quiet, but for the keys of a multiget */
+    call->req.noreply = 0;
 
-    p = call->rsp.pcurr;
-    q = mcp_memchr(p, '\n', size);
-    if (q == NULL) {
-        return MCP_EAGAIN;
+    call->req.nkey = call_make_nkey(ctx);
+    if (call->req.nkey == 1) {
+        len = call_make_bin_key(ctx, call->req.keyname, key_id);
+        call_make_bin_header(call->req.header, op, (uint16_t)len, 0, 0,
+                             opaque, 0);
+        call_make_bin_iov(call, call->req.header, BIN_HEADER_LEN,
+                          call->req.keyname, (size_t)len, NULL, 0);
+        return;
     }
-    ASSERT(*(q - 1) == '\r');
-    q = q + 1;
 
-    /* update the start and end marker of response line */
-    call->rsp.start = p;
-    call->rsp.end = q;
-
-    /* update the parsing marker */
-    call->rsp.pcurr = q;
-
-    for (str = &rsp_strings[0]; str->data != NULL; str++) {
-        if ((str->len < (call->rsp.end - call->rsp.start)) &&
-            strncmp(p, str->data, str->len) == 0) {
-            call->rsp.type = str - rsp_strings;
-            call->rsp.parsed_line = 1;
-            return MCP_OK;
+    /*
+     * Every key of a multiget but the last is a quiet get, so that the
+     * server only responds to its hits, while the last get is responded
+     * to even when it misses and completes the call.
+     */
+    p = (uint8_t *)call->req.keys;
+    for (i = 0; i < call->req.nkey; i++) {
+        if (i != 0) {
+            key_id = call_make_multiget_key_id(ctx, call);
         }
+        len = call_make_bin_key(ctx, (char *)p + BIN_HEADER_LEN, key_id);
+        call_make_bin_header(p, (i == call->req.nkey - 1) ? op : opq,
+                             (uint16_t)len, 0, 0, opaque, 0);
+        p += BIN_HEADER_LEN + len;
     }
 
-    return MCP_ERROR;
+    call_make_bin_iov(call, call->req.keys,
+                      (size_t)(p - (uint8_t *)call->req.keys), NULL, 0, NULL,
+                      0);
 }
 
-static rstatus_t
-call_parse_rsp_vlen(struct context *ctx, struct call *call)
+static void
+call_make_bin_delete_req(struct context *ctx, struct call *call,
+                         uint32_t key_id)
 {
-    char *p, *q;
-    int token;
-
-    p = call->rsp.start;
-    q = call->rsp.end;
-
-    /*
-     * Parse value line with format:
-     *   VALUE <key> <flags> <datalen>\r\n<data>\r\n
-     */
-    token = 0;
-    while (p < q) {
-        if (*p != ' ') {
-            p++;
-            continue;
-        }
+    uint8_t opcode;
+    int len;
 
-        token++;
+    opcode = call_make_bin_opcode(ctx, call);
 
-        /* skip multiple spaces */
-        while (*p == ' ') {
-            p++;
-        }
+    len = call_make_bin_key(ctx, call->req.keyname, key_id);
+    call_make_bin_header(call->req.header, opcode, (uint16_t)len, 0, 0,
+                         (uint32_t)call->id, 0);
+    call_make_bin_iov(call, call->req.header, BIN_HEADER_LEN,
+                      call->req.keyname, (size_t)len, NULL, 0);
+}
 
-        if (token == 3) {
-            break;
-        }
-    }
+static void
+call_make_bin_storage_req(struct context *ctx, struct call *call,
+                          uint32_t key_id, long int key_vlen)
+{
+    uint8_t *extras = call->req.header + BIN_HEADER_LEN;
+    uint8_t opcode, extlen;
+    int len;
 
-    if (token != 3) {
-        return MCP_EAGAIN;
-    }
+    ASSERT(key_vlen >= 0 && key_vlen <= sizeof(ctx->buf1m));
 
-    call->rsp.vlen = 0;
-    while (p < q) {
-        if (*p < '0' || *p > '9') {
-            break;
-        }
+    opcode = call_make_bin_opcode(ctx, call);
 
-        call->rsp.vlen = call->rsp.vlen * 10 + (uint32_t)(*p - '0');
-        p++;
-    }
+    /* append and prepend carry no flags and expiry extras */
+    switch (call->req.method) {
+    case REQ_APPEND:
+    case REQ_PREPEND:
+        extlen = 0;
+        break;
 
-    p = (p != q) ? p : p - 1;
-    q = mcp_memchr(p, '\n', q - p);
-    if (q == NULL) {
-        call->rsp.vlen = 0;
-        return MCP_EAGAIN;
+    default:
+        bin_put32(extras, 0);
+        bin_put32(extras + 4, ctx->opt.expiry);
+        extlen = 8;
+        break;
     }
 
-    call->rsp.vlen += (sizeof("\r\n") - 1) + (sizeof("END\r\n") - 1);
-    call->rsp.parsed_vlen = 1;
-
-    return MCP_OK;
+    len = call_make_bin_key(ctx, call->req.keyname, key_id);
+    call_make_bin_header(call->req.header, opcode, (uint16_t)len, extlen,
+                         (uint32_t)key_vlen, (uint32_t)call->id,
+                         (call->req.method == REQ_CAS) ? 1 : 0);
+    call_make_bin_iov(call, call->req.header, BIN_HEADER_LEN + extlen,
+                      call->req.keyname, (size_t)len, ctx->buf1m,
+                      (size_t)key_vlen);
 }
 
-static rstatus_t
-call_parse_rsp_value(struct context *ctx, struct call *call)
+static void
+call_make_bin_arithmetic_req(struct context *ctx, struct call *call,
+                             uint32_t key_id, long int key_vlen)
 {
-    rstatus_t status;
-    struct conn *conn = call->conn;
-    size_t size;
-
-    if (!call->rsp.parsed_vlen) {
-        status = call_parse_rsp_vlen(ctx, call);
-        if (status != MCP_OK) {
-            return status;
-        }
-        ASSERT(call->rsp.parsed_vlen);
-    }
-
-    ASSERT(call->rsp.rcurr >= call->rsp.pcurr);
-
-    size = (size_t)(call->rsp.rcurr - call->rsp.pcurr);
-
-    if (call->rsp.vlen < size) {
-        /*
-         * Unparsed data in the read buffer after vlen bytes
-         * should be parsed as a response for the next calls
-         */
-        call->rsp.pcurr = call->rsp.pcurr + call->rsp.vlen;
-        call->rsp.vlen = 0;
-        return MCP_OK;
-    }
+    uint8_t *extras = call->req.header + BIN_HEADER_LEN;
+    uint8_t opcode;
+    int len;
 
-    call->rsp.vlen -= size;
+    opcode = call_make_bin_opcode(ctx, call);
 
     /*
-     * We have parsed all the data in the read buffer. Reset the read
-     * marker to make more space in the read buffer
+     * The extras are the delta, the initial value and an expiry of all
+     * ones, which fails on a missing key instead of creating it, as an
+     * ascii incr or decr does
      */
-    call->rsp.rcurr = conn->buf;
-    call->rsp.rsize = sizeof(conn->buf);
-    call->rsp.pcurr = call->rsp.rcurr;
-
-    return call->rsp.vlen == 0 ? MCP_OK : MCP_EAGAIN;
+    bin_put64(extras, (uint64_t)key_vlen);
+    bin_put64(extras + 8, 0);
+    bin_put32(extras + 16, UINT32_MAX);
+
+    len = call_make_bin_key(ctx, call->req.keyname, key_id);
+    call_make_bin_header(call->req.header, opcode, (uint16_t)len,
+                         BIN_EXTRAS_LEN, 0, (uint32_t)call->id, 0);
+    call_make_bin_iov(call, call->req.header, BIN_HEADER_LEN + BIN_EXTRAS_LEN,
+                      call->req.keyname, (size_t)len, NULL, 0);
 }
 
-static rstatus_t
-call_parse_rsp(struct context *ctx, struct call *call)
+static void
+call_make_bin_req(struct context *ctx, struct call *call, uint32_t key_id,
+                  long int key_vlen)
 {
-    rstatus_t status;
+    switch (call->req.method) {
+    case REQ_GET:
+    case REQ_GETS:
+        call_make_bin_retrieval_req(ctx, call, key_id);
+        break;
+
+    case REQ_DELETE:
+        call_make_bin_delete_req(ctx, call, key_id);
+        break;
+
+    case REQ_CAS:
+    case REQ_SET:
+    case REQ_ADD:
+    case REQ_REPLACE:
+    case REQ_APPEND:
+    case REQ_PREPEND:
+    case REQ_XXX:
+        call_make_bin_storage_req(ctx, call, key_id, key_vlen);
+        break;
+
+    case REQ_INCR:
+    case REQ_DECR:
+        call_make_bin_arithmetic_req(ctx, call, key_id, key_vlen);
+        break;
+
+    default:
+        NOT_REACHED();
+    }
+}
+
+/*
+ * Lay out a meta request, the command, the key, the flags and the value
+ * if any, in the iovs of call.
+ */
+static void
+call_make_meta_iov(struct call *call, char *key, size_t keylen, char *flags,
+                   size_t flen, void *value, size_t vlen)
+{
+    uint32_t i;
+
+    for (i = 0; i < REQ_IOV_LEN; i++) {
+        struct iovec *iov = &call->req.iov[i];
+
+        switch (i) {
+        case REQ_IOV_METHOD:
+            iov->iov_base = meta_strings[call->req.method].data;
+            iov->iov_len = meta_strings[call->req.method].len;
+            break;
+
+        case REQ_IOV_KEY:
+            iov->iov_base = key;
+            iov->iov_len = keylen;
+            break;
+
+        case REQ_IOV_FLAG:
+            iov->iov_base = flags;
+            iov->iov_len = flen;
+            break;
+
+        case REQ_IOV_CRLF:
+            iov->iov_base = msg_strings[MSG_CRLF].data;
+            iov->iov_len = msg_strings[MSG_CRLF].len;
+            break;
+
+        case REQ_IOV_VALUE:
+            iov->iov_base = value;
+            iov->iov_len = vlen;
+            break;
+
+        case REQ_IOV_CRLF2:
+            if (value != NULL) {
+                iov->iov_base = msg_strings[MSG_CRLF].data;
+                iov->iov_len = msg_strings[MSG_CRLF].len;
+            } else {
+                iov->iov_base = NULL;
+                iov->iov_len = 0;
+            }
+            break;
+
+        case REQ_IOV_EXPIRY:
+        case REQ_IOV_VLEN:
+        case REQ_IOV_CAS:
+        case REQ_IOV_NOREPLY:
+        case REQ_IOV_FENCE:
+            iov->iov_base = NULL;
+            iov->iov_len = 0;
+            break;
+
+        default:
+            NOT_REACHED();
+        }
+        call->req.send += iov->iov_len;
+    }
+}
+
+/*
+ * Like a binary request, a meta request carries the id of its call as its
+ * opaque and, with noreply, the q flag, so that the server only responds
+ * if it failed.
+ */
+static char *
+call_make_meta_flags(struct context *ctx, struct call *call)
+{
+    call->req.noreply = 0;
+    call->req.quiet = ctx->opt.use_noreply && call->req.method != REQ_XXX;
+
+    return call->req.quiet ? " q" : "";
+}
+
+static void
+call_make_meta_retrieval_req(struct context *ctx, struct call *call,
+                             uint32_t key_id)
+{
+    char *cas = (call->req.method == REQ_GETS) ? " c" : "";
+    char *p, *last;
+    int len, flen;
+    uint32_t i;
+
+    /* retrieval request are never quiet, but for the keys of a multiget */
+    call->req.noreply = 0;
+
+    call->req.nkey = call_make_nkey(ctx);
+    if (call->req.nkey == 1) {
+        len = call_make_bin_key(ctx, call->req.keyname, key_id);
+        flen = mcp_scnprintf(call->req.header, sizeof(call->req.header),
+                             " v%s O%"PRIx32, cas, (uint32_t)call->id);
+        call_make_meta_iov(call, call->req.keyname, (size_t)len,
+                           (char *)call->req.header, (size_t)flen, NULL, 0);
+        return;
+    }
+
+    /*
+     * Every key of a multiget is a quiet mg, so that the server only
+     * responds to its hits, and the noop that follows them completes the
+     * call.
+     */
+    p = call->req.keys;
+    last = p + CALL_MULTIGET_MAX * CALL_MULTIGET_KEY_LEN;
+    for (i = 0; i < call->req.nkey; i++) {
+        if (i != 0) {
+            key_id = call_make_multiget_key_id(ctx, call);
+        }
+        p += mcp_scnprintf(p, (size_t)(last - p), "%.*s",
+                           (int)meta_strings[call->req.method].len,
+                           meta_strings[call->req.method].data);
+        p += call_make_bin_key(ctx, p, key_id);
+        p += mcp_scnprintf(p, (size_t)(last - p), " v q%s O%"PRIx32 CRLF,
+                           cas, (uint32_t)call->id);
+    }
+    p += mcp_scnprintf(p, (size_t)(last - p), "mn" CRLF);
+    call->req.fenced = 1;
+
+    call_make_bin_iov(call, call->req.keys, (size_t)(p - call->req.keys),
+                      NULL, 0, NULL, 0);
+}
+
+static void
+call_make_meta_delete_req(struct context *ctx, struct call *call,
+                          uint32_t key_id)
+{
+    char *quiet;
+    int len, flen;
+
+    quiet = call_make_meta_flags(ctx, call);
+
+    len = call_make_bin_key(ctx, call->req.keyname, key_id);
+    flen = mcp_scnprintf(call->req.header, sizeof(call->req.header),
+                         "%s O%"PRIx32, quiet, (uint32_t)call->id);
+    call_make_meta_iov(call, call->req.keyname, (size_t)len,
+                       (char *)call->req.header, (size_t)flen, NULL, 0);
+}
+
+static void
+call_make_meta_storage_req(struct context *ctx, struct call *call,
+                           uint32_t key_id, long int key_vlen)
+{
+    char *quiet;
+    int len, flen;
+
+    ASSERT(key_vlen >= 0 && key_vlen <= sizeof(ctx->buf1m));
+
+    quiet = call_make_meta_flags(ctx, call);
+
+    len = call_make_bin_key(ctx, call->req.keyname, key_id);
+    flen = mcp_scnprintf(call->req.header, sizeof(call->req.header),
+                         " %ld T%"PRIu32" M%c%s%s O%"PRIx32, key_vlen,
+                         ctx->opt.expiry, meta_modes[call->req.method],
+                         (call->req.method == REQ_CAS) ? " C1" : "", quiet,
+                         (uint32_t)call->id);
+    call_make_meta_iov(call, call->req.keyname, (size_t)len,
+                       (char *)call->req.header, (size_t)flen, ctx->buf1m,
+                       (size_t)key_vlen);
+}
+
+static void
+call_make_meta_arithmetic_req(struct context *ctx, struct call *call,
+                              uint32_t key_id, long int key_vlen)
+{
+    char *quiet;
+    int len, flen;
+
+    quiet = call_make_meta_flags(ctx, call);
+
+    len = call_make_bin_key(ctx, call->req.keyname, key_id);
+    flen = mcp_scnprintf(call->req.header, sizeof(call->req.header),
+                         " D%ld M%c%s O%"PRIx32, key_vlen,
+                         meta_modes[call->req.method], quiet,
+                         (uint32_t)call->id);
+    call_make_meta_iov(call, call->req.keyname, (size_t)len,
+                       (char *)call->req.header, (size_t)flen, NULL, 0);
+}
+
+static void
+call_make_meta_req(struct context *ctx, struct call *call, uint32_t key_id,
+                   long int key_vlen)
+{
+    switch (call->req.method) {
+    case REQ_GET:
+    case REQ_GETS:
+        call_make_meta_retrieval_req(ctx, call, key_id);
+        break;
+
+    case REQ_DELETE:
+        call_make_meta_delete_req(ctx, call, key_id);
+        break;
+
+    case REQ_CAS:
+    case REQ_SET:
+    case REQ_ADD:
+    case REQ_REPLACE:
+    case REQ_APPEND:
+    case REQ_PREPEND:
+    case REQ_XXX:
+        call_make_meta_storage_req(ctx, call, key_id, key_vlen);
+        break;
+
+    case REQ_INCR:
+    case REQ_DECR:
+        call_make_meta_arithmetic_req(ctx, call, key_id, key_vlen);
+        break;
+
+    default:
+        NOT_REACHED();
+    }
+}
+
+/*
+ * Fence a quiet request with a noop, whose response completes the request
+ * if the server suppressed its own. A binary noop carries the opaque of
+ * the request, while a meta one has none and completes the fenced call
+ * that is first in the recv q.
+ */
+static void
+call_make_fence(struct context *ctx, struct call *call)
+{
+    struct iovec *iov = &call->req.iov[REQ_IOV_FENCE];
+
+    ASSERT(call->req.quiet && !call->req.fenced);
+
+    if (ctx->opt.protocol == PROTOCOL_BINARY) {
+        call_make_bin_header(call->req.fence, BIN_OP_NOOP, 0, 0, 0,
+                             (uint32_t)call->id, 0);
+        iov->iov_len = BIN_HEADER_LEN;
+    } else {
+        mcp_memcpy(call->req.fence, "mn" CRLF, sizeof("mn" CRLF) - 1);
+        iov->iov_len = sizeof("mn" CRLF) - 1;
+    }
+    iov->iov_base = call->req.fence;
+    call->req.send += iov->iov_len;
+    call->req.fenced = 1;
+}
+
+void
+call_make_req(struct context *ctx, struct call *call)
+{
+    struct opt *opt = &ctx->opt;
+    struct dist_info *di = &ctx->size_dist;
+    req_type_t method;
+    uint32_t key_id;
+    long int key_vlen;
+
+    /* pick the request type of a mix by its weight */
+    if (opt->nmethod > 1) {
+        method = (req_type_t)alias_next(&ctx->method_alias);
+    } else {
+        method = opt->method;
+    }
+
+    /*
+     * Get the key of the request from the key distribution, where sets and
+     * adds insert new keys, and the current item size from the size
+     * distribution, and call into the size generator to move to the next
+     * value
+     */
+    key_id = key_next(&ctx->key_dist, method == REQ_SET || method == REQ_ADD);
+    key_vlen = lrint(di->next_val);
+    ecb_signal(ctx, EVENT_GEN_SIZE_FIRE, &ctx->size_gen);
+
+    call_make_key_req(ctx, call, method, key_id, key_vlen);
+}
+
+/*
+ * Make a request of type method on the key key_id with an item size, or
+ * the delta of an incr or decr, of key_vlen. Generated requests as well as
+ * requests replayed from a trace are made here.
+ */
+void
+call_make_key_req(struct context *ctx, struct call *call, req_type_t method,
+                  uint32_t key_id, long int key_vlen)
+{
+    struct opt *opt = &ctx->opt;
+
+    call->req.send = 0;
+    call->req.sent = 0;
+    call->req.nkey = 1;
+    call->req.key_id = key_id;
+    call->req.server = server_next(&ctx->server_dist, key_id);
+    call->req.method = method;
+
+    if (opt->protocol == PROTOCOL_BINARY) {
+        call_make_bin_req(ctx, call, key_id, key_vlen);
+        return;
+    }
+
+    if (opt->protocol == PROTOCOL_META) {
+        call_make_meta_req(ctx, call, key_id, key_vlen);
+        return;
+    }
+
+    switch (call->req.method) {
+    case REQ_GET:
+    case REQ_GETS:
+        call_make_retrieval_req(ctx, call, key_id);
+        break;
+
+    case REQ_DELETE:
+        call_make_delete_req(ctx, call, key_id);
+        break;
+
+    case REQ_CAS:
+    case REQ_SET:
+    case REQ_ADD:
+    case REQ_REPLACE:
+    case REQ_APPEND:
+    case REQ_PREPEND:
+    case REQ_XXX:
+        call_make_storage_req(ctx, call, key_id, key_vlen);
+        break;
+
+    case REQ_INCR:
+    case REQ_DECR:
+        call_make_arithmetic_req(ctx, call, key_id, key_vlen);
+        break;
+
+    default:
+        NOT_REACHED();
+    }
+}
+
+/*
+ * Send as many calls from the conn send q as possible in a single writev.
+ * The iovs of every queued call, skipping the empty ones, are gathered
+ * into one array of at most IOV_MAX elements; the bytes written are then
+ * split back across the calls in queue order, so that each call still
+ * signals its own send start and send stop.
+ */
+rstatus_t
+call_send(struct context *ctx, struct conn *conn)
+{
+    struct call *call, *ncall; /* current and next call */
+    struct iovec *iov;
+    size_t send, sent, csent;
+    ssize_t n;
+    uint64_t cid = conn->id;
+    int iovcnt;
+    uint32_t i;
+
+    ASSERT(!STAILQ_EMPTY(&conn->call_sendq));
+
+    iovcnt = 0;
+    send = 0;
+    STAILQ_FOREACH(call, &conn->call_sendq, call_tqe) {
+        ASSERT(call->req.send != 0);
+
+        if (iovcnt == IOV_MAX) {
+            break;
+        }
+
+        /*
+         * A quiet request that is the last one queued would wait for a
+         * response that never comes on success; fence it with a noop
+         */
+        if (call->req.quiet && !call->req.fenced &&
+            STAILQ_NEXT(call, call_tqe) == NULL) {
+            call_make_fence(ctx, call);
+        }
+
+        for (i = 0; i < REQ_IOV_LEN && iovcnt < IOV_MAX; i++) {
+            iov = &call->req.iov[i];
+            if (iov->iov_len == 0) {
+                continue;
+            }
+            send_iov[iovcnt++] = *iov;
+            send += iov->iov_len;
+        }
+    }
+
+    n = conn_sendv(conn, send_iov, iovcnt, send);
+
+    sent = n > 0 ? (size_t)n : 0;
+
+    log_debug(LOG_VERB, "send %"PRIu32" calls on c %"PRIu64" sd %d %zu of "
+              "%zu bytes in %d buffers", conn->ncall_sendq, conn->id,
+              conn->sd, sent, send, iovcnt);
+
+    for (call = STAILQ_FIRST(&conn->call_sendq); call != NULL && sent != 0;
+         call = ncall) {
+        ncall = STAILQ_NEXT(call, call_tqe);
+
+        csent = MIN(sent, call->req.send);
+        sent -= csent;
+
+        if (csent > 0 && !call->req.sending) {
+            /*
+             * We might need multiple write events to send a call
+             * completely. Signal the first time some bytes of a given
+             * call make it out.
+             */
+            ecb_signal(ctx, EVENT_CALL_SEND_START, call);
+            call->req.sending = 1;
+        }
+
+        call->req.send -= csent;
+        call->req.sent += csent;
+
+        for (i = 0; i < REQ_IOV_LEN && csent != 0; i++) {
+            iov = &call->req.iov[i];
+
+            if (csent < iov->iov_len) {
+                /* iov element was sent partially; send remaining bytes later */
+                iov->iov_base = (char *)iov->iov_base + csent;
+                iov->iov_len -= csent;
+                csent = 0;
+                break;
+            }
+
+            /* iov element was sent completely; mark it empty */
+            csent -= iov->iov_len;
+            iov->iov_base = NULL;
+            iov->iov_len = 0;
+        }
+
+        if (call->req.send != 0) {
+            ASSERT(sent == 0);
+            break;
+        }
+
+        ecb_signal(ctx, EVENT_CALL_SEND_STOP, call);
+
+        /*
+         * Call has been sent completely; move the call from sendq
+         * to recvq unless it has been marked as noreply.
+         */
+        conn->ncall_sendq--;
+        STAILQ_REMOVE_HEAD(&conn->call_sendq, call_tqe);
+
+        if (call->req.noreply) {
+            ecb_signal(ctx, EVENT_CALL_DESTROYED, call);
+            call_put(call);
+            if (conn->sd < 0 || conn->id != cid) {
+                /* a completed noreply call closed the conn */
+                return MCP_OK;
+            }
+        } else {
+            STAILQ_INSERT_TAIL(&conn->call_recvq, call, call_tqe);
+            conn->ncall_recvq++;
+            call_start_timer(ctx, call);
+        }
+    }
+
+    if (n > 0) {
+        return MCP_OK;
+    }
+
+    return (n == MCP_EAGAIN) ? MCP_OK : MCP_ERROR;
+}
+
+void
+rsp_parser_init(struct rsp_parser *rp)
+{
+    rp->state = RSP_PARSE_START;
+    rp->type = RSP_NUM;
+    rp->line = RSP_NUM;
+    rp->vlen = 0;
+    rp->nvalue = 0;
+    rp->value_bytes = 0;
+    rp->ntype = 0;
+    rp->meta = META_MAX_TYPES;
+    rp->rlen = 0;
+    rp->first = 1;
+    rp->pending = 0;
+    rp->has_opaque = 0;
+}
+
+static bool
+rsp_parse_type_is(struct rsp_parser *rp, rsp_type_t type)
+{
+    struct string *str = &rsp_strings[type];
+
+    return rp->ntype == str->len && memcmp(rp->stype, str->data, str->len) == 0;
+}
+
+/*
+ * Classify the response type with a switch on its first byte; a response
+ * line that doesn't start with a known type is a numeric response to an
+ * incr or decr.
+ */
+static rsp_type_t
+rsp_parse_type(struct rsp_parser *rp)
+{
+    if (rp->ntype == 0) {
+        return RSP_NUM;
+    }
+
+    switch (rp->stype[0]) {
+    case 'C':
+        if (rsp_parse_type_is(rp, RSP_CLIENT_ERROR)) {
+            return RSP_CLIENT_ERROR;
+        }
+        break;
+
+    case 'D':
+        if (rsp_parse_type_is(rp, RSP_DELETED)) {
+            return RSP_DELETED;
+        }
+        break;
+
+    case 'E':
+        if (rsp_parse_type_is(rp, RSP_END)) {
+            return RSP_END;
+        }
+        if (rsp_parse_type_is(rp, RSP_ERROR)) {
+            return RSP_ERROR;
+        }
+        if (rsp_parse_type_is(rp, RSP_EXISTS)) {
+            return RSP_EXISTS;
+        }
+        break;
+
+    case 'N':
+        if (rsp_parse_type_is(rp, RSP_NOT_FOUND)) {
+            return RSP_NOT_FOUND;
+        }
+        if (rsp_parse_type_is(rp, RSP_NOT_STORED)) {
+            return RSP_NOT_STORED;
+        }
+        break;
+
+    case 'S':
+        if (rsp_parse_type_is(rp, RSP_STORED)) {
+            return RSP_STORED;
+        }
+        if (rsp_parse_type_is(rp, RSP_SERVER_ERROR)) {
+            return RSP_SERVER_ERROR;
+        }
+        break;
+
+    case 'V':
+        if (rsp_parse_type_is(rp, RSP_VALUE)) {
+            return RSP_VALUE;
+        }
+        break;
+
+    default:
+        break;
+    }
+
+    return RSP_NUM;
+}
+
+static void
+rsp_parse_line(struct rsp_parser *rp)
+{
+    rp->line = rsp_parse_type(rp);
+    if (rp->first) {
+        rp->type = rp->line;
+        rp->first = 0;
+    }
+}
+
+/*
+ * Parse the response bytes in [pos, last) and set nparsed to the number of
+ * bytes consumed. Returns MCP_OK once a complete response has been parsed,
+ * leaving the bytes beyond it unconsumed, MCP_EAGAIN if all the bytes were
+ * consumed without completing the response and MCP_ERROR on a malformed
+ * response. A retrieval response is complete at the END line that follows
+ * zero or more values, which are counted along with their bytes.
+ */
+rstatus_t
+rsp_parse(struct rsp_parser *rp, char *pos, char *last, size_t *nparsed)
+{
+    char *p, *q, ch;
+    size_t n;
+
+    for (p = pos; p < last; p++) {
+        ch = *p;
+
+        switch (rp->state) {
+        case RSP_PARSE_START:
+            rp->ntype = 0;
+            rp->vlen = 0;
+            rp->state = RSP_PARSE_TYPE;
+
+            /* fall through */
+
+        case RSP_PARSE_TYPE:
+            q = scan_delim(p, last);
+            n = (size_t)(q - p);
+            if (rp->ntype < RSP_TYPE_LEN) {
+                mcp_memcpy(rp->stype + rp->ntype, p,
+                           MIN(n, RSP_TYPE_LEN - rp->ntype));
+            }
+            /* a type longer than RSP_TYPE_LEN is classified as a number */
+            rp->ntype += (uint32_t)n;
+            if (q == last) {
+                p = last - 1;
+                break;
+            }
+            p = q;
+
+            rsp_parse_line(rp);
+            if (*p == ' ') {
+                rp->state = (rp->line == RSP_VALUE) ?
+                            RSP_PARSE_SPACES_BEFORE_KEY : RSP_PARSE_RUNTO_CRLF;
+            } else {
+                if (rp->line == RSP_VALUE) {
+                    goto error;
+                }
+                rp->state = RSP_PARSE_ALMOST_DONE;
+            }
+            break;
+
+        case RSP_PARSE_SPACES_BEFORE_KEY:
+        case RSP_PARSE_SPACES_BEFORE_FLAGS:
+        case RSP_PARSE_SPACES_BEFORE_VLEN:
+            if (ch == ' ') {
+                break;
+            }
+            if (ch == CR) {
+                goto error;
+            }
+            rp->state++;
+            p--;
+            break;
+
+        case RSP_PARSE_KEY:
+        case RSP_PARSE_FLAGS:
+            q = scan_delim(p, last);
+            if (q == last) {
+                p = last - 1;
+                break;
+            }
+            p = q;
+            if (*p == CR) {
+                goto error;
+            }
+            rp->state++;
+            break;
+
+        case RSP_PARSE_VLEN:
+            q = scan_delim(p, last);
+            for (; p < q; p++) {
+                if (*p < '0' || *p > '9') {
+                    goto error;
+                }
+                rp->vlen = rp->vlen * 10 + (uint32_t)(*p - '0');
+            }
+            if (q == last) {
+                p = last - 1;
+                break;
+            }
+            /* skip the optional cas unique */
+            rp->state = (*p == ' ') ? RSP_PARSE_RUNTO_CRLF :
+                        RSP_PARSE_ALMOST_DONE;
+            break;
+
+        case RSP_PARSE_RUNTO_CRLF:
+            q = mcp_memchr(p, CR, last - p);
+            if (q == NULL) {
+                p = last - 1;
+                break;
+            }
+            p = q;
+            rp->state = RSP_PARSE_ALMOST_DONE;
+            break;
+
+        case RSP_PARSE_ALMOST_DONE:
+            if (ch != LF) {
+                goto error;
+            }
+            if (rp->line == RSP_VALUE) {
+                rp->nvalue++;
+                rp->value_bytes += rp->vlen;
+                rp->state = (rp->vlen == 0) ? RSP_PARSE_VAL_CR : RSP_PARSE_VAL;
+                break;
+            }
+            if (rp->type == RSP_VALUE && rp->line != RSP_END) {
+                goto error;
+            }
+            rp->state = RSP_PARSE_START;
+            *nparsed = (size_t)(p - pos + 1);
+            return MCP_OK;
+
+        case RSP_PARSE_VAL:
+            n = MIN(rp->vlen, (size_t)(last - p));
+            rp->vlen -= (uint32_t)n;
+            p += n - 1;
+            if (rp->vlen == 0) {
+                rp->state = RSP_PARSE_VAL_CR;
+            }
+            break;
+
+        case RSP_PARSE_VAL_CR:
+            if (ch != CR) {
+                goto error;
+            }
+            rp->state = RSP_PARSE_VAL_LF;
+            break;
+
+        case RSP_PARSE_VAL_LF:
+            if (ch != LF) {
+                goto error;
+            }
+            rp->state = RSP_PARSE_START;
+            break;
+
+        default:
+            NOT_REACHED();
+        }
+    }
+
+    *nparsed = (size_t)(last - pos);
+    return MCP_EAGAIN;
+
+error:
+    *nparsed = (size_t)(p - pos);
+    log_debug(LOG_ERR, "parsed bad response in state %d at '%c'", rp->state,
+              *p);
+    return MCP_ERROR;
+}
+
+/*
+ * Parse the binary response bytes in [pos, last) and set nparsed to the
+ * number of bytes consumed. Returns MCP_OK once the header and the body of
+ * a response have been parsed, leaving the bytes beyond it unconsumed,
+ * MCP_EAGAIN if all the bytes were consumed without completing it and
+ * MCP_ERROR on a malformed header. The header fields are left in the
+ * parser for the caller to match the response to its call.
+ */
+rstatus_t
+rsp_parse_bin(struct rsp_parser *rp, char *pos, char *last, size_t *nparsed)
+{
+    char *p;
+    size_t n;
+
+    for (p = pos; p < last;) {
+        switch (rp->state) {
+        case RSP_PARSE_START:
+            rp->ntype = 0;
+            rp->rlen = 0;
+            rp->state = RSP_PARSE_BIN_HEADER;
+
+            /* fall through */
+
+        case RSP_PARSE_BIN_HEADER:
+            n = MIN(BIN_HEADER_LEN - rp->ntype, (size_t)(last - p));
+            mcp_memcpy(rp->bin + rp->ntype, p, n);
+            rp->ntype += (uint32_t)n;
+            rp->rlen += (uint32_t)n;
+            p += n;
+            if (rp->ntype < BIN_HEADER_LEN) {
+                break;
+            }
+
+            rp->opcode = rp->bin[1];
+            rp->keylen = bin_get16(rp->bin + 2);
+            rp->extlen = rp->bin[4];
+            rp->status = bin_get16(rp->bin + 6);
+            rp->blen = bin_get32(rp->bin + 8);
+            rp->opaque = bin_get32(rp->bin + 12);
+            rp->has_opaque = 1;
+            if (rp->bin[0] != BIN_RSP_MAGIC ||
+                (uint32_t)rp->extlen + rp->keylen > rp->blen) {
+                goto error;
+            }
+
+            rp->vlen = rp->blen;
+            if (rp->vlen == 0) {
+                goto done;
+            }
+            rp->state = RSP_PARSE_BIN_BODY;
+            break;
+
+        case RSP_PARSE_BIN_BODY:
+            n = MIN(rp->vlen, (size_t)(last - p));
+            rp->vlen -= (uint32_t)n;
+            rp->rlen += (uint32_t)n;
+            p += n;
+            if (rp->vlen == 0) {
+                goto done;
+            }
+            break;
+
+        default:
+            NOT_REACHED();
+        }
+    }
+
+    *nparsed = (size_t)(last - pos);
+    return MCP_EAGAIN;
+
+done:
+    rp->state = RSP_PARSE_START;
+    *nparsed = (size_t)(p - pos);
+    return MCP_OK;
+
+error:
+    *nparsed = (size_t)(p - pos);
+    log_debug(LOG_ERR, "parsed bad binary response with magic 0x%02x",
+              rp->bin[0]);
+    return MCP_ERROR;
+}
+
+/*
+ * Classify the type of a meta response line; a line that isn't a meta
+ * response is one of the error lines of the ascii protocol.
+ */
+static void
+rsp_parse_meta_line(struct rsp_parser *rp)
+{
+    meta_type_t meta;
+
+    rp->meta = META_MAX_TYPES;
+    rp->line = RSP_NUM;
+
+    if (rp->ntype == 2) {
+        for (meta = 0; meta < META_MAX_TYPES; meta++) {
+            if (memcmp(rp->stype, meta_rsp_strings[meta].data, 2) == 0) {
+                rp->meta = meta;
+                return;
+            }
+        }
+    }
+
+    rp->line = rsp_parse_type(rp);
+}
+
+/*
+ * Parse the meta response bytes in [pos, last) and set nparsed to the
+ * number of bytes consumed. Returns MCP_OK once a response line, and the
+ * value that follows a VA line, have been parsed, leaving the bytes beyond
+ * it unconsumed, MCP_EAGAIN if all the bytes were consumed without
+ * completing it and MCP_ERROR on a malformed response. The opaque flag of
+ * the line is left in the parser for the caller to match the response to
+ * its call.
+ */
+rstatus_t
+rsp_parse_meta(struct rsp_parser *rp, char *pos, char *last, size_t *nparsed)
+{
+    char *p, *q, ch;
+    size_t n;
+
+    for (p = pos; p < last; p++) {
+        ch = *p;
+
+        switch (rp->state) {
+        case RSP_PARSE_START:
+            rp->ntype = 0;
+            rp->vlen = 0;
+            rp->keylen = 0;
+            rp->extlen = 0;
+            rp->blen = 0;
+            rp->opaque = 0;
+            rp->rlen = 0;
+            rp->has_opaque = 0;
+            rp->state = RSP_PARSE_TYPE;
+
+            /* fall through */
+
+        case RSP_PARSE_TYPE:
+            q = scan_delim(p, last);
+            n = (size_t)(q - p);
+            if (rp->ntype < RSP_TYPE_LEN) {
+                mcp_memcpy(rp->stype + rp->ntype, p,
+                           MIN(n, RSP_TYPE_LEN - rp->ntype));
+            }
+            rp->ntype += (uint32_t)n;
+            if (q == last) {
+                p = last - 1;
+                break;
+            }
+            p = q;
+
+            rsp_parse_meta_line(rp);
+            if (rp->meta == META_MAX_TYPES && rp->line != RSP_ERROR &&
+                rp->line != RSP_CLIENT_ERROR && rp->line != RSP_SERVER_ERROR) {
+                goto error;
+            }
+            if (*p == ' ') {
+                if (rp->meta == META_VA) {
+                    rp->state = RSP_PARSE_SPACES_BEFORE_VLEN;
+                } else if (rp->meta == META_MAX_TYPES) {
+                    rp->state = RSP_PARSE_RUNTO_CRLF;
+                } else {
+                    rp->state = RSP_PARSE_META_FLAGS;
+                }
+            } else {
+                if (rp->meta == META_VA) {
+                    goto error;
+                }
+                rp->state = RSP_PARSE_ALMOST_DONE;
+            }
+            break;
 
-    /*
-     * Parse the response line until crlf is encountered to
-     * determine the response type.
-     */
-    status = call_parse_rsp_line(ctx, call);
-    if (status != MCP_OK) {
-        return status;
+        case RSP_PARSE_SPACES_BEFORE_VLEN:
+            if (ch == ' ') {
+                break;
+            }
+            if (ch == CR) {
+                goto error;
+            }
+            rp->state = RSP_PARSE_VLEN;
+            p--;
+            break;
+
+        case RSP_PARSE_VLEN:
+            q = scan_delim(p, last);
+            for (; p < q; p++) {
+                if (*p < '0' || *p > '9') {
+                    goto error;
+                }
+                rp->vlen = rp->vlen * 10 + (uint32_t)(*p - '0');
+            }
+            if (q == last) {
+                p = last - 1;
+                break;
+            }
+            rp->state = (*p == ' ') ? RSP_PARSE_META_FLAGS :
+                        RSP_PARSE_ALMOST_DONE;
+            break;
+
+        case RSP_PARSE_META_FLAGS:
+            if (ch == ' ') {
+                break;
+            }
+            if (ch == CR) {
+                rp->state = RSP_PARSE_ALMOST_DONE;
+                break;
+            }
+            if (ch == 'O') {
+                rp->opaque = 0;
+                rp->has_opaque = 1;
+                rp->state = RSP_PARSE_META_OPAQUE;
+                break;
+            }
+            rp->state = RSP_PARSE_META_SKIP;
+            break;
+
+        case RSP_PARSE_META_OPAQUE:
+            /* our requests carry the call id as a hex opaque */
+            q = scan_delim(p, last);
+            for (; p < q; p++) {
+                if (*p >= '0' && *p <= '9') {
+                    rp->opaque = (rp->opaque << 4) | (uint32_t)(*p - '0');
+                } else if (*p >= 'a' && *p <= 'f') {
+                    rp->opaque = (rp->opaque << 4) | (uint32_t)(*p - 'a' + 10);
+                } else {
+                    goto error;
+                }
+            }
+            if (q == last) {
+                p = last - 1;
+                break;
+            }
+            rp->state = (*p == ' ') ? RSP_PARSE_META_FLAGS :
+                        RSP_PARSE_ALMOST_DONE;
+            break;
+
+        case RSP_PARSE_META_SKIP:
+            q = scan_delim(p, last);
+            if (q == last) {
+                p = last - 1;
+                break;
+            }
+            p = q;
+            rp->state = (*p == ' ') ? RSP_PARSE_META_FLAGS :
+                        RSP_PARSE_ALMOST_DONE;
+            break;
+
+        case RSP_PARSE_RUNTO_CRLF:
+            q = mcp_memchr(p, CR, last - p);
+            if (q == NULL) {
+                p = last - 1;
+                break;
+            }
+            p = q;
+            rp->state = RSP_PARSE_ALMOST_DONE;
+            break;
+
+        case RSP_PARSE_ALMOST_DONE:
+            if (ch != LF) {
+                goto error;
+            }
+            if (rp->meta == META_VA) {
+                rp->blen = rp->vlen;
+                rp->state = (rp->vlen == 0) ? RSP_PARSE_VAL_CR : RSP_PARSE_VAL;
+                break;
+            }
+            goto done;
+
+        case RSP_PARSE_VAL:
+            n = MIN(rp->vlen, (size_t)(last - p));
+            rp->vlen -= (uint32_t)n;
+            p += n - 1;
+            if (rp->vlen == 0) {
+                rp->state = RSP_PARSE_VAL_CR;
+            }
+            break;
+
+        case RSP_PARSE_VAL_CR:
+            if (ch != CR) {
+                goto error;
+            }
+            rp->state = RSP_PARSE_VAL_LF;
+            break;
+
+        case RSP_PARSE_VAL_LF:
+            if (ch != LF) {
+                goto error;
+            }
+            goto done;
+
+        default:
+            NOT_REACHED();
+        }
     }
 
-    /*
-     * After we have parsed the response line and determined that it is a
-     * value response, we need to parse remaining data until we encounter
-     * data of size value length followed by crlf.
-     */
-    if (call->rsp.type == RSP_VALUE) {
-       return call_parse_rsp_value(ctx, call);
+    n = (size_t)(last - pos);
+    rp->rlen += (uint32_t)n;
+    *nparsed = n;
+    return MCP_EAGAIN;
+
+done:
+    rp->state = RSP_PARSE_START;
+    n = (size_t)(p - pos + 1);
+    rp->rlen += (uint32_t)n;
+    *nparsed = n;
+    return MCP_OK;
+
+error:
+    *nparsed = (size_t)(p - pos);
+    log_debug(LOG_ERR, "parsed bad meta response in state %d at '%c'",
+              rp->state, *p);
+    return MCP_ERROR;
+}
+
+/*
+ * Return the # value bytes that the parser expects next and would skip
+ * without looking at them; these can be discarded before they are read.
+ * The last byte of a binary body is left to the parser, which completes
+ * the response on it.
+ */
+size_t
+rsp_parse_skippable(struct rsp_parser *rp)
+{
+    switch (rp->state) {
+    case RSP_PARSE_VAL:
+        return rp->vlen;
+
+    case RSP_PARSE_BIN_BODY:
+        return rp->vlen - 1;
+
+    default:
+        return 0;
+    }
+}
+
+void
+rsp_parse_skip(struct rsp_parser *rp, size_t n)
+{
+    ASSERT(rp->state == RSP_PARSE_VAL || rp->state == RSP_PARSE_BIN_BODY);
+    ASSERT(n <= rp->vlen);
+
+    rp->vlen -= (uint32_t)n;
+    rp->rlen += (uint32_t)n;
+    if (rp->vlen == 0) {
+        ASSERT(rp->state == RSP_PARSE_VAL);
+        rp->state = RSP_PARSE_VAL_CR;
+    }
+}
+
+/*
+ * Discard the value bytes that the call at the head of the recv q still
+ * expects, provided nothing else is buffered in the recv ring and they
+ * wouldn't fit in it anyway. Large values are then dropped straight from
+ * the socket, instead of being copied through the ring chunk by chunk.
+ */
+static rstatus_t
+call_discard(struct context *ctx, struct conn *conn, bool *discarded)
+{
+    struct call *call;
+    size_t size;
+    ssize_t n;
+
+    *discarded = false;
+
+    if (conn->ppos != conn->rpos) {
+        return MCP_OK;
+    }
+
+    call = STAILQ_FIRST(&conn->call_recvq);
+    ASSERT(call != NULL);
+
+    size = rsp_parse_skippable(&call->rsp.parser);
+    if (size < CONN_RBUF_SIZE) {
+        return MCP_OK;
+    }
+
+    *discarded = true;
+
+    n = conn_discard(conn, size);
+    if (n <= 0) {
+        if (n == 0 || n == MCP_EAGAIN) {
+            return MCP_OK;
+        }
+        return MCP_ERROR;
     }
 
+    rsp_parse_skip(&call->rsp.parser, (size_t)n);
+    call->rsp.rcvd += (size_t)n;
+
     return MCP_OK;
 }
 
-rstatus_t
-call_recv(struct context *ctx, struct call *call)
+/*
+ * Map the status of a binary response to the response type that the ascii
+ * protocol would have given the request of call.
+ */
+static rsp_type_t
+call_bin_rsp_type(struct call *call, uint16_t status)
+{
+    switch (status) {
+    case 0x0000:                                /* no error */
+        switch (call->req.method) {
+        case REQ_GET:
+        case REQ_GETS:
+            return RSP_VALUE;
+
+        case REQ_DELETE:
+            return RSP_DELETED;
+
+        case REQ_INCR:
+        case REQ_DECR:
+            return RSP_NUM;
+
+        default:
+            return RSP_STORED;
+        }
+
+    case 0x0001:                                /* key not found */
+        if (call->req.method == REQ_GET || call->req.method == REQ_GETS) {
+            return RSP_END;
+        }
+        return RSP_NOT_FOUND;
+
+    case 0x0002:                                /* key exists */
+        return RSP_EXISTS;
+
+    case 0x0005:                                /* item not stored */
+        return RSP_NOT_STORED;
+
+    case 0x0003:                                /* value too large */
+    case 0x0004:                                /* invalid arguments */
+    case 0x0006:                                /* non-numeric value */
+        return RSP_CLIENT_ERROR;
+
+    case 0x0081:                                /* unknown command */
+        return RSP_ERROR;
+
+    default:
+        return RSP_SERVER_ERROR;
+    }
+}
+
+/*
+ * Map a meta response to the response type that the ascii protocol would
+ * have given the request of call.
+ */
+static rsp_type_t
+call_meta_rsp_type(struct call *call, meta_type_t meta)
+{
+    switch (meta) {
+    case META_VA:
+        return RSP_VALUE;
+
+    case META_HD:
+        switch (call->req.method) {
+        case REQ_GET:
+        case REQ_GETS:
+            return RSP_VALUE;
+
+        case REQ_DELETE:
+            return RSP_DELETED;
+
+        case REQ_INCR:
+        case REQ_DECR:
+            return RSP_NUM;
+
+        default:
+            return RSP_STORED;
+        }
+
+    case META_EN:
+        return RSP_END;
+
+    case META_NS:
+        return RSP_NOT_STORED;
+
+    case META_EX:
+        return RSP_EXISTS;
+
+    case META_NF:
+        return RSP_NOT_FOUND;
+
+    default:
+        NOT_REACHED();
+        return RSP_SERVER_ERROR;
+    }
+}
+
+/*
+ * Map the parsed binary or meta response of call to a response type.
+ */
+static rsp_type_t
+call_quiet_rsp_type(struct context *ctx, struct call *call)
+{
+    struct rsp_parser *rp = &call->rsp.parser;
+
+    if (ctx->opt.protocol == PROTOCOL_BINARY) {
+        return call_bin_rsp_type(call, rp->status);
+    }
+
+    if (rp->meta == META_MAX_TYPES) {
+        return rp->line;
+    }
+
+    return call_meta_rsp_type(call, rp->meta);
+}
+
+/*
+ * Return true if the parsed response is a noop that fences a quiet
+ * request.
+ */
+static bool
+call_quiet_rsp_is_fence(struct context *ctx, struct call *call)
+{
+    struct rsp_parser *rp = &call->rsp.parser;
+
+    if (ctx->opt.protocol == PROTOCOL_BINARY) {
+        return rp->opcode == BIN_OP_NOOP;
+    }
+
+    return rp->meta == META_MN;
+}
+
+/*
+ * Return true if the parsed response belongs to call. A meta noop has no
+ * opaque and belongs to the first fenced call, while a response without
+ * an opaque, like an error line, belongs to the call that is first in the
+ * recv q.
+ */
+static bool
+call_quiet_rsp_is_mine(struct context *ctx, struct call *call)
+{
+    struct rsp_parser *rp = &call->rsp.parser;
+
+    if (ctx->opt.protocol == PROTOCOL_META && rp->meta == META_MN) {
+        return call->req.fenced;
+    }
+
+    return !rp->has_opaque || rp->opaque == (uint32_t)call->id;
+}
+
+/*
+ * Return true if the parsed response of call is its last one: the
+ * response to its non quiet request, or the noop that fences it.
+ */
+static bool
+call_quiet_rsp_is_last(struct context *ctx, struct call *call)
+{
+    struct rsp_parser *rp = &call->rsp.parser;
+
+    if (call_quiet_rsp_is_fence(ctx, call)) {
+        return true;
+    }
+
+    if (ctx->opt.protocol == PROTOCOL_BINARY) {
+        return rp->opcode == bin_opcodes[call->req.method].op;
+    }
+
+    return !call->req.fenced;
+}
+
+/*
+ * Complete the binary or meta request of call with the response type of
+ * its first response, or with the one that the server suppressed when it
+ * sent none: a success, but for the misses of a quiet meta retrieval.
+ */
+static void
+call_quiet_complete(struct context *ctx, struct call *call)
+{
+    struct rsp_parser *rp = &call->rsp.parser;
+
+    if (!rp->first) {
+        call->rsp.type = rp->type;
+    } else if (ctx->opt.protocol == PROTOCOL_BINARY) {
+        call->rsp.type = call_bin_rsp_type(call, 0x0000);
+    } else if (call->req.method == REQ_GET || call->req.method == REQ_GETS) {
+        call->rsp.type = RSP_END;
+    } else {
+        call->rsp.type = call_meta_rsp_type(call, META_HD);
+    }
+}
+
+/*
+ * Feed the unparsed data in the recv ring to the binary or meta response
+ * parser of call and match every parsed response to a call by its opaque.
+ * Responses come in request order, so a response of another call means
+ * that the server suppressed the remaining responses of this quiet call;
+ * it is then completed and the response is handed over to the next call
+ * in the recv q. A call is otherwise completed by the response to its non
+ * quiet request or by the noop that fences it.
+ */
+static rstatus_t
+call_parse_quiet_rsp(struct context *ctx, struct call *call)
 {
-    rstatus_t status;
     struct conn *conn = call->conn;
-    ssize_t n;
-    size_t rcvd;
+    struct rsp_parser *rp = &call->rsp.parser;
+    struct rsp_parser *nrp;
+    struct call *ncall;
+    rstatus_t status;
+    rsp_type_t type;
+    uint32_t off, size;
+    size_t n;
+
+    for (;;) {
+        if (!rp->pending) {
+            if (conn->ppos == conn->rpos) {
+                return MCP_EAGAIN;
+            }
 
-    if (call->rsp.rsize == 0) {
-        size_t chunk_size;
+            off = conn->ppos & CONN_RBUF_MASK;
+            size = MIN(conn->rpos - conn->ppos, CONN_RBUF_SIZE - off);
+
+            if (ctx->opt.protocol == PROTOCOL_BINARY) {
+                status = rsp_parse_bin(rp, conn->buf + off,
+                                       conn->buf + off + size, &n);
+            } else {
+                status = rsp_parse_meta(rp, conn->buf + off,
+                                        conn->buf + off + size, &n);
+            }
 
-        ASSERT(call->rsp.rcurr > call->rsp.pcurr);
+            conn->ppos += (uint32_t)n;
+            call->rsp.rcvd += n;
 
-        /*
-         * Make space in the read buffer by moving the unparsed chunk
-         * at the tail end to the head.
-         */
-        chunk_size = (size_t)(call->rsp.rcurr - call->rsp.pcurr);
-        mcp_memmove(conn->buf, call->rsp.pcurr, chunk_size);
-        call->rsp.pcurr = conn->buf;
-        call->rsp.rcurr = conn->buf + chunk_size;
-        call->rsp.rsize = sizeof(conn->buf) - chunk_size;
+            if (status != MCP_OK) {
+                if (status == MCP_EAGAIN) {
+                    continue;
+                }
+                return status;
+            }
+        }
+        rp->pending = 0;
+
+        if (!call_quiet_rsp_is_mine(ctx, call)) {
+            ncall = STAILQ_NEXT(call, call_tqe);
+            if (ncall == NULL) {
+                log_debug(LOG_ERR, "stray %s response with opaque "
+                          "%"PRIu32" on c %"PRIu64"",
+                          protocol_name(ctx->opt.protocol), rp->opaque,
+                          conn->id);
+                return MCP_ERROR;
+            }
+
+            nrp = &ncall->rsp.parser;
+            *nrp = *rp;
+            nrp->nvalue = 0;
+            nrp->value_bytes = 0;
+            nrp->first = 1;
+            nrp->pending = 1;
+
+            call->rsp.rcvd -= rp->rlen;
+            ncall->rsp.rcvd += rp->rlen;
+
+            call_quiet_complete(ctx, call);
+            return MCP_OK;
+        }
+
+        if (!call_quiet_rsp_is_fence(ctx, call)) {
+            type = call_quiet_rsp_type(ctx, call);
+            if (type == RSP_VALUE) {
+                rp->nvalue++;
+                rp->value_bytes += rp->blen - rp->extlen - rp->keylen;
+            }
+            if (rp->first) {
+                rp->type = type;
+                rp->first = 0;
+            }
+        }
+
+        if (call_quiet_rsp_is_last(ctx, call)) {
+            call_quiet_complete(ctx, call);
+            return MCP_OK;
+        }
+
+        /* a response to a quiet request; wait for the one completing it */
+    }
+
+    NOT_REACHED();
+}
+
+/*
+ * Feed the unparsed data in the recv ring, which can be in two pieces if
+ * it wraps around the end of the ring, to the response parser of call.
+ */
+static rstatus_t
+call_parse_rsp(struct context *ctx, struct call *call)
+{
+    struct conn *conn = call->conn;
+    rstatus_t status;
+    uint32_t off, size;
+    size_t n;
+
+    if (ctx->opt.protocol != PROTOCOL_ASCII) {
+        return call_parse_quiet_rsp(ctx, call);
     }
 
-    if (call->rsp.rcvd == 0) {
-        ecb_signal(ctx, EVENT_CALL_RECV_START, call);
+    do {
+        off = conn->ppos & CONN_RBUF_MASK;
+        size = MIN(conn->rpos - conn->ppos, CONN_RBUF_SIZE - off);
+
+        status = rsp_parse(&call->rsp.parser, conn->buf + off,
+                           conn->buf + off + size, &n);
+
+        conn->ppos += (uint32_t)n;
+        call->rsp.rcvd += n;
+    } while (status == MCP_EAGAIN && conn->ppos != conn->rpos);
+
+    if (status == MCP_OK) {
+        call->rsp.type = call->rsp.parser.type;
     }
 
-    n = conn_recv(conn, call->rsp.rcurr, call->rsp.rsize);
+    return status;
+}
+
+/*
+ * Read all that fits into the free space of the conn recv ring in a
+ * single readv and complete as many calls in the recv q as the received
+ * data allows.
+ */
+rstatus_t
+call_recv(struct context *ctx, struct conn *conn)
+{
+    rstatus_t status;
+    struct call *call;
+    struct iovec iov[2];
+    uint32_t size, off;
+    uint64_t cid = conn->id;
+    bool discarded;
+    int iovcnt;
+    ssize_t n;
+
+    status = call_discard(ctx, conn, &discarded);
+    if (status != MCP_OK || discarded) {
+        return status;
+    }
 
-    rcvd = n > 0 ? (size_t)n : 0;
+    size = CONN_RBUF_SIZE - (conn->rpos - conn->ppos);
+    if (size == 0) {
+        log_debug(LOG_ERR, "recv ring full on c %"PRIu64"", conn->id);
+        conn->err = EINVAL;
+        return MCP_ERROR;
+    }
 
-    call->rsp.rcvd += rcvd;
-    call->rsp.rcurr += rcvd;
-    call->rsp.rsize -= rcvd;
+    off = conn->rpos & CONN_RBUF_MASK;
+    iov[0].iov_base = conn->buf + off;
+    iov[0].iov_len = MIN(size, CONN_RBUF_SIZE - off);
+    iovcnt = 1;
+    if (iov[0].iov_len < size) {
+        iov[1].iov_base = conn->buf;
+        iov[1].iov_len = size - iov[0].iov_len;
+        iovcnt = 2;
+    }
 
+    n = conn_recvv(conn, iov, iovcnt, size);
     if (n <= 0) {
         if (n == 0 || n == MCP_EAGAIN) {
             return MCP_OK;
@@ -811,49 +2403,38 @@ call_recv(struct context *ctx, struct call *call)
         return MCP_ERROR;
     }
 
-    do {
-        struct call *next_call; /* next call in recv q */
+    conn->rpos += (uint32_t)n;
+
+    for (;;) {
+        call = STAILQ_FIRST(&conn->call_recvq);
+        if (conn->ppos == conn->rpos &&
+            (call == NULL || !call->rsp.parser.pending)) {
+            break;
+        }
+        if (call == NULL) {
+            log_debug(LOG_ERR, "stray response of %"PRIu32" bytes on c "
+                      "%"PRIu64"", conn->rpos - conn->ppos, conn->id);
+            conn->err = EINVAL;
+            return MCP_ERROR;
+        }
+
+        if (!call->rsp.receiving) {
+            ecb_signal(ctx, EVENT_CALL_RECV_START, call);
+            call->rsp.receiving = 1;
+        }
 
         status = call_parse_rsp(ctx, call);
         if (status != MCP_OK) {
             if (status == MCP_EAGAIN) {
                 /* incomplete response; parse again when more data arrives */
-                return MCP_OK;
+                break;
             }
+            conn->err = EINVAL;
             return status;
         }
 
-        next_call = NULL;
-        /*
-         * Spill over unparsed response onto the next call and update
-         * the current call appropriately
-         */
-        if (call->rsp.rcurr != call->rsp.pcurr) {
-            next_call = STAILQ_NEXT(call, call_tqe);
-            if (next_call == NULL) {
-                log_debug(LOG_ERR, "stray response type %d on c %"PRIu64"",
-                          call->rsp.type, conn->id);
-                conn->err = EINVAL;
-                return MCP_ERROR;
-            }
-
-            ecb_signal(ctx, EVENT_CALL_RECV_START, next_call);
-
-            next_call->rsp.rcurr = call->rsp.rcurr;
-            next_call->rsp.rsize = call->rsp.rsize;
-            next_call->rsp.pcurr = call->rsp.pcurr;
-
-            /*
-             * Calculate the exact bytes received on this call and accumulate
-             * the remaining bytes onto the next call
-             */
-            ASSERT(call->rsp.rcurr > call->rsp.pcurr);
-            next_call->rsp.rcvd = (size_t)(call->rsp.rcurr - call->rsp.pcurr);
-            call->rsp.rcvd -= next_call->rsp.rcvd;
-        }
-
         conn->ncall_recvq--;
-        STAILQ_REMOVE(&conn->call_recvq, call, call, call_tqe);
+        STAILQ_REMOVE_HEAD(&conn->call_recvq, call_tqe);
 
         call_reset_timer(ctx, call);
 
@@ -862,8 +2443,17 @@ call_recv(struct context *ctx, struct call *call)
 
         call_put(call);
 
-        call = next_call;
-    } while (call != NULL);
+        if (conn->sd < 0 || conn->id != cid) {
+            /* the last completed call closed the conn */
+            return MCP_OK;
+        }
+    }
+
+    if (conn->ppos == conn->rpos) {
+        /* rewind an empty ring, so that the next read is contiguous */
+        conn->rpos = 0;
+        conn->ppos = 0;
+    }
 
     return MCP_OK;
 }
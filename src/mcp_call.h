@@ -58,6 +58,53 @@
     ACTION( CRLF,           "\r\n"         )\
     ACTION( ZERO,           "0 "           )\
 
+/*
+ * Binary protocol opcodes of every request type, in the order of the
+ * REQ_CODEC, followed by their quiet variant whose success responses are
+ * suppressed by the server. The bogus 'xxx' request has no quiet variant.
+ */
+#define BIN_CODEC(ACTION)                   \
+    ACTION( GET,            0x00,   0x09   )\
+    ACTION( GETS,           0x00,   0x09   )\
+    ACTION( DELETE,         0x04,   0x14   )\
+    ACTION( CAS,            0x01,   0x11   )\
+    ACTION( SET,            0x01,   0x11   )\
+    ACTION( ADD,            0x02,   0x12   )\
+    ACTION( REPLACE,        0x03,   0x13   )\
+    ACTION( APPEND,         0x0e,   0x19   )\
+    ACTION( PREPEND,        0x0f,   0x1a   )\
+    ACTION( INCR,           0x05,   0x15   )\
+    ACTION( DECR,           0x06,   0x16   )\
+    ACTION( XXX,            0xfe,   0xfe   )\
+
+/*
+ * Meta protocol commands of every request type, in the order of the
+ * REQ_CODEC, and the mode flag of ms and ma. The bogus 'xxx' request is an
+ * ms with an invalid mode.
+ */
+#define META_CODEC(ACTION)                  \
+    ACTION( GET,            "mg ",  0      )\
+    ACTION( GETS,           "mg ",  0      )\
+    ACTION( DELETE,         "md ",  0      )\
+    ACTION( CAS,            "ms ",  'S'    )\
+    ACTION( SET,            "ms ",  'S'    )\
+    ACTION( ADD,            "ms ",  'E'    )\
+    ACTION( REPLACE,        "ms ",  'R'    )\
+    ACTION( APPEND,         "ms ",  'A'    )\
+    ACTION( PREPEND,        "ms ",  'P'    )\
+    ACTION( INCR,           "ma ",  'I'    )\
+    ACTION( DECR,           "ma ",  'D'    )\
+    ACTION( XXX,            "ms ",  'X'    )\
+
+#define META_RSP_CODEC(ACTION)              \
+    ACTION( VA,             "VA"           )\
+    ACTION( HD,             "HD"           )\
+    ACTION( EN,             "EN"           )\
+    ACTION( NS,             "NS"           )\
+    ACTION( EX,             "EX"           )\
+    ACTION( NF,             "NF"           )\
+    ACTION( MN,             "MN"           )\
+
 #define DEFINE_ACTION(_type, _name) REQ_##_type,
 typedef enum req_type {
     REQ_CODEC( DEFINE_ACTION )
@@ -72,6 +119,13 @@ typedef enum rsp_type {
 } rsp_type_t;
 #undef DEFINE_ACTION
 
+#define DEFINE_ACTION(_type, _name) META_##_type,
+typedef enum meta_type {
+    META_RSP_CODEC( DEFINE_ACTION )
+    META_MAX_TYPES
+} meta_type_t;
+#undef DEFINE_ACTION
+
 #define DEFINE_ACTION(_type, _name) MSG_##_type,
 typedef enum msg_type {
     REQ_CODEC( DEFINE_ACTION )
@@ -81,6 +135,13 @@ typedef enum msg_type {
 } msg_type_t;
 #undef DEFINE_ACTION
 
+typedef enum protocol_type {
+    PROTOCOL_ASCII,             /* ascii text protocol */
+    PROTOCOL_BINARY,            /* binary protocol */
+    PROTOCOL_META,              /* meta text protocol */
+    PROTOCOL_SENTINEL
+} protocol_type_t;
+
 typedef enum req_iov {
     REQ_IOV_METHOD,
     REQ_IOV_KEY,
@@ -92,6 +153,7 @@ typedef enum req_iov {
     REQ_IOV_CRLF,
     REQ_IOV_VALUE,
     REQ_IOV_CRLF2,
+    REQ_IOV_FENCE,
     REQ_IOV_LEN
 } req_iov_t;
 
@@ -102,6 +164,73 @@ typedef enum req_iov {
 #define CALL_KEYNAME_LEN    (CALL_PREFIX_LEN + CALL_ID_LEN)
 #define CALL_EXPIRY_LEN     UINT32_MAX_LEN
 #define CALL_KEYLEN_LEN     UINT32_MAX_LEN
+#define CALL_MULTIGET_MAX   256 /* max # keys of a get or gets request */
+#define CALL_MULTIGET_TRIES 16  /* # draws per server of a further multiget key */
+
+#define RSP_TYPE_LEN        12  /* longest response type: "CLIENT_ERROR" */
+
+#define BIN_HEADER_LEN      24  /* binary request and response header */
+#define BIN_EXTRAS_LEN      20  /* longest request extras: incr and decr */
+#define BIN_REQ_MAGIC       0x80
+#define BIN_RSP_MAGIC       0x81
+#define BIN_OP_NOOP         0x0a
+
+/* longest key of a multiget request in any protocol, with its header */
+#define CALL_MULTIGET_KEY_LEN   (BIN_HEADER_LEN + CALL_KEYNAME_LEN)
+
+typedef enum rsp_parse_state {
+    RSP_PARSE_START,                /* start of a response line */
+    RSP_PARSE_TYPE,                 /* response type */
+    RSP_PARSE_SPACES_BEFORE_KEY,    /* value line: " <key>" */
+    RSP_PARSE_KEY,
+    RSP_PARSE_SPACES_BEFORE_FLAGS,  /* value line: " <flags>" */
+    RSP_PARSE_FLAGS,
+    RSP_PARSE_SPACES_BEFORE_VLEN,   /* value line: " <bytes>" */
+    RSP_PARSE_VLEN,
+    RSP_PARSE_RUNTO_CRLF,           /* rest of the response line */
+    RSP_PARSE_ALMOST_DONE,          /* lf ending the response line */
+    RSP_PARSE_VAL,                  /* value data */
+    RSP_PARSE_VAL_CR,               /* crlf ending the value data */
+    RSP_PARSE_VAL_LF,
+    RSP_PARSE_BIN_HEADER,           /* binary header */
+    RSP_PARSE_BIN_BODY,             /* binary extras, key and value */
+    RSP_PARSE_META_FLAGS,           /* meta line: " <flag>..." */
+    RSP_PARSE_META_OPAQUE,          /* meta opaque flag: "O<opaque>" */
+    RSP_PARSE_META_SKIP             /* meta flag other than the opaque */
+} rsp_parse_state_t;
+
+/*
+ * A response parser is a state machine that is fed the response bytes as
+ * they are received, in as many pieces as they happen to arrive in. Every
+ * byte is looked at exactly once; the fields of a response line are
+ * skipped with scan_delim and value data is skipped in bulk. A binary
+ * response is a fixed header followed by a body that is skipped in bulk,
+ * and is matched to its call by the opaque of the header; a meta response
+ * is a line like an ascii one, and is matched by the opaque flag of its
+ * line.
+ */
+struct rsp_parser {
+    rsp_parse_state_t state;               /* parser state */
+    rsp_type_t        type;                /* response type (first line) */
+    rsp_type_t        line;                /* current line type */
+    uint32_t          vlen;                /* value bytes left */
+    uint32_t          nvalue;              /* # values */
+    size_t            value_bytes;         /* # value bytes */
+    uint32_t          ntype;               /* # response type bytes */
+    char              stype[RSP_TYPE_LEN]; /* response type bytes */
+    uint8_t           bin[BIN_HEADER_LEN]; /* binary header bytes */
+    uint8_t           opcode;              /* binary opcode */
+    uint16_t          status;              /* binary status */
+    uint16_t          keylen;              /* binary key length */
+    uint8_t           extlen;              /* binary extras length */
+    uint32_t          blen;                /* binary body length */
+    uint32_t          opaque;              /* binary or meta opaque */
+    meta_type_t       meta;                /* meta response type */
+    uint32_t          rlen;                /* # response bytes */
+    unsigned          first:1;             /* first response line? */
+    unsigned          pending:1;           /* response to be matched? */
+    unsigned          has_opaque:1;        /* response with an opaque? */
+};
 
 /*
  * A call is the basic unit representing a single request followed by
@@ -114,44 +243,58 @@ struct call {
     struct conn        *conn;                      /* owner connection */
 
     struct {
+        req_type_t      method;                    /* request type */
+        uint32_t        nkey;                      /* # keys */
+        uint32_t        key_id;                    /* key id of the first key */
+        uint32_t        server;                    /* server index of the keys */
         char            keyname[CALL_KEYNAME_LEN]; /* key name */
+        char            *keys;                     /* key names of a multiget */
         char            expiry[CALL_EXPIRY_LEN];   /* expiry in ascii */
         char            keylen[CALL_KEYLEN_LEN];   /* key length in ascii */
+        uint8_t         header[BIN_HEADER_LEN + BIN_EXTRAS_LEN]; /* binary header and extras, or meta flags */
+        uint8_t         fence[BIN_HEADER_LEN];     /* binary or meta noop fence */
         size_t          send;                      /* bytes to send */
         size_t          sent;                      /* bytes sent */
+        double          intended_start;            /* scheduled issue time in sec */
         double          issue_start;               /* issue start time in sec */
         double          send_start;                /* send start time in sec */
         double          send_stop;                 /* send stop time in sec */
         struct iovec    iov[REQ_IOV_LEN];          /* request iov */
         unsigned        noreply:1;                 /* noreply? */
+        unsigned        quiet:1;                   /* binary or meta quiet request? */
+        unsigned        fenced:1;                  /* noop fence sent? */
         unsigned        sending:1;                 /* sending call? */
     } req;                                         /* request */
 
     struct {
         double           recv_start;               /* recv start time in sec */
         size_t           rcvd;                     /* bytes received */
-        char             *rcurr;                   /* recv marker */
-        size_t           rsize;                    /* recv buffer size */
-        char             *pcurr;                   /* parsing marker */
-        char             *start;                   /* start marker */
-        char             *end;                     /* end marker */
         rsp_type_t       type;                     /* parsed response type? */
-        uint32_t         vlen;                     /* value length + crlf length */
-        unsigned         parsed_line:1;            /* parsed line? */
-        unsigned         parsed_vlen:1;            /* parsed vlen? */
+        struct rsp_parser parser;                  /* response parser */
+        unsigned         receiving:1;              /* receiving call? */
     } rsp;                                         /* response */
 };
 
 STAILQ_HEAD(call_tqh, call);
 
+char *protocol_name(protocol_type_t protocol);
+protocol_type_t protocol_type(char *name);
+
 struct call *call_get(struct conn *conn);
 void call_put(struct call *call);
 
-ssize_t call_sendv(struct call *call, struct iovec *iov, int iovcnt);
 void call_make_req(struct context *ctx, struct call *call);
+void call_make_key_req(struct context *ctx, struct call *call, req_type_t method, uint32_t key_id, long int key_vlen);
+
+void rsp_parser_init(struct rsp_parser *rp);
+rstatus_t rsp_parse(struct rsp_parser *rp, char *pos, char *last, size_t *nparsed);
+rstatus_t rsp_parse_bin(struct rsp_parser *rp, char *pos, char *last, size_t *nparsed);
+rstatus_t rsp_parse_meta(struct rsp_parser *rp, char *pos, char *last, size_t *nparsed);
+size_t rsp_parse_skippable(struct rsp_parser *rp);
+void rsp_parse_skip(struct rsp_parser *rp, size_t n);
 
-rstatus_t call_send(struct context *ctx, struct call *call);
-rstatus_t call_recv(struct context *ctx, struct call *call);
+rstatus_t call_send(struct context *ctx, struct conn *conn);
+rstatus_t call_recv(struct context *ctx, struct conn *conn);
 
 void call_init(void);
 void call_deinit(void);
@@ -20,9 +20,10 @@
 
 #include <mcp_core.h>
 
-static int nfree_connq;            /* # free conn q */
-static struct conn_tqh free_connq; /* free conn q */
-static uint64_t id;
+/* connections are owned by the worker thread that created them */
+static __thread int nfree_connq;            /* # free conn q */
+static __thread struct conn_tqh free_connq; /* free conn q */
+static uint64_t id;                         /* conn id counter (shared) */
 
 struct conn *
 conn_get(struct context *ctx)
@@ -41,10 +42,13 @@ conn_get(struct context *ctx)
         if (conn == NULL) {
             return NULL;
         }
+        conn->siov = NULL;
+        conn->nsiov = 0;
+        conn->pool = NULL;
     }
 
     STAILQ_NEXT(conn, conn_tqe) = NULL;
-    conn->id = ++id;
+    conn->id = __sync_add_and_fetch(&id, 1);
     conn->ctx = ctx;
 
     conn->ncall_sendq = 0;
@@ -57,10 +61,19 @@ conn_get(struct context *ctx)
 
     conn->sd = -1;
 
-    /* conn->call_gen is initialized later */
+    /* conn->pool is preserved across reuse */
+    conn->lead = conn;
+    conn->server = 0;
+
+    conn->rpos = 0;
+    conn->ppos = 0;
+
+    /* conn->call_gen is initialized later, once the conn is connected */
+    conn->call_gen.done = 1;
     conn->ncall_created = 0;
     conn->ncall_create_failed = 0;
     conn->ncall_completed = 0;
+    conn->trace_next = 0;
 
     conn->err = 0;
     conn->recv_active = 0;
@@ -71,6 +84,24 @@ conn_get(struct context *ctx)
     conn->connecting = 0;
     conn->connected = 0;
     conn->eof = 0;
+    conn->send_pending = 0;
+    conn->closing = 0;
+    conn->failed = 0;
+
+    /* conn->siov and conn->nsiov are preserved across reuse */
+    conn->rbuf_head = -1;
+    conn->rbuf_tail = -1;
+    conn->rbuf_off = 0;
+    conn->sres = 0;
+    conn->uevents = 0;
+    conn->arm_poll = 0;
+    conn->arm_recv = 0;
+    conn->recv_inflight = 0;
+    conn->poll_inflight = 0;
+    conn->send_inflight = 0;
+    conn->send_done = 0;
+    conn->recv_eof = 0;
+    conn->recv_queued = 0;
 
     log_debug(LOG_VVERB, "get conn %p id %"PRIu64"", conn, conn->id);
 
@@ -86,22 +117,73 @@ conn_put(struct conn *conn)
     STAILQ_INSERT_TAIL(&free_connq, conn, conn_tqe);
 }
 
+/*
+ * Get the conns of the pool led by conn, one to every server but the first
+ * one, which conn itself connects to
+ */
+rstatus_t
+conn_get_pool(struct context *ctx, struct conn *conn)
+{
+    uint32_t i, nserver = ctx->opt.pool.nserver;
+    struct conn *c;
+
+    ASSERT(conn->lead == conn);
+
+    if (conn->pool == NULL) {
+        conn->pool = mcp_alloc(nserver * sizeof(*conn->pool));
+        if (conn->pool == NULL) {
+            return MCP_ENOMEM;
+        }
+    }
+
+    conn->pool[0] = conn;
+    for (i = 1; i < nserver; i++) {
+        c = conn_get(ctx);
+        if (c == NULL) {
+            while (--i > 0) {
+                conn_put(conn->pool[i]);
+            }
+            return MCP_ENOMEM;
+        }
+
+        c->lead = conn;
+        c->server = i;
+        conn->pool[i] = c;
+    }
+
+    return MCP_OK;
+}
+
 static void
 conn_free(struct conn *conn)
 {
     log_debug(LOG_VVERB, "free conn %p id %"PRIu64"", conn, conn->id);
+    if (conn->siov != NULL) {
+        mcp_free(conn->siov);
+    }
+    if (conn->pool != NULL) {
+        mcp_free(conn->pool);
+    }
     mcp_free(conn);
 }
 
 ssize_t
 conn_sendv(struct conn *conn, struct iovec *iov, int iovcnt, size_t iov_size)
 {
+    struct context *ctx = conn->ctx;
     ssize_t n;
 
     ASSERT(iov_size != 0);
     ASSERT(conn->send_ready);
 
+    if (ctx->engine->sendv != NULL) {
+        return ctx->engine->sendv(conn, iov, iovcnt, iov_size);
+    }
+
     for (;;) {
+        ctx->stats.nsys_send++;
+        ctx->stats.nio_send++;
+
         n = writev(conn->sd, iov, iovcnt);
 
         log_debug(LOG_VERB, "sendv on c %"PRIu64" sd %d %zd of %zu in "
@@ -144,21 +226,30 @@ conn_sendv(struct conn *conn, struct iovec *iov, int iovcnt, size_t iov_size)
 }
 
 ssize_t
-conn_recv(struct conn *conn, void *buf, size_t size)
+conn_recvv(struct conn *conn, struct iovec *iov, int iovcnt, size_t iov_size)
 {
+    struct context *ctx = conn->ctx;
     ssize_t n;
 
-    ASSERT(buf != NULL);
-    ASSERT(size > 0);
+    ASSERT(iovcnt > 0);
+    ASSERT(iov_size > 0);
     ASSERT(conn->recv_ready);
 
+    if (ctx->engine->recvv != NULL) {
+        return ctx->engine->recvv(conn, iov, iovcnt, iov_size);
+    }
+
     for (;;) {
-        n = read(conn->sd, buf, size);
+        ctx->stats.nsys_recv++;
+        ctx->stats.nio_recv++;
 
-        log_debug(LOG_VERB, "recv on sd %d %zd of %zu", conn->sd, n, size);
+        n = readv(conn->sd, iov, iovcnt);
+
+        log_debug(LOG_VERB, "recv on sd %d %zd of %zu in %d buffers", conn->sd,
+                  n, iov_size, iovcnt);
 
         if (n > 0) {
-            if (n < (ssize_t) size) {
+            if (n < (ssize_t) iov_size) {
                 conn->recv_ready = 0;
             }
             return n;
@@ -189,6 +280,64 @@ conn_recv(struct conn *conn, void *buf, size_t size)
     NOT_REACHED();
 }
 
+/*
+ * Discard up to size bytes of received data without copying them to user
+ * space; a tcp socket drops the data when recv(2) is called with MSG_TRUNC.
+ */
+ssize_t
+conn_discard(struct conn *conn, size_t size)
+{
+    struct context *ctx = conn->ctx;
+    ssize_t n;
+
+    ASSERT(size > 0);
+    ASSERT(conn->recv_ready);
+
+    if (ctx->engine->discard != NULL) {
+        return ctx->engine->discard(conn, size);
+    }
+
+    for (;;) {
+        ctx->stats.nsys_recv++;
+        ctx->stats.nio_recv++;
+
+        n = recv(conn->sd, NULL, size, MSG_TRUNC);
+
+        log_debug(LOG_VERB, "discard on sd %d %zd of %zu", conn->sd, n, size);
+
+        if (n > 0) {
+            if (n < (ssize_t) size) {
+                conn->recv_ready = 0;
+            }
+            return n;
+        }
+
+        if (n == 0) {
+            conn->recv_ready = 0;
+            conn->eof = 1;
+            log_debug(LOG_INFO, "discard on sd %d eof", conn->sd);
+            return n;
+        }
+
+        if (errno == EINTR) {
+            log_debug(LOG_VERB, "discard on sd %d not ready - eintr", conn->sd);
+            continue;
+        } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            conn->recv_ready = 0;
+            log_debug(LOG_VERB, "discard on sd %d not ready - eagain",
+                      conn->sd);
+            return MCP_EAGAIN;
+        } else {
+            conn->recv_ready = 0;
+            conn->err = errno;
+            log_error("discard on sd %d failed: %s", conn->sd, strerror(errno));
+            return MCP_ERROR;
+        }
+    }
+
+    NOT_REACHED();
+}
+
 void
 conn_init(void)
 {
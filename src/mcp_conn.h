@@ -19,10 +19,29 @@
 #ifndef _MCP_CONN_H_
 #define _MCP_CONN_H_
 
+#include <sys/socket.h>
+
 #include <mcp_generator.h>
 
+#define CONN_RBUF_SIZE  (16 * KB)   /* recv ring buffer size; power of 2 */
+#define CONN_RBUF_MASK  (CONN_RBUF_SIZE - 1)
+
+/*
+ * With a pool of servers, every connection made by the conn generator is
+ * a pool of conns, one to every server, led by the conn to the first one.
+ * Calls are issued and counted on the lead, and each is sent on the conn
+ * to the server of its key; the pool is closed as a whole.
+ *
+ * Responses are read into a per-conn ring buffer. The read and parse
+ * positions are free running counters that are masked on access, so the
+ * ring is empty when they are equal. One read fills all the free space,
+ * wrapping around if needed, and the parser then completes as many calls
+ * in the recv q as the received bytes allow.
+ */
 struct conn {
     STAILQ_ENTRY(conn) conn_tqe;            /* link in free q */
+    TAILQ_ENTRY(conn)  pend_tqe;            /* link in send pending q */
+    TAILQ_ENTRY(conn)  live_tqe;            /* link in live q */
     uint64_t           id;                  /* unique id */
     struct context     *ctx;                /* owner context */
 
@@ -36,12 +55,19 @@ struct conn {
 
     int                sd;                  /* socket descriptor */
 
-    char               buf[8 * KB];         /* conn buffer */
+    struct conn        *lead;               /* lead of the pool, or self */
+    struct conn        **pool;              /* conns of the pool by server */
+    uint32_t           server;              /* server index */
+
+    char               buf[CONN_RBUF_SIZE]; /* recv ring buffer */
+    uint32_t           rpos;                /* recv ring read position */
+    uint32_t           ppos;                /* recv ring parse position */
 
     struct gen         call_gen;            /* call generator */
     uint32_t           ncall_created;       /* # call created */
     uint32_t           ncall_create_failed; /* # call create failed */
     uint32_t           ncall_completed;     /* # call completed */
+    uint64_t           trace_next;          /* next trace record to replay */
 
     err_t              err;                 /* connection errno? */
     unsigned           recv_active:1;       /* recv active? */
@@ -52,15 +78,42 @@ struct conn {
     unsigned           connecting:1;        /* connecting? */
     unsigned           connected:1;         /* connected? */
     unsigned           eof:1;               /* eof? */
+    unsigned           send_pending:1;      /* in send pending q? */
+    unsigned           closing:1;           /* pool closing? */
+    unsigned           failed:1;            /* server failed? */
+
+    /* io_uring event engine state */
+    TAILQ_ENTRY(conn)  arm_tqe;             /* link in io_uring arm q */
+    TAILQ_ENTRY(conn)  ready_tqe;           /* link in io_uring ready q */
+    int32_t            rbuf_head;           /* first received buffer id */
+    int32_t            rbuf_tail;           /* last received buffer id */
+    uint32_t           rbuf_off;            /* offset into first received buffer */
+    struct msghdr      smsg;                /* in-flight send message */
+    struct iovec       *siov;               /* in-flight send iovec */
+    int                nsiov;               /* # allocated in-flight send iovec */
+    ssize_t            sres;                /* send completion result */
+    uint32_t           uevents;             /* events gathered for this conn */
+    unsigned           arm_poll:1;          /* poll pending submission? */
+    unsigned           arm_recv:1;          /* recv pending submission? */
+    unsigned           recv_inflight:1;     /* multishot recv in-flight? */
+    unsigned           poll_inflight:1;     /* poll in-flight? */
+    unsigned           send_inflight:1;     /* send in-flight? */
+    unsigned           send_done:1;         /* send completed? */
+    unsigned           recv_eof:1;          /* eof received? */
+    unsigned           recv_queued:1;       /* in io_uring ready q? */
 };
 
 STAILQ_HEAD(conn_tqh, conn);
+TAILQ_HEAD(conn_pendq, conn);
+TAILQ_HEAD(conn_liveq, conn);
 
 struct conn *conn_get(struct context *ctx);
 void conn_put(struct conn *conn);
+rstatus_t conn_get_pool(struct context *ctx, struct conn *conn);
 
 ssize_t conn_sendv(struct conn *conn, struct iovec *iov, int iovcnt, size_t iov_size);
-ssize_t conn_recv(struct conn *conn, void *buf, size_t size);
+ssize_t conn_recvv(struct conn *conn, struct iovec *iov, int iovcnt, size_t iov_size);
+ssize_t conn_discard(struct conn *conn, size_t size);
 
 void conn_init(void);
 void conn_deinit(void);
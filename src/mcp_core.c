@@ -20,30 +20,97 @@
 
 #include <mcp_core.h>
 
+#define CORE_DRAIN_TIMEOUT 1.0 /* min drain of the calls in flight in sec */
+
 extern struct load_generator size_generator, conn_generator, call_generator;
-extern struct stats_collector conn_stats, call_stats;
+extern struct load_generator replay_generator;
+extern struct stats_collector conn_stats, call_stats, record_stats;
 
 static struct load_generator *gen[] = {   /* load generators */
     &size_generator,
     &conn_generator,
-    &call_generator
+    &call_generator,
+    &replay_generator
 };
 
 static struct stats_collector *col[] = {  /* stats collectors */
     &conn_stats,
-    &call_stats
+    &call_stats,
+    &record_stats
 };
 
+/* workers publish their report intervals to the main context */
+static pthread_mutex_t report_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t report_cond = PTHREAD_COND_INITIALIZER;
+
 rstatus_t
 core_init(struct context *ctx)
 {
     rstatus_t status;
     struct opt *opt = &ctx->opt;
-    uint32_t i;
+    uint32_t i, seed;
+
+    ctx->engine = NULL;
+    ctx->ep = -1;
+    ctx->uring = NULL;
+    TAILQ_INIT(&ctx->send_pendq);
+    TAILQ_INIT(&ctx->live_connq);
+    ctx->done = 0;
+    ctx->report_timer = NULL;
+    ctx->warmup_timer = NULL;
+    ctx->duration_timer = NULL;
+    ctx->warmed_up = 0;
+    ctx->expired = 0;
+
+    /* initialize buffer */
+    memset(ctx->buf1m, '0', sizeof(ctx->buf1m));
+
+    /*
+     * Initialize distribution for {conn, call, size} load generators with
+     * either default or user-supplied values. Every worker of every client
+     * instance is seeded differently.
+     */
+    seed = opt->client.id * opt->num_threads + ctx->id;
+
+    dist_init(&ctx->conn_dist, opt->conn_dopt.type, opt->conn_dopt.min,
+              opt->conn_dopt.max, seed);
+
+    dist_init(&ctx->call_dist, opt->call_dopt.type, opt->call_dopt.min,
+              opt->call_dopt.max, seed);
+
+    dist_init(&ctx->size_dist, opt->size_dopt.type, opt->size_dopt.min,
+              opt->size_dopt.max, seed);
+
+    dist_init(&ctx->mget_dist, opt->mget_dopt.type, opt->mget_dopt.min,
+              opt->mget_dopt.max, seed);
+
+    key_dist_init(&ctx->key_dist, &opt->key_opt, seed);
+
+    server_dist_init(&ctx->server_dist, &opt->pool, seed);
+
+    /* a single request type needs no sampling */
+    if (opt->nmethod > 1) {
+        status = alias_init(&ctx->method_alias, opt->method_weight,
+                            REQ_MAX_TYPES, seed);
+        if (status != MCP_OK) {
+            return status;
+        }
+    }
+
+    /* initialize stats subsystem */
+    status = stats_init(ctx);
+    if (status != MCP_OK) {
+        return status;
+    }
+
+    /* initialize timer */
+    timer_init(opt->hires_pacing ? TIMER_HIRES_INTERVAL : TIMER_INTERVAL);
 
     /* initialize event machine */
-    ctx->timeout = TIMER_INTERVAL * 1e3;
-    ctx->nevent = (int)opt->num_conns;
+    ctx->timeout = TIMER_INTERVAL * 1e6;
+    ctx->nevent = (int)(opt->num_conns * opt->pool.nserver);
+    ctx->nready = 0;
+    ctx->iready = 0;
     status = event_init(ctx, EVENT_SIZE_HINT);
     if (status != MCP_OK) {
         return status;
@@ -71,6 +138,164 @@ core_init(struct context *ctx)
 void
 core_deinit(struct context *ctx)
 {
+    if (ctx->ep > 0) {
+        event_deinit(ctx);
+    }
+
+    call_deinit();
+    conn_deinit();
+    timer_deinit();
+    alias_deinit(&ctx->method_alias);
+}
+
+/*
+ * End the current report interval of a worker, publish it to the main
+ * context and schedule the end of the next one. The interval ends are
+ * kept on a fixed grid from the start of the test, so that a late timer
+ * does not make every later interval late as well.
+ *
+ * The intervals are published into a ring that the main context drains at
+ * its own pace, so that a worker held up by another never stalls its own
+ * event loop; see struct stats_interval.
+ */
+static void
+core_report(struct timer *t, void *arg)
+{
+    struct context *ctx = arg;
+
+    ASSERT(ctx->report_timer == t);
+
+    if (!stats_interval_rotate(&ctx->stats, ctx->nreport + 1)) {
+        log_warn("report interval %"PRIu32" of worker %"PRIu32" folded into "
+                 "the next one, as %d intervals are yet to be reported",
+                 ctx->nreport + 1, ctx->id, STATS_IVAL_NRING - 1);
+    }
+
+    pthread_mutex_lock(&report_lock);
+    ctx->nreport++;
+    pthread_cond_broadcast(&report_cond);
+    pthread_mutex_unlock(&report_lock);
+
+    /* a report late by more than an interval is followed right away */
+    ctx->report_time += ctx->opt.report_interval;
+    ctx->report_timer = timer_schedule(core_report, ctx,
+                                       MAX(ctx->report_time - timer_now(),
+                                           0.0));
+    if (ctx->report_timer == NULL) {
+        log_warn("schedule of report interval failed: %s", strerror(errno));
+    }
+}
+
+/*
+ * End the warmup of a worker. The stats gathered so far are discarded,
+ * along with those of the calls issued in the warmup that are yet to
+ * complete.
+ */
+static void
+core_warmup(struct timer *t, void *arg)
+{
+    struct context *ctx = arg;
+
+    ASSERT(ctx->warmup_timer == t);
+
+    /* timer are freed by the timeout handler */
+    ctx->warmup_timer = NULL;
+
+    log_debug(LOG_INFO, "warmup of %g s elapsed on worker %"PRIu32"",
+              ctx->opt.warmup, ctx->id);
+
+    stats_reset(ctx);
+    ctx->warmed_up = 1;
+}
+
+/*
+ * Time out the calls that are still in flight once the drain after the
+ * test duration is over, and close their connections.
+ */
+static void
+core_drain(struct timer *t, void *arg)
+{
+    struct context *ctx = arg;
+    struct conn *conn, *c;
+    uint32_t i;
+
+    ASSERT(ctx->duration_timer == t);
+
+    /* timer are freed by the timeout handler */
+    ctx->duration_timer = NULL;
+
+    log_debug(LOG_NOTICE, "timing out %"PRIu32" connections with calls in "
+              "flight on worker %"PRIu32"",
+              ctx->nconn_created - ctx->nconn_destroyed, ctx->id);
+
+    while ((conn = TAILQ_FIRST(&ctx->live_connq)) != NULL) {
+        for (i = 0; i < ctx->opt.pool.nserver; i++) {
+            c = conn->pool[i];
+            if (c->ncall_sendq + c->ncall_recvq != 0) {
+                ecb_signal(ctx, EVENT_CONN_TIMEOUT, c);
+            }
+        }
+        ecb_signal(ctx, EVENT_CONN_DESTROYED, conn);
+    }
+}
+
+/*
+ * End the test duration of a worker. No more connections or calls are
+ * made, and every connection is closed as soon as its calls in flight
+ * complete, or once the drain is over.
+ */
+static void
+core_expire(struct timer *t, void *arg)
+{
+    struct context *ctx = arg;
+    struct conn *conn, *nconn; /* current and next connection */
+    struct gen *g;
+    double drain;
+
+    ASSERT(ctx->duration_timer == t);
+
+    /* timer are freed by the timeout handler */
+    ctx->duration_timer = NULL;
+
+    log_debug(LOG_INFO, "duration of %g s elapsed on worker %"PRIu32"",
+              ctx->opt.duration, ctx->id);
+
+    ctx->expired = 1;
+
+    g = &ctx->conn_gen;
+    if (!g->done) {
+        g->done = 1;
+        gen_stop(g);
+    }
+
+    for (conn = TAILQ_FIRST(&ctx->live_connq); conn != NULL; conn = nconn) {
+        nconn = TAILQ_NEXT(conn, live_tqe);
+
+        g = &conn->call_gen;
+        if (!g->done) {
+            g->done = 1;
+            gen_stop(g);
+        }
+
+        if (conn->ncall_completed == conn->ncall_created) {
+            ecb_signal(ctx, EVENT_CONN_DESTROYED, conn);
+        }
+    }
+
+    if (ctx->done) {
+        return;
+    }
+
+    if (TAILQ_EMPTY(&ctx->live_connq)) {
+        core_stop(ctx);
+        return;
+    }
+
+    drain = MAX(ctx->opt.timeout, CORE_DRAIN_TIMEOUT);
+    ctx->duration_timer = timer_schedule(core_drain, ctx, drain);
+    if (ctx->duration_timer == NULL) {
+        log_warn("schedule of drain failed: %s", strerror(errno));
+    }
 }
 
 void
@@ -81,6 +306,33 @@ core_start(struct context *ctx)
     /* start the stats subsystem */
     stats_start(ctx);
 
+    /* start the report intervals */
+    if (ctx->opt.report_interval > 0.0) {
+        ctx->report_time = timer_now() + ctx->opt.report_interval;
+        ctx->report_timer = timer_schedule(core_report, ctx,
+                                           ctx->opt.report_interval);
+        if (ctx->report_timer == NULL) {
+            log_warn("schedule of report interval failed: %s",
+                     strerror(errno));
+        }
+    }
+
+    /* end the warmup and the test at their deadlines */
+    if (ctx->opt.warmup > 0.0) {
+        ctx->warmup_timer = timer_schedule(core_warmup, ctx,
+                                           ctx->opt.warmup);
+        if (ctx->warmup_timer == NULL) {
+            log_warn("schedule of warmup failed: %s", strerror(errno));
+        }
+    }
+    if (ctx->opt.duration > 0.0) {
+        ctx->duration_timer = timer_schedule(core_expire, ctx,
+                                             ctx->opt.duration);
+        if (ctx->duration_timer == NULL) {
+            log_warn("schedule of duration failed: %s", strerror(errno));
+        }
+    }
+
     /* start stats collectors */
     for (i = 0; i < NELEM(col); i++) {
         col[i]->start(ctx, NULL);
@@ -99,10 +351,23 @@ core_start(struct context *ctx)
 void
 core_stop(struct context *ctx)
 {
-    mcp_free(ctx->event);
-    close(ctx->ep);
+    event_deinit(ctx);
+
+    stats_stop(ctx);
+
+    if (ctx->report_timer != NULL) {
+        timer_cancel(ctx->report_timer);
+    }
+
+    if (ctx->warmup_timer != NULL) {
+        timer_cancel(ctx->warmup_timer);
+    }
+
+    if (ctx->duration_timer != NULL) {
+        timer_cancel(ctx->duration_timer);
+    }
 
-    stats_dump(ctx);
+    ctx->done = 1;
 }
 
 void
@@ -118,6 +383,7 @@ core_timeout(struct timer *t, void *arg)
     conn->watchdog = NULL;
 
     conn->connecting = 0;
+    conn->failed = 1;
 
     ecb_signal(ctx, EVENT_CONN_TIMEOUT, conn);
     ecb_signal(ctx, EVENT_CONN_DESTROYED, conn);
@@ -177,7 +443,7 @@ core_connect(struct context *ctx, struct conn *conn)
 {
     rstatus_t status;
     struct opt *opt = &ctx->opt;
-    struct sockinfo *si = &opt->si;
+    struct sockinfo *si = &opt->pool.server[conn->server].si;
 
     ASSERT(conn->sd < 0);
 
@@ -228,7 +494,7 @@ core_connect(struct context *ctx, struct conn *conn)
         goto error;
     }
 
-    status = event_add_conn(ctx->ep, conn);
+    status = event_add_conn(ctx, conn);
     if (status != MCP_OK) {
         log_debug(LOG_ERR, "event add conn e %d sd %d failed: %s", ctx->ep,
                   conn->sd, strerror(errno));
@@ -277,46 +543,173 @@ void
 core_send(struct context *ctx, struct conn *conn)
 {
     rstatus_t status;
-    struct call *call;
+    uint64_t id = conn->id;
 
     if (conn->connecting) {
         core_connected(ctx, conn);
     }
 
+    /* drain the send q until the socket would block */
     conn->send_ready = 1;
-    do {
-        call = STAILQ_FIRST(&conn->call_sendq);
-        if (call == NULL) {
+    while (conn->send_ready && !STAILQ_EMPTY(&conn->call_sendq)) {
+        status = call_send(ctx, conn);
+        if (status != MCP_OK) {
             return;
         }
 
-        status = call_send(ctx, call);
-        if (status != MCP_OK) {
-            return;
+        if (conn->sd < 0 || conn->id != id) {
+            break;
         }
+    }
+
+    if (conn->sd < 0 || conn->id != id) {
+        /* conn was closed, and maybe reused, by a completed noreply call */
+        return;
+    }
 
-    } while (conn->send_ready);
+    /*
+     * Out events are only needed to resume a partial write; they are
+     * disabled again once the send q drains.
+     */
+    if (conn->send_ready || STAILQ_EMPTY(&conn->call_sendq)) {
+        if (conn->send_active) {
+            event_del_out(ctx, conn);
+        }
+    } else if (!conn->send_active) {
+        event_add_out(ctx, conn);
+    }
+}
+
+/*
+ * Mark conn as having calls pending to be sent. Pending conns are flushed
+ * once per event loop iteration, so that the calls issued by timers are
+ * sent without waiting for an out event and, with an engine that batches
+ * submissions, are submitted together.
+ */
+void
+core_pend_send(struct context *ctx, struct conn *conn)
+{
+    if (conn->send_pending || !(conn->connected || conn->failed)) {
+        return;
+    }
+
+    conn->send_pending = 1;
+    TAILQ_INSERT_TAIL(&ctx->send_pendq, conn, pend_tqe);
+}
+
+static void
+core_unpend_send(struct context *ctx, struct conn *conn)
+{
+    if (!conn->send_pending) {
+        return;
+    }
+
+    conn->send_pending = 0;
+    TAILQ_REMOVE(&ctx->send_pendq, conn, pend_tqe);
+}
+
+/*
+ * Take the socket of conn off the event engine. A conn of a pool is closed
+ * along with the others on the events of any one of them; drop its events
+ * that are yet to be handled in this loop iteration, so that they don't act
+ * on a closed or reused conn.
+ */
+static void
+core_drop_events(struct context *ctx, struct conn *conn)
+{
+    int i;
+
+    for (i = ctx->iready + 1; i < ctx->nready; i++) {
+        if (ctx->event[i].data.ptr == conn) {
+            ctx->event[i].data.ptr = NULL;
+        }
+    }
+
+    if (conn->recv_active) {
+        event_del_conn(ctx, conn);
+    }
+}
+
+/*
+ * Fail the calls queued on a conn of a pool whose server failed. Every
+ * call counts as an error of the server and is completed, which can issue
+ * further calls, but not close the pool while some of its calls are still
+ * to be completed.
+ */
+static void
+core_fail_calls(struct context *ctx, struct conn *conn)
+{
+    struct call_tqh callq;
+    struct call *call;
+    uint32_t server = conn->server;
+
+    STAILQ_INIT(&callq);
+    STAILQ_CONCAT(&callq, &conn->call_recvq);
+    STAILQ_CONCAT(&callq, &conn->call_sendq);
+    conn->ncall_recvq = 0;
+    conn->ncall_sendq = 0;
+
+    while ((call = STAILQ_FIRST(&callq)) != NULL) {
+        STAILQ_REMOVE_HEAD(&callq, call_tqe);
+
+        if (ctx->stats.nserver != 0) {
+            ctx->stats.server[server].nerror++;
+        }
+
+        ecb_signal(ctx, EVENT_CALL_DESTROYED, call);
+        call_put(call);
+    }
+}
+
+static void
+core_flush(struct context *ctx)
+{
+    struct conn *conn;
+
+    while (!ctx->done && (conn = TAILQ_FIRST(&ctx->send_pendq)) != NULL) {
+        core_unpend_send(ctx, conn);
+
+        if (conn->failed) {
+            core_fail_calls(ctx, conn);
+            continue;
+        }
+
+        if (!conn->send_ready && conn->send_active) {
+            /* previous send is still waiting for an out event */
+            continue;
+        }
+
+        core_send(ctx, conn);
+        if (conn->err != 0) {
+            core_error(ctx, conn);
+        }
+    }
 }
 
 void
 core_recv(struct context *ctx, struct conn *conn)
 {
     rstatus_t status;
-    struct call *call;
+    uint64_t id = conn->id;
 
     ASSERT(!conn->connecting);
 
+    /* drain the socket until it would block */
     conn->recv_ready = 1;
     do {
-        call = STAILQ_FIRST(&conn->call_recvq);
-        if (call == NULL) {
+        if (STAILQ_EMPTY(&conn->call_recvq)) {
             return;
         }
 
-        status = call_recv(ctx, call);
+        status = call_recv(ctx, conn);
         if (status != MCP_OK) {
             return;
         }
+
+        if (conn->sd < 0 || conn->id != id) {
+            /* conn was closed, and maybe reused, by a completed call */
+            return;
+        }
     } while (conn->recv_ready);
 }
 
@@ -326,10 +719,29 @@ core_close(struct context *ctx, struct conn *conn)
     rstatus_t status;
     struct call *call, *ncall; /* current and next call */
 
-    if (conn->sd < 0) {
+    /* a failed conn of a pool has no socket but is still to be put */
+    if (conn->sd < 0 && !conn->failed) {
         return;
     }
 
+    /*
+     * A conn closed on an error or a timeout might still have its call
+     * generator ticking; stop it so that it doesn't issue calls on a
+     * closed (or reused) conn.
+     */
+    if (!conn->call_gen.done) {
+        conn->call_gen.done = 1;
+        gen_stop(&conn->call_gen);
+    }
+
+    core_unpend_send(ctx, conn);
+
+    if (conn->watchdog != NULL) {
+        timer_cancel(conn->watchdog);
+    }
+
+    core_drop_events(ctx, conn);
+
     for (call = STAILQ_FIRST(&conn->call_recvq); call != NULL; call = ncall) {
         ncall = STAILQ_NEXT(call, call_tqe);
 
@@ -352,16 +764,53 @@ core_close(struct context *ctx, struct conn *conn)
     }
     ASSERT(conn->ncall_sendq == 0);
 
-    status = close(conn->sd);
-    if (status != MCP_OK) {
-        log_debug(LOG_ERR, "close c %"PRIu64" sd %d failed: %s", conn->id,
-                  conn->sd, strerror(errno));
+    if (conn->sd >= 0) {
+        status = close(conn->sd);
+        if (status != MCP_OK) {
+            log_debug(LOG_ERR, "close c %"PRIu64" sd %d failed: %s", conn->id,
+                      conn->sd, strerror(errno));
+        }
+        conn->sd = -1;
     }
-    conn->sd = -1;
+    conn->failed = 0;
 
     conn_put(conn);
 }
 
+/*
+ * Close the socket of a conn of a pool whose server failed, but keep the
+ * conn in its pool, so that the pool carries on with its other servers.
+ * The calls queued on the conn, and the calls routed to it later on, fail
+ * on the next flush of the pending sends.
+ */
+void
+core_fail(struct context *ctx, struct conn *conn)
+{
+    rstatus_t status;
+
+    conn->failed = 1;
+
+    if (conn->watchdog != NULL) {
+        timer_cancel(conn->watchdog);
+    }
+
+    core_drop_events(ctx, conn);
+
+    if (conn->sd >= 0) {
+        status = close(conn->sd);
+        if (status != MCP_OK) {
+            log_debug(LOG_ERR, "close c %"PRIu64" sd %d failed: %s", conn->id,
+                      conn->sd, strerror(errno));
+        }
+        conn->sd = -1;
+    }
+
+    conn->connecting = 0;
+    conn->connected = 0;
+
+    core_pend_send(ctx, conn);
+}
+
 void
 core_error(struct context *ctx, struct conn *conn)
 {
@@ -379,6 +828,8 @@ core_error(struct context *ctx, struct conn *conn)
     log_debug(LOG_ERR, "error on c %"PRIu64" sd %d: %s", conn->id, conn->sd,
               strerror(conn->err));
 
+    conn->failed = 1;
+
     ecb_signal(ctx, EVENT_CONN_FAILED, conn);
     ecb_signal(ctx, EVENT_CONN_DESTROYED, conn);
 }
@@ -409,6 +860,34 @@ core_core(struct context *ctx, struct conn *conn, uint32_t events)
     }
 }
 
+/*
+ * Return the timeout of the event wait in usec. With high resolution
+ * pacing, sleep in the event wait only until TIMER_HIRES_SPIN before the
+ * next timer is due and poll without blocking for the rest, so that the
+ * timer is not late by the wake up latency of the event wait.
+ */
+static int
+core_wait_timeout(struct context *ctx)
+{
+    double delay;
+
+    if (!ctx->opt.hires_pacing) {
+        return ctx->timeout;
+    }
+
+    delay = timer_next();
+    if (delay < 0.0) {
+        return ctx->timeout;
+    }
+
+    delay -= TIMER_HIRES_SPIN;
+    if (delay <= 0.0) {
+        return 0;
+    }
+
+    return (int)MIN(delay * 1e6, (double)ctx->timeout);
+}
+
 rstatus_t
 core_loop(struct context *ctx)
 {
@@ -416,18 +895,260 @@ core_loop(struct context *ctx)
 
     timer_tick();
 
-    nsd = event_wait(ctx->ep, ctx->event, ctx->nevent, ctx->timeout);
+    core_flush(ctx);
+    if (ctx->done) {
+        return MCP_OK;
+    }
+
+    nsd = event_wait(ctx, core_wait_timeout(ctx));
     if (nsd < 0) {
         return nsd;
     }
 
-    for (i = 0; i < nsd; i++) {
+    /* the wait may have slept; stamp the ready events with the wake up */
+    timer_tick();
+
+    ctx->nready = nsd;
+    for (i = 0; i < nsd && !ctx->done; i++) {
         struct epoll_event *ev = &ctx->event[i];
 
+        ctx->iready = i;
+
+        /* the conn was closed by the events of another one of its pool */
+        if (ev->data.ptr == NULL) {
+            continue;
+        }
+
         core_core(ctx, ev->data.ptr, ev->events);
 
         timer_tick();
     }
+    ctx->nready = 0;
 
     return MCP_OK;
 }
+
+static void
+core_exit(struct context *ctx)
+{
+    pthread_mutex_lock(&report_lock);
+    ctx->exited = true;
+    pthread_cond_broadcast(&report_cond);
+    pthread_mutex_unlock(&report_lock);
+}
+
+static void *
+core_worker(void *arg)
+{
+    rstatus_t status;
+    struct context *ctx = arg;
+
+    status = core_init(ctx);
+    if (status != MCP_OK) {
+        ctx->status = status;
+        core_exit(ctx);
+        return NULL;
+    }
+
+    core_start(ctx);
+
+    while (!ctx->done) {
+        status = core_loop(ctx);
+        if (status != MCP_OK) {
+            ctx->status = status;
+            break;
+        }
+    }
+
+    core_deinit(ctx);
+
+    core_exit(ctx);
+
+    return NULL;
+}
+
+/*
+ * Wait for every running worker to publish report interval idx. Return
+ * false if no worker published it before exiting.
+ */
+static bool
+core_report_wait(struct context *ctx, uint32_t idx)
+{
+    struct context *w;
+    uint32_t i, nready, nwait;
+
+    for (;;) {
+        for (i = 0, nready = 0, nwait = 0; i < ctx->nworker; i++) {
+            w = &ctx->worker[i];
+            if (w->nreport >= idx) {
+                nready++;
+            } else if (!w->exited) {
+                nwait++;
+            }
+        }
+        if (nwait == 0) {
+            return nready != 0;
+        }
+        pthread_cond_wait(&report_cond, &report_lock);
+    }
+}
+
+/*
+ * Print a line for every report interval of the test, merging the
+ * intervals published by the workers, until all the workers have exited.
+ * The partial interval at the end of the test is left to the summary.
+ */
+static void
+core_report_run(struct context *ctx)
+{
+    struct context *w;
+    uint32_t idx, i;
+
+    for (idx = 1;; idx++) {
+        pthread_mutex_lock(&report_lock);
+        if (!core_report_wait(ctx, idx)) {
+            pthread_mutex_unlock(&report_lock);
+            break;
+        }
+        pthread_mutex_unlock(&report_lock);
+
+        /* the published intervals are read without holding up the workers */
+        stats_interval_reset(&ctx->stats);
+        for (i = 0; i < ctx->nworker; i++) {
+            w = &ctx->worker[i];
+            stats_interval_merge(&ctx->stats, &w->stats, idx);
+        }
+
+        stats_interval_dump(ctx, idx);
+    }
+}
+
+static void
+core_scale_dist(struct dist_opt *dopt, uint32_t n)
+{
+    /*
+     * A rate R split evenly across n workers is a rate of R / n on
+     * every worker, which stretches the inter-arrival interval n times.
+     */
+    if (dopt->type != DIST_NONE) {
+        dopt->min *= n;
+        dopt->max *= n;
+    }
+}
+
+/*
+ * Split the load across opt.num_threads worker contexts, run each worker
+ * in its own thread until it is done and fold the statistics collected by
+ * the workers into the statistics of the main context.
+ */
+rstatus_t
+core_run(struct context *ctx)
+{
+    rstatus_t status;
+    struct opt *opt = &ctx->opt;
+    struct context *w;
+    uint32_t i, nworker, nconn_active_max;
+    bool warmed_up;
+    int err;
+
+    nworker = MAX(1, MIN(opt->num_threads, opt->num_conns));
+    if (nworker != opt->num_threads) {
+        log_warn("reducing %"PRIu32" threads to %"PRIu32" threads for %"PRIu32
+                 " connections", opt->num_threads, nworker, opt->num_conns);
+        opt->num_threads = nworker;
+    }
+
+    ctx->worker = mcp_calloc(nworker, sizeof(*ctx->worker));
+    if (ctx->worker == NULL) {
+        return MCP_ENOMEM;
+    }
+    ctx->nworker = nworker;
+
+    for (i = 0; i < nworker; i++) {
+        w = &ctx->worker[i];
+
+        w->opt = *opt;
+        w->id = i;
+        w->status = MCP_OK;
+        w->exited = false;
+        w->nreport = 0;
+
+        /* distribute connections as evenly as possible */
+        w->opt.num_conns = opt->num_conns / nworker;
+        if (i < opt->num_conns % nworker) {
+            w->opt.num_conns++;
+        }
+
+        core_scale_dist(&w->opt.conn_dopt, nworker);
+    }
+
+    stats_start(ctx);
+
+    for (i = 0; i < nworker; i++) {
+        w = &ctx->worker[i];
+
+        /* one epoch for the whole test, whenever the worker gets going */
+        w->start_time = ctx->stats.start_time;
+
+        err = pthread_create(&w->tid, NULL, core_worker, w);
+        if (err != 0) {
+            log_error("create of worker %"PRIu32" failed: %s", i,
+                      strerror(err));
+            ctx->nworker = i;
+            break;
+        }
+    }
+
+    status = (ctx->nworker == nworker) ? MCP_OK : MCP_ERROR;
+    warmed_up = false;
+    nconn_active_max = 0;
+
+    if (opt->report_interval > 0.0) {
+        core_report_run(ctx);
+    }
+
+    for (i = 0; i < ctx->nworker; i++) {
+        w = &ctx->worker[i];
+
+        err = pthread_join(w->tid, NULL);
+        if (err != 0) {
+            log_error("join of worker %"PRIu32" failed: %s", i,
+                      strerror(err));
+            status = MCP_ERROR;
+            continue;
+        }
+
+        if (w->status != MCP_OK) {
+            status = w->status;
+        }
+
+        /*
+         * The stats of a test with a warmup start at the end of the warmup
+         * of the first worker; the stats of a worker that ended before its
+         * warmup was over are all kept
+         */
+        if (w->warmed_up && (!warmed_up ||
+                             w->stats.start_time < ctx->stats.start_time)) {
+            ctx->stats.start_time = w->stats.start_time;
+            ctx->stats.rusage_start = w->stats.rusage_start;
+            warmed_up = true;
+        }
+
+        nconn_active_max = MAX(nconn_active_max, w->stats.nconn_active_max);
+
+        stats_merge(&ctx->stats, &w->stats);
+        stats_deinit(w);
+    }
+
+    /* every worker saw the connections of all; see stats_conn_active */
+    ctx->stats.nconn_active_max = nconn_active_max;
+
+    if (opt->warmup > 0.0 && !warmed_up) {
+        log_warn("test ended before the warmup of %g s was over", opt->warmup);
+    }
+
+    /* advance the clock of the main context to the end of the test */
+    timer_tick();
+
+    return status;
+}
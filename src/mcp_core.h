@@ -43,7 +43,9 @@ struct context;
 struct conn;
 struct call;
 struct epoll_event;
+struct iovec;
 struct string;
+struct uring;
 
 typedef enum event_type {
     EVENT_INVALID           =  0,
@@ -81,6 +83,7 @@ typedef enum event_type {
 #include <string.h>
 #include <errno.h>
 #include <unistd.h>
+#include <pthread.h>
 
 #include <mcp_queue.h>
 #include <mcp_log.h>
@@ -88,10 +91,19 @@ typedef enum event_type {
 #include <mcp_event.h>
 #include <mcp_ecb.h>
 #include <mcp_distribution.h>
+#include <mcp_alias.h>
+#include <mcp_key.h>
+#include <mcp_server.h>
+#include <mcp_scan.h>
 #include <mcp_call.h>
 #include <mcp_conn.h>
 #include <mcp_timer.h>
+#include <mcp_histogram.h>
+#include <mcp_output.h>
 #include <mcp_stats.h>
+#include <mcp_result.h>
+#include <mcp_trace.h>
+#include <mcp_record.h>
 #include <mcp_generator.h>
 
 struct string {
@@ -103,46 +115,100 @@ struct opt {
     int               log_level;         /* log level */
     char              *log_filename;     /* log filename */
 
-    char              *server;           /* server name */
-    uint16_t          port;              /* server port */
-    struct sockinfo   si;                /* server socket info */
+    char              *server;           /* server list */
+    uint16_t          port;              /* default server port */
+    server_dist_type_t server_dist;      /* key distribution over the servers */
+    struct server_pool pool;             /* server pool */
+
+    uint32_t          hist_digits;       /* # histogram significant digits */
+    output_format_t   output_format;     /* stats output format */
+    char              *result_filename;  /* result filename */
 
     double            timeout;           /* connection timeout in sec */
+    double            report_interval;   /* report interval in sec */
+    double            duration;          /* test duration in sec */
+    double            warmup;            /* warmup in sec */
     int               linger_timeout;    /* linger timeout */
 
     int               send_buf_size;     /* send buffer size */
     int               recv_buf_size;     /* recv buffer size */
 
     struct string     prefix;            /* key prefix */
-    req_type_t        method;            /* request type */
+    req_type_t        method;            /* request type (first of the mix) */
+    uint32_t          nmethod;           /* # request types in the mix */
+    double            method_weight[REQ_MAX_TYPES]; /* weight of request type in the mix */
+    protocol_type_t   protocol;          /* protocol */
     uint32_t          expiry;            /* key expiry */
+    struct key_opt    key_opt;           /* key space and distribution option */
+
+    char              *replay_filename;  /* replay trace filename */
+    double            replay_speed;      /* replay speed up */
+    struct trace      trace;             /* replay trace */
+
+    char              *record_filename;  /* call record filename */
+    double            record_sample;     /* fraction of calls recorded */
+    struct record     record;            /* call record file */
 
     struct {
         uint32_t      id;                /* unique client id */
         uint32_t      n;                 /* # client */
     } client;                            /* client */
 
+    event_engine_type_t engine;          /* event engine */
+    uint32_t          num_threads;       /* # worker threads */
     uint32_t          num_conns;         /* # connections */
     uint32_t          num_calls;         /* # calls */
+    uint32_t          pipeline;          /* # calls in flight on a connection */
 
     struct dist_opt   conn_dopt;         /* conn distribution option */
     struct dist_opt   call_dopt;         /* call distribution option */
     struct dist_opt   size_dopt;         /* size distribution option */
+    struct dist_opt   mget_dopt;         /* multiget # keys distribution option */
 
     unsigned          print_histogram:1; /* print response time histogram? */
     unsigned          disable_nodelay:1; /* disable_nodelay? */
     unsigned          print_rusage:1;    /* print rusage? */
     unsigned          linger:1;          /* linger? */
     unsigned          use_noreply:1;     /* use_noreply? */
+    unsigned          hires_pacing:1;    /* high resolution pacing? */
+    unsigned          multiget:1;        /* multiget of more than one key? */
 };
 
+/*
+ * A context drives a single event loop. When mcperf runs with N worker
+ * threads, the main context only holds the cmdline options and the
+ * aggregated statistics, while each worker thread owns a context with its
+ * own share of connections, event machine, timers and statistics.
+ */
 struct context {
     struct opt         opt;                     /* cmdline option */
 
-    int                ep;                      /* epoll descriptor */
+    uint32_t           id;                      /* worker id */
+    pthread_t          tid;                     /* worker thread id */
+    uint32_t           nworker;                 /* # worker */
+    struct context     *worker;                 /* worker contexts */
+    rstatus_t          status;                  /* worker exit status */
+    unsigned           done:1;                  /* worker done? */
+    bool               exited;                  /* worker exited? (report lock) */
+    uint32_t           nreport;                 /* # intervals published (report lock) */
+    struct timer       *report_timer;           /* report interval timer */
+    double             report_time;             /* end of current report interval */
+    double             start_time;              /* start of the test on the main context */
+    struct timer       *warmup_timer;           /* end of warmup timer */
+    struct timer       *duration_timer;         /* end of test duration or drain timer */
+    unsigned           warmed_up:1;             /* warmup elapsed? */
+    unsigned           expired:1;               /* test duration elapsed? */
+
+    struct event_engine *engine;                /* event engine */
+    int                ep;                      /* epoll or io_uring descriptor */
     struct epoll_event *event;                  /* epoll event */
     int                nevent;                  /* # epoll event */
-    int                timeout;                 /* epoll timeout */
+    int                nready;                  /* # event of the current wait */
+    int                iready;                  /* index of the event handled */
+    int                timeout;                 /* event wait timeout in usec */
+    struct uring       *uring;                  /* io_uring instance */
+    struct conn_pendq  send_pendq;              /* conns with calls pending send */
+    struct conn_liveq  live_connq;              /* leads of the live conns */
 
     uint32_t           nconn_created;           /* # connection created */
     uint32_t           nconn_create_failed;     /* # connection create failed */
@@ -151,6 +217,11 @@ struct context {
     struct dist_info   conn_dist;               /* conn generator distribution */
     struct dist_info   call_dist;               /* call generator distribution */
     struct dist_info   size_dist;               /* size generator distribution */
+    struct dist_info   mget_dist;               /* multiget # keys distribution */
+    struct alias       method_alias;            /* request type sampler of the mix */
+    struct key_dist    key_dist;                /* key distribution */
+    struct server_dist server_dist;             /* server distribution */
+    struct record_ring record;                  /* call record ring */
 
     struct gen         conn_gen;                /* connection generator */
     struct gen         size_gen;                /* size generator */
@@ -190,11 +261,14 @@ void core_deinit(struct context *ctx);
 void core_start(struct context *ctx);
 void core_stop(struct context *ctx);
 rstatus_t core_loop(struct context *ctx);
+rstatus_t core_run(struct context *ctx);
 
 rstatus_t core_connect(struct context *ctx, struct conn *conn);
 void core_send(struct context *ctx, struct conn *conn);
+void core_pend_send(struct context *ctx, struct conn *conn);
 void core_recv(struct context *ctx, struct conn *conn);
 void core_close(struct context *ctx, struct conn *conn);
+void core_fail(struct context *ctx, struct conn *conn);
 void core_error(struct context *ctx, struct conn *conn);
 
 void core_timeout(struct timer *t, void *arg);
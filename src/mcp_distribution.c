@@ -20,6 +20,15 @@
 
 #include <mcp_core.h>
 
+static char *dist_names[] = {             /* distribution names */
+    "none",                                /* DIST_NONE */
+    "deterministic",                       /* DIST_DETERMINISTIC */
+    "uniform",                             /* DIST_UNIFORM */
+    "exponential",                         /* DIST_EXPONENTIAL */
+    "sequential",                          /* DIST_SEQUENTIAL */
+    NULL
+};
+
 static void
 dist_next_deterministic(struct dist_info *di)
 {
@@ -92,3 +101,11 @@ dist_init(struct dist_info *di, dist_type_t type, double min, double max,
     di->next_id = 0;
     di->next_val = 0.0;
 }
+
+char *
+dist_name(dist_type_t type)
+{
+    ASSERT(type >= DIST_NONE && type < DIST_SENTINEL);
+
+    return dist_names[type];
+}
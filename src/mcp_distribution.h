@@ -51,5 +51,6 @@ struct dist_info {
 };
 
 void dist_init(struct dist_info *di, dist_type_t type, double min, double max, uint32_t id);
+char *dist_name(dist_type_t type);
 
 #endif
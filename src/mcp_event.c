@@ -21,8 +21,55 @@
 
 #include <mcp_core.h>
 
-int
-event_init(struct context *ctx, int size)
+extern struct event_engine uring_engine;
+
+static struct event_engine epoll_engine;
+
+static struct event_engine *engine[] = {  /* event engines */
+    &epoll_engine,                         /* EVENT_ENGINE_EPOLL */
+    &uring_engine,                         /* EVENT_ENGINE_URING */
+    &uring_engine                          /* EVENT_ENGINE_URING_SQPOLL */
+};
+
+static char *engine_names[] = {           /* event engine names */
+    "epoll",                               /* EVENT_ENGINE_EPOLL */
+    "uring",                               /* EVENT_ENGINE_URING */
+    "uring-sqpoll",                        /* EVENT_ENGINE_URING_SQPOLL */
+    NULL
+};
+
+char *
+event_engine_name(event_engine_type_t type)
+{
+    ASSERT(type >= EVENT_ENGINE_EPOLL && type < EVENT_ENGINE_SENTINEL);
+
+    return engine_names[type];
+}
+
+event_engine_type_t
+event_engine_type(char *name)
+{
+    event_engine_type_t type;
+
+    for (type = EVENT_ENGINE_EPOLL; type < EVENT_ENGINE_SENTINEL; type++) {
+        if (strcmp(name, engine_names[type]) == 0) {
+            break;
+        }
+    }
+
+    return type;
+}
+
+/*
+ * Connections are registered edge-triggered, so an event is reported
+ * only when a socket becomes readable or writable. The core therefore
+ * drains a socket until it would block (tracked in recv_ready and
+ * send_ready) and only keeps out events enabled while a partial write
+ * has left data queued on the connection.
+ */
+
+static int
+epoll_init(struct context *ctx, int size)
 {
     int status, ep;
     struct epoll_event *event;
@@ -55,8 +102,8 @@ event_init(struct context *ctx, int size)
     return 0;
 }
 
-void
-event_deinit(struct context *ctx)
+static void
+epoll_deinit(struct context *ctx)
 {
     int status;
 
@@ -71,11 +118,12 @@ event_deinit(struct context *ctx)
     ctx->ep = -1;
 }
 
-int
-event_add_out(int ep, struct conn *c)
+static int
+epoll_add_out(struct context *ctx, struct conn *c)
 {
     int status;
     struct epoll_event event;
+    int ep = ctx->ep;
 
     ASSERT(ep > 0);
     ASSERT(c != NULL);
@@ -86,10 +134,11 @@ event_add_out(int ep, struct conn *c)
         return 0;
     }
 
-    //event.events = (uint32_t)(EPOLLIN | EPOLLOUT | EPOLLET);
-    event.events = (uint32_t)(EPOLLIN | EPOLLOUT);
+    event.events = (uint32_t)(EPOLLIN | EPOLLOUT | EPOLLET);
     event.data.ptr = c;
 
+    ctx->stats.nsys_ctl++;
+
     status = epoll_ctl(ep, EPOLL_CTL_MOD, c->sd, &event);
     if (status < 0) {
         log_error("epoll ctl on e %d sd %d failed: %s", ep, c->sd,
@@ -101,11 +150,12 @@ event_add_out(int ep, struct conn *c)
     return status;
 }
 
-int
-event_del_out(int ep, struct conn *c)
+static int
+epoll_del_out(struct context *ctx, struct conn *c)
 {
     int status;
     struct epoll_event event;
+    int ep = ctx->ep;
 
     ASSERT(ep > 0);
     ASSERT(c != NULL);
@@ -116,10 +166,11 @@ event_del_out(int ep, struct conn *c)
         return 0;
     }
 
-    //event.events = (uint32_t)(EPOLLIN | EPOLLET);
-    event.events = (uint32_t)(EPOLLIN);
+    event.events = (uint32_t)(EPOLLIN | EPOLLET);
     event.data.ptr = c;
 
+    ctx->stats.nsys_ctl++;
+
     status = epoll_ctl(ep, EPOLL_CTL_MOD, c->sd, &event);
     if (status < 0) {
         log_error("epoll ctl on e %d sd %d failed: %s", ep, c->sd,
@@ -131,20 +182,22 @@ event_del_out(int ep, struct conn *c)
     return status;
 }
 
-int
-event_add_conn(int ep, struct conn *c)
+static int
+epoll_add_conn(struct context *ctx, struct conn *c)
 {
     int status;
     struct epoll_event event;
+    int ep = ctx->ep;
 
     ASSERT(ep > 0);
     ASSERT(c != NULL);
     ASSERT(c->sd > 0);
 
-    //event.events = (uint32_t)(EPOLLIN | EPOLLOUT | EPOLLET);
-    event.events = (uint32_t)(EPOLLIN | EPOLLOUT);
+    event.events = (uint32_t)(EPOLLIN | EPOLLOUT | EPOLLET);
     event.data.ptr = c;
 
+    ctx->stats.nsys_ctl++;
+
     status = epoll_ctl(ep, EPOLL_CTL_ADD, c->sd, &event);
     if (status < 0) {
         log_error("epoll ctl on e %d sd %d failed: %s", ep, c->sd,
@@ -157,15 +210,18 @@ event_add_conn(int ep, struct conn *c)
     return status;
 }
 
-int
-event_del_conn(int ep, struct conn *c)
+static int
+epoll_del_conn(struct context *ctx, struct conn *c)
 {
     int status;
+    int ep = ctx->ep;
 
     ASSERT(ep > 0);
     ASSERT(c != NULL);
     ASSERT(c->sd > 0);
 
+    ctx->stats.nsys_ctl++;
+
     status = epoll_ctl(ep, EPOLL_CTL_DEL, c->sd, NULL);
     if (status < 0) {
         log_error("epoll ctl on e %d sd %d failed: %s", ep, c->sd,
@@ -178,17 +234,49 @@ event_del_conn(int ep, struct conn *c)
     return status;
 }
 
-int
-event_wait(int ep, struct epoll_event *event, int nevent, int timeout)
+/*
+ * Wait for at most timeout usec, or forever if timeout is -1. A timeout
+ * that is not a whole number of msec needs epoll_pwait2, and is cut down
+ * to whole msec where the system lacks it.
+ */
+static int
+epoll_wait_usec(int ep, struct epoll_event *event, int nevent, int timeout)
+{
+#ifdef HAVE_EPOLL_PWAIT2
+    static __thread bool nopwait2; /* epoll_pwait2 missing? */
+    struct timespec ts;
+    int nsd;
+
+    if (timeout > 0 && timeout % 1000 != 0 && !nopwait2) {
+        ts.tv_sec = timeout / 1000000;
+        ts.tv_nsec = (long)(timeout % 1000000) * 1000L;
+        nsd = epoll_pwait2(ep, event, nevent, &ts, NULL);
+        if (nsd >= 0 || errno != ENOSYS) {
+            return nsd;
+        }
+        nopwait2 = true;
+    }
+#endif
+
+    return epoll_wait(ep, event, nevent, timeout < 0 ? -1 : timeout / 1000);
+}
+
+static int
+epoll_wait_events(struct context *ctx, int timeout)
 {
     int nsd;
+    int ep = ctx->ep;
+    struct epoll_event *event = ctx->event;
+    int nevent = ctx->nevent;
 
     ASSERT(ep > 0);
     ASSERT(event != NULL);
     ASSERT(nevent > 0);
 
     for (;;) {
-        nsd = epoll_wait(ep, event, nevent, timeout);
+        ctx->stats.nsys_wait++;
+
+        nsd = epoll_wait_usec(ep, event, nevent, timeout);
         if (nsd > 0) {
             return nsd;
         }
@@ -215,3 +303,68 @@ event_wait(int ep, struct epoll_event *event, int nevent, int timeout)
 
     NOT_REACHED();
 }
+
+static struct event_engine epoll_engine = {
+    "epoll",
+    epoll_init,
+    epoll_deinit,
+    epoll_add_out,
+    epoll_del_out,
+    epoll_add_conn,
+    epoll_del_conn,
+    epoll_wait_events,
+    NULL,
+    NULL,
+    NULL
+};
+
+int
+event_init(struct context *ctx, int size)
+{
+    event_engine_type_t type = ctx->opt.engine;
+
+    ASSERT(type >= EVENT_ENGINE_EPOLL && type < EVENT_ENGINE_SENTINEL);
+
+    ctx->engine = engine[type];
+
+    log_debug(LOG_INFO, "event engine '%s'", engine_names[type]);
+
+    return ctx->engine->init(ctx, size);
+}
+
+void
+event_deinit(struct context *ctx)
+{
+    ctx->engine->deinit(ctx);
+}
+
+int
+event_add_out(struct context *ctx, struct conn *c)
+{
+    return ctx->engine->add_out(ctx, c);
+}
+
+int
+event_del_out(struct context *ctx, struct conn *c)
+{
+    return ctx->engine->del_out(ctx, c);
+}
+
+int
+event_add_conn(struct context *ctx, struct conn *c)
+{
+    return ctx->engine->add_conn(ctx, c);
+}
+
+int
+event_del_conn(struct context *ctx, struct conn *c)
+{
+    return ctx->engine->del_conn(ctx, c);
+}
+
+/* Wait for events for at most timeout usec, or forever if timeout is -1 */
+int
+event_wait(struct context *ctx, int timeout)
+{
+    return ctx->engine->wait(ctx, timeout);
+}
@@ -25,14 +25,53 @@
  */
 #define EVENT_SIZE_HINT 1024
 
+typedef enum event_engine_type {
+    EVENT_ENGINE_EPOLL,         /* epoll(7) */
+    EVENT_ENGINE_URING,         /* io_uring(7) */
+    EVENT_ENGINE_URING_SQPOLL,  /* io_uring(7) with kernel submission thread */
+    EVENT_ENGINE_SENTINEL
+} event_engine_type_t;
+
+typedef int (*event_init_t)(struct context *, int);
+typedef void (*event_deinit_t)(struct context *);
+typedef int (*event_conn_t)(struct context *, struct conn *);
+typedef int (*event_wait_t)(struct context *, int);
+typedef ssize_t (*event_sendv_t)(struct conn *, struct iovec *, int, size_t);
+typedef ssize_t (*event_recvv_t)(struct conn *, struct iovec *, int, size_t);
+typedef ssize_t (*event_discard_t)(struct conn *, size_t);
+
+/*
+ * An event engine multiplexes the connections of a context. Readiness
+ * (and completion) is always reported through the epoll_event array of
+ * the context. An engine that does the socket I/O on its own, instead of
+ * leaving it to plain writev(2) and readv(2) calls in the conn layer,
+ * provides the sendv, recvv and discard handlers.
+ */
+struct event_engine {
+    char            *name;     /* engine name */
+    event_init_t    init;      /* init event machine */
+    event_deinit_t  deinit;    /* deinit event machine */
+    event_conn_t    add_out;   /* enable out events on a conn */
+    event_conn_t    del_out;   /* disable out events on a conn */
+    event_conn_t    add_conn;  /* add conn to event machine */
+    event_conn_t    del_conn;  /* delete conn from event machine */
+    event_wait_t    wait;      /* wait for events */
+    event_sendv_t   sendv;     /* send on a conn (optional) */
+    event_recvv_t   recvv;     /* recv on a conn (optional) */
+    event_discard_t discard;   /* discard received data on a conn (optional) */
+};
+
+char *event_engine_name(event_engine_type_t type);
+event_engine_type_t event_engine_type(char *name);
+
 int event_init(struct context *ctx, int size);
 void event_deinit(struct context *ctx);
 
-int event_add_out(int ep, struct conn *c);
-int event_del_out(int ep, struct conn *c);
-int event_add_conn(int ep, struct conn *c);
-int event_del_conn(int ep, struct conn *c);
+int event_add_out(struct context *ctx, struct conn *c);
+int event_del_out(struct context *ctx, struct conn *c);
+int event_add_conn(struct context *ctx, struct conn *c);
+int event_del_conn(struct context *ctx, struct conn *c);
 
-int event_wait(int ep, struct epoll_event *event, int nevent, int timeout);
+int event_wait(struct context *ctx, int timeout);
 
 #endif
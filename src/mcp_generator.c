@@ -39,6 +39,7 @@ gen_tick(struct timer *t, void *arg)
     now = timer_now();
 
     while (now > g->next_time) {
+        g->tick_time = g->next_time;
         g->done = (g->tick(ctx, g->arg) < 0) ? 1 : 0;
         if (g->done) {
             gen_stop(g);
@@ -66,6 +67,7 @@ gen_fire(struct context *ctx, event_type_t type, void *rarg, void *carg)
         return;
     }
 
+    g->tick_time = timer_now();
     g->done = (g->tick(ctx, g->arg) < 0) ? 1 : 0;
     if (g->done) {
         gen_stop(g);
@@ -87,6 +89,7 @@ _gen_start(struct gen *g, struct context *ctx, struct dist_info *di,
     g->arg = arg;
     g->start_time = timer_now();
     /* g->next_time is initialized later */
+    /* g->tick_time is initialized later */
 
     /* g->done is initialized later */
     g->oneshot = (firing_event != EVENT_INVALID) ? 1 : 0;
@@ -116,6 +119,7 @@ _gen_start(struct gen *g, struct context *ctx, struct dist_info *di,
 
     log_debug(LOG_DEBUG, "start gen %p to tick '%s'", g, g->tickname);
 
+    g->tick_time = timer_now();
     g->done = (g->tick(ctx, g->arg) < 0) ? 1 : 0;
     if (g->done) {
         gen_stop(g);
@@ -129,6 +133,7 @@ gen_stop(struct gen *g)
 
     if (g->timer != NULL) {
         timer_cancel(g->timer);
+        g->timer = NULL;
     }
 
     log_debug(LOG_DEBUG, "stop gen %p to tick '%s'", g, g->tickname);
@@ -37,6 +37,7 @@ struct gen {
     void              *arg;        /* opaque tick arg */
     double            start_time;  /* start time of a tick (const) */
     double            next_time;   /* next time to tick again */
+    double            tick_time;   /* scheduled time of the current tick */
 
     unsigned          oneshot:1;   /* one-shot? */
     unsigned          done:1;      /* done? */
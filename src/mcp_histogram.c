@@ -0,0 +1,245 @@
+/*
+ *  twemperf - a tool for measuring memcached server performance.
+ *  Copyright (C) 2011 Twitter, Inc.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <mcp_core.h>
+
+/*
+ * The counter index of a value is made of the bucket, which is the power
+ * of two above the first bucket, and the sub-bucket within it. The first
+ * bucket holds sub_bucket_count values at unit width; every bucket after
+ * it only needs its upper half, as the lower half is covered at twice the
+ * resolution by the bucket before.
+ */
+static uint32_t
+histogram_bucket(struct histogram *h, uint64_t value)
+{
+    uint32_t pow2ceiling;
+
+    pow2ceiling = 64 - (uint32_t)__builtin_clzll(value | h->sub_bucket_mask);
+
+    return pow2ceiling - (h->sub_bucket_half_count_magnitude + 1);
+}
+
+static uint32_t
+histogram_index(struct histogram *h, uint64_t value)
+{
+    uint32_t bucket, sub_bucket;
+
+    bucket = histogram_bucket(h, value);
+    sub_bucket = (uint32_t)(value >> bucket);
+
+    return ((bucket + 1) << h->sub_bucket_half_count_magnitude) +
+           (sub_bucket - h->sub_bucket_half_count);
+}
+
+static uint64_t
+histogram_value(struct histogram *h, uint32_t idx)
+{
+    int32_t bucket;
+    uint32_t sub_bucket;
+
+    bucket = (int32_t)(idx >> h->sub_bucket_half_count_magnitude) - 1;
+    sub_bucket = (idx & (h->sub_bucket_half_count - 1)) +
+                 h->sub_bucket_half_count;
+    if (bucket < 0) {
+        sub_bucket -= h->sub_bucket_half_count;
+        bucket = 0;
+    }
+
+    return (uint64_t)sub_bucket << bucket;
+}
+
+/* highest value that is counted in the same counter as value */
+static uint64_t
+histogram_highest_equivalent(struct histogram *h, uint64_t value)
+{
+    return value + (1ULL << histogram_bucket(h, value)) - 1;
+}
+
+rstatus_t
+histogram_init(struct histogram *h, uint64_t highest, uint32_t digits)
+{
+    uint64_t largest, trackable;
+    uint32_t magnitude, i;
+
+    ASSERT(highest >= 2);
+    ASSERT(digits >= HIST_MIN_DIGITS && digits <= HIST_MAX_DIGITS);
+
+    /* sub-buckets to tell apart two values 10^-digits apart */
+    for (largest = 2, i = 0; i < digits; i++) {
+        largest *= 10;
+    }
+    for (magnitude = 1; (1ULL << magnitude) < largest; magnitude++) {
+        /* void */
+    }
+
+    h->highest = highest;
+    h->digits = digits;
+    h->sub_bucket_half_count_magnitude = magnitude - 1;
+    h->sub_bucket_half_count = 1U << (magnitude - 1);
+    h->sub_bucket_mask = (1ULL << magnitude) - 1;
+
+    /* buckets to cover values up to highest */
+    h->bucket_count = 1;
+    for (trackable = 1ULL << magnitude; trackable <= highest;
+         trackable <<= 1) {
+        h->bucket_count++;
+        if (trackable > (UINT64_MAX >> 1)) {
+            break;
+        }
+    }
+
+    h->ncount = (h->bucket_count + 1) * h->sub_bucket_half_count;
+    h->count = mcp_calloc(h->ncount, sizeof(*h->count));
+    if (h->count == NULL) {
+        return MCP_ENOMEM;
+    }
+
+    h->total = 0;
+    h->min = UINT64_MAX;
+    h->max = 0;
+
+    return MCP_OK;
+}
+
+void
+histogram_deinit(struct histogram *h)
+{
+    if (h->count != NULL) {
+        mcp_free(h->count);
+        h->count = NULL;
+    }
+}
+
+void
+histogram_reset(struct histogram *h)
+{
+    memset(h->count, 0, h->ncount * sizeof(*h->count));
+    h->total = 0;
+    h->min = UINT64_MAX;
+    h->max = 0;
+}
+
+void
+histogram_record(struct histogram *h, uint64_t value)
+{
+    uint32_t idx;
+
+    if (value > h->highest) {
+        value = h->highest;
+    }
+
+    idx = histogram_index(h, value);
+    ASSERT(idx < h->ncount);
+
+    h->count[idx]++;
+    h->total++;
+    h->min = MIN(h->min, value);
+    h->max = MAX(h->max, value);
+}
+
+/*
+ * Fold src into dst; both histograms must have been initialized with the
+ * same range and significant digits. A src that failed to initialize is
+ * treated as empty.
+ */
+void
+histogram_merge(struct histogram *dst, struct histogram *src)
+{
+    uint32_t i;
+
+    if (src->count == NULL) {
+        return;
+    }
+
+    ASSERT(dst->ncount == src->ncount);
+    ASSERT(dst->digits == src->digits);
+
+    for (i = 0; i < src->ncount; i++) {
+        dst->count[i] += src->count[i];
+    }
+    dst->total += src->total;
+    dst->min = MIN(dst->min, src->min);
+    dst->max = MAX(dst->max, src->max);
+}
+
+/*
+ * Return the value below which the fraction q of the recorded values fall,
+ * as the highest value that is equivalent to it at the histogram
+ * resolution, capped at the max value recorded.
+ */
+uint64_t
+histogram_percentile(struct histogram *h, double q)
+{
+    struct histogram_iter it;
+    uint64_t rank;
+
+    if (h->total == 0) {
+        return 0;
+    }
+
+    rank = (uint64_t)ceil(q * (double)h->total);
+    rank = MAX(rank, 1);
+
+    histogram_iter_init(&it, h);
+    while (histogram_iter_next(&it)) {
+        if (it.cumulative >= rank) {
+            return MIN(it.high, h->max);
+        }
+    }
+
+    return h->max;
+}
+
+void
+histogram_iter_init(struct histogram_iter *it, struct histogram *h)
+{
+    it->h = h;
+    it->idx = -1;
+    it->count = 0;
+    it->cumulative = 0;
+    it->low = 0;
+    it->high = 0;
+}
+
+bool
+histogram_iter_next(struct histogram_iter *it)
+{
+    struct histogram *h = it->h;
+    uint32_t i;
+
+    if (it->cumulative == h->total) {
+        return false;
+    }
+
+    for (i = (uint32_t)(it->idx + 1); i < h->ncount; i++) {
+        if (h->count[i] != 0) {
+            break;
+        }
+    }
+    ASSERT(i < h->ncount);
+
+    it->idx = (int32_t)i;
+    it->count = h->count[i];
+    it->cumulative += it->count;
+    it->low = histogram_value(h, i);
+    it->high = histogram_highest_equivalent(h, it->low);
+
+    return true;
+}
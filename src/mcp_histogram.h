@@ -0,0 +1,74 @@
+/*
+ *  twemperf - a tool for measuring memcached server performance.
+ *  Copyright (C) 2011 Twitter, Inc.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _MCP_HISTOGRAM_H_
+#define _MCP_HISTOGRAM_H_
+
+#define HIST_MIN_DIGITS 1
+#define HIST_MAX_DIGITS 5
+
+/*
+ * Log-linear histogram of integer values in [1, highest], in the manner of
+ * HdrHistogram. Values are bucketed by powers of two, and every bucket is
+ * split linearly into enough sub-buckets to tell apart values that differ
+ * in the given number of significant decimal digits. Values above highest
+ * are recorded as highest.
+ *
+ * With 3 significant digits, a histogram of 1 usec to 100 sec takes 18432
+ * counters and reports any value to within 0.1%.
+ */
+struct histogram {
+    uint64_t  highest;                         /* highest trackable value */
+    uint32_t  digits;                          /* # significant digits */
+    uint32_t  sub_bucket_half_count_magnitude; /* log2 of sub_bucket_half_count */
+    uint32_t  sub_bucket_half_count;           /* # sub-buckets in half a bucket */
+    uint64_t  sub_bucket_mask;                 /* mask of values in the first bucket */
+    uint32_t  bucket_count;                    /* # buckets */
+    uint32_t  ncount;                          /* # counters */
+    uint64_t  *count;                          /* counters */
+    uint64_t  total;                           /* # values recorded */
+    uint64_t  min;                             /* min value recorded */
+    uint64_t  max;                             /* max value recorded */
+};
+
+/*
+ * Iterator over the non-empty counters of a histogram in increasing order
+ * of value.
+ */
+struct histogram_iter {
+    struct histogram *h;                       /* histogram */
+    int32_t          idx;                      /* current counter index */
+    uint64_t         count;                    /* # values in the current counter */
+    uint64_t         cumulative;               /* # values up to the current counter */
+    uint64_t         low;                      /* lowest value of the current counter */
+    uint64_t         high;                     /* highest value of the current counter */
+};
+
+rstatus_t histogram_init(struct histogram *h, uint64_t highest, uint32_t digits);
+void histogram_deinit(struct histogram *h);
+void histogram_reset(struct histogram *h);
+
+void histogram_record(struct histogram *h, uint64_t value);
+void histogram_merge(struct histogram *dst, struct histogram *src);
+uint64_t histogram_percentile(struct histogram *h, double q);
+
+void histogram_iter_init(struct histogram_iter *it, struct histogram *h);
+bool histogram_iter_next(struct histogram_iter *it);
+
+#endif
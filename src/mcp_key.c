@@ -0,0 +1,224 @@
+/*
+ *  twemperf - a tool for measuring memcached server performance.
+ *  Copyright (C) 2011 Twitter, Inc.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <stdlib.h>
+#include <math.h>
+
+#include <mcp_core.h>
+
+static char *key_dist_names[] = {         /* key distribution names */
+    "sequential",                          /* KEY_DIST_SEQUENTIAL */
+    "uniform",                             /* KEY_DIST_UNIFORM */
+    "zipf",                                /* KEY_DIST_ZIPF */
+    "hotspot",                             /* KEY_DIST_HOTSPOT */
+    "latest",                              /* KEY_DIST_LATEST */
+    NULL
+};
+
+char *
+key_dist_name(key_dist_type_t type)
+{
+    ASSERT(type >= KEY_DIST_SEQUENTIAL && type < KEY_DIST_SENTINEL);
+
+    return key_dist_names[type];
+}
+
+key_dist_type_t
+key_dist_type(char *name)
+{
+    key_dist_type_t type;
+
+    for (type = KEY_DIST_SEQUENTIAL; type < KEY_DIST_SENTINEL; type++) {
+        if (strcmp(name, key_dist_names[type]) == 0) {
+            break;
+        }
+    }
+
+    return type;
+}
+
+/* log(1 + x) / x, accurate near 0 */
+static double
+key_zipf_helper1(double x)
+{
+    if (fabs(x) > 1e-8) {
+        return log1p(x) / x;
+    }
+    return 1.0 - x * (0.5 - x * (1.0 / 3.0 - 0.25 * x));
+}
+
+/* (exp(x) - 1) / x, accurate near 0 */
+static double
+key_zipf_helper2(double x)
+{
+    if (fabs(x) > 1e-8) {
+        return expm1(x) / x;
+    }
+    return 1.0 + x * 0.5 * (1.0 + x * (1.0 / 3.0) * (1.0 + 0.25 * x));
+}
+
+/* h(x) = 1 / x^theta, the hat function of the zipf weights */
+static double
+key_zipf_h(struct key_dist *kd, double x)
+{
+    return exp(-kd->theta * log(x));
+}
+
+/* H(x), an integral of h(x) */
+static double
+key_zipf_hintegral(struct key_dist *kd, double x)
+{
+    double logx = log(x);
+
+    return key_zipf_helper2((1.0 - kd->theta) * logx) * logx;
+}
+
+/* inverse of H(x) */
+static double
+key_zipf_hintegral_inverse(struct key_dist *kd, double x)
+{
+    double t = x * (1.0 - kd->theta);
+
+    if (t < -1.0) {
+        /* limit rounding errors */
+        t = -1.0;
+    }
+
+    return exp(key_zipf_helper1(t) * x);
+}
+
+/*
+ * Draw a rank in [1, nkey] with weight 1/k^theta: invert the integral of
+ * the hat function at a uniform point under it, round to the nearest
+ * rank and accept the rank if the point also falls under the weight of
+ * the rank, which is all but always the case.
+ */
+static uint32_t
+key_zipf_next(struct key_dist *kd)
+{
+    double u, x, k;
+
+    for (;;) {
+        u = kd->hxn + erand48(kd->xsubi) * (kd->hx1 - kd->hxn);
+        x = key_zipf_hintegral_inverse(kd, u);
+
+        k = floor(x + 0.5);
+        if (k < 1.0) {
+            k = 1.0;
+        } else if (k > kd->nkey) {
+            k = kd->nkey;
+        }
+
+        if (k - x <= kd->s ||
+            u >= key_zipf_hintegral(kd, k + 0.5) - key_zipf_h(kd, k)) {
+            return (uint32_t)k;
+        }
+    }
+}
+
+void
+key_dist_init(struct key_dist *kd, struct key_opt *kopt, uint32_t id)
+{
+    kd->type = kopt->type;
+    kd->nkey = kopt->nkey;
+    kd->next = 0;
+
+    kd->xsubi[0] = (uint16_t)(0x2468 ^ id);
+    kd->xsubi[1] = (uint16_t)(0x1357 ^ (id << 8));
+    kd->xsubi[2] = (uint16_t)(0xfdb9 ^ ~id);
+
+    kd->theta = kopt->theta;
+    kd->hx1 = 0.0;
+    kd->hxn = 0.0;
+    kd->s = 0.0;
+
+    kd->nhot = 0;
+    kd->hot_ops = kopt->hot_ops;
+
+    switch (kd->type) {
+    case KEY_DIST_SEQUENTIAL:
+    case KEY_DIST_UNIFORM:
+        break;
+
+    case KEY_DIST_ZIPF:
+    case KEY_DIST_LATEST:
+        ASSERT(kd->nkey > 0 && kd->theta > 0.0);
+        kd->hx1 = key_zipf_hintegral(kd, 1.5) - 1.0;
+        kd->hxn = key_zipf_hintegral(kd, kd->nkey + 0.5);
+        kd->s = 2.0 - key_zipf_hintegral_inverse(kd,
+                          key_zipf_hintegral(kd, 2.5) - key_zipf_h(kd, 2.0));
+        /* the newest key is the last one until the first insert */
+        kd->next = kd->nkey - 1;
+        break;
+
+    case KEY_DIST_HOTSPOT:
+        ASSERT(kd->nkey > 0);
+        kd->nhot = (uint32_t)MAX(lrint(kopt->hot_keys * kd->nkey), 1);
+        kd->nhot = MIN(kd->nhot, kd->nkey);
+        break;
+
+    default:
+        NOT_REACHED();
+    }
+}
+
+/*
+ * Return the id of the key of the next request, which is an insert of a
+ * new key if insert is set.
+ */
+uint32_t
+key_next(struct key_dist *kd, bool insert)
+{
+    uint32_t key, ncold;
+
+    switch (kd->type) {
+    case KEY_DIST_SEQUENTIAL:
+        key = kd->next++;
+        if (kd->next == kd->nkey) {
+            kd->next = 0;
+        }
+        return key;
+
+    case KEY_DIST_UNIFORM:
+        return (uint32_t)(erand48(kd->xsubi) * kd->nkey);
+
+    case KEY_DIST_ZIPF:
+        return key_zipf_next(kd) - 1;
+
+    case KEY_DIST_HOTSPOT:
+        ncold = kd->nkey - kd->nhot;
+        if (ncold == 0 || erand48(kd->xsubi) < kd->hot_ops) {
+            return (uint32_t)(erand48(kd->xsubi) * kd->nhot);
+        }
+        return kd->nhot + (uint32_t)(erand48(kd->xsubi) * ncold);
+
+    case KEY_DIST_LATEST:
+        if (insert) {
+            kd->next = kd->next + 1 == kd->nkey ? 0 : kd->next + 1;
+            return kd->next;
+        }
+        key = key_zipf_next(kd) - 1;
+        return kd->next >= key ? kd->next - key : kd->nkey - (key - kd->next);
+
+    default:
+        NOT_REACHED();
+    }
+
+    return 0;
+}
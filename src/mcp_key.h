@@ -0,0 +1,73 @@
+/*
+ *  twemperf - a tool for measuring memcached server performance.
+ *  Copyright (C) 2011 Twitter, Inc.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _MCP_KEY_H_
+#define _MCP_KEY_H_
+
+#define KEY_ZIPF_THETA      0.99    /* default zipf exponent */
+#define KEY_HOT_KEYS        0.2     /* default fraction of hot keys */
+#define KEY_HOT_OPS         0.8     /* default fraction of ops on hot keys */
+
+typedef enum key_dist_type {
+    KEY_DIST_SEQUENTIAL,    /* every key in turn */
+    KEY_DIST_UNIFORM,       /* every key alike */
+    KEY_DIST_ZIPF,          /* key of rank k with weight 1/k^theta */
+    KEY_DIST_HOTSPOT,       /* a fraction of hot keys takes a fraction of ops */
+    KEY_DIST_LATEST,        /* zipf over the keys written most recently */
+    KEY_DIST_SENTINEL
+} key_dist_type_t;
+
+struct key_opt {
+    key_dist_type_t type;       /* key distribution type */
+    uint32_t        nkey;       /* # keys, or 0 for unbounded */
+    double          theta;      /* zipf exponent */
+    double          hot_keys;   /* fraction of hot keys */
+    double          hot_ops;    /* fraction of ops on hot keys */
+};
+
+/*
+ * A key distribution picks the id of the key of every request out of a
+ * key space of nkey keys. Zipf keys are drawn in constant expected time
+ * by rejection-inversion (Hormann and Derflinger, 1996), which needs no
+ * table over the key space and takes about one draw per key. The latest
+ * distribution writes a new key with every insert and reads the keys at
+ * zipf distributed distances behind the newest one.
+ */
+struct key_dist {
+    key_dist_type_t type;       /* key distribution type */
+    uint32_t        nkey;       /* # keys, or 0 for unbounded */
+    uint32_t        next;       /* next sequential key, or newest key */
+    uint16_t        xsubi[3];   /* erand48 seed */
+
+    double          theta;      /* zipf exponent */
+    double          hx1;        /* zipf H(1.5) - 1 */
+    double          hxn;        /* zipf H(nkey + 0.5) */
+    double          s;          /* zipf squeeze bound */
+
+    uint32_t        nhot;       /* # hot keys */
+    double          hot_ops;    /* fraction of ops on hot keys */
+};
+
+char *key_dist_name(key_dist_type_t type);
+key_dist_type_t key_dist_type(char *name);
+
+void key_dist_init(struct key_dist *kd, struct key_opt *kopt, uint32_t id);
+uint32_t key_next(struct key_dist *kd, bool insert);
+
+#endif
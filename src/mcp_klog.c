@@ -0,0 +1,585 @@
+/*
+ *  twemperf - a tool for measuring memcached server performance.
+ *  Copyright (C) 2011 Twitter, Inc.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <getopt.h>
+#include <time.h>
+
+#include <mcp_core.h>
+
+extern struct string req_strings[];
+
+/*
+ * mcperf-klog converts the command logs (klogs) of twemcache into a trace
+ * file that mcperf replays with -F. Every klog line holds one request:
+ *
+ *   <peer> - [<dd/Mon/yyyy:HH:MM:SS zone>] "<command> <key> [<arg>...]" <status> <length>
+ *
+ * The value length of a storage request is the <bytes> argument of its
+ * command and the delta of an incr or decr is its first argument. The
+ * timestamps of a klog have a resolution of a second, so the requests
+ * logged in the same second are spread evenly over that second. Lines of
+ * other commands are skipped.
+ */
+
+#define KLOG_NTOKEN     6           /* # command tokens that are looked at */
+#define KLOG_NBUCKET    (64 * 1024) /* initial # key hash buckets */
+
+struct klog_key {
+    struct klog_key *next;          /* next key in hash bucket */
+    uint32_t        hash;           /* key hash */
+    uint32_t        id;             /* key id */
+    uint32_t        len;            /* key length */
+    char            name[1];        /* key name */
+};
+
+struct klog {
+    FILE             *fp;           /* trace file */
+    char             *name;         /* trace file name */
+
+    struct klog_key  **bucket;      /* key hash buckets */
+    uint32_t         nbucket;       /* # key hash buckets */
+    uint32_t         nkey;          /* # distinct keys */
+
+    struct trace_rec *rec;          /* records of the current second */
+    uint32_t         nrec;          /* # records of the current second */
+    uint32_t         nrec_alloc;    /* # records allocated */
+    time_t           first_sec;     /* second of the first record */
+    time_t           sec;           /* current second */
+
+    uint64_t         nline;         /* # lines read */
+    uint64_t         nskip;         /* # lines skipped */
+    uint64_t         ntrace;        /* # records written */
+    uint64_t         duration;      /* usec of the last record written */
+};
+
+static int show_help;
+static int show_version;
+static char *output_filename;
+
+static struct option long_options[] = {
+    { "help",               no_argument,        NULL,   'h' },
+    { "version",            no_argument,        NULL,   'V' },
+    { "output",             required_argument,  NULL,   'o' },
+    { NULL,                 0,                  NULL,    0  }
+};
+
+static char short_options[] = "hVo:";
+
+static void
+klog_show_usage(void)
+{
+    log_stderr(
+        "Usage: mcperf-klog [-?hV] -o trace-file [file...]" CRLF
+        "" CRLF
+        "Options:" CRLF
+        "  -h, --help            : this help" CRLF
+        "  -V, --version         : show version and exit" CRLF
+        "  -o, --output=S        : set the trace file to write for mcperf -F" CRLF
+        "  file                  : twemcache klog to convert, in order (default: stdin)"
+        );
+}
+
+static rstatus_t
+klog_get_options(int argc, char **argv)
+{
+    int c;
+
+    opterr = 0;
+
+    for (;;) {
+        c = getopt_long(argc, argv, short_options, long_options, NULL);
+        if (c == -1) {
+            break;
+        }
+
+        switch (c) {
+        case 'h':
+            show_version = 1;
+            show_help = 1;
+            break;
+
+        case 'V':
+            show_version = 1;
+            break;
+
+        case 'o':
+            output_filename = optarg;
+            break;
+
+        case '?':
+            if (optopt == 'o') {
+                log_stderr("mcperf-klog: option -%c requires a file name",
+                           optopt);
+            } else {
+                log_stderr("mcperf-klog: invalid option -- '%c'", optopt);
+            }
+            return MCP_ERROR;
+
+        default:
+            log_stderr("mcperf-klog: invalid option -- '%c'", optopt);
+            return MCP_ERROR;
+        }
+    }
+
+    return MCP_OK;
+}
+
+static uint32_t
+klog_hash(char *key, size_t len)
+{
+    uint32_t hash = 2166136261U;
+    size_t i;
+
+    for (i = 0; i < len; i++) {
+        hash ^= (uint8_t)key[i];
+        hash *= 16777619U;
+    }
+
+    return hash;
+}
+
+static rstatus_t
+klog_grow_keys(struct klog *k)
+{
+    struct klog_key **bucket, *key, *nkey;
+    uint32_t i, nbucket;
+
+    nbucket = (k->nbucket == 0) ? KLOG_NBUCKET : 2 * k->nbucket;
+
+    bucket = mcp_calloc(nbucket, sizeof(*bucket));
+    if (bucket == NULL) {
+        return MCP_ENOMEM;
+    }
+
+    for (i = 0; i < k->nbucket; i++) {
+        for (key = k->bucket[i]; key != NULL; key = nkey) {
+            nkey = key->next;
+            key->next = bucket[key->hash & (nbucket - 1)];
+            bucket[key->hash & (nbucket - 1)] = key;
+        }
+    }
+
+    if (k->bucket != NULL) {
+        mcp_free(k->bucket);
+    }
+    k->bucket = bucket;
+    k->nbucket = nbucket;
+
+    return MCP_OK;
+}
+
+/*
+ * Return the id of the key name of len bytes in id, numbering the keys in
+ * the order in which they first appear.
+ */
+static rstatus_t
+klog_key_id(struct klog *k, char *name, size_t len, uint32_t *id)
+{
+    struct klog_key *key;
+    uint32_t hash;
+    rstatus_t status;
+
+    hash = klog_hash(name, len);
+
+    if (k->nbucket != 0) {
+        for (key = k->bucket[hash & (k->nbucket - 1)]; key != NULL;
+             key = key->next) {
+            if (key->hash == hash && key->len == len &&
+                memcmp(key->name, name, len) == 0) {
+                *id = key->id;
+                return MCP_OK;
+            }
+        }
+    }
+
+    if (k->nkey == UINT32_MAX) {
+        log_stderr("mcperf-klog: too many distinct keys");
+        return MCP_ERROR;
+    }
+
+    if (k->nkey >= k->nbucket) {
+        status = klog_grow_keys(k);
+        if (status != MCP_OK) {
+            return status;
+        }
+    }
+
+    key = mcp_alloc(sizeof(*key) + len);
+    if (key == NULL) {
+        return MCP_ENOMEM;
+    }
+    key->hash = hash;
+    key->id = k->nkey++;
+    key->len = (uint32_t)len;
+    mcp_memcpy(key->name, name, len);
+
+    key->next = k->bucket[hash & (k->nbucket - 1)];
+    k->bucket[hash & (k->nbucket - 1)] = key;
+
+    *id = key->id;
+
+    return MCP_OK;
+}
+
+static void
+klog_free_keys(struct klog *k)
+{
+    struct klog_key *key, *nkey;
+    uint32_t i;
+
+    for (i = 0; i < k->nbucket; i++) {
+        for (key = k->bucket[i]; key != NULL; key = nkey) {
+            nkey = key->next;
+            mcp_free(key);
+        }
+    }
+
+    if (k->bucket != NULL) {
+        mcp_free(k->bucket);
+    }
+}
+
+/*
+ * Write the records of the current second, spread evenly over it.
+ */
+static rstatus_t
+klog_flush(struct klog *k)
+{
+    uint64_t base;
+    uint32_t i;
+
+    base = (uint64_t)(k->sec - k->first_sec) * 1000000;
+
+    for (i = 0; i < k->nrec; i++) {
+        k->rec[i].time = base + (uint64_t)i * 1000000 / k->nrec;
+        k->duration = k->rec[i].time;
+    }
+
+    if (k->nrec != 0 && fwrite(k->rec, sizeof(*k->rec), k->nrec, k->fp) !=
+        k->nrec) {
+        log_stderr("mcperf-klog: write to '%s' failed: %s", k->name,
+                   strerror(errno));
+        return MCP_ERROR;
+    }
+
+    k->ntrace += k->nrec;
+    k->nrec = 0;
+
+    return MCP_OK;
+}
+
+static req_type_t
+klog_method(char *name, size_t len)
+{
+    struct string *str;
+
+    for (str = req_strings; str->data != NULL; str++) {
+        if (str->len - 1 == len && strncmp(str->data, name, len) == 0) {
+            return (req_type_t)(str - req_strings);
+        }
+    }
+
+    return REQ_MAX_TYPES;
+}
+
+/*
+ * Append the request of a klog line to the records of its second. A line
+ * that doesn't hold a request is counted as skipped.
+ */
+static rstatus_t
+klog_line(struct klog *k, char *line)
+{
+    struct trace_rec *rec;
+    struct tm tm;
+    char *p, *q, *end, *token[KLOG_NTOKEN];
+    size_t len[KLOG_NTOKEN];
+    uint32_t i, ntoken, id;
+    req_type_t method;
+    long int vlen;
+    time_t sec;
+    rstatus_t status;
+
+    k->nline++;
+
+    /* the timestamp, ignoring its zone */
+    p = strchr(line, '[');
+    if (p == NULL) {
+        goto skip;
+    }
+    memset(&tm, 0, sizeof(tm));
+    q = strptime(p + 1, "%d/%b/%Y:%H:%M:%S", &tm);
+    if (q == NULL) {
+        goto skip;
+    }
+    sec = timegm(&tm);
+
+    /* the command, split into its first tokens */
+    p = strchr(q, '"');
+    if (p == NULL) {
+        goto skip;
+    }
+    end = strchr(p + 1, '"');
+    if (end == NULL) {
+        goto skip;
+    }
+    for (ntoken = 0, p++; p < end && ntoken < KLOG_NTOKEN;) {
+        if (*p == ' ') {
+            p++;
+            continue;
+        }
+        for (q = p; q < end && *q != ' '; q++) {
+            /* find the end of the token */
+        }
+        token[ntoken] = p;
+        len[ntoken] = (size_t)(q - p);
+        ntoken++;
+        p = q;
+    }
+    if (ntoken < 2) {
+        goto skip;
+    }
+
+    method = klog_method(token[0], len[0]);
+    if (method == REQ_MAX_TYPES || method == REQ_XXX) {
+        goto skip;
+    }
+
+    vlen = 0;
+    switch (method) {
+    case REQ_CAS:
+    case REQ_SET:
+    case REQ_ADD:
+    case REQ_REPLACE:
+    case REQ_APPEND:
+    case REQ_PREPEND:
+        i = 4;
+        break;
+
+    case REQ_INCR:
+    case REQ_DECR:
+        i = 2;
+        break;
+
+    default:
+        i = KLOG_NTOKEN;
+        break;
+    }
+    if (i < ntoken) {
+        vlen = strtol(token[i], NULL, 10);
+        if (vlen < 0) {
+            goto skip;
+        }
+    }
+
+    status = klog_key_id(k, token[1], len[1], &id);
+    if (status != MCP_OK) {
+        return status;
+    }
+
+    if (k->ntrace == 0 && k->nrec == 0) {
+        k->first_sec = sec;
+        k->sec = sec;
+    }
+
+    /* a line logged out of order is replayed in the current second */
+    if (sec > k->sec) {
+        status = klog_flush(k);
+        if (status != MCP_OK) {
+            return status;
+        }
+        k->sec = sec;
+    }
+
+    if (k->nrec == k->nrec_alloc) {
+        rec = mcp_realloc(k->rec, 2 * MAX(k->nrec_alloc, 1024) * sizeof(*rec));
+        if (rec == NULL) {
+            return MCP_ENOMEM;
+        }
+        k->rec = rec;
+        k->nrec_alloc = 2 * MAX(k->nrec_alloc, 1024);
+    }
+
+    rec = &k->rec[k->nrec++];
+    rec->time = 0;
+    rec->key = id;
+    rec->method = (uint8_t)method;
+    trace_rec_set_vlen(rec, (uint32_t)MIN(vlen, TRACE_VLEN_MAX));
+
+    return MCP_OK;
+
+skip:
+    k->nskip++;
+    return MCP_OK;
+}
+
+static rstatus_t
+klog_file(struct klog *k, FILE *fp, char *filename)
+{
+    rstatus_t status;
+    char *line;
+    size_t size;
+    ssize_t n;
+
+    line = NULL;
+    size = 0;
+    status = MCP_OK;
+
+    while (status == MCP_OK && (n = getline(&line, &size, fp)) >= 0) {
+        status = klog_line(k, line);
+    }
+
+    if (status == MCP_OK && ferror(fp)) {
+        log_stderr("mcperf-klog: read of '%s' failed: %s", filename,
+                   strerror(errno));
+        status = MCP_ERROR;
+    }
+
+    free(line);
+
+    return status;
+}
+
+static rstatus_t
+klog_write_header(struct klog *k)
+{
+    struct trace_header header;
+
+    header.magic = TRACE_MAGIC;
+    header.version = TRACE_VERSION;
+    header.nrec = k->ntrace;
+    header.nkey = k->nkey;
+    header.duration = k->duration;
+
+    if (fseek(k->fp, 0, SEEK_SET) < 0 ||
+        fwrite(&header, sizeof(header), 1, k->fp) != 1) {
+        log_stderr("mcperf-klog: write to '%s' failed: %s", k->name,
+                   strerror(errno));
+        return MCP_ERROR;
+    }
+
+    return MCP_OK;
+}
+
+/*
+ * Convert the klogs into the trace of the klog; the header is written
+ * first as a placeholder and rewritten with the final counts at the end.
+ */
+static rstatus_t
+klog_convert(struct klog *k, int argc, char **argv)
+{
+    rstatus_t status;
+    FILE *fp;
+    int i;
+
+    status = klog_write_header(k);
+    if (status != MCP_OK) {
+        return status;
+    }
+
+    if (optind == argc) {
+        status = klog_file(k, stdin, "stdin");
+    }
+
+    for (i = optind; i < argc && status == MCP_OK; i++) {
+        fp = fopen(argv[i], "r");
+        if (fp == NULL) {
+            log_stderr("mcperf-klog: open of '%s' failed: %s", argv[i],
+                       strerror(errno));
+            return MCP_ERROR;
+        }
+        status = klog_file(k, fp, argv[i]);
+        fclose(fp);
+    }
+
+    if (status == MCP_OK) {
+        status = klog_flush(k);
+    }
+
+    if (status == MCP_OK) {
+        status = klog_write_header(k);
+    }
+
+    return status;
+}
+
+int
+main(int argc, char **argv)
+{
+    static struct klog k;
+    rstatus_t status;
+
+    status = klog_get_options(argc, argv);
+    if (status != MCP_OK) {
+        klog_show_usage();
+        exit(1);
+    }
+
+    if (show_version) {
+        log_stderr("This is mcperf-klog-%s" CRLF, MCP_VERSION_STRING);
+        if (show_help) {
+            klog_show_usage();
+        }
+        exit(0);
+    }
+
+    if (output_filename == NULL) {
+        log_stderr("mcperf-klog: no trace file to write");
+        klog_show_usage();
+        exit(1);
+    }
+
+    status = log_init(LOG_NOTICE, NULL);
+    if (status != MCP_OK) {
+        exit(1);
+    }
+
+    k.name = output_filename;
+    k.fp = fopen(output_filename, "w");
+    if (k.fp == NULL) {
+        log_stderr("mcperf-klog: open of '%s' failed: %s", output_filename,
+                   strerror(errno));
+        exit(1);
+    }
+
+    status = klog_convert(&k, argc, argv);
+
+    if (fclose(k.fp) != 0 && status == MCP_OK) {
+        log_stderr("mcperf-klog: write to '%s' failed: %s", output_filename,
+                   strerror(errno));
+        status = MCP_ERROR;
+    }
+
+    if (status != MCP_OK) {
+        log_stderr("mcperf-klog: conversion to '%s' failed", output_filename);
+        exit(1);
+    }
+
+    log_stderr("mcperf-klog: converted %"PRIu64" of %"PRIu64" lines to "
+               "%"PRIu64" requests on %"PRIu32" keys over %.3f s",
+               k.nline - k.nskip, k.nline, k.ntrace, k.nkey,
+               (double)k.duration / 1e6);
+
+    klog_free_keys(&k);
+    if (k.rec != NULL) {
+        mcp_free(k.rec);
+    }
+
+    return 0;
+}
@@ -0,0 +1,267 @@
+/*
+ *  twemperf - a tool for measuring memcached server performance.
+ *  Copyright (C) 2011 Twitter, Inc.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <getopt.h>
+#include <sys/time.h>
+
+#include <mcp_core.h>
+
+/*
+ * mcperf-merge merges the result files that mcperf writes with -w into
+ * the stats of a single test, as if all the connections of all the tests
+ * had been driven by one mcperf instance. Counters, sums and histograms
+ * are added, so that the merged percentiles are exact. The merged test
+ * runs from the earliest start to the latest stop of the merged tests.
+ */
+
+static int show_help;
+static int show_version;
+
+static struct option long_options[] = {
+    { "help",               no_argument,        NULL,   'h' },
+    { "version",            no_argument,        NULL,   'V' },
+    { "print-histogram",    no_argument,        NULL,   'H' },
+    { "output-format",      required_argument,  NULL,   'f' },
+    { NULL,                 0,                  NULL,    0  }
+};
+
+static char short_options[] = "hVHf:";
+
+static void
+merge_show_usage(void)
+{
+    log_stderr(
+        "Usage: mcperf-merge [-?hV] [-H] [-f output-format] file..." CRLF
+        "" CRLF
+        "Options:" CRLF
+        "  -h, --help            : this help" CRLF
+        "  -V, --version         : show version and exit" CRLF
+        "  -H, --print-histogram : print response time histogram" CRLF
+        "  -f, --output-format=S : print stats as 'human' text on stderr, or as 'json' or 'csv' records on stdout (default: human)" CRLF
+        "  file                  : result file written by mcperf -w"
+        );
+}
+
+static rstatus_t
+merge_get_options(struct context *ctx, int argc, char **argv)
+{
+    struct opt *opt = &ctx->opt;
+    int c;
+
+    opterr = 0;
+
+    for (;;) {
+        c = getopt_long(argc, argv, short_options, long_options, NULL);
+        if (c == -1) {
+            break;
+        }
+
+        switch (c) {
+        case 'h':
+            show_version = 1;
+            show_help = 1;
+            break;
+
+        case 'V':
+            show_version = 1;
+            break;
+
+        case 'H':
+            opt->print_histogram = 1;
+            break;
+
+        case 'f':
+            opt->output_format = output_format_type(optarg);
+            if (opt->output_format == OUTPUT_FORMAT_SENTINEL) {
+                log_stderr("mcperf-merge: invalid output format '%s'", optarg);
+                return MCP_ERROR;
+            }
+            break;
+
+        case '?':
+            if (optopt == 'f') {
+                log_stderr("mcperf-merge: option -%c requires a string",
+                           optopt);
+            } else {
+                log_stderr("mcperf-merge: invalid option -- '%c'", optopt);
+            }
+            return MCP_ERROR;
+
+        default:
+            log_stderr("mcperf-merge: invalid option -- '%c'", optopt);
+            return MCP_ERROR;
+        }
+    }
+
+    return MCP_OK;
+}
+
+static void
+merge_rusage(struct rusage *dst, struct rusage *src)
+{
+    timeradd(&dst->ru_utime, &src->ru_utime, &dst->ru_utime);
+    timeradd(&dst->ru_stime, &src->ru_stime, &dst->ru_stime);
+
+#define MERGE_ACTION(_field)                                            \
+    dst->_field += src->_field;
+
+    RUSAGE_CODEC( MERGE_ACTION )
+
+#undef MERGE_ACTION
+}
+
+/*
+ * Fold the test read into part into the merged test in ctx. The first
+ * test sets the histogram layout and run parameters that the others are
+ * checked against.
+ */
+static rstatus_t
+merge_result(struct context *ctx, struct context *part, char *filename,
+             bool first)
+{
+    struct opt *opt = &ctx->opt;
+    struct stats *stats = &ctx->stats;
+    rstatus_t status;
+    uint32_t i;
+
+    if (first) {
+        opt->hist_digits = part->opt.hist_digits;
+        opt->engine = part->opt.engine;
+        opt->method = part->opt.method;
+        opt->nmethod = part->opt.nmethod;
+        for (i = 0; i < REQ_MAX_TYPES; i++) {
+            opt->method_weight[i] = part->opt.method_weight[i];
+        }
+
+        /* the merged test takes over the servers of the first one */
+        opt->server_dist = part->opt.server_dist;
+        opt->pool = part->opt.pool;
+        part->opt.pool.nserver = 0;
+        part->opt.pool.server = NULL;
+
+        status = stats_init(ctx);
+        if (status != MCP_OK) {
+            return status;
+        }
+
+        stats->start_time = part->stats.start_time;
+        stats->stop_time = part->stats.stop_time;
+    } else if (part->opt.hist_digits != opt->hist_digits) {
+        log_stderr("mcperf-merge: '%s' has histograms of %"PRIu32" digits, "
+                   "expected %"PRIu32"", filename, part->opt.hist_digits,
+                   opt->hist_digits);
+        return MCP_ERROR;
+    }
+
+    /* the stats of every method of a mix are only merged with their own */
+    for (i = 0; i < REQ_MAX_TYPES; i++) {
+        if ((part->opt.method_weight[i] > 0.0) != (opt->method_weight[i] > 0.0)) {
+            log_stderr("mcperf-merge: '%s' has a different mix of methods",
+                       filename);
+            return MCP_ERROR;
+        }
+    }
+
+    /* the stats of every server of a pool are only merged with their own */
+    if (!first) {
+        if (part->opt.pool.nserver != opt->pool.nserver) {
+            log_stderr("mcperf-merge: '%s' has a different pool of servers",
+                       filename);
+            return MCP_ERROR;
+        }
+        for (i = 0; i < opt->pool.nserver; i++) {
+            if (strcmp(part->opt.pool.server[i].name,
+                       opt->pool.server[i].name) != 0) {
+                log_stderr("mcperf-merge: '%s' has a different pool of "
+                           "servers", filename);
+                return MCP_ERROR;
+            }
+        }
+    }
+
+    opt->client.n++;
+    opt->num_threads += part->opt.num_threads;
+    opt->num_conns += part->opt.num_conns;
+    opt->num_calls = MAX(opt->num_calls, part->opt.num_calls);
+
+    stats->start_time = MIN(stats->start_time, part->stats.start_time);
+    stats->stop_time = MAX(stats->stop_time, part->stats.stop_time);
+    merge_rusage(&stats->rusage_stop, &part->stats.rusage_stop);
+
+    stats_merge(stats, &part->stats);
+
+    return MCP_OK;
+}
+
+int
+main(int argc, char **argv)
+{
+    static struct context ctx, part;
+    rstatus_t status;
+    int i;
+
+    ctx.opt.output_format = OUTPUT_FORMAT_HUMAN;
+
+    status = merge_get_options(&ctx, argc, argv);
+    if (status != MCP_OK) {
+        merge_show_usage();
+        exit(1);
+    }
+
+    if (show_version) {
+        log_stderr("This is mcperf-merge-%s" CRLF, MCP_VERSION_STRING);
+        if (show_help) {
+            merge_show_usage();
+        }
+        exit(0);
+    }
+
+    if (optind == argc) {
+        log_stderr("mcperf-merge: no result files to merge");
+        merge_show_usage();
+        exit(1);
+    }
+
+    status = log_init(LOG_NOTICE, NULL);
+    if (status != MCP_OK) {
+        exit(1);
+    }
+
+    for (i = optind; i < argc; i++) {
+        memset(&part, 0, sizeof(part));
+        part.opt.output_format = OUTPUT_FORMAT_HUMAN;
+
+        status = result_read(&part, argv[i]);
+        if (status == MCP_OK) {
+            status = merge_result(&ctx, &part, argv[i], i == optind);
+        }
+        stats_deinit(&part);
+        server_pool_deinit(&part.opt.pool);
+        if (status != MCP_OK) {
+            log_stderr("mcperf-merge: merge of '%s' failed", argv[i]);
+            exit(1);
+        }
+    }
+
+    stats_print(&ctx);
+
+    return 0;
+}
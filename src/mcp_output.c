@@ -0,0 +1,287 @@
+/*
+ *  twemperf - a tool for measuring memcached server performance.
+ *  Copyright (C) 2011 Twitter, Inc.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <math.h>
+
+#include <mcp_core.h>
+
+static char *format_names[] = {            /* output format names */
+    "human",                               /* OUTPUT_FORMAT_HUMAN */
+    "json",                                /* OUTPUT_FORMAT_JSON */
+    "csv",                                 /* OUTPUT_FORMAT_CSV */
+    NULL
+};
+
+char *
+output_format_name(output_format_t format)
+{
+    ASSERT(format >= OUTPUT_FORMAT_HUMAN && format < OUTPUT_FORMAT_SENTINEL);
+
+    return format_names[format];
+}
+
+output_format_t
+output_format_type(char *name)
+{
+    output_format_t format;
+
+    for (format = OUTPUT_FORMAT_HUMAN; format < OUTPUT_FORMAT_SENTINEL;
+         format++) {
+        if (strcmp(name, format_names[format]) == 0) {
+            break;
+        }
+    }
+
+    return format;
+}
+
+void
+output_init(struct output *o, output_format_t format, FILE *fp)
+{
+    o->format = format;
+    o->fp = fp;
+    o->header = 0;
+    o->depth = 0;
+}
+
+/* write string s as a json string or a csv field */
+static void
+output_quote(struct output *o, char *s)
+{
+    FILE *fp = o->fp;
+    char *p;
+
+    if (o->format == OUTPUT_FORMAT_CSV) {
+        if (strpbrk(s, ",\"\r\n") == NULL) {
+            fputs(s, fp);
+            return;
+        }
+        fputc('"', fp);
+        for (p = s; *p != '\0'; p++) {
+            if (*p == '"') {
+                fputc('"', fp);
+            }
+            fputc(*p, fp);
+        }
+        fputc('"', fp);
+        return;
+    }
+
+    fputc('"', fp);
+    for (p = s; *p != '\0'; p++) {
+        switch (*p) {
+        case '"':
+        case '\\':
+            fputc('\\', fp);
+            fputc(*p, fp);
+            break;
+
+        case '\n':
+            fputs("\\n", fp);
+            break;
+
+        case '\r':
+            fputs("\\r", fp);
+            break;
+
+        case '\t':
+            fputs("\\t", fp);
+            break;
+
+        default:
+            if ((unsigned char)*p < 0x20) {
+                fprintf(fp, "\\u%04x", (unsigned char)*p);
+            } else {
+                fputc(*p, fp);
+            }
+            break;
+        }
+    }
+    fputc('"', fp);
+}
+
+/*
+ * Start a member of the current json object, or a csv row of the current
+ * section.
+ */
+static void
+output_member(struct output *o, char *name)
+{
+    uint32_t i;
+
+    ASSERT(o->depth > 0);
+
+    if (o->format == OUTPUT_FORMAT_CSV) {
+        if (!o->header) {
+            fputs("section,name,low,high,value\n", o->fp);
+            o->header = 1;
+        }
+        for (i = 0; i < o->depth; i++) {
+            if (i > 0) {
+                fputc('.', o->fp);
+            }
+            fputs(o->path[i], o->fp);
+        }
+        fputc(',', o->fp);
+        output_quote(o, name);
+        fputc(',', o->fp);
+        return;
+    }
+
+    if (!o->first[o->depth - 1]) {
+        fputc(',', o->fp);
+    }
+    o->first[o->depth - 1] = false;
+
+    output_quote(o, name);
+    fputc(':', o->fp);
+}
+
+/* Start a record; records are closed with output_end */
+void
+output_begin_record(struct output *o, char *type, uint32_t id)
+{
+    ASSERT(o->format != OUTPUT_FORMAT_HUMAN);
+    ASSERT(o->depth == 0);
+
+    mcp_snprintf(o->record, sizeof(o->record), "%s.%"PRIu32"", type, id);
+
+    o->first[0] = true;
+    o->path[0] = o->record;
+    o->depth = 1;
+
+    if (o->format == OUTPUT_FORMAT_JSON) {
+        fputc('{', o->fp);
+        output_string(o, "type", type);
+        output_uint(o, "id", id);
+    }
+}
+
+void
+output_begin(struct output *o, char *name)
+{
+    ASSERT(o->depth > 0 && o->depth < OUTPUT_MAX_DEPTH);
+
+    if (o->format == OUTPUT_FORMAT_JSON) {
+        output_member(o, name);
+        fputc('{', o->fp);
+    }
+
+    o->first[o->depth] = true;
+    o->path[o->depth] = name;
+    o->depth++;
+}
+
+void
+output_end(struct output *o)
+{
+    ASSERT(o->depth > 0);
+
+    o->depth--;
+
+    if (o->format == OUTPUT_FORMAT_JSON) {
+        fputc('}', o->fp);
+    }
+
+    if (o->depth == 0) {
+        if (o->format == OUTPUT_FORMAT_JSON) {
+            fputc('\n', o->fp);
+        }
+        fflush(o->fp);
+    }
+}
+
+void
+output_uint(struct output *o, char *name, uint64_t value)
+{
+    output_member(o, name);
+    if (o->format == OUTPUT_FORMAT_CSV) {
+        fputs(",,", o->fp);
+    }
+    fprintf(o->fp, "%"PRIu64"", value);
+    if (o->format == OUTPUT_FORMAT_CSV) {
+        fputc('\n', o->fp);
+    }
+}
+
+/* non-finite values have no json representation and are written as null */
+void
+output_double(struct output *o, char *name, double value)
+{
+    output_member(o, name);
+    if (o->format == OUTPUT_FORMAT_CSV) {
+        fputs(",,", o->fp);
+        if (isfinite(value)) {
+            fprintf(o->fp, "%.15g", value);
+        }
+        fputc('\n', o->fp);
+        return;
+    }
+
+    if (isfinite(value)) {
+        fprintf(o->fp, "%.15g", value);
+    } else {
+        fputs("null", o->fp);
+    }
+}
+
+void
+output_string(struct output *o, char *name, char *value)
+{
+    output_member(o, name);
+    if (o->format == OUTPUT_FORMAT_CSV) {
+        fputs(",,", o->fp);
+    }
+    output_quote(o, value == NULL ? "" : value);
+    if (o->format == OUTPUT_FORMAT_CSV) {
+        fputc('\n', o->fp);
+    }
+}
+
+/*
+ * Write the non-empty buckets of histogram h as [low, high, count] triples
+ * in json, or as one csv row per bucket, in the unit of the histogram.
+ */
+void
+output_histogram(struct output *o, char *name, struct histogram *h)
+{
+    struct histogram_iter it;
+    bool first;
+
+    if (o->format == OUTPUT_FORMAT_CSV) {
+        histogram_iter_init(&it, h);
+        while (histogram_iter_next(&it)) {
+            output_member(o, name);
+            fprintf(o->fp, "%"PRIu64",%"PRIu64",%"PRIu64"\n", it.low,
+                    it.high, it.count);
+        }
+        return;
+    }
+
+    output_member(o, name);
+    fputc('[', o->fp);
+    first = true;
+    histogram_iter_init(&it, h);
+    while (histogram_iter_next(&it)) {
+        fprintf(o->fp, "%s[%"PRIu64",%"PRIu64",%"PRIu64"]", first ? "" : ",",
+                it.low, it.high, it.count);
+        first = false;
+    }
+    fputc(']', o->fp);
+}
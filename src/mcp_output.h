@@ -0,0 +1,67 @@
+/*
+ *  twemperf - a tool for measuring memcached server performance.
+ *  Copyright (C) 2011 Twitter, Inc.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _MCP_OUTPUT_H_
+#define _MCP_OUTPUT_H_
+
+#include <stdio.h>
+
+#define OUTPUT_MAX_DEPTH 8
+
+typedef enum output_format {
+    OUTPUT_FORMAT_HUMAN,        /* human readable text on stderr */
+    OUTPUT_FORMAT_JSON,         /* one json object per record on stdout */
+    OUTPUT_FORMAT_CSV,          /* section,name,low,high,value rows on stdout */
+    OUTPUT_FORMAT_SENTINEL
+} output_format_t;
+
+/*
+ * Writer of machine readable records. A record has a type and an id, and
+ * is a tree of named objects with scalar members and histograms. In json,
+ * every record is written as a single line object with type and id
+ * members. In csv, every scalar is a row named by the dotted path of its
+ * enclosing objects, headed by type.id, and every histogram bucket is a
+ * row with the low and high value of the bucket, so that the rows of many
+ * records and many mcperf instances can be concatenated and filtered alike.
+ */
+struct output {
+    output_format_t format;                   /* output format */
+    FILE            *fp;                      /* output stream */
+    unsigned        header:1;                 /* csv header written? */
+    uint32_t        depth;                    /* # open objects */
+    bool            first[OUTPUT_MAX_DEPTH];  /* no member written at depth? */
+    char            *path[OUTPUT_MAX_DEPTH];  /* object names at depth */
+    char            record[64];               /* record type.id */
+};
+
+char *output_format_name(output_format_t format);
+output_format_t output_format_type(char *name);
+
+void output_init(struct output *o, output_format_t format, FILE *fp);
+
+void output_begin_record(struct output *o, char *type, uint32_t id);
+void output_begin(struct output *o, char *name);
+void output_end(struct output *o);
+
+void output_uint(struct output *o, char *name, uint64_t value);
+void output_double(struct output *o, char *name, double value);
+void output_string(struct output *o, char *name, char *value);
+void output_histogram(struct output *o, char *name, struct histogram *h);
+
+#endif
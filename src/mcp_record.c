@@ -0,0 +1,179 @@
+/*
+ *  twemperf - a tool for measuring memcached server performance.
+ *  Copyright (C) 2011 Twitter, Inc.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+
+#include <mcp_core.h>
+
+static struct record_rec *
+record_data(void *addr, uint32_t npart)
+{
+    return (struct record_rec *)((char *)addr + record_data_offset(npart));
+}
+
+/*
+ * Create the record file filename with room for the parts of npart workers
+ * and RECORD_NREC records, and map it read-write into memory. The file is
+ * sparse, so that only the pages of the records that are written take up
+ * space.
+ */
+rstatus_t
+record_open(struct record *r, char *filename, uint32_t npart, double sample)
+{
+    struct record_header *header;
+    struct timeval tv;
+    int status;
+
+    r->filename = filename;
+    r->addr = MAP_FAILED;
+    r->size = record_data_offset(npart) +
+              RECORD_NREC * sizeof(struct record_rec);
+    r->npart = npart;
+    r->sample = sample;
+
+    r->fd = open(filename, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (r->fd < 0) {
+        log_stderr("mcperf: open of record file '%s' failed: %s", filename,
+                   strerror(errno));
+        return MCP_ERROR;
+    }
+
+    status = ftruncate(r->fd, (off_t)r->size);
+    if (status < 0) {
+        log_stderr("mcperf: truncate of record file '%s' failed: %s",
+                   filename, strerror(errno));
+        goto error;
+    }
+
+    r->addr = mmap(NULL, r->size, PROT_READ | PROT_WRITE, MAP_SHARED, r->fd,
+                   0);
+    if (r->addr == MAP_FAILED) {
+        log_stderr("mcperf: mmap of record file '%s' failed: %s", filename,
+                   strerror(errno));
+        goto error;
+    }
+
+    gettimeofday(&tv, NULL);
+    r->start = TV_TO_SEC(&tv);
+
+    header = r->addr;
+    header->magic = RECORD_MAGIC;
+    header->version = RECORD_VERSION;
+    header->size = sizeof(struct record_rec);
+    header->npart = npart;
+    header->start = (uint64_t)tv.tv_sec * 1000000 + (uint64_t)tv.tv_usec;
+    header->sample = sample;
+    header->ncall = 0;
+    header->nsampled = 0;
+    header->nrec = 0;
+
+    return MCP_OK;
+
+error:
+    if (r->addr != MAP_FAILED) {
+        munmap(r->addr, r->size);
+        r->addr = MAP_FAILED;
+    }
+    close(r->fd);
+    r->fd = -1;
+    unlink(filename);
+    return MCP_ERROR;
+}
+
+/*
+ * Initialize the ring of worker id out of nring workers over its share of
+ * the records of the record file r.
+ */
+void
+record_ring_init(struct record_ring *ring, struct record *r, uint32_t id,
+                 uint32_t nring, uint32_t seed)
+{
+    ASSERT(id < nring && nring <= r->npart);
+
+    ring->cap = RECORD_NREC / nring;
+    ring->rec = record_data(r->addr, r->npart) + id * ring->cap;
+    ring->idx = 0;
+    ring->ncall = 0;
+    ring->nsampled = 0;
+    ring->sample = r->sample;
+    ring->start = r->start;
+
+    ring->xsubi[0] = (uint16_t)(0x7f4a ^ seed);
+    ring->xsubi[1] = (uint16_t)(0x2c1b ^ (seed << 8));
+    ring->xsubi[2] = (uint16_t)(0x96e3 ^ ~seed);
+
+    ring->skip = record_skip(ring);
+}
+
+/*
+ * Pack the rings of the workers of ctx back to back behind their parts,
+ * truncate the record file to the records written and unmap it. A ring
+ * never starts ahead of where its records are packed, so the rings are
+ * moved down in place in the order of the workers.
+ */
+rstatus_t
+record_close(struct context *ctx)
+{
+    struct record *r = &ctx->opt.record;
+    struct record_header *header = r->addr;
+    struct record_part *part = (struct record_part *)(header + 1);
+    struct record_ring *ring;
+    struct record_rec *rec;
+    uint32_t i;
+    size_t size;
+    int status;
+
+    rec = record_data(r->addr, ctx->nworker);
+
+    for (i = 0; i < ctx->nworker; i++) {
+        ring = &ctx->worker[i].record;
+
+        part[i].ncall = ring->ncall;
+        part[i].nsampled = ring->nsampled;
+        part[i].nrec = MIN(ring->nsampled, ring->cap);
+        part[i].head = ring->nsampled > ring->cap ? ring->idx : 0;
+
+        if (part[i].nrec != 0) {
+            memmove(rec, ring->rec, part[i].nrec * sizeof(*rec));
+        }
+        rec += part[i].nrec;
+
+        header->ncall += part[i].ncall;
+        header->nsampled += part[i].nsampled;
+        header->nrec += part[i].nrec;
+    }
+    header->npart = ctx->nworker;
+
+    size = (size_t)((char *)rec - (char *)r->addr);
+
+    munmap(r->addr, r->size);
+    r->addr = MAP_FAILED;
+
+    status = ftruncate(r->fd, (off_t)size);
+    if (status < 0) {
+        log_stderr("mcperf: truncate of record file '%s' failed: %s",
+                   r->filename, strerror(errno));
+    }
+
+    close(r->fd);
+    r->fd = -1;
+
+    return status < 0 ? MCP_ERROR : MCP_OK;
+}
@@ -0,0 +1,160 @@
+/*
+ *  twemperf - a tool for measuring memcached server performance.
+ *  Copyright (C) 2011 Twitter, Inc.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _MCP_RECORD_H_
+#define _MCP_RECORD_H_
+
+#include <math.h>
+#include <stdlib.h>
+
+#define RECORD_MAGIC    0x4352504d  /* "MPRC" in little endian */
+#define RECORD_VERSION  1
+
+#define RECORD_NREC     (4 * 1024 * 1024) /* # records kept over all rings */
+
+/*
+ * A record file holds a fixed size record of every sampled call that
+ * completed in a test, for the forensics of the tail of the response
+ * times that the histograms only summarize. It starts with a header,
+ * followed by a part for every worker that says how many records the
+ * worker wrote, followed by the records of the workers in turn.
+ *
+ * While the test runs, every worker writes its records into its own ring
+ * in the mapping of the file, so that a long test keeps the most recent
+ * records. When the test is done, the rings are packed back to back and
+ * the file is truncated to the records written; the oldest record of a
+ * ring that wrapped is the head of its part. Times are in usec, relative
+ * to the start of the test for the time of a record, and relative to the
+ * time of the record for the others. Integers are in host byte order,
+ * which the magic checks for.
+ */
+struct record_header {
+    uint32_t magic;      /* RECORD_MAGIC */
+    uint32_t version;    /* RECORD_VERSION */
+    uint32_t size;       /* record size */
+    uint32_t npart;      /* # parts, one per worker */
+    uint64_t start;      /* usec since the epoch at the start of the test */
+    double   sample;     /* fraction of completed calls recorded */
+    uint64_t ncall;      /* # completed calls */
+    uint64_t nsampled;   /* # calls sampled */
+    uint64_t nrec;       /* # records */
+};
+
+struct record_part {
+    uint64_t ncall;      /* # completed calls */
+    uint64_t nsampled;   /* # calls sampled */
+    uint64_t nrec;       /* # records */
+    uint64_t head;       /* index of the oldest record */
+};
+
+struct record_rec {
+    uint64_t time;       /* intended issue start since the start of the test */
+    uint32_t issue;      /* issue start since time */
+    uint32_t send_start; /* send start since time */
+    uint32_t send_stop;  /* send stop since time */
+    uint32_t recv_start; /* recv start since time */
+    uint32_t recv_stop;  /* recv stop since time */
+    uint32_t conn;       /* connection id */
+    uint32_t key;        /* key id of the first key */
+    uint32_t req_bytes;  /* request bytes sent */
+    uint32_t rsp_bytes;  /* response bytes received */
+    uint16_t nkey;       /* # keys */
+    uint8_t  method;     /* request type */
+    uint8_t  type;       /* response type */
+};
+
+/* a record file mapped read-write in memory, shared by every worker */
+struct record {
+    char                 *filename; /* record filename */
+    int                  fd;        /* record file descriptor */
+    void                 *addr;     /* mapping of the record file */
+    size_t               size;      /* record file size */
+    uint32_t             npart;     /* # parts the file has room for */
+    double               sample;    /* fraction of completed calls recorded */
+    double               start;     /* start of the test in sec */
+};
+
+/* the ring of records of a worker */
+struct record_ring {
+    struct record_rec    *rec;      /* records */
+    uint64_t             cap;       /* # records the ring holds */
+    uint64_t             idx;       /* index of the next record */
+    uint64_t             ncall;     /* # completed calls */
+    uint64_t             nsampled;  /* # calls sampled */
+    uint64_t             skip;      /* # calls to the next sampled call */
+    double               sample;    /* fraction of completed calls recorded */
+    double               start;     /* start of the test in sec */
+    unsigned short       xsubi[3];  /* sampler state */
+};
+
+/* Return the offset of the records in a record file of npart parts */
+static inline size_t
+record_data_offset(uint32_t npart)
+{
+    return sizeof(struct record_header) + npart * sizeof(struct record_part);
+}
+
+/*
+ * Return the # calls from a sampled call to the next one, which is
+ * geometrically distributed, so that the sampler costs a random number per
+ * sampled call rather than per call.
+ */
+static inline uint64_t
+record_skip(struct record_ring *ring)
+{
+    if (ring->sample >= 1.0) {
+        return 1;
+    }
+
+    return 1 + (uint64_t)(log(1.0 - erand48(ring->xsubi)) /
+                          log(1.0 - ring->sample));
+}
+
+/* Return the time t in sec as usec, clamped to the range of a record */
+static inline uint32_t
+record_usec(double t)
+{
+    if (t <= 0.0) {
+        return 0;
+    }
+    if (t >= UINT32_MAX / 1e6) {
+        return UINT32_MAX;
+    }
+    return (uint32_t)(t * 1e6 + 0.5);
+}
+
+/* Return the slot of the next record of the ring, overwriting the oldest */
+static inline struct record_rec *
+record_next(struct record_ring *ring)
+{
+    struct record_rec *rec = &ring->rec[ring->idx];
+
+    ring->idx++;
+    if (ring->idx == ring->cap) {
+        ring->idx = 0;
+    }
+    ring->nsampled++;
+
+    return rec;
+}
+
+rstatus_t record_open(struct record *r, char *filename, uint32_t npart, double sample);
+void record_ring_init(struct record_ring *ring, struct record *r, uint32_t id, uint32_t nring, uint32_t seed);
+rstatus_t record_close(struct context *ctx);
+
+#endif
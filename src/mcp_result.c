@@ -0,0 +1,487 @@
+/*
+ *  twemperf - a tool for measuring memcached server performance.
+ *  Copyright (C) 2011 Twitter, Inc.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <stdio.h>
+#include <float.h>
+
+#include <mcp_core.h>
+
+/*
+ * A result stream; the first failed read or write sticks, so that a
+ * whole result can be read or written before checking for errors once.
+ */
+struct result {
+    FILE      *fp;      /* result file */
+    char      *name;    /* result file name */
+    rstatus_t status;   /* first error */
+};
+
+static void
+result_put(struct result *r, void *buf, size_t size)
+{
+    if (r->status != MCP_OK) {
+        return;
+    }
+
+    if (fwrite(buf, size, 1, r->fp) != 1) {
+        log_error("write to result file '%s' failed: %s", r->name,
+                  strerror(errno));
+        r->status = MCP_ERROR;
+    }
+}
+
+static void
+result_get(struct result *r, void *buf, size_t size)
+{
+    if (r->status != MCP_OK) {
+        memset(buf, 0, size);
+        return;
+    }
+
+    if (fread(buf, size, 1, r->fp) != 1) {
+        log_error("read of result file '%s' failed: %s", r->name,
+                  feof(r->fp) ? "truncated file" : strerror(errno));
+        memset(buf, 0, size);
+        r->status = MCP_ERROR;
+    }
+}
+
+static void
+result_put_u32(struct result *r, uint32_t value)
+{
+    result_put(r, &value, sizeof(value));
+}
+
+static void
+result_put_u64(struct result *r, uint64_t value)
+{
+    result_put(r, &value, sizeof(value));
+}
+
+static void
+result_put_double(struct result *r, double value)
+{
+    result_put(r, &value, sizeof(value));
+}
+
+static uint32_t
+result_get_u32(struct result *r)
+{
+    uint32_t value;
+
+    result_get(r, &value, sizeof(value));
+
+    return value;
+}
+
+static uint64_t
+result_get_u64(struct result *r)
+{
+    uint64_t value;
+
+    result_get(r, &value, sizeof(value));
+
+    return value;
+}
+
+static double
+result_get_double(struct result *r)
+{
+    double value;
+
+    result_get(r, &value, sizeof(value));
+
+    return value;
+}
+
+static int64_t
+result_tv_usec(struct timeval *tv)
+{
+    return (int64_t)tv->tv_sec * 1000000 + tv->tv_usec;
+}
+
+static void
+result_usec_tv(int64_t usec, struct timeval *tv)
+{
+    tv->tv_sec = (time_t)(usec / 1000000);
+    tv->tv_usec = (suseconds_t)(usec % 1000000);
+}
+
+/* resource usage is written as the usage of the test alone */
+static void
+result_put_rusage(struct result *r, struct rusage *start, struct rusage *stop)
+{
+    result_put_u64(r, (uint64_t)(result_tv_usec(&stop->ru_utime) -
+                                 result_tv_usec(&start->ru_utime)));
+    result_put_u64(r, (uint64_t)(result_tv_usec(&stop->ru_stime) -
+                                 result_tv_usec(&start->ru_stime)));
+
+#define PUT_ACTION(_field)                                              \
+    result_put_u64(r, (uint64_t)(stop->_field - start->_field));
+
+    RUSAGE_CODEC( PUT_ACTION )
+
+#undef PUT_ACTION
+}
+
+static void
+result_get_rusage(struct result *r, struct rusage *start, struct rusage *stop)
+{
+    memset(start, 0, sizeof(*start));
+    memset(stop, 0, sizeof(*stop));
+
+    result_usec_tv((int64_t)result_get_u64(r), &stop->ru_utime);
+    result_usec_tv((int64_t)result_get_u64(r), &stop->ru_stime);
+
+#define GET_ACTION(_field)                                              \
+    stop->_field = (long)result_get_u64(r);
+
+    RUSAGE_CODEC( GET_ACTION )
+
+#undef GET_ACTION
+}
+
+static void
+result_put_time(struct result *r, struct stats_time *st)
+{
+    struct histogram *h = &st->hist;
+    uint32_t i, n;
+
+    result_put_double(r, st->sum);
+    result_put_double(r, st->sum2);
+    result_put_double(r, st->min);
+    result_put_double(r, st->max);
+
+    result_put_u64(r, h->total);
+    result_put_u64(r, h->min);
+    result_put_u64(r, h->max);
+
+    for (i = 0, n = 0; i < h->ncount; i++) {
+        if (h->count[i] != 0) {
+            n++;
+        }
+    }
+
+    result_put_u32(r, n);
+    for (i = 0; i < h->ncount; i++) {
+        if (h->count[i] != 0) {
+            result_put_u32(r, i);
+            result_put_u64(r, h->count[i]);
+        }
+    }
+}
+
+static void
+result_get_time(struct result *r, struct stats_time *st)
+{
+    struct histogram *h = &st->hist;
+    uint32_t i, n, idx;
+
+    st->sum = result_get_double(r);
+    st->sum2 = result_get_double(r);
+    st->min = result_get_double(r);
+    st->max = result_get_double(r);
+
+    h->total = result_get_u64(r);
+    h->min = result_get_u64(r);
+    h->max = result_get_u64(r);
+
+    n = result_get_u32(r);
+    for (i = 0; i < n && r->status == MCP_OK; i++) {
+        idx = result_get_u32(r);
+        if (idx >= h->ncount) {
+            log_error("result file '%s' has a histogram counter %"PRIu32" "
+                      "out of range", r->name, idx);
+            r->status = MCP_ERROR;
+            break;
+        }
+        h->count[idx] = result_get_u64(r);
+    }
+}
+
+/*
+ * Write the stats of ctx to the result file filename. The run parameters
+ * in the header are those that merged results need to agree on or report.
+ */
+rstatus_t
+result_write(struct context *ctx, char *filename)
+{
+    struct opt *opt = &ctx->opt;
+    struct stats *stats = &ctx->stats;
+    struct result r;
+    uint32_t i, len;
+
+    r.fp = fopen(filename, "w");
+    if (r.fp == NULL) {
+        log_error("open of result file '%s' failed: %s", filename,
+                  strerror(errno));
+        return MCP_ERROR;
+    }
+    r.name = filename;
+    r.status = MCP_OK;
+
+    result_put_u32(&r, RESULT_MAGIC);
+    result_put_u32(&r, RESULT_VERSION);
+    result_put_u32(&r, opt->hist_digits);
+    result_put_u32(&r, (uint32_t)opt->engine);
+    result_put_u32(&r, opt->client.id);
+    result_put_u32(&r, opt->client.n);
+    result_put_u32(&r, opt->num_threads);
+    result_put_u32(&r, opt->num_conns);
+    result_put_u32(&r, opt->num_calls);
+    result_put_u32(&r, (uint32_t)opt->method);
+
+    result_put_u32(&r, REQ_MAX_TYPES);
+    for (i = 0; i < REQ_MAX_TYPES; i++) {
+        result_put_double(&r, opt->method_weight[i]);
+    }
+
+    result_put_u32(&r, (uint32_t)opt->server_dist);
+    result_put_u32(&r, opt->pool.nserver);
+    for (i = 0; i < opt->pool.nserver; i++) {
+        len = (uint32_t)strlen(opt->pool.server[i].name);
+        result_put_u32(&r, len);
+        result_put(&r, opt->pool.server[i].name, len);
+    }
+
+    result_put_double(&r, stats->start_time);
+    result_put_double(&r, stats->stop_time);
+    result_put_rusage(&r, &stats->rusage_start, &stats->rusage_stop);
+
+#define PUT_ACTION(_type, _field)                                       \
+    result_put_##_type(&r, stats->_field);
+
+    RESULT_CODEC( PUT_ACTION )
+
+#undef PUT_ACTION
+
+    result_put_u32(&r, RSP_MAX_TYPES);
+    for (i = 0; i < RSP_MAX_TYPES; i++) {
+        result_put_u32(&r, stats->rsp_type[i]);
+    }
+
+    result_put_time(&r, &stats->connect);
+    result_put_time(&r, &stats->req_xfer);
+    result_put_time(&r, &stats->req_rsp);
+    result_put_time(&r, &stats->int_rsp);
+    result_put_time(&r, &stats->rsp_xfer);
+
+    for (i = 0; i < REQ_MAX_TYPES && opt->nmethod > 1; i++) {
+        if (opt->method_weight[i] > 0.0) {
+            result_put_u32(&r, stats->method[i].nreq);
+            result_put_u32(&r, stats->method[i].nrsp);
+            result_put_time(&r, &stats->method[i].req_rsp);
+            result_put_time(&r, &stats->method[i].int_rsp);
+        }
+    }
+
+    for (i = 0; i < stats->nserver; i++) {
+        result_put_u32(&r, stats->server[i].nreq);
+        result_put_u32(&r, stats->server[i].nrsp);
+        result_put_u32(&r, stats->server[i].nerror);
+        result_put_time(&r, &stats->server[i].req_rsp);
+        result_put_time(&r, &stats->server[i].int_rsp);
+    }
+
+    if (fclose(r.fp) != 0 && r.status == MCP_OK) {
+        log_error("close of result file '%s' failed: %s", filename,
+                  strerror(errno));
+        r.status = MCP_ERROR;
+    }
+
+    return r.status;
+}
+
+/*
+ * Read the result file filename into the stats of ctx, which are
+ * initialized here with the histogram digits of the result, and into the
+ * run parameters of its options.
+ */
+rstatus_t
+result_read(struct context *ctx, char *filename)
+{
+    struct opt *opt = &ctx->opt;
+    struct stats *stats = &ctx->stats;
+    struct result r;
+    uint32_t magic, version, digits, engine, method, dist, i, n, len;
+    struct server *s;
+    rstatus_t status;
+
+    r.fp = fopen(filename, "r");
+    if (r.fp == NULL) {
+        log_error("open of result file '%s' failed: %s", filename,
+                  strerror(errno));
+        return MCP_ERROR;
+    }
+    r.name = filename;
+    r.status = MCP_OK;
+
+    magic = result_get_u32(&r);
+    version = result_get_u32(&r);
+    if (r.status == MCP_OK && magic != RESULT_MAGIC) {
+        log_error("'%s' is not a result file of this host byte order",
+                  filename);
+        r.status = MCP_ERROR;
+    }
+    if (r.status == MCP_OK && version != RESULT_VERSION) {
+        log_error("result file '%s' has version %"PRIu32", expected "
+                  "%"PRIu32"", filename, version, RESULT_VERSION);
+        r.status = MCP_ERROR;
+    }
+
+    digits = result_get_u32(&r);
+    engine = result_get_u32(&r);
+    if (r.status == MCP_OK &&
+        (digits < HIST_MIN_DIGITS || digits > HIST_MAX_DIGITS ||
+         engine >= EVENT_ENGINE_SENTINEL)) {
+        log_error("result file '%s' has an invalid header", filename);
+        r.status = MCP_ERROR;
+    }
+    if (r.status != MCP_OK) {
+        fclose(r.fp);
+        return r.status;
+    }
+
+    opt->hist_digits = digits;
+    opt->engine = (event_engine_type_t)engine;
+    opt->client.id = result_get_u32(&r);
+    opt->client.n = result_get_u32(&r);
+    opt->num_threads = result_get_u32(&r);
+    opt->num_conns = result_get_u32(&r);
+    opt->num_calls = result_get_u32(&r);
+    method = result_get_u32(&r);
+    opt->method = (req_type_t)MIN(method, REQ_XXX);
+
+    n = result_get_u32(&r);
+    if (r.status == MCP_OK && n != REQ_MAX_TYPES) {
+        log_error("result file '%s' has %"PRIu32" request types, expected "
+                  "%d", filename, n, REQ_MAX_TYPES);
+        r.status = MCP_ERROR;
+    }
+    opt->nmethod = 0;
+    for (i = 0; i < REQ_MAX_TYPES; i++) {
+        opt->method_weight[i] = result_get_double(&r);
+        if (opt->method_weight[i] > 0.0) {
+            opt->nmethod++;
+        } else {
+            opt->method_weight[i] = 0.0;
+        }
+    }
+    if (r.status == MCP_OK && opt->nmethod == 0) {
+        log_error("result file '%s' has no request types", filename);
+        r.status = MCP_ERROR;
+    }
+
+    dist = result_get_u32(&r);
+    opt->server_dist = (server_dist_type_t)MIN(dist, SERVER_DIST_RANDOM);
+    n = result_get_u32(&r);
+    if (r.status == MCP_OK && (n == 0 || n > UINT16_MAX)) {
+        log_error("result file '%s' has %"PRIu32" servers", filename, n);
+        r.status = MCP_ERROR;
+    }
+    if (r.status != MCP_OK) {
+        fclose(r.fp);
+        return r.status;
+    }
+
+    opt->pool.server = mcp_calloc(n, sizeof(*opt->pool.server));
+    if (opt->pool.server == NULL) {
+        fclose(r.fp);
+        return MCP_ENOMEM;
+    }
+    opt->pool.nserver = n;
+    for (i = 0; i < n && r.status == MCP_OK; i++) {
+        s = &opt->pool.server[i];
+
+        len = result_get_u32(&r);
+        if (r.status == MCP_OK && len >= SERVER_NAME_LEN) {
+            log_error("result file '%s' has an invalid server name",
+                      filename);
+            r.status = MCP_ERROR;
+            break;
+        }
+
+        s->name = mcp_alloc(len + 1);
+        if (s->name == NULL) {
+            r.status = MCP_ENOMEM;
+            break;
+        }
+        result_get(&r, s->name, len);
+        s->name[len] = '\0';
+        s->host = s->name;
+    }
+    if (r.status != MCP_OK) {
+        fclose(r.fp);
+        return r.status;
+    }
+
+    status = stats_init(ctx);
+    if (status != MCP_OK) {
+        fclose(r.fp);
+        return status;
+    }
+
+    stats->start_time = result_get_double(&r);
+    stats->stop_time = result_get_double(&r);
+    result_get_rusage(&r, &stats->rusage_start, &stats->rusage_stop);
+
+#define GET_ACTION(_type, _field)                                       \
+    stats->_field = result_get_##_type(&r);
+
+    RESULT_CODEC( GET_ACTION )
+
+#undef GET_ACTION
+
+    n = result_get_u32(&r);
+    if (r.status == MCP_OK && n != RSP_MAX_TYPES) {
+        log_error("result file '%s' has %"PRIu32" response types, expected "
+                  "%d", filename, n, RSP_MAX_TYPES);
+        r.status = MCP_ERROR;
+    }
+    for (i = 0; i < RSP_MAX_TYPES; i++) {
+        stats->rsp_type[i] = result_get_u32(&r);
+    }
+
+    result_get_time(&r, &stats->connect);
+    result_get_time(&r, &stats->req_xfer);
+    result_get_time(&r, &stats->req_rsp);
+    result_get_time(&r, &stats->int_rsp);
+    result_get_time(&r, &stats->rsp_xfer);
+
+    for (i = 0; i < REQ_MAX_TYPES && opt->nmethod > 1; i++) {
+        if (opt->method_weight[i] > 0.0) {
+            stats->method[i].nreq = result_get_u32(&r);
+            stats->method[i].nrsp = result_get_u32(&r);
+            result_get_time(&r, &stats->method[i].req_rsp);
+            result_get_time(&r, &stats->method[i].int_rsp);
+        }
+    }
+
+    for (i = 0; i < stats->nserver; i++) {
+        stats->server[i].nreq = result_get_u32(&r);
+        stats->server[i].nrsp = result_get_u32(&r);
+        stats->server[i].nerror = result_get_u32(&r);
+        result_get_time(&r, &stats->server[i].req_rsp);
+        result_get_time(&r, &stats->server[i].int_rsp);
+    }
+
+    fclose(r.fp);
+
+    return r.status;
+}
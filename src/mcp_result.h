@@ -0,0 +1,103 @@
+/*
+ *  twemperf - a tool for measuring memcached server performance.
+ *  Copyright (C) 2011 Twitter, Inc.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _MCP_RESULT_H_
+#define _MCP_RESULT_H_
+
+#define RESULT_MAGIC    0x5452504d  /* "MPRT" in little endian */
+#define RESULT_VERSION  4
+
+/*
+ * A result file holds the stats of a test in a compact binary form that
+ * can be merged exactly with the result files of other tests. It starts
+ * with a header of the magic, the format version and the parameters that
+ * the stats were collected with, followed by the counters, sums, min and
+ * max of every stats field in the order of RESULT_CODEC, and the time
+ * series, each with its non-empty histogram counters only. The stats of
+ * every request type of a mix of more than one type come last, followed by
+ * the stats of every server of a pool of more than one server, whose names
+ * are in the header. Integers and doubles are written in host byte order,
+ * which the magic checks for.
+ */
+#define RESULT_CODEC(ACTION)                        \
+    ACTION( u32,    nconn_created               )   \
+    ACTION( u32,    nconn_destroyed             )   \
+    ACTION( u32,    nconn_active                )   \
+    ACTION( u32,    nconn_active_max            )   \
+    ACTION( u32,    nconnect_issued             )   \
+    ACTION( u32,    nconnect                    )   \
+    ACTION( double, connection_sum              )   \
+    ACTION( double, connection_sum2             )   \
+    ACTION( double, connection_min              )   \
+    ACTION( double, connection_max              )   \
+    ACTION( u32,    nclient_timeout             )   \
+    ACTION( u32,    nsock_fdunavail             )   \
+    ACTION( u32,    nsock_ftabfull              )   \
+    ACTION( u32,    nsock_addrunavail           )   \
+    ACTION( u32,    nsock_refused               )   \
+    ACTION( u32,    nsock_reset                 )   \
+    ACTION( u32,    nsock_timedout              )   \
+    ACTION( u32,    nsock_other_error           )   \
+    ACTION( u32,    nreq                        )   \
+    ACTION( double, req_bytes_sent              )   \
+    ACTION( double, req_bytes_sent2             )   \
+    ACTION( double, req_bytes_sent_min          )   \
+    ACTION( double, req_bytes_sent_max          )   \
+    ACTION( u32,    npace                       )   \
+    ACTION( double, pace_sum                    )   \
+    ACTION( double, pace_sum2                   )   \
+    ACTION( double, pace_min                    )   \
+    ACTION( double, pace_max                    )   \
+    ACTION( u32,    nrsp                        )   \
+    ACTION( double, rsp_bytes_rcvd              )   \
+    ACTION( double, rsp_bytes_rcvd2             )   \
+    ACTION( double, rsp_bytes_rcvd_min          )   \
+    ACTION( double, rsp_bytes_rcvd_max          )   \
+    ACTION( u32,    nget                        )   \
+    ACTION( u64,    nget_key                    )   \
+    ACTION( u64,    nget_hit                    )   \
+    ACTION( double, get_value_bytes             )   \
+    ACTION( u64,    nsys_wait                   )   \
+    ACTION( u64,    nsys_ctl                    )   \
+    ACTION( u64,    nsys_send                   )   \
+    ACTION( u64,    nsys_recv                   )   \
+    ACTION( u64,    nio_send                    )   \
+    ACTION( u64,    nio_recv                    )   \
+
+/* integer fields of struct rusage, after ru_utime and ru_stime */
+#define RUSAGE_CODEC(ACTION)                        \
+    ACTION( ru_maxrss   )                           \
+    ACTION( ru_ixrss    )                           \
+    ACTION( ru_idrss    )                           \
+    ACTION( ru_isrss    )                           \
+    ACTION( ru_minflt   )                           \
+    ACTION( ru_majflt   )                           \
+    ACTION( ru_nswap    )                           \
+    ACTION( ru_inblock  )                           \
+    ACTION( ru_oublock  )                           \
+    ACTION( ru_msgsnd   )                           \
+    ACTION( ru_msgrcv   )                           \
+    ACTION( ru_nsignals )                           \
+    ACTION( ru_nvcsw    )                           \
+    ACTION( ru_nivcsw   )                           \
+
+rstatus_t result_write(struct context *ctx, char *filename);
+rstatus_t result_read(struct context *ctx, char *filename);
+
+#endif
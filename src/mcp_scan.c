@@ -0,0 +1,176 @@
+/*
+ *  twemperf - a tool for measuring memcached server performance.
+ *  Copyright (C) 2011 Twitter, Inc.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <mcp_core.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+# define MCP_HAVE_SCAN_X86 1
+# include <immintrin.h>
+#endif
+
+static char *scan_names[] = {
+    "scalar",
+    "sse2",
+    "avx2",
+    NULL
+};
+
+static char *
+scan_delim_scalar(char *p, char *last)
+{
+    for (; p < last; p++) {
+        if (*p == ' ' || *p == CR) {
+            return p;
+        }
+    }
+
+    return last;
+}
+
+#ifdef MCP_HAVE_SCAN_X86
+
+/*
+ * Compare a block against both delimiters at once and take the lowest set
+ * bit of the resulting byte mask; the tail shorter than a block is left to
+ * the scalar loop.
+ */
+__attribute__((target("sse2")))
+static char *
+scan_delim_sse2(char *p, char *last)
+{
+    __m128i sp = _mm_set1_epi8(' ');
+    __m128i cr = _mm_set1_epi8(CR);
+    __m128i v;
+    int mask;
+
+    for (; last - p >= 16; p += 16) {
+        v = _mm_loadu_si128((__m128i *)p);
+        mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, sp),
+                                              _mm_cmpeq_epi8(v, cr)));
+        if (mask != 0) {
+            return p + __builtin_ctz((unsigned)mask);
+        }
+    }
+
+    return scan_delim_scalar(p, last);
+}
+
+__attribute__((target("avx2")))
+static char *
+scan_delim_avx2(char *p, char *last)
+{
+    __m256i sp = _mm256_set1_epi8(' ');
+    __m256i cr = _mm256_set1_epi8(CR);
+    __m256i v;
+    int mask;
+
+    for (; last - p >= 32; p += 32) {
+        v = _mm256_loadu_si256((__m256i *)p);
+        mask = _mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(v, sp),
+                                                    _mm256_cmpeq_epi8(v, cr)));
+        if (mask != 0) {
+            return p + __builtin_ctz((unsigned)mask);
+        }
+    }
+
+    return scan_delim_sse2(p, last);
+}
+
+#endif
+
+scan_t scan_delim = scan_delim_scalar;
+
+char *
+scan_name(scan_type_t type)
+{
+    ASSERT(type >= SCAN_SCALAR && type < SCAN_SENTINEL);
+
+    return scan_names[type];
+}
+
+bool
+scan_supported(scan_type_t type)
+{
+    switch (type) {
+    case SCAN_SCALAR:
+        return true;
+
+#ifdef MCP_HAVE_SCAN_X86
+    case SCAN_SSE2:
+        return __builtin_cpu_supports("sse2");
+
+    case SCAN_AVX2:
+        return __builtin_cpu_supports("avx2");
+#endif
+
+    default:
+        return false;
+    }
+}
+
+scan_type_t
+scan_best(void)
+{
+    int type;
+
+    for (type = SCAN_SENTINEL - 1; type > SCAN_SCALAR; type--) {
+        if (scan_supported(type)) {
+            break;
+        }
+    }
+
+    return (scan_type_t)type;
+}
+
+/*
+ * Select the scanner implementation; must be called before any worker
+ * starts parsing.
+ */
+rstatus_t
+scan_init(scan_type_t type)
+{
+    if (!scan_supported(type)) {
+        log_error("%s scanner is not supported on this cpu", scan_name(type));
+        return MCP_ERROR;
+    }
+
+    switch (type) {
+    case SCAN_SCALAR:
+        scan_delim = scan_delim_scalar;
+        break;
+
+#ifdef MCP_HAVE_SCAN_X86
+    case SCAN_SSE2:
+        scan_delim = scan_delim_sse2;
+        break;
+
+    case SCAN_AVX2:
+        scan_delim = scan_delim_avx2;
+        break;
+#endif
+
+    default:
+        NOT_REACHED();
+        return MCP_ERROR;
+    }
+
+    log_debug(LOG_INFO, "using %s scanner", scan_name(type));
+
+    return MCP_OK;
+}
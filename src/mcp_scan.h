@@ -0,0 +1,44 @@
+/*
+ *  twemperf - a tool for measuring memcached server performance.
+ *  Copyright (C) 2011 Twitter, Inc.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _MCP_SCAN_H_
+#define _MCP_SCAN_H_
+
+typedef enum scan_type {
+    SCAN_SCALAR,    /* byte at a time */
+    SCAN_SSE2,      /* 16 bytes at a time */
+    SCAN_AVX2,      /* 32 bytes at a time */
+    SCAN_SENTINEL
+} scan_type_t;
+
+typedef char *(*scan_t)(char *, char *);
+
+/*
+ * scan_delim returns the first space or cr in [p, last), or last if there
+ * is none; these are the bytes that end the fields of a response line.
+ * It dispatches to the widest implementation that the cpu supports.
+ */
+extern scan_t scan_delim;
+
+char *scan_name(scan_type_t type);
+bool scan_supported(scan_type_t type);
+rstatus_t scan_init(scan_type_t type);
+scan_type_t scan_best(void);
+
+#endif
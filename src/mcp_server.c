@@ -0,0 +1,520 @@
+/*
+ *  twemperf - a tool for measuring memcached server performance.
+ *  Copyright (C) 2011 Twitter, Inc.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <math.h>
+
+#include <mcp_core.h>
+
+#define SERVER_FNV_INIT     ((uint32_t)0xcbf29ce484222325ULL)
+#define SERVER_FNV_PRIME    ((uint32_t)0x100000001b3ULL)
+#define SERVER_WEIGHT_MAX   UINT16_MAX
+
+static char *server_dist_names[] = {      /* server distribution names */
+    "ketama",                              /* SERVER_DIST_KETAMA */
+    "modula",                              /* SERVER_DIST_MODULA */
+    "random",                              /* SERVER_DIST_RANDOM */
+    NULL
+};
+
+char *
+server_dist_name(server_dist_type_t type)
+{
+    ASSERT(type >= SERVER_DIST_KETAMA && type < SERVER_DIST_SENTINEL);
+
+    return server_dist_names[type];
+}
+
+server_dist_type_t
+server_dist_type(char *name)
+{
+    server_dist_type_t type;
+
+    for (type = SERVER_DIST_KETAMA; type < SERVER_DIST_SENTINEL; type++) {
+        if (strcmp(name, server_dist_names[type]) == 0) {
+            break;
+        }
+    }
+
+    return type;
+}
+
+/*
+ * Per round shift amounts and sine derived constants of md5 (RFC 1321),
+ * which places the ketama points of a server.
+ */
+static const uint8_t md5_shift[64] = {
+    7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22,
+    5,  9, 14, 20, 5,  9, 14, 20, 5,  9, 14, 20, 5,  9, 14, 20,
+    4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23,
+    6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21
+};
+
+static const uint32_t md5_sine[64] = {
+    0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee,
+    0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501,
+    0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be,
+    0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821,
+    0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa,
+    0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+    0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed,
+    0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a,
+    0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c,
+    0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70,
+    0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05,
+    0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+    0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039,
+    0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1,
+    0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1,
+    0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391
+};
+
+static void
+server_md5_block(uint32_t h[4], const uint8_t *p)
+{
+    uint32_t w[16], a, b, c, d, f, t;
+    uint32_t i, g;
+
+    for (i = 0; i < 16; i++) {
+        w[i] = (uint32_t)p[4 * i] | ((uint32_t)p[4 * i + 1] << 8) |
+               ((uint32_t)p[4 * i + 2] << 16) | ((uint32_t)p[4 * i + 3] << 24);
+    }
+
+    a = h[0];
+    b = h[1];
+    c = h[2];
+    d = h[3];
+
+    for (i = 0; i < 64; i++) {
+        if (i < 16) {
+            f = d ^ (b & (c ^ d));
+            g = i;
+        } else if (i < 32) {
+            f = c ^ (d & (b ^ c));
+            g = (5 * i + 1) % 16;
+        } else if (i < 48) {
+            f = b ^ c ^ d;
+            g = (3 * i + 5) % 16;
+        } else {
+            f = c ^ (b | ~d);
+            g = (7 * i) % 16;
+        }
+
+        t = a + f + md5_sine[i] + w[g];
+        a = d;
+        d = c;
+        c = b;
+        b += (t << md5_shift[i]) | (t >> (32 - md5_shift[i]));
+    }
+
+    h[0] += a;
+    h[1] += b;
+    h[2] += c;
+    h[3] += d;
+}
+
+static void
+server_md5(const uint8_t *data, size_t len, uint8_t digest[16])
+{
+    uint32_t h[4] = { 0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476 };
+    uint8_t block[128];
+    uint64_t nbit = (uint64_t)len * 8;
+    size_t i, n;
+
+    for (; len >= 64; data += 64, len -= 64) {
+        server_md5_block(h, data);
+    }
+
+    /* pad the tail with a one bit, zeros and the bit length */
+    mcp_memcpy(block, data, len);
+    block[len] = 0x80;
+    n = (len < 56) ? 64 : 128;
+    memset(block + len + 1, 0, n - len - 1);
+    for (i = 0; i < 8; i++) {
+        block[n - 8 + i] = (uint8_t)(nbit >> (8 * i));
+    }
+
+    server_md5_block(h, block);
+    if (n == 128) {
+        server_md5_block(h, block + 64);
+    }
+
+    for (i = 0; i < 16; i++) {
+        digest[i] = (uint8_t)(h[i / 4] >> (8 * (i % 4)));
+    }
+}
+
+static uint32_t
+server_hash(uint32_t hash, const char *p, size_t len)
+{
+    size_t i;
+
+    for (i = 0; i < len; i++) {
+        hash ^= (uint32_t)(uint8_t)p[i];
+        hash *= SERVER_FNV_PRIME;
+    }
+
+    return hash;
+}
+
+/*
+ * Return the hash of the name of key key_id, the key prefix followed by
+ * the key id in eight hex digits, continuing from the hash of the prefix
+ */
+static uint32_t
+server_key_hash(struct server_pool *pool, uint32_t key_id)
+{
+    static const char hex[] = "0123456789abcdef";
+    uint32_t hash = pool->prefix_hash;
+    int shift;
+
+    for (shift = 28; shift >= 0; shift -= 4) {
+        hash ^= (uint32_t)(uint8_t)hex[(key_id >> shift) & 0xf];
+        hash *= SERVER_FNV_PRIME;
+    }
+
+    return hash;
+}
+
+/*
+ * Parse a server of a list, host[:port[:weight]] with an empty port for
+ * the default one. An ipv6 host with a port is written in brackets and a
+ * unix socket path, which starts with a '/', has neither port nor weight.
+ */
+static rstatus_t
+server_parse(struct server *s, char *entry, uint16_t port)
+{
+    char *host, *rest, *weight, *p;
+    uint32_t ncolon;
+    int value;
+
+    host = entry;
+    rest = NULL;
+
+    for (ncolon = 0, p = entry; *p != '\0'; p++) {
+        ncolon += (*p == ':') ? 1 : 0;
+    }
+
+    if (entry[0] == '[') {
+        host = entry + 1;
+        p = strchr(host, ']');
+        if (p == NULL || (p[1] != '\0' && p[1] != ':')) {
+            return MCP_ERROR;
+        }
+        *p = '\0';
+        rest = (p[1] == ':') ? p + 2 : NULL;
+    } else if (entry[0] != '/' && ncolon <= 2) {
+        rest = strchr(entry, ':');
+        if (rest != NULL) {
+            *rest++ = '\0';
+        }
+    }
+
+    if (*host == '\0') {
+        return MCP_ERROR;
+    }
+
+    s->host = host;
+    s->port = port;
+    s->weight = 1;
+
+    if (rest == NULL) {
+        return MCP_OK;
+    }
+
+    weight = strchr(rest, ':');
+    if (weight != NULL) {
+        *weight++ = '\0';
+    }
+
+    if (*rest != '\0') {
+        value = mcp_atoi(rest);
+        if (!mcp_valid_port(value)) {
+            return MCP_ERROR;
+        }
+        s->port = (uint16_t)value;
+    }
+
+    if (weight != NULL) {
+        value = mcp_atoi(weight);
+        if (value <= 0 || value > SERVER_WEIGHT_MAX) {
+            return MCP_ERROR;
+        }
+        s->weight = (uint32_t)value;
+    }
+
+    return MCP_OK;
+}
+
+static int
+server_continuum_cmp(const void *t1, const void *t2)
+{
+    const struct continuum *ct1 = t1, *ct2 = t2;
+
+    if (ct1->value == ct2->value) {
+        return 0;
+    }
+
+    return (ct1->value > ct2->value) ? 1 : -1;
+}
+
+static rstatus_t
+server_pool_ketama(struct server_pool *pool, uint32_t total_weight)
+{
+    char name[SERVER_NAME_LEN + sizeof("-4294967295")];
+    uint8_t digest[16];
+    uint32_t i, j, k, npoint, len;
+    struct server *s;
+    struct continuum *c;
+
+    pool->continuum = mcp_calloc((size_t)pool->nserver * SERVER_KETAMA_POINTS,
+                                 sizeof(*pool->continuum));
+    if (pool->continuum == NULL) {
+        return MCP_ENOMEM;
+    }
+
+    for (i = 0; i < pool->nserver; i++) {
+        s = &pool->server[i];
+
+        npoint = (uint32_t)floor((double)s->weight / total_weight *
+                                 SERVER_KETAMA_POINTS / 4 * pool->nserver +
+                                 0.0000000001) * 4;
+
+        for (j = 0; j < npoint / 4; j++) {
+            len = (uint32_t)mcp_scnprintf(name, sizeof(name), "%s-%"PRIu32"",
+                                          s->name, j);
+            server_md5((uint8_t *)name, len, digest);
+
+            for (k = 0; k < 4; k++) {
+                c = &pool->continuum[pool->ncontinuum++];
+                c->index = i;
+                c->value = ((uint32_t)digest[3 + k * 4] << 24) |
+                           ((uint32_t)digest[2 + k * 4] << 16) |
+                           ((uint32_t)digest[1 + k * 4] << 8) |
+                           (uint32_t)digest[k * 4];
+            }
+        }
+    }
+
+    qsort(pool->continuum, pool->ncontinuum, sizeof(*pool->continuum),
+          server_continuum_cmp);
+
+    return MCP_OK;
+}
+
+static rstatus_t
+server_pool_weight(struct server_pool *pool, uint32_t total_weight)
+{
+    uint32_t i, j;
+    struct continuum *c;
+
+    pool->continuum = mcp_calloc(total_weight, sizeof(*pool->continuum));
+    if (pool->continuum == NULL) {
+        return MCP_ENOMEM;
+    }
+
+    for (i = 0; i < pool->nserver; i++) {
+        for (j = 0; j < pool->server[i].weight; j++) {
+            c = &pool->continuum[pool->ncontinuum++];
+            c->index = i;
+            c->value = 0;
+        }
+    }
+
+    return MCP_OK;
+}
+
+/*
+ * Initialize a pool of the comma separated list of servers, resolve them
+ * and build the continuum of the key distribution over them
+ */
+rstatus_t
+server_pool_init(struct server_pool *pool, char *servers, uint16_t port,
+                 server_dist_type_t type, struct string *prefix)
+{
+    rstatus_t status;
+    char *entry, *next;
+    size_t len;
+    uint32_t i, total_weight;
+    struct server *s;
+
+    pool->type = type;
+    pool->nserver = 1;
+    pool->server = NULL;
+    pool->ncontinuum = 0;
+    pool->continuum = NULL;
+    pool->prefix_hash = server_hash(SERVER_FNV_INIT, prefix->data,
+                                    prefix->len);
+
+    for (entry = servers; *entry != '\0'; entry++) {
+        pool->nserver += (*entry == ',') ? 1 : 0;
+    }
+
+    pool->server = mcp_calloc(pool->nserver, sizeof(*pool->server));
+    if (pool->server == NULL) {
+        return MCP_ENOMEM;
+    }
+
+    total_weight = 0;
+    for (i = 0, entry = servers; i < pool->nserver; i++, entry = next) {
+        s = &pool->server[i];
+
+        next = strchr(entry, ',');
+        len = (next != NULL) ? (size_t)(next - entry) : strlen(entry);
+        next = (next != NULL) ? next + 1 : NULL;
+
+        s->name = mcp_alloc(SERVER_NAME_LEN + len + 1);
+        if (s->name == NULL) {
+            server_pool_deinit(pool);
+            return MCP_ENOMEM;
+        }
+        s->host = s->name + SERVER_NAME_LEN;
+        mcp_memcpy(s->host, entry, len);
+        s->host[len] = '\0';
+
+        if (len == 0 || len >= SERVER_NAME_LEN ||
+            server_parse(s, s->host, port) != MCP_OK) {
+            log_stderr("mcperf: invalid server '%.*s' in '%s'", (int)len,
+                       entry, servers);
+            server_pool_deinit(pool);
+            return MCP_ERROR;
+        }
+
+        if (s->host[0] == '/') {
+            mcp_snprintf(s->name, SERVER_NAME_LEN, "%s", s->host);
+        } else if (strchr(s->host, ':') != NULL) {
+            mcp_snprintf(s->name, SERVER_NAME_LEN, "[%s]:%"PRIu16"", s->host,
+                         s->port);
+        } else {
+            mcp_snprintf(s->name, SERVER_NAME_LEN, "%s:%"PRIu16"", s->host,
+                         s->port);
+        }
+
+        status = mcp_resolve_addr(s->host, s->port, &s->si);
+        if (status != MCP_OK) {
+            log_stderr("mcperf: resolve of server '%s' failed", s->name);
+            server_pool_deinit(pool);
+            return MCP_ERROR;
+        }
+
+        total_weight += s->weight;
+    }
+
+    if (type == SERVER_DIST_KETAMA) {
+        status = server_pool_ketama(pool, total_weight);
+    } else {
+        status = server_pool_weight(pool, total_weight);
+    }
+    if (status != MCP_OK) {
+        server_pool_deinit(pool);
+        return status;
+    }
+
+    return MCP_OK;
+}
+
+void
+server_pool_deinit(struct server_pool *pool)
+{
+    uint32_t i;
+
+    if (pool->server != NULL) {
+        for (i = 0; i < pool->nserver; i++) {
+            if (pool->server[i].name != NULL) {
+                mcp_free(pool->server[i].name);
+            }
+        }
+        mcp_free(pool->server);
+        pool->server = NULL;
+    }
+
+    if (pool->continuum != NULL) {
+        mcp_free(pool->continuum);
+        pool->continuum = NULL;
+    }
+    pool->ncontinuum = 0;
+}
+
+/*
+ * Return the index of the server that the key key_id maps to by its hash;
+ * with the random distribution, this is the server of a modula one
+ */
+uint32_t
+server_pool_key(struct server_pool *pool, uint32_t key_id)
+{
+    struct continuum *left, *right, *middle, *end;
+    uint32_t hash;
+
+    if (pool->nserver == 1) {
+        return 0;
+    }
+
+    hash = server_key_hash(pool, key_id);
+
+    if (pool->type != SERVER_DIST_KETAMA) {
+        return pool->continuum[hash % pool->ncontinuum].index;
+    }
+
+    /* first point at or after the hash, wrapping around the continuum */
+    left = pool->continuum;
+    right = end = pool->continuum + pool->ncontinuum;
+    while (left < right) {
+        middle = left + (right - left) / 2;
+        if (middle->value < hash) {
+            left = middle + 1;
+        } else {
+            right = middle;
+        }
+    }
+
+    if (right == end) {
+        right = pool->continuum;
+    }
+
+    return right->index;
+}
+
+void
+server_dist_init(struct server_dist *sd, struct server_pool *pool, uint32_t id)
+{
+    sd->pool = pool;
+
+    sd->xsubi[0] = (uint16_t)(0x5eed ^ id);
+    sd->xsubi[1] = (uint16_t)(0x3c5a ^ (id << 8));
+    sd->xsubi[2] = (uint16_t)(0xa3f1 ^ ~id);
+}
+
+/* Return the index of the server of the next request, on the key key_id */
+uint32_t
+server_next(struct server_dist *sd, uint32_t key_id)
+{
+    struct server_pool *pool = sd->pool;
+    uint32_t idx;
+
+    if (pool->nserver == 1) {
+        return 0;
+    }
+
+    if (pool->type != SERVER_DIST_RANDOM) {
+        return server_pool_key(pool, key_id);
+    }
+
+    idx = (uint32_t)(erand48(sd->xsubi) * pool->ncontinuum);
+
+    return pool->continuum[MIN(idx, pool->ncontinuum - 1)].index;
+}
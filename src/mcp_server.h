@@ -0,0 +1,80 @@
+/*
+ *  twemperf - a tool for measuring memcached server performance.
+ *  Copyright (C) 2011 Twitter, Inc.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _MCP_SERVER_H_
+#define _MCP_SERVER_H_
+
+#define SERVER_KETAMA_POINTS    160     /* # continuum points of a server of mean weight */
+#define SERVER_NAME_LEN         256     /* longest server name, host:port */
+
+typedef enum server_dist_type {
+    SERVER_DIST_KETAMA,         /* ketama consistent hashing of the key */
+    SERVER_DIST_MODULA,         /* key hash modulo the total weight */
+    SERVER_DIST_RANDOM,         /* random server by weight */
+    SERVER_DIST_SENTINEL
+} server_dist_type_t;
+
+struct server {
+    char            *name;      /* server name, host:port */
+    char            *host;      /* server hostname or unix socket path */
+    uint16_t        port;       /* server port */
+    uint32_t        weight;     /* server weight */
+    struct sockinfo si;         /* server socket info */
+};
+
+struct continuum {
+    uint32_t        index;      /* server index */
+    uint32_t        value;      /* hash value of the point */
+};
+
+/*
+ * A server pool is the list of servers given with -s, and the map of the
+ * keys on them. A key is hashed like twemproxy does by default, with the
+ * 32 bit variant of fnv1a_64 over the full key name, so a pool maps the
+ * keys on the same servers as a twemproxy pool of the same servers. With
+ * ketama, every server gets 160 points on a continuum, in proportion to
+ * its weight, placed at the md5 of "host:port-i", and a key maps to the
+ * first point at or after its hash. With modula and random, the continuum
+ * has one point per unit of weight of every server.
+ */
+struct server_pool {
+    server_dist_type_t type;        /* key distribution over the servers */
+    uint32_t           nserver;     /* # servers */
+    struct server      *server;     /* servers */
+    uint32_t           ncontinuum;  /* # continuum points */
+    struct continuum   *continuum;  /* continuum points */
+    uint32_t           prefix_hash; /* hash of the key prefix */
+};
+
+/* the server distribution of a worker */
+struct server_dist {
+    struct server_pool *pool;       /* server pool */
+    uint16_t           xsubi[3];    /* erand48 seed */
+};
+
+char *server_dist_name(server_dist_type_t type);
+server_dist_type_t server_dist_type(char *name);
+
+rstatus_t server_pool_init(struct server_pool *pool, char *servers, uint16_t port, server_dist_type_t type, struct string *prefix);
+void server_pool_deinit(struct server_pool *pool);
+uint32_t server_pool_key(struct server_pool *pool, uint32_t key_id);
+
+void server_dist_init(struct server_dist *sd, struct server_pool *pool, uint32_t id);
+uint32_t server_next(struct server_dist *sd, uint32_t key_id);
+
+#endif
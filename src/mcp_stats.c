@@ -22,6 +22,40 @@
 #include <mcp_core.h>
 #include <mcp_stats.h>
 
+char *req_type_names[] = {         /* request type names */
+    "get",                                 /* REQ_GET */
+    "gets",                                /* REQ_GETS */
+    "delete",                              /* REQ_DELETE */
+    "cas",                                 /* REQ_CAS */
+    "set",                                 /* REQ_SET */
+    "add",                                 /* REQ_ADD */
+    "replace",                             /* REQ_REPLACE */
+    "append",                              /* REQ_APPEND */
+    "prepend",                             /* REQ_PREPEND */
+    "incr",                                /* REQ_INCR */
+    "decr",                                /* REQ_DECR */
+    "xxx",                                 /* REQ_XXX */
+    NULL
+};
+
+char *rsp_type_names[] = {         /* response type names */
+    "stored",                              /* RSP_STORED */
+    "not_stored",                          /* RSP_NOT_STORED */
+    "exists",                              /* RSP_EXISTS */
+    "not_found",                           /* RSP_NOT_FOUND */
+    "end",                                 /* RSP_END */
+    "value",                               /* RSP_VALUE */
+    "deleted",                             /* RSP_DELETED */
+    "error",                               /* RSP_ERROR */
+    "client_error",                        /* RSP_CLIENT_ERROR */
+    "server_error",                        /* RSP_SERVER_ERROR */
+    "num",                                 /* RSP_NUM */
+    NULL
+};
+
+/* # connections active over all the workers of the process */
+static uint32_t nconn_active_all;
+
 static void
 stats_rusage_start(struct context *ctx)
 {
@@ -151,30 +185,311 @@ stats_rusage_print(struct context *ctx)
     log_stderr("Number of involuntary context switches: %ld", nivcsw);
 }
 
+/*
+ * Print the syscalls issued by the event loops. Every send and recv
+ * operation costs a syscall of its own with the epoll engine, while the
+ * io_uring engine batches them into the io_uring_enter(2) calls that it
+ * also waits for completions with.
+ */
+static void
+stats_syscall_print(struct context *ctx)
+{
+    struct opt *opt = &ctx->opt;
+    struct stats *stats = &ctx->stats;
+    uint64_t nsys, nio, nsaved;
+
+    nsys = stats->nsys_wait + stats->nsys_ctl + stats->nsys_send +
+           stats->nsys_recv;
+
+    log_stderr("Syscalls: total %"PRIu64" (%.2f/rsp) wait %"PRIu64" ctl "
+               "%"PRIu64" send %"PRIu64" recv %"PRIu64" engine %s", nsys,
+               stats->nrsp != 0 ? (double)nsys / stats->nrsp : 0.0,
+               stats->nsys_wait, stats->nsys_ctl, stats->nsys_send,
+               stats->nsys_recv, event_engine_name(opt->engine));
+
+    if (opt->engine == EVENT_ENGINE_EPOLL) {
+        return;
+    }
+
+    nio = stats->nio_send + stats->nio_recv;
+    nsaved = nio - (stats->nsys_send + stats->nsys_recv);
+
+    log_stderr("Syscalls saved: %"PRIu64" (%.1f%%) on %"PRIu64" sends and "
+               "%"PRIu64" recvs", nsaved,
+               nsys + nsaved != 0 ?
+               100.0 * (double)nsaved / (double)(nsys + nsaved) : 0.0,
+               stats->nio_send, stats->nio_recv);
+}
+
+static uint32_t
+stats_nerror(struct stats *stats)
+{
+    return stats->nclient_timeout + stats->nsock_fdunavail +
+           stats->nsock_ftabfull + stats->nsock_addrunavail +
+           stats->nsock_refused + stats->nsock_reset +
+           stats->nsock_timedout + stats->nsock_other_error;
+}
+
+static rstatus_t
+stats_time_init(struct stats_time *st, uint32_t digits)
+{
+    st->sum = 0.0;
+    st->sum2 = 0.0;
+    st->min = DBL_MAX;
+    st->max = 0.0;
+
+    return histogram_init(&st->hist, (uint64_t)(HIST_MAX_TIME / HIST_UNIT),
+                          digits);
+}
+
+static void
+stats_time_reset(struct stats_time *st)
+{
+    st->sum = 0.0;
+    st->sum2 = 0.0;
+    st->min = DBL_MAX;
+    st->max = 0.0;
+
+    if (st->hist.count != NULL) {
+        histogram_reset(&st->hist);
+    }
+}
+
+static void
+stats_time_merge(struct stats_time *dst, struct stats_time *src)
+{
+    dst->sum += src->sum;
+    dst->sum2 += src->sum2;
+    dst->min = MIN(dst->min, src->min);
+    dst->max = MAX(dst->max, src->max);
+    histogram_merge(&dst->hist, &src->hist);
+}
+
 void
-stats_init(struct context *ctx)
+stats_time_add(struct stats_time *st, double time)
+{
+    st->sum += time;
+    st->sum2 += SQUARE(time);
+    st->min = MIN(time, st->min);
+    st->max = MAX(time, st->max);
+
+    histogram_record(&st->hist, (uint64_t)MAX(llrint(time / HIST_UNIT), 0));
+}
+
+/*
+ * Return the time below which the fraction q of the samples in the series
+ * fall, at the histogram resolution.
+ */
+static double
+stats_time_quantile(struct stats_time *st, double q)
+{
+    return HIST_UNIT * (double)histogram_percentile(&st->hist, q);
+}
+
+static void
+stats_time_print(struct context *ctx, char *name, struct stats_time *st)
+{
+    struct opt *opt = &ctx->opt;
+    struct histogram_iter it;
+    uint64_t n = st->hist.total;
+    double avg, stddev;
+
+    if (n == 0) {
+        return;
+    }
+
+    avg = st->sum / (double)n;
+    stddev = STDDEV(st->sum, st->sum2, (double)n);
+
+    log_stderr("%s [ms]: avg %.3f min %.3f max %.3f stddev %.3f", name,
+               1e3 * avg, 1e3 * st->min, 1e3 * st->max, 1e3 * stddev);
+
+    if (opt->print_histogram) {
+        log_stderr("%s histogram [ms]:", name);
+
+        /* one line per non-empty bucket: low high count cumulative% */
+        histogram_iter_init(&it, &st->hist);
+        while (histogram_iter_next(&it)) {
+            log_stderr("%16.3f %12.3f %10"PRIu64" %8.3f%%",
+                       1e3 * HIST_UNIT * (double)it.low,
+                       1e3 * HIST_UNIT * (double)it.high, it.count,
+                       100.0 * (double)it.cumulative / (double)n);
+        }
+    }
+
+    log_stderr("%s [ms]: p25 %.3f p50 %.3f p75 %.3f", name,
+               1e3 * stats_time_quantile(st, 0.25),
+               1e3 * stats_time_quantile(st, 0.50),
+               1e3 * stats_time_quantile(st, 0.75));
+
+    log_stderr("%s [ms]: p95 %.3f p99 %.3f p999 %.3f", name,
+               1e3 * stats_time_quantile(st, 0.95),
+               1e3 * stats_time_quantile(st, 0.99),
+               1e3 * stats_time_quantile(st, 0.999));
+}
+
+static void
+stats_interval_zero(struct stats_interval *ival)
+{
+    ival->idx = 0;
+    ival->nreq = 0;
+    ival->nrsp = 0;
+    ival->nerror = 0;
+    ival->bytes = 0.0;
+}
+
+/*
+ * The stats of every request type of a mix are only allocated when there
+ * is more than one type in the mix.
+ */
+static rstatus_t
+stats_method_init(struct context *ctx)
+{
+    struct opt *opt = &ctx->opt;
+    struct stats_method *sm;
+    rstatus_t status;
+    uint32_t i;
+
+    for (i = 0; i < REQ_MAX_TYPES; i++) {
+        sm = &ctx->stats.method[i];
+
+        sm->nreq = 0;
+        sm->nrsp = 0;
+        sm->req_rsp.hist.count = NULL;
+        sm->int_rsp.hist.count = NULL;
+
+        if (opt->nmethod <= 1 || opt->method_weight[i] == 0.0) {
+            continue;
+        }
+
+        status = stats_time_init(&sm->req_rsp, opt->hist_digits);
+        if (status != MCP_OK) {
+            return status;
+        }
+        status = stats_time_init(&sm->int_rsp, opt->hist_digits);
+        if (status != MCP_OK) {
+            return status;
+        }
+    }
+
+    return MCP_OK;
+}
+
+/*
+ * The stats of every server of a pool are only allocated when there is
+ * more than one server in the pool.
+ */
+static rstatus_t
+stats_server_init(struct context *ctx)
 {
+    struct opt *opt = &ctx->opt;
     struct stats *stats = &ctx->stats;
+    struct stats_server *ss;
+    rstatus_t status;
     uint32_t i;
 
-    memset(&stats->rusage_start, 0, sizeof(stats->rusage_start));
-    memset(&stats->rusage_stop, 0, sizeof(stats->rusage_stop));
+    stats->nserver = 0;
+    stats->server = NULL;
 
-    stats->start_time = 0.0;
-    stats->stop_time = 0.0;
+    if (opt->pool.nserver <= 1) {
+        return MCP_OK;
+    }
+
+    stats->server = mcp_calloc(opt->pool.nserver, sizeof(*stats->server));
+    if (stats->server == NULL) {
+        return MCP_ENOMEM;
+    }
+    stats->nserver = opt->pool.nserver;
+
+    for (i = 0; i < stats->nserver; i++) {
+        ss = &stats->server[i];
+
+        ss->nreq = 0;
+        ss->nrsp = 0;
+        ss->nerror = 0;
+
+        status = stats_time_init(&ss->req_rsp, opt->hist_digits);
+        if (status != MCP_OK) {
+            return status;
+        }
+        status = stats_time_init(&ss->int_rsp, opt->hist_digits);
+        if (status != MCP_OK) {
+            return status;
+        }
+    }
+
+    return MCP_OK;
+}
+
+/*
+ * The interval histograms are only allocated when interval reporting is
+ * on; the main context merges the intervals of its workers into the first
+ * histogram of its own ring.
+ */
+static rstatus_t
+stats_interval_init(struct context *ctx)
+{
+    struct stats *stats = &ctx->stats;
+    struct stats_interval_summary *sum = &stats->ival_sum;
+    rstatus_t status;
+    uint32_t i;
+
+    stats->ival_head = 0;
+    stats->ival_tail = 0;
+    for (i = 0; i < NELEM(stats->ival_hist); i++) {
+        stats->ival_hist[i].count = NULL;
+        stats_interval_zero(&stats->ival_ring[i]);
+        stats->ival_ring[i].hist = &stats->ival_hist[i];
+    }
+    stats_interval_zero(&stats->ival_last);
+    stats_interval_zero(&stats->ival);
+    stats->ival.hist = NULL;
+
+    sum->n = 0;
+    sum->rate_sum = 0.0;
+    sum->rate_min = DBL_MAX;
+    sum->rate_max = 0.0;
+    sum->rate_min_idx = 0;
+    sum->p99_sum = 0.0;
+    sum->p99_min = DBL_MAX;
+    sum->p99_max = 0.0;
+    sum->p99_max_idx = 0;
+    sum->nerror_ival = 0;
+
+    if (ctx->opt.report_interval == 0.0) {
+        return MCP_OK;
+    }
+
+    for (i = 0; i < NELEM(stats->ival_hist); i++) {
+        status = histogram_init(&stats->ival_hist[i],
+                                (uint64_t)(HIST_MAX_TIME / HIST_UNIT),
+                                ctx->opt.hist_digits);
+        if (status != MCP_OK) {
+            return status;
+        }
+    }
+
+    return MCP_OK;
+}
+
+/*
+ * Zero the counters, sums and histograms of stats; the connections that
+ * are active stay active.
+ */
+static void
+stats_clear(struct stats *stats)
+{
+    uint32_t i;
 
     stats->nconn_created = 0;
     stats->nconn_destroyed = 0;
 
-    stats->nconn_active = 0;
-    stats->nconn_active_max = 0;
+    stats->nconn_active_max = __atomic_load_n(&nconn_active_all,
+                                              __ATOMIC_RELAXED);
 
     stats->nconnect_issued = 0;
     stats->nconnect = 0;
-    stats->connect_sum = 0.0;
-    stats->connect_sum2 = 0.0;
-    stats->connect_min = DBL_MAX;
-    stats->connect_max = 0.0;
+    stats_time_reset(&stats->connect);
     stats->connection_sum = 0.0;
     stats->connection_sum2 = 0.0;
     stats->connection_min = DBL_MAX;
@@ -195,18 +510,16 @@ stats_init(struct context *ctx)
     stats->req_bytes_sent_min = DBL_MAX;
     stats->req_bytes_sent_max = 0.0;
 
-    stats->req_xfer_sum = 0.0;
-    stats->req_xfer_sum2 = 0.0;
-    stats->req_xfer_min = DBL_MAX;
-    stats->req_xfer_max = 0.0;
+    stats_time_reset(&stats->req_xfer);
 
-    stats->req_rsp_sum = 0.0;
-    stats->req_rsp_sum2 = 0.0;
-    stats->req_rsp_min = DBL_MAX;
-    stats->req_rsp_max = 0.0;
-    for (i = 0; i < HIST_NUM_BINS; i++) {
-        stats->req_rsp_hist[i] = 0;
-    }
+    stats->npace = 0;
+    stats->pace_sum = 0.0;
+    stats->pace_sum2 = 0.0;
+    stats->pace_min = DBL_MAX;
+    stats->pace_max = 0.0;
+
+    stats_time_reset(&stats->req_rsp);
+    stats_time_reset(&stats->int_rsp);
 
     stats->nrsp = 0;
     stats->rsp_bytes_rcvd = 0.0;
@@ -214,14 +527,747 @@ stats_init(struct context *ctx)
     stats->rsp_bytes_rcvd_min = DBL_MAX;
     stats->rsp_bytes_rcvd_max = 0.0;
 
-    stats->rsp_xfer_sum = 0.0;
-    stats->rsp_xfer_sum2 = 0.0;
-    stats->rsp_xfer_min = DBL_MAX;
-    stats->rsp_xfer_max = 0.0;
+    stats_time_reset(&stats->rsp_xfer);
 
     for (i = 0; i < RSP_MAX_TYPES; i++) {
         stats->rsp_type[i] = 0;
     }
+
+    stats->nget = 0;
+    stats->nget_key = 0;
+    stats->nget_hit = 0;
+    stats->get_value_bytes = 0.0;
+
+    for (i = 0; i < REQ_MAX_TYPES; i++) {
+        stats->method[i].nreq = 0;
+        stats->method[i].nrsp = 0;
+        stats_time_reset(&stats->method[i].req_rsp);
+        stats_time_reset(&stats->method[i].int_rsp);
+    }
+
+    for (i = 0; i < stats->nserver; i++) {
+        stats->server[i].nreq = 0;
+        stats->server[i].nrsp = 0;
+        stats->server[i].nerror = 0;
+        stats_time_reset(&stats->server[i].req_rsp);
+        stats_time_reset(&stats->server[i].int_rsp);
+    }
+
+    stats->nsys_wait = 0;
+    stats->nsys_ctl = 0;
+    stats->nsys_send = 0;
+    stats->nsys_recv = 0;
+    stats->nio_send = 0;
+    stats->nio_recv = 0;
+}
+
+rstatus_t
+stats_init(struct context *ctx)
+{
+    struct stats *stats = &ctx->stats;
+    uint32_t digits = ctx->opt.hist_digits;
+    rstatus_t status;
+
+    memset(&stats->rusage_start, 0, sizeof(stats->rusage_start));
+    memset(&stats->rusage_stop, 0, sizeof(stats->rusage_stop));
+
+    stats->start_time = 0.0;
+    stats->stop_time = 0.0;
+
+    status = stats_time_init(&stats->connect, digits);
+    if (status != MCP_OK) {
+        return status;
+    }
+    status = stats_time_init(&stats->req_xfer, digits);
+    if (status != MCP_OK) {
+        return status;
+    }
+    status = stats_time_init(&stats->req_rsp, digits);
+    if (status != MCP_OK) {
+        return status;
+    }
+    status = stats_time_init(&stats->int_rsp, digits);
+    if (status != MCP_OK) {
+        return status;
+    }
+    status = stats_time_init(&stats->rsp_xfer, digits);
+    if (status != MCP_OK) {
+        return status;
+    }
+
+    status = stats_method_init(ctx);
+    if (status != MCP_OK) {
+        return status;
+    }
+
+    status = stats_server_init(ctx);
+    if (status != MCP_OK) {
+        return status;
+    }
+
+    stats->nconn_active = 0;
+    stats_clear(stats);
+
+    output_init(&stats->output, ctx->opt.output_format, stdout);
+
+    return stats_interval_init(ctx);
+}
+
+/*
+ * Discard the stats gathered so far and start collecting them afresh,
+ * at the end of the warmup of a test. The report intervals carry on
+ * across the reset, so their counters are rebased on the new ones.
+ */
+void
+stats_reset(struct context *ctx)
+{
+    struct stats *stats = &ctx->stats;
+    struct stats_interval *last = &ctx->stats.ival_last;
+
+    last->nreq -= stats->nreq;
+    last->nrsp -= stats->nrsp;
+    last->nerror -= stats_nerror(stats);
+    last->bytes -= stats->req_bytes_sent + stats->rsp_bytes_rcvd;
+
+    stats_clear(stats);
+
+    stats_start(ctx);
+}
+
+void
+stats_deinit(struct context *ctx)
+{
+    struct stats *stats = &ctx->stats;
+    uint32_t i;
+
+    histogram_deinit(&stats->connect.hist);
+    histogram_deinit(&stats->req_xfer.hist);
+    histogram_deinit(&stats->req_rsp.hist);
+    histogram_deinit(&stats->int_rsp.hist);
+    histogram_deinit(&stats->rsp_xfer.hist);
+    for (i = 0; i < REQ_MAX_TYPES; i++) {
+        histogram_deinit(&stats->method[i].req_rsp.hist);
+        histogram_deinit(&stats->method[i].int_rsp.hist);
+    }
+    if (stats->server != NULL) {
+        for (i = 0; i < stats->nserver; i++) {
+            histogram_deinit(&stats->server[i].req_rsp.hist);
+            histogram_deinit(&stats->server[i].int_rsp.hist);
+        }
+        mcp_free(stats->server);
+        stats->server = NULL;
+        stats->nserver = 0;
+    }
+    for (i = 0; i < NELEM(stats->ival_hist); i++) {
+        histogram_deinit(&stats->ival_hist[i]);
+    }
+}
+
+void
+stats_interval_add(struct stats *stats, double rsp_time)
+{
+    struct histogram *h = &stats->ival_hist[stats->ival_tail %
+                                            STATS_IVAL_NRING];
+
+    if (h->count == NULL) {
+        return;
+    }
+
+    histogram_record(h, (uint64_t)MAX(llrint(rsp_time / HIST_UNIT), 0));
+}
+
+/*
+ * End report interval idx of a worker: publish the counters and the
+ * histogram of the interval, and start recording into the next slot of the
+ * ring. Return false if the ring is full of intervals yet to be merged; the
+ * interval then carries on in its slot and is published along with the
+ * next one.
+ */
+bool
+stats_interval_rotate(struct stats *stats, uint32_t idx)
+{
+    struct stats_interval *last = &stats->ival_last;
+    struct stats_interval *ival;
+    uint32_t head, tail, nerror;
+    double bytes;
+
+    head = __atomic_load_n(&stats->ival_head, __ATOMIC_ACQUIRE);
+    tail = stats->ival_tail;
+    if (tail + 1 - head >= STATS_IVAL_NRING) {
+        return false;
+    }
+    ival = &stats->ival_ring[tail % STATS_IVAL_NRING];
+
+    nerror = stats_nerror(stats);
+    bytes = stats->req_bytes_sent + stats->rsp_bytes_rcvd;
+
+    ival->idx = idx;
+    ival->nreq = stats->nreq - last->nreq;
+    ival->nrsp = stats->nrsp - last->nrsp;
+    ival->nerror = nerror - last->nerror;
+    ival->bytes = bytes - last->bytes;
+
+    last->nreq = stats->nreq;
+    last->nrsp = stats->nrsp;
+    last->nerror = nerror;
+    last->bytes = bytes;
+
+    histogram_reset(&stats->ival_hist[(tail + 1) % STATS_IVAL_NRING]);
+    __atomic_store_n(&stats->ival_tail, tail + 1, __ATOMIC_RELEASE);
+
+    return true;
+}
+
+void
+stats_interval_reset(struct stats *stats)
+{
+    stats_interval_zero(&stats->ival);
+    stats->ival.hist = &stats->ival_hist[0];
+    histogram_reset(stats->ival.hist);
+}
+
+/*
+ * Fold report interval idx of the worker stats src into dst, and hand its
+ * slot back to the worker. A worker that folded idx into a later interval
+ * has nothing to merge for it.
+ */
+void
+stats_interval_merge(struct stats *dst, struct stats *src, uint32_t idx)
+{
+    struct stats_interval *ival;
+    uint32_t head, tail;
+
+    head = src->ival_head;
+    tail = __atomic_load_n(&src->ival_tail, __ATOMIC_ACQUIRE);
+    if (head == tail) {
+        return;
+    }
+
+    ival = &src->ival_ring[head % STATS_IVAL_NRING];
+    if (ival->idx != idx) {
+        return;
+    }
+
+    dst->ival.nreq += ival->nreq;
+    dst->ival.nrsp += ival->nrsp;
+    dst->ival.nerror += ival->nerror;
+    dst->ival.bytes += ival->bytes;
+    histogram_merge(dst->ival.hist, ival->hist);
+
+    __atomic_store_n(&src->ival_head, head + 1, __ATOMIC_RELEASE);
+}
+
+/* DBL_MAX stands for the min of an empty series */
+static double
+stats_min(double min)
+{
+    return min == DBL_MAX ? 0.0 : min;
+}
+
+static void
+stats_output_time(struct output *o, char *name, struct stats_time *st)
+{
+    uint64_t n = st->hist.total;
+
+    output_begin(o, name);
+    output_uint(o, "n", n);
+    output_double(o, "sum", st->sum);
+    output_double(o, "sum2", st->sum2);
+    output_double(o, "min", stats_min(st->min));
+    output_double(o, "max", st->max);
+    output_double(o, "avg", n != 0 ? st->sum / (double)n : 0.0);
+    output_double(o, "stddev", STDDEV(st->sum, st->sum2, (double)n));
+    output_double(o, "p25", stats_time_quantile(st, 0.25));
+    output_double(o, "p50", stats_time_quantile(st, 0.50));
+    output_double(o, "p75", stats_time_quantile(st, 0.75));
+    output_double(o, "p95", stats_time_quantile(st, 0.95));
+    output_double(o, "p99", stats_time_quantile(st, 0.99));
+    output_double(o, "p999", stats_time_quantile(st, 0.999));
+    output_double(o, "hist_unit", HIST_UNIT);
+    output_histogram(o, "hist", &st->hist);
+    output_end(o);
+}
+
+static void
+stats_output_dist(struct output *o, char *name, struct dist_opt *dopt)
+{
+    output_begin(o, name);
+    output_string(o, "type", dist_name(dopt->type));
+    output_double(o, "min", dopt->min);
+    output_double(o, "max", dopt->max);
+    output_end(o);
+}
+
+/* run configuration */
+static void
+stats_output_opt(struct output *o, struct opt *opt)
+{
+    uint32_t i;
+
+    output_begin(o, "opt");
+    output_string(o, "server", opt->server);
+    output_uint(o, "port", opt->port);
+    output_string(o, "distribution", server_dist_name(opt->server_dist));
+    output_double(o, "timeout", opt->timeout);
+    output_double(o, "report_interval", opt->report_interval);
+    output_double(o, "duration", opt->duration);
+    output_double(o, "warmup", opt->warmup);
+    output_uint(o, "linger", opt->linger);
+    output_uint(o, "linger_timeout",
+                (uint64_t)(opt->linger ? opt->linger_timeout : 0));
+    output_uint(o, "send_buf_size", (uint64_t)opt->send_buf_size);
+    output_uint(o, "recv_buf_size", (uint64_t)opt->recv_buf_size);
+    output_uint(o, "disable_nodelay", opt->disable_nodelay);
+    output_string(o, "engine", event_engine_name(opt->engine));
+    output_uint(o, "hires_pacing", opt->hires_pacing);
+    output_string(o, "method", req_type_names[opt->method]);
+    output_begin(o, "method_mix");
+    for (i = 0; i < REQ_MAX_TYPES; i++) {
+        if (opt->method_weight[i] > 0.0) {
+            output_double(o, req_type_names[i], opt->method_weight[i]);
+        }
+    }
+    output_end(o);
+    output_string(o, "protocol", protocol_name(opt->protocol));
+    output_uint(o, "expiry", opt->expiry);
+    output_uint(o, "use_noreply", opt->use_noreply);
+    output_string(o, "prefix", opt->prefix.data);
+    output_uint(o, "num_keys", opt->key_opt.nkey);
+    output_begin(o, "key_dist");
+    output_string(o, "type", key_dist_name(opt->key_opt.type));
+    output_double(o, "theta", opt->key_opt.theta);
+    output_double(o, "hot_keys", opt->key_opt.hot_keys);
+    output_double(o, "hot_ops", opt->key_opt.hot_ops);
+    output_end(o);
+    if (opt->replay_filename != NULL) {
+        output_string(o, "replay", opt->replay_filename);
+        output_double(o, "replay_speed", opt->replay_speed);
+    }
+    if (opt->record_filename != NULL) {
+        output_string(o, "record", opt->record_filename);
+        output_double(o, "record_sample", opt->record_sample);
+    }
+    output_uint(o, "client_id", opt->client.id);
+    output_uint(o, "client_n", opt->client.n);
+    output_uint(o, "num_threads", opt->num_threads);
+    output_uint(o, "num_conns", opt->num_conns);
+    output_uint(o, "num_calls", opt->num_calls);
+    output_uint(o, "pipeline", opt->pipeline);
+    stats_output_dist(o, "conn_rate", &opt->conn_dopt);
+    stats_output_dist(o, "call_rate", &opt->call_dopt);
+    stats_output_dist(o, "sizes", &opt->size_dopt);
+    stats_output_dist(o, "multiget", &opt->mget_dopt);
+    output_uint(o, "print_histogram", opt->print_histogram);
+    output_uint(o, "print_rusage", opt->print_rusage);
+    output_uint(o, "hist_digits", opt->hist_digits);
+    output_string(o, "output_format", output_format_name(opt->output_format));
+    output_end(o);
+}
+
+static void
+stats_output_rusage(struct output *o, struct stats *stats)
+{
+    struct rusage *start = &stats->rusage_start;
+    struct rusage *stop = &stats->rusage_stop;
+
+    output_begin(o, "rusage");
+    output_double(o, "utime", TV_TO_SEC(&stop->ru_utime) -
+                  TV_TO_SEC(&start->ru_utime));
+    output_double(o, "stime", TV_TO_SEC(&stop->ru_stime) -
+                  TV_TO_SEC(&start->ru_stime));
+    output_double(o, "maxrss", (double)(stop->ru_maxrss - start->ru_maxrss));
+    output_double(o, "ixrss", (double)(stop->ru_ixrss - start->ru_ixrss));
+    output_double(o, "idrss", (double)(stop->ru_idrss - start->ru_idrss));
+    output_double(o, "isrss", (double)(stop->ru_isrss - start->ru_isrss));
+    output_double(o, "minflt", (double)(stop->ru_minflt - start->ru_minflt));
+    output_double(o, "majflt", (double)(stop->ru_majflt - start->ru_majflt));
+    output_double(o, "nswap", (double)(stop->ru_nswap - start->ru_nswap));
+    output_double(o, "inblock", (double)(stop->ru_inblock - start->ru_inblock));
+    output_double(o, "oublock", (double)(stop->ru_oublock - start->ru_oublock));
+    output_double(o, "msgsnd", (double)(stop->ru_msgsnd - start->ru_msgsnd));
+    output_double(o, "msgrcv", (double)(stop->ru_msgrcv - start->ru_msgrcv));
+    output_double(o, "nsignals",
+                  (double)(stop->ru_nsignals - start->ru_nsignals));
+    output_double(o, "nvcsw", (double)(stop->ru_nvcsw - start->ru_nvcsw));
+    output_double(o, "nivcsw", (double)(stop->ru_nivcsw - start->ru_nivcsw));
+    output_end(o);
+}
+
+static void
+stats_output_method(struct output *o, struct context *ctx)
+{
+    struct stats_method *sm;
+    uint32_t i;
+
+    if (ctx->opt.nmethod <= 1) {
+        return;
+    }
+
+    output_begin(o, "method");
+    for (i = 0; i < REQ_MAX_TYPES; i++) {
+        if (ctx->opt.method_weight[i] == 0.0) {
+            continue;
+        }
+        sm = &ctx->stats.method[i];
+
+        output_begin(o, req_type_names[i]);
+        output_uint(o, "nreq", sm->nreq);
+        output_uint(o, "nrsp", sm->nrsp);
+        stats_output_time(o, "req_rsp", &sm->req_rsp);
+        stats_output_time(o, "int_rsp", &sm->int_rsp);
+        output_end(o);
+    }
+    output_end(o);
+}
+
+static void
+stats_output_server(struct output *o, struct context *ctx)
+{
+    struct stats *stats = &ctx->stats;
+    struct stats_server *ss;
+    uint32_t i;
+
+    if (stats->nserver == 0) {
+        return;
+    }
+
+    output_begin(o, "server");
+    for (i = 0; i < stats->nserver; i++) {
+        ss = &stats->server[i];
+
+        output_begin(o, ctx->opt.pool.server[i].name);
+        output_uint(o, "nreq", ss->nreq);
+        output_uint(o, "nrsp", ss->nrsp);
+        output_uint(o, "nerror", ss->nerror);
+        stats_output_time(o, "req_rsp", &ss->req_rsp);
+        stats_output_time(o, "int_rsp", &ss->int_rsp);
+        output_end(o);
+    }
+    output_end(o);
+}
+
+static void
+stats_output_interval_summary(struct output *o, struct context *ctx)
+{
+    struct stats_interval_summary *sum = &ctx->stats.ival_sum;
+
+    output_begin(o, "interval");
+    output_uint(o, "n", sum->n);
+    output_uint(o, "nerror_ival", sum->nerror_ival);
+    output_double(o, "rate_sum", sum->rate_sum);
+    output_double(o, "rate_min", stats_min(sum->rate_min));
+    output_double(o, "rate_max", sum->rate_max);
+    output_uint(o, "rate_min_idx", sum->rate_min_idx);
+    output_double(o, "p99_sum", sum->p99_sum);
+    output_double(o, "p99_min", stats_min(sum->p99_min));
+    output_double(o, "p99_max", sum->p99_max);
+    output_uint(o, "p99_max_idx", sum->p99_max_idx);
+    output_end(o);
+}
+
+/*
+ * Write every field of the stats, the run configuration and the resource
+ * usage as a summary record. Sums, sums of squares and histograms are
+ * written raw, so that the records of many mcperf instances can be merged
+ * exactly.
+ */
+static void
+stats_output(struct context *ctx)
+{
+    struct stats *stats = &ctx->stats;
+    struct output *o = &stats->output;
+    uint32_t i;
+
+    output_begin_record(o, "summary", ctx->opt.client.id);
+
+    output_double(o, "start_time", stats->start_time);
+    output_double(o, "stop_time", stats->stop_time);
+    output_double(o, "duration", stats->stop_time - stats->start_time);
+
+    stats_output_opt(o, &ctx->opt);
+
+    output_begin(o, "stats");
+
+    output_uint(o, "nconn_created", stats->nconn_created);
+    output_uint(o, "nconn_destroyed", stats->nconn_destroyed);
+    output_uint(o, "nconn_active", stats->nconn_active);
+    output_uint(o, "nconn_active_max", stats->nconn_active_max);
+
+    output_uint(o, "nconnect_issued", stats->nconnect_issued);
+    output_uint(o, "nconnect", stats->nconnect);
+    stats_output_time(o, "connect", &stats->connect);
+    output_double(o, "connection_sum", stats->connection_sum);
+    output_double(o, "connection_sum2", stats->connection_sum2);
+    output_double(o, "connection_min", stats_min(stats->connection_min));
+    output_double(o, "connection_max", stats->connection_max);
+
+    output_uint(o, "nclient_timeout", stats->nclient_timeout);
+    output_uint(o, "nsock_fdunavail", stats->nsock_fdunavail);
+    output_uint(o, "nsock_ftabfull", stats->nsock_ftabfull);
+    output_uint(o, "nsock_addrunavail", stats->nsock_addrunavail);
+    output_uint(o, "nsock_refused", stats->nsock_refused);
+    output_uint(o, "nsock_reset", stats->nsock_reset);
+    output_uint(o, "nsock_timedout", stats->nsock_timedout);
+    output_uint(o, "nsock_other_error", stats->nsock_other_error);
+    output_uint(o, "nerror", stats_nerror(stats));
+
+    output_uint(o, "nreq", stats->nreq);
+    output_double(o, "req_bytes_sent", stats->req_bytes_sent);
+    output_double(o, "req_bytes_sent2", stats->req_bytes_sent2);
+    output_double(o, "req_bytes_sent_min", stats_min(stats->req_bytes_sent_min));
+    output_double(o, "req_bytes_sent_max", stats->req_bytes_sent_max);
+    stats_output_time(o, "req_xfer", &stats->req_xfer);
+
+    output_uint(o, "npace", stats->npace);
+    output_double(o, "pace_sum", stats->pace_sum);
+    output_double(o, "pace_sum2", stats->pace_sum2);
+    output_double(o, "pace_min", stats_min(stats->pace_min));
+    output_double(o, "pace_max", stats->pace_max);
+
+    stats_output_time(o, "req_rsp", &stats->req_rsp);
+    stats_output_time(o, "int_rsp", &stats->int_rsp);
+
+    output_uint(o, "nrsp", stats->nrsp);
+    output_double(o, "rsp_bytes_rcvd", stats->rsp_bytes_rcvd);
+    output_double(o, "rsp_bytes_rcvd2", stats->rsp_bytes_rcvd2);
+    output_double(o, "rsp_bytes_rcvd_min", stats_min(stats->rsp_bytes_rcvd_min));
+    output_double(o, "rsp_bytes_rcvd_max", stats->rsp_bytes_rcvd_max);
+    stats_output_time(o, "rsp_xfer", &stats->rsp_xfer);
+
+    output_begin(o, "rsp_type");
+    for (i = 0; i < RSP_MAX_TYPES; i++) {
+        output_uint(o, rsp_type_names[i], stats->rsp_type[i]);
+    }
+    output_end(o);
+
+    output_uint(o, "nget", stats->nget);
+    output_uint(o, "nget_key", stats->nget_key);
+    output_uint(o, "nget_hit", stats->nget_hit);
+    output_double(o, "get_value_bytes", stats->get_value_bytes);
+
+    stats_output_method(o, ctx);
+    stats_output_server(o, ctx);
+
+    output_uint(o, "nsys_wait", stats->nsys_wait);
+    output_uint(o, "nsys_ctl", stats->nsys_ctl);
+    output_uint(o, "nsys_send", stats->nsys_send);
+    output_uint(o, "nsys_recv", stats->nsys_recv);
+    output_uint(o, "nio_send", stats->nio_send);
+    output_uint(o, "nio_recv", stats->nio_recv);
+
+    output_end(o);
+
+    stats_output_interval_summary(o, ctx);
+    stats_output_rusage(o, stats);
+
+    output_end(o);
+}
+
+/* Write the stats of report interval idx as an interval record */
+static void
+stats_interval_output(struct context *ctx, uint32_t idx)
+{
+    struct stats *stats = &ctx->stats;
+    struct stats_interval *ival = &stats->ival;
+    struct output *o = &stats->output;
+
+    output_begin_record(o, "interval", idx);
+    output_double(o, "time", idx * ctx->opt.report_interval);
+    output_double(o, "duration", ctx->opt.report_interval);
+    output_uint(o, "nreq", ival->nreq);
+    output_uint(o, "nrsp", ival->nrsp);
+    output_uint(o, "nerror", ival->nerror);
+    output_double(o, "bytes", ival->bytes);
+    output_double(o, "rsp_p50", HIST_UNIT *
+                  (double)histogram_percentile(ival->hist, 0.50));
+    output_double(o, "rsp_p99", HIST_UNIT *
+                  (double)histogram_percentile(ival->hist, 0.99));
+    output_double(o, "rsp_p999", HIST_UNIT *
+                  (double)histogram_percentile(ival->hist, 0.999));
+    output_double(o, "rsp_max", HIST_UNIT * (double)ival->hist->max);
+    output_double(o, "hist_unit", HIST_UNIT);
+    output_histogram(o, "rsp_hist", ival->hist);
+    output_end(o);
+}
+
+/*
+ * Print a line with the rates, errors and response time percentiles of
+ * the report interval idx, and fold it into the summary of all intervals.
+ */
+void
+stats_interval_dump(struct context *ctx, uint32_t idx)
+{
+    struct stats *stats = &ctx->stats;
+    struct stats_interval *ival = &stats->ival;
+    struct stats_interval_summary *sum = &stats->ival_sum;
+    double delta = ctx->opt.report_interval;
+    double rsp_rate, p50, p99, p999, max;
+
+    rsp_rate = ival->nrsp / delta;
+    p50 = HIST_UNIT * (double)histogram_percentile(ival->hist, 0.50);
+    p99 = HIST_UNIT * (double)histogram_percentile(ival->hist, 0.99);
+    p999 = HIST_UNIT * (double)histogram_percentile(ival->hist, 0.999);
+    max = HIST_UNIT * (double)ival->hist->max;
+
+    if (ctx->opt.output_format != OUTPUT_FORMAT_HUMAN) {
+        stats_interval_output(ctx, idx);
+    } else {
+            log_stderr("Interval %"PRIu32" [%.3f s]: req %.1f/s rsp %.1f/s errors "
+                   "%"PRIu32" net-io %.1f KB/s rsp-time [ms] p50 %.3f p99 "
+                   "%.3f p999 %.3f max %.3f", idx, idx * delta,
+                   ival->nreq / delta, rsp_rate, ival->nerror,
+                   ival->bytes / delta / 1024.0, 1e3 * p50, 1e3 * p99,
+                   1e3 * p999, 1e3 * max);
+    }
+
+    /* the intervals of the warmup are left out of the summary */
+    if (idx * delta <= ctx->opt.warmup) {
+        return;
+    }
+
+    sum->n++;
+    sum->rate_sum += rsp_rate;
+    if (rsp_rate < sum->rate_min) {
+        sum->rate_min = rsp_rate;
+        sum->rate_min_idx = idx;
+    }
+    sum->rate_max = MAX(sum->rate_max, rsp_rate);
+    sum->p99_sum += p99;
+    sum->p99_min = MIN(sum->p99_min, p99);
+    if (p99 >= sum->p99_max) {
+        sum->p99_max = p99;
+        sum->p99_max_idx = idx;
+    }
+    if (ival->nerror != 0) {
+        sum->nerror_ival++;
+    }
+}
+
+static void
+stats_method_print(struct context *ctx)
+{
+    struct opt *opt = &ctx->opt;
+    struct stats *stats = &ctx->stats;
+    struct stats_method *sm;
+    char name[64];
+    uint32_t i;
+
+    for (i = 0; i < REQ_MAX_TYPES; i++) {
+        if (opt->method_weight[i] == 0.0) {
+            continue;
+        }
+        sm = &stats->method[i];
+
+        log_stderr("");
+        log_stderr("Method %s: requests %"PRIu32" (%.1f%%) responses %"PRIu32
+                   "", req_type_names[i], sm->nreq,
+                   stats->nreq != 0 ? 100.0 * sm->nreq / stats->nreq : 0.0,
+                   sm->nrsp);
+
+        mcp_snprintf(name, sizeof(name), "Method %s response time",
+                     req_type_names[i]);
+        stats_time_print(ctx, name, &sm->req_rsp);
+
+        mcp_snprintf(name, sizeof(name), "Method %s response time from "
+                     "intended start", req_type_names[i]);
+        stats_time_print(ctx, name, &sm->int_rsp);
+    }
+}
+
+static int
+stats_double_cmp(const void *t1, const void *t2)
+{
+    const double *d1 = t1, *d2 = t2;
+
+    if (*d1 == *d2) {
+        return 0;
+    }
+
+    return (*d1 > *d2) ? 1 : -1;
+}
+
+/*
+ * Print the requests, errors and response time of every server of a pool,
+ * and the server of the highest p99 response time against the median p99
+ * of the servers.
+ */
+static void
+stats_server_print(struct context *ctx)
+{
+    struct stats *stats = &ctx->stats;
+    struct stats_server *ss;
+    char *sname;
+    char name[SERVER_NAME_LEN + 32];
+    double p99, p99_max, p99_median, *p99s;
+    uint32_t i, n, imax;
+
+    p99s = mcp_alloc(stats->nserver * sizeof(*p99s));
+
+    p99_max = 0.0;
+    imax = 0;
+    for (i = 0, n = 0; i < stats->nserver; i++) {
+        ss = &stats->server[i];
+        sname = ctx->opt.pool.server[i].name;
+
+        log_stderr("");
+        log_stderr("Server %s: requests %"PRIu32" (%.1f%%) responses %"PRIu32
+                   " errors %"PRIu32"", sname, ss->nreq,
+                   stats->nreq != 0 ? 100.0 * ss->nreq / stats->nreq : 0.0,
+                   ss->nrsp, ss->nerror);
+
+        mcp_snprintf(name, sizeof(name), "Server %s response time", sname);
+        stats_time_print(ctx, name, &ss->req_rsp);
+
+        if (p99s == NULL || ss->req_rsp.hist.total == 0) {
+            continue;
+        }
+
+        p99 = stats_time_quantile(&ss->req_rsp, 0.99);
+        p99s[n++] = p99;
+        if (p99 >= p99_max) {
+            p99_max = p99;
+            imax = i;
+        }
+    }
+
+    if (n >= 2) {
+        qsort(p99s, n, sizeof(*p99s), stats_double_cmp);
+        p99_median = n % 2 != 0 ? p99s[n / 2] :
+                     (p99s[n / 2 - 1] + p99s[n / 2]) / 2.0;
+
+        log_stderr("");
+        if (p99_median > 0.0) {
+            log_stderr("Server p99 response time [ms]: median %.3f slowest "
+                       "%.3f (%s, %.1fx the median)", 1e3 * p99_median,
+                       1e3 * p99_max, ctx->opt.pool.server[imax].name,
+                       p99_max / p99_median);
+        } else {
+            log_stderr("Server p99 response time [ms]: median %.3f slowest "
+                       "%.3f (%s)", 1e3 * p99_median, 1e3 * p99_max,
+                       ctx->opt.pool.server[imax].name);
+        }
+    }
+
+    if (p99s != NULL) {
+        mcp_free(p99s);
+    }
+}
+
+static void
+stats_interval_summary_print(struct context *ctx)
+{
+    struct stats_interval_summary *sum = &ctx->stats.ival_sum;
+
+    log_stderr("Intervals: %"PRIu32" of %.3f s, %"PRIu32" with errors",
+               sum->n, ctx->opt.report_interval, sum->nerror_ival);
+
+    log_stderr("Interval response rate [rsp/s]: avg %.1f min %.1f (interval "
+               "%"PRIu32") max %.1f", sum->rate_sum / sum->n, sum->rate_min,
+               sum->rate_min_idx, sum->rate_max);
+
+    log_stderr("Interval response time p99 [ms]: avg %.3f min %.3f max %.3f "
+               "(interval %"PRIu32")", 1e3 * sum->p99_sum / sum->n,
+               1e3 * sum->p99_min, 1e3 * sum->p99_max, sum->p99_max_idx);
 }
 
 void
@@ -233,6 +1279,28 @@ stats_start(struct context *ctx)
     stats->start_time = timer_now();
 }
 
+/*
+ * Account a connection of a worker that became active or inactive. The
+ * peak is the number of connections active over all the workers, so that
+ * the largest peak of the workers is the peak of the whole process.
+ */
+void
+stats_conn_active(struct stats *stats, bool active)
+{
+    uint32_t n;
+
+    if (!active) {
+        ASSERT(stats->nconn_active > 0);
+        stats->nconn_active--;
+        __atomic_sub_fetch(&nconn_active_all, 1, __ATOMIC_RELAXED);
+        return;
+    }
+
+    stats->nconn_active++;
+    n = __atomic_add_fetch(&nconn_active_all, 1, __ATOMIC_RELAXED);
+    stats->nconn_active_max = MAX(n, stats->nconn_active_max);
+}
+
 void
 stats_stop(struct context *ctx)
 {
@@ -242,32 +1310,134 @@ stats_stop(struct context *ctx)
     stats->stop_time = timer_now();
 }
 
+/*
+ * Fold the statistics in src into dst. The resource usage and the test
+ * start and stop times are owned by the context that dumps the stats and
+ * are not merged.
+ */
 void
-stats_dump(struct context *ctx)
+stats_merge(struct stats *dst, struct stats *src)
+{
+    uint32_t i;
+
+    dst->nconn_created += src->nconn_created;
+    dst->nconn_destroyed += src->nconn_destroyed;
+
+    /*
+     * Separate clients reach their peak concurrency independently of each
+     * other, so the sum of the peaks is an upper bound on the overall
+     * peak. The workers of a process already share theirs, and core_run
+     * keeps the largest one instead.
+     */
+    dst->nconn_active += src->nconn_active;
+    dst->nconn_active_max += src->nconn_active_max;
+
+    dst->nconnect_issued += src->nconnect_issued;
+    dst->nconnect += src->nconnect;
+    stats_time_merge(&dst->connect, &src->connect);
+    dst->connection_sum += src->connection_sum;
+    dst->connection_sum2 += src->connection_sum2;
+    dst->connection_min = MIN(dst->connection_min, src->connection_min);
+    dst->connection_max = MAX(dst->connection_max, src->connection_max);
+
+    dst->nclient_timeout += src->nclient_timeout;
+    dst->nsock_fdunavail += src->nsock_fdunavail;
+    dst->nsock_ftabfull += src->nsock_ftabfull;
+    dst->nsock_addrunavail += src->nsock_addrunavail;
+    dst->nsock_refused += src->nsock_refused;
+    dst->nsock_reset += src->nsock_reset;
+    dst->nsock_timedout += src->nsock_timedout;
+    dst->nsock_other_error += src->nsock_other_error;
+
+    dst->nreq += src->nreq;
+    dst->req_bytes_sent += src->req_bytes_sent;
+    dst->req_bytes_sent2 += src->req_bytes_sent2;
+    dst->req_bytes_sent_min = MIN(dst->req_bytes_sent_min,
+                                  src->req_bytes_sent_min);
+    dst->req_bytes_sent_max = MAX(dst->req_bytes_sent_max,
+                                  src->req_bytes_sent_max);
+
+    stats_time_merge(&dst->req_xfer, &src->req_xfer);
+
+    dst->npace += src->npace;
+    dst->pace_sum += src->pace_sum;
+    dst->pace_sum2 += src->pace_sum2;
+    dst->pace_min = MIN(dst->pace_min, src->pace_min);
+    dst->pace_max = MAX(dst->pace_max, src->pace_max);
+
+    stats_time_merge(&dst->req_rsp, &src->req_rsp);
+    stats_time_merge(&dst->int_rsp, &src->int_rsp);
+
+    dst->nrsp += src->nrsp;
+    dst->rsp_bytes_rcvd += src->rsp_bytes_rcvd;
+    dst->rsp_bytes_rcvd2 += src->rsp_bytes_rcvd2;
+    dst->rsp_bytes_rcvd_min = MIN(dst->rsp_bytes_rcvd_min,
+                                  src->rsp_bytes_rcvd_min);
+    dst->rsp_bytes_rcvd_max = MAX(dst->rsp_bytes_rcvd_max,
+                                  src->rsp_bytes_rcvd_max);
+
+    stats_time_merge(&dst->rsp_xfer, &src->rsp_xfer);
+
+    for (i = 0; i < RSP_MAX_TYPES; i++) {
+        dst->rsp_type[i] += src->rsp_type[i];
+    }
+
+    dst->nget += src->nget;
+    dst->nget_key += src->nget_key;
+    dst->nget_hit += src->nget_hit;
+    dst->get_value_bytes += src->get_value_bytes;
+
+    for (i = 0; i < REQ_MAX_TYPES; i++) {
+        dst->method[i].nreq += src->method[i].nreq;
+        dst->method[i].nrsp += src->method[i].nrsp;
+        if (src->method[i].req_rsp.hist.count != NULL) {
+            stats_time_merge(&dst->method[i].req_rsp, &src->method[i].req_rsp);
+            stats_time_merge(&dst->method[i].int_rsp, &src->method[i].int_rsp);
+        }
+    }
+
+    for (i = 0; i < MIN(dst->nserver, src->nserver); i++) {
+        dst->server[i].nreq += src->server[i].nreq;
+        dst->server[i].nrsp += src->server[i].nrsp;
+        dst->server[i].nerror += src->server[i].nerror;
+        stats_time_merge(&dst->server[i].req_rsp, &src->server[i].req_rsp);
+        stats_time_merge(&dst->server[i].int_rsp, &src->server[i].int_rsp);
+    }
+
+    dst->nsys_wait += src->nsys_wait;
+    dst->nsys_ctl += src->nsys_ctl;
+    dst->nsys_send += src->nsys_send;
+    dst->nsys_recv += src->nsys_recv;
+    dst->nio_send += src->nio_send;
+    dst->nio_recv += src->nio_recv;
+}
+
+/*
+ * Print the stats of a test that has stopped, in the output format of the
+ * test.
+ */
+void
+stats_print(struct context *ctx)
 {
-    struct opt *opt = &ctx->opt;
     struct stats *stats = &ctx->stats;
     double conn_period, conn_rate;
-    double conn_avg, conn_min, conn_max, conn_stddev;
     double connection_avg, connection_min, connection_max, connection_stddev;
     double req_rate, req_period;
     double req_size_avg, req_size_min, req_size_max, req_size_stddev;
+    double pace_avg, pace_stddev;
     double rsp_rate, rsp_period;
     double rsp_size_avg, rsp_size_min, rsp_size_max, rsp_size_stddev;
-    double req_rsp_avg, req_rsp_min, req_rsp_max, req_rsp_stddev;
-    double req_rsp_p25 = 0.0, req_rsp_p50 = 0.0, req_rsp_p75 = 0.0;
-    double req_rsp_p95 = 0.0, req_rsp_p99 = 0.0, req_rsp_p999 = 0.0;
     double total_size, total_rate;
     double delta;
-    double bin_time;
-    uint32_t i, nerror;
-    long int n;
-
-    /* stop stats collection */
-    stats_stop(ctx);
+    uint32_t nerror;
 
     ASSERT(stats->stop_time > stats->start_time);
 
+    if (ctx->opt.output_format != OUTPUT_FORMAT_HUMAN) {
+        stats_output(ctx);
+        return;
+    }
+
     delta = stats->stop_time - stats->start_time;
 
     /*
@@ -309,20 +1479,14 @@ stats_dump(struct context *ctx)
                    "%.2f", 1e3 * connection_avg, 1e3 * connection_min,
                    1e3 * connection_max, 1e3 * connection_stddev);
 
-        conn_avg = stats->connect_sum / stats->nconnect;
-        conn_min = stats->connect_min;
-        conn_max = stats->connect_max;
-        conn_stddev = STDDEV(stats->connect_sum, stats->connect_sum2,
-                             stats->nconnect);
-        log_stderr("Connect time [ms]: avg %.1f min %.1f max %.1f "
-                   "stddev %.2f", 1e3 * conn_avg, 1e3 * conn_min,
-                   1e3 * conn_max, 1e3 * conn_stddev);
+        stats_time_print(ctx, "Connect time", &stats->connect);
     }
 
     /*
      * Request section
      * 1. request rate - rate at which request were issued
      * 2. request size
+     * 3. request transfer time
      */
     if (stats->nreq != 0) {
         log_stderr("");
@@ -341,6 +1505,19 @@ stats_dump(struct context *ctx)
 
         log_stderr("Request size [B]: avg %.1f min %.1f max %.1f stddev %.2f",
                    req_size_avg, req_size_min, req_size_max, req_size_stddev);
+
+        stats_time_print(ctx, "Request transfer time", &stats->req_xfer);
+
+        /* how late requests were issued relative to the call rate */
+        if (stats->npace != 0) {
+            pace_avg = stats->pace_sum / stats->npace;
+            pace_stddev = STDDEV(stats->pace_sum, stats->pace_sum2,
+                                 stats->npace);
+
+            log_stderr("Request pacing error [us]: avg %.1f min %.1f max %.1f "
+                       "stddev %.2f", 1e6 * pace_avg, 1e6 * stats->pace_min,
+                       1e6 * stats->pace_max, 1e6 * pace_stddev);
+        }
     }
 
     /*
@@ -348,7 +1525,10 @@ stats_dump(struct context *ctx)
      * 1. response rate
      * 2. response size
      * 3. response time - how long it took for the server to respond
-     * 4. response types
+     * 4. response time from the time the request was scheduled to be issued
+     * 5. response transfer time
+     * 6. response types
+     * 7. keys and hits of retrieval requests
      */
     if (stats->nrsp != 0) {
         log_stderr("");
@@ -368,67 +1548,10 @@ stats_dump(struct context *ctx)
         log_stderr("Response size [B]: avg %.1f min %.1f max %.1f stddev %.2f",
                    rsp_size_avg, rsp_size_min, rsp_size_max, rsp_size_stddev);
 
-        req_rsp_avg = stats->req_rsp_sum / stats->nrsp;
-        req_rsp_min = stats->req_rsp_min;
-        req_rsp_max = stats->req_rsp_max;
-        req_rsp_stddev = STDDEV(stats->req_rsp_sum, stats->req_rsp_sum2,
-                                stats->nrsp);
-
-        log_stderr("Response time [ms]: avg %.1f min %.1f max %.1f stddev %.2f",
-                   1e3 * req_rsp_avg, 1e3 * req_rsp_min, 1e3 * req_rsp_max,
-                   req_rsp_stddev);
-
-        if (opt->print_histogram) {
-            log_stderr("Response time histogram [ms]:");
-
-            for (i = 0; i < HIST_NUM_BINS; i++) {
-                if (stats->req_rsp_hist[i] == 0) {
-                    continue;
-                }
-                if (i > 0 && stats->req_rsp_hist[i - 1] == 0) {
-                    log_stderr("%14c", ':');
-                }
-                bin_time = i * HIST_BIN_WIDTH;
-                log_stderr("%16.1f %u", 1e3 * bin_time, stats->req_rsp_hist[i]);
-            }
-            if (stats->req_rsp_hist[i - 1] == 0) {
-                log_stderr("%14c", ':');
-            }
-        }
-
-        for (i = 0, n = 0; i < HIST_NUM_BINS; i++) {
-            n += stats->req_rsp_hist[i];
-
-            if (req_rsp_p25 == 0.0 && n >= lrint(0.25 * stats->nrsp)) {
-                req_rsp_p25 = i * HIST_BIN_WIDTH;
-            }
-
-            if (req_rsp_p50 == 0.0 && n >= lrint(0.50 * stats->nrsp)) {
-                req_rsp_p50 = i * HIST_BIN_WIDTH;
-            }
-
-            if (req_rsp_p75 == 0.0 && n >= lrint(0.70 * stats->nrsp)) {
-                req_rsp_p75 = i * HIST_BIN_WIDTH;
-            }
-
-            if (req_rsp_p95 == 0.0 && n >= lrint(0.95 * stats->nrsp)) {
-                req_rsp_p95 = i * HIST_BIN_WIDTH;
-            }
-
-            if (req_rsp_p99 == 0.0 && n >= lrint(0.99 * stats->nrsp)) {
-                req_rsp_p99 = i * HIST_BIN_WIDTH;
-            }
-
-            if (req_rsp_p999 == 0.0 && n >= lrint(0.999 * stats->nrsp)) {
-                req_rsp_p999 = i * HIST_BIN_WIDTH;
-            }
-        }
-
-        log_stderr("Response time [ms]: p25 %.1f p50 %.1f p75 %.1f",
-                   1e3 * req_rsp_p25, 1e3 * req_rsp_p50, 1e3 * req_rsp_p75);
-
-        log_stderr("Response time [ms]: p95 %.1f p99 %.1f p999 %.1f",
-                   1e3 * req_rsp_p95, 1e3 * req_rsp_p99, 1e3 * req_rsp_p999);
+        stats_time_print(ctx, "Response time", &stats->req_rsp);
+        stats_time_print(ctx, "Response time from intended start",
+                         &stats->int_rsp);
+        stats_time_print(ctx, "Response transfer time", &stats->rsp_xfer);
 
         log_stderr("Response type: stored %"PRIu32" not_stored %"PRIu32" "
                    "exists %"PRIu32" not_found %"PRIu32"",
@@ -444,6 +1567,49 @@ stats_dump(struct context *ctx)
                    "server_error %"PRIu32"", stats->rsp_type[RSP_ERROR],
                    stats->rsp_type[RSP_CLIENT_ERROR],
                    stats->rsp_type[RSP_SERVER_ERROR]);
+
+        /* keys, hits and value bytes of get and gets, per request */
+        if (stats->nget != 0) {
+            log_stderr("Response keys: requests %"PRIu32" keys %"PRIu64" "
+                       "(%.1f/req) hits %"PRIu64" (%.1f%%) value-size [B] "
+                       "avg %.1f", stats->nget, stats->nget_key,
+                       (double)stats->nget_key / stats->nget, stats->nget_hit,
+                       stats->nget_key != 0 ?
+                       100.0 * (double)stats->nget_hit /
+                       (double)stats->nget_key : 0.0,
+                       stats->nget_hit != 0 ?
+                       stats->get_value_bytes / (double)stats->nget_hit : 0.0);
+        }
+    }
+
+    /*
+     * Method section, for a mix of methods
+     * 1. requests and responses of every method
+     * 2. response times of every method
+     */
+    if (ctx->opt.nmethod > 1) {
+        stats_method_print(ctx);
+    }
+
+    /*
+     * Server section, for a pool of servers
+     * 1. requests, responses and errors of every server
+     * 2. response times of every server
+     * 3. slowest server by p99 response time
+     */
+    if (stats->nserver != 0) {
+        stats_server_print(ctx);
+    }
+
+    /*
+     * Interval section
+     * 1. response rate of the slowest interval
+     * 2. p99 response time of the worst interval
+     */
+    if (stats->ival_sum.n != 0) {
+        log_stderr("");
+
+        stats_interval_summary_print(ctx);
     }
 
     /*
@@ -451,10 +1617,7 @@ stats_dump(struct context *ctx)
      */
     log_stderr("");
 
-    nerror = stats->nclient_timeout + stats->nsock_fdunavail +
-             stats->nsock_ftabfull + stats->nsock_addrunavail +
-             stats->nsock_refused + stats->nsock_reset +
-             stats->nsock_timedout + stats->nsock_other_error;
+    nerror = stats_nerror(stats);
 
     log_stderr("Errors: total %"PRIu32" client-timo %"PRIu32" "
                "socket-timo %"PRIu32" connrefused %"PRIu32" "
@@ -502,7 +1665,22 @@ stats_dump(struct context *ctx)
                    8e-6 * total_size / delta);
     }
 
+    stats_syscall_print(ctx);
+
     log_stderr("");
+}
+
+void
+stats_dump(struct context *ctx)
+{
+    char *filename = ctx->opt.result_filename;
+
+    /* stop stats collection */
+    stats_stop(ctx);
+
+    if (filename != NULL && result_write(ctx, filename) != MCP_OK) {
+        log_stderr("mcperf: write of result file '%s' failed", filename);
+    }
 
-    exit(0);
+    stats_print(ctx);
 }
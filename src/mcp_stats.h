@@ -21,9 +21,82 @@
 
 #include <sys/resource.h>
 
-#define HIST_MAX_TIME  100                     /* max time in sec (histogram resolution) */
-#define HIST_BIN_WIDTH 1e-3                    /* bin width in sec (granularity) */
-#define HIST_NUM_BINS  (HIST_MAX_TIME * 1000)  /* # bins */
+#define HIST_MAX_TIME  100                     /* max time in sec (histogram range) */
+#define HIST_UNIT      1e-6                    /* histogram unit in sec (resolution) */
+#define STATS_IVAL_NRING 4                     /* # intervals in the ring of a worker */
+
+/*
+ * Summary and histogram of a time series. Times are recorded in the
+ * histogram in usec, so that any time between 1 usec and HIST_MAX_TIME
+ * is reported to within the configured number of significant digits.
+ *
+ * The response time is measured from the request send start, and also from
+ * the time the request was scheduled to be issued, which accounts for the
+ * time the request waited behind a stalled connection or a late generator.
+ */
+struct stats_time {
+    double        sum;                         /* sum of time in sec */
+    double        sum2;                        /* sum of time squared in sec^2 */
+    double        min;                         /* min time in sec */
+    double        max;                         /* max time in sec */
+    struct histogram hist;                     /* histogram of time in usec */
+};
+
+/*
+ * Stats of a request type of a mix, which are only collected when the
+ * requests are a mix of more than one type.
+ */
+struct stats_method {
+    uint32_t      nreq;                        /* # request sent */
+    uint32_t      nrsp;                        /* # responses received */
+    struct stats_time req_rsp;                 /* request send to response time */
+    struct stats_time int_rsp;                 /* intended request issue to response time */
+};
+
+/*
+ * Stats of a server of a pool, which are only collected when there is
+ * more than one server, so that a slow server stands out rather than
+ * being averaged with the others. Errors are the connection failures and
+ * timeouts on the server.
+ */
+struct stats_server {
+    uint32_t      nreq;                        /* # request sent */
+    uint32_t      nrsp;                        /* # responses received */
+    uint32_t      nerror;                      /* # connection errors */
+    struct stats_time req_rsp;                 /* request send to response time */
+    struct stats_time int_rsp;                 /* intended request issue to response time */
+};
+
+/*
+ * Stats of a report interval. Every worker records the response times of
+ * the current interval into a slot of a small ring of intervals. At the
+ * end of the interval it fills in the counter deltas, publishes the slot
+ * and moves on to the next one, which the reporter frees once it merged
+ * the interval it held. The worker never waits for the reporter; with the
+ * ring full, it keeps the slot and folds the interval into the next one.
+ */
+struct stats_interval {
+    uint32_t      idx;                         /* last report interval covered */
+    uint32_t      nreq;                        /* # request sent */
+    uint32_t      nrsp;                        /* # responses received */
+    uint32_t      nerror;                      /* # errors */
+    double        bytes;                       /* bytes sent and received */
+    struct histogram *hist;                    /* histogram of response time in usec */
+};
+
+/* Summary of the report intervals over the whole test */
+struct stats_interval_summary {
+    uint32_t      n;                           /* # intervals reported */
+    double        rate_sum;                    /* sum of response rate in rsp/s */
+    double        rate_min;                    /* min response rate in rsp/s */
+    double        rate_max;                    /* max response rate in rsp/s */
+    uint32_t      rate_min_idx;                /* interval of min response rate */
+    double        p99_sum;                     /* sum of p99 response time in sec */
+    double        p99_min;                     /* min p99 response time in sec */
+    double        p99_max;                     /* max p99 response time in sec */
+    uint32_t      p99_max_idx;                 /* interval of max p99 response time */
+    uint32_t      nerror_ival;                 /* # intervals with errors */
+};
 
 struct stats {
     struct rusage rusage_start;                /* resource usage at start */
@@ -36,14 +109,11 @@ struct stats {
     uint32_t      nconn_destroyed;             /* # connection destroyed */
 
     uint32_t      nconn_active;                /* # connection active */
-    uint32_t      nconn_active_max;            /* max # connection active */
+    uint32_t      nconn_active_max;            /* max # connection active over all workers */
 
     uint32_t      nconnect_issued;             /* # connect issued */
     uint32_t      nconnect;                    /* # successful connect */
-    double        connect_sum;                 /* sum of connect time in sec */
-    double        connect_sum2;                /* sum of connect time squared in sec^2 */
-    double        connect_min;                 /* min connect time in sec */
-    double        connect_max;                 /* max connect time in sec */
+    struct stats_time connect;                 /* connect time */
     double        connection_sum;              /* sum of connection time in sec */
     double        connection_sum2;             /* sum of connection time squared in sec^2 */
     double        connection_min;              /* min connection time in sec */
@@ -64,16 +134,16 @@ struct stats {
     double        req_bytes_sent_min;          /* min request bytes sent */
     double        req_bytes_sent_max;          /* max request bytes sent */
 
-    double        req_xfer_sum;                /* sum of request transfer time in sec */
-    double        req_xfer_sum2;               /* sum of request transfer time squared in sec^2 */
-    double        req_xfer_min;                /* min request transfer time in sec */
-    double        req_xfer_max;                /* max request transfer time in sec */
+    struct stats_time req_xfer;                /* request transfer time */
 
-    double        req_rsp_sum;                 /* sum of request to response time in sec */
-    double        req_rsp_sum2;                /* sum of request to response time squared in sec^2 */
-    double        req_rsp_min;                 /* min request to response time in sec */
-    double        req_rsp_max;                 /* max request to response time in sec */
-    long int      req_rsp_hist[HIST_NUM_BINS]; /* histogram of request to response time */
+    uint32_t      npace;                       /* # request issued by a paced generator */
+    double        pace_sum;                    /* sum of pacing error in sec */
+    double        pace_sum2;                   /* sum of pacing error squared in sec^2 */
+    double        pace_min;                    /* min pacing error in sec */
+    double        pace_max;                    /* max pacing error in sec */
+
+    struct stats_time req_rsp;                 /* request send to response time */
+    struct stats_time int_rsp;                 /* intended request issue to response time */
 
     uint32_t      nrsp;                        /* # responses received */
     double        rsp_bytes_rcvd;              /* bytes received */
@@ -81,17 +151,56 @@ struct stats {
     double        rsp_bytes_rcvd_min;          /* min bytes received */
     double        rsp_bytes_rcvd_max;          /* max bytes received */
 
-    double        rsp_xfer_sum;                /* sum of response transfer sum */
-    double        rsp_xfer_sum2;               /* sum of response transfer sum squared */
-    double        rsp_xfer_min;                /* minimum response transfer time */
-    double        rsp_xfer_max;                /* maximum response transfer time */
+    struct stats_time rsp_xfer;                /* response transfer time */
 
     uint32_t      rsp_type[RSP_MAX_TYPES];     /* # response type */
+
+    uint32_t      nget;                        /* # get and gets responses */
+    uint64_t      nget_key;                    /* # keys requested by gets */
+    uint64_t      nget_hit;                    /* # values returned by gets */
+    double        get_value_bytes;             /* value bytes returned by gets */
+
+    struct stats_method method[REQ_MAX_TYPES]; /* stats of request type in the mix */
+    uint32_t      nserver;                     /* # server stats */
+    struct stats_server *server;               /* stats of every server of a pool */
+
+    uint64_t      nsys_wait;                   /* # event wait syscalls */
+    uint64_t      nsys_ctl;                    /* # event control syscalls */
+    uint64_t      nsys_send;                   /* # send syscalls */
+    uint64_t      nsys_recv;                   /* # recv syscalls */
+    uint64_t      nio_send;                    /* # send operations */
+    uint64_t      nio_recv;                    /* # recv operations */
+
+    uint32_t      ival_head;                   /* oldest published interval, merged next */
+    uint32_t      ival_tail;                   /* current interval, published next */
+    struct stats_interval ival_ring[STATS_IVAL_NRING]; /* ring of intervals */
+    struct histogram ival_hist[STATS_IVAL_NRING];      /* histograms of the ring */
+    struct stats_interval ival_last;           /* counters at the last interval end */
+    struct stats_interval ival;                /* interval merged over the workers */
+    struct stats_interval_summary ival_sum;    /* summary of all intervals */
+
+    struct output output;                      /* machine readable output */
 };
 
-void stats_init(struct context *ctx);
+extern char *req_type_names[];
+extern char *rsp_type_names[];
+
+rstatus_t stats_init(struct context *ctx);
+void stats_deinit(struct context *ctx);
 void stats_start(struct context *ctx);
 void stats_stop(struct context *ctx);
+void stats_conn_active(struct stats *stats, bool active);
+void stats_reset(struct context *ctx);
+void stats_merge(struct stats *dst, struct stats *src);
+void stats_print(struct context *ctx);
 void stats_dump(struct context *ctx);
 
+void stats_time_add(struct stats_time *st, double time);
+
+void stats_interval_add(struct stats *stats, double rsp_time);
+bool stats_interval_rotate(struct stats *stats, uint32_t idx);
+void stats_interval_reset(struct stats *stats);
+void stats_interval_merge(struct stats *dst, struct stats *src, uint32_t idx);
+void stats_interval_dump(struct context *ctx, uint32_t idx);
+
 #endif
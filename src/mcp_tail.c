@@ -0,0 +1,578 @@
+/*
+ *  twemperf - a tool for measuring memcached server performance.
+ *  Copyright (C) 2011 Twitter, Inc.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <getopt.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <mcp_core.h>
+
+/*
+ * mcperf-tail reads the record files that mcperf writes with -L, where
+ * every sampled call that completed has a record of its own, and
+ * recomputes the percentiles of the response times from the records
+ * rather than from histograms. It lists the slowest calls with their
+ * connection, key and timings, or exports every record as csv, so that
+ * the calls in the tail of a test can be told apart.
+ */
+
+#define TAIL_NSLOW      10          /* default # slowest calls to list */
+
+struct tail_file {
+    char                 *name;     /* record filename */
+    int                  fd;        /* record file descriptor */
+    void                 *addr;     /* mapping of the record file */
+    size_t               size;      /* record file size */
+    struct record_header *header;   /* header */
+    struct record_part   *part;     /* parts */
+    struct record_rec    *rec;      /* records */
+};
+
+struct tail_times {
+    uint32_t             *rsp;      /* send start to response times in usec */
+    uint32_t             *int_rsp;  /* intended start to response times in usec */
+    uint64_t             n;         /* # times */
+};
+
+static int show_help;
+static int show_version;
+static int export_csv;
+static uint32_t nslow = TAIL_NSLOW;
+
+static struct option long_options[] = {
+    { "help",               no_argument,        NULL,   'h' },
+    { "version",            no_argument,        NULL,   'V' },
+    { "csv",                no_argument,        NULL,   'c' },
+    { "slowest",            required_argument,  NULL,   'n' },
+    { NULL,                 0,                  NULL,    0  }
+};
+
+static char short_options[] = "hVcn:";
+
+static void
+tail_show_usage(void)
+{
+    log_stderr(
+        "Usage: mcperf-tail [-?hV] [-c] [-n slowest] file..." CRLF
+        "" CRLF
+        "Options:" CRLF
+        "  -h, --help            : this help" CRLF
+        "  -V, --version         : show version and exit" CRLF
+        "  -c, --csv             : write every record as a csv row on stdout instead of the summary" CRLF
+        "  -n, --slowest=N       : set the number of slowest calls to list (default: %d)" CRLF
+        "  file                  : record file written by mcperf -L",
+        TAIL_NSLOW
+        );
+}
+
+static rstatus_t
+tail_get_options(int argc, char **argv)
+{
+    int c, value;
+
+    opterr = 0;
+
+    for (;;) {
+        c = getopt_long(argc, argv, short_options, long_options, NULL);
+        if (c == -1) {
+            break;
+        }
+
+        switch (c) {
+        case 'h':
+            show_version = 1;
+            show_help = 1;
+            break;
+
+        case 'V':
+            show_version = 1;
+            break;
+
+        case 'c':
+            export_csv = 1;
+            break;
+
+        case 'n':
+            value = mcp_atoi(optarg);
+            if (value < 0) {
+                log_stderr("mcperf-tail: option -n requires a number");
+                return MCP_ERROR;
+            }
+            nslow = (uint32_t)value;
+            break;
+
+        case '?':
+            if (optopt == 'n') {
+                log_stderr("mcperf-tail: option -%c requires a number",
+                           optopt);
+            } else {
+                log_stderr("mcperf-tail: invalid option -- '%c'", optopt);
+            }
+            return MCP_ERROR;
+
+        default:
+            log_stderr("mcperf-tail: invalid option -- '%c'", optopt);
+            return MCP_ERROR;
+        }
+    }
+
+    return MCP_OK;
+}
+
+static void
+tail_close(struct tail_file *f)
+{
+    if (f->addr != MAP_FAILED) {
+        munmap(f->addr, f->size);
+        f->addr = MAP_FAILED;
+    }
+
+    if (f->fd >= 0) {
+        close(f->fd);
+        f->fd = -1;
+    }
+}
+
+/* Map the record file name read-only and check that it is whole */
+static rstatus_t
+tail_open(struct tail_file *f, char *name)
+{
+    struct record_header *header;
+    struct stat st;
+    uint64_t nrec;
+    uint32_t i;
+
+    f->name = name;
+    f->addr = MAP_FAILED;
+    f->size = 0;
+
+    f->fd = open(name, O_RDONLY);
+    if (f->fd < 0) {
+        log_stderr("mcperf-tail: open of '%s' failed: %s", name,
+                   strerror(errno));
+        return MCP_ERROR;
+    }
+
+    if (fstat(f->fd, &st) < 0) {
+        log_stderr("mcperf-tail: stat of '%s' failed: %s", name,
+                   strerror(errno));
+        goto error;
+    }
+
+    f->size = (size_t)st.st_size;
+    if (f->size < sizeof(*header)) {
+        log_stderr("mcperf-tail: '%s' is truncated", name);
+        goto error;
+    }
+
+    f->addr = mmap(NULL, f->size, PROT_READ, MAP_SHARED, f->fd, 0);
+    if (f->addr == MAP_FAILED) {
+        log_stderr("mcperf-tail: mmap of '%s' failed: %s", name,
+                   strerror(errno));
+        goto error;
+    }
+
+    header = f->addr;
+    if (header->magic != RECORD_MAGIC) {
+        log_stderr("mcperf-tail: '%s' is not a record file, or is of another "
+                   "byte order", name);
+        goto error;
+    }
+
+    if (header->version != RECORD_VERSION ||
+        header->size != sizeof(struct record_rec)) {
+        log_stderr("mcperf-tail: record file '%s' is of version %"PRIu32", "
+                   "expected %d", name, header->version, RECORD_VERSION);
+        goto error;
+    }
+
+    if (f->size < record_data_offset(header->npart) ||
+        f->size != record_data_offset(header->npart) +
+                   header->nrec * sizeof(struct record_rec)) {
+        log_stderr("mcperf-tail: record file '%s' has %"PRIu64" records in "
+                   "%zu bytes", name, header->nrec, f->size);
+        goto error;
+    }
+
+    f->header = header;
+    f->part = (struct record_part *)(header + 1);
+    f->rec = (struct record_rec *)((char *)f->addr +
+                                   record_data_offset(header->npart));
+
+    for (i = 0, nrec = 0; i < header->npart; i++) {
+        if (f->part[i].nrec != 0 && f->part[i].head >= f->part[i].nrec) {
+            break;
+        }
+        nrec += f->part[i].nrec;
+    }
+    if (i != header->npart || nrec != header->nrec) {
+        log_stderr("mcperf-tail: record file '%s' has corrupt parts", name);
+        goto error;
+    }
+
+    return MCP_OK;
+
+error:
+    tail_close(f);
+    return MCP_ERROR;
+}
+
+/*
+ * Call fn on every record of file f, oldest first within the part of
+ * every worker.
+ */
+static void
+tail_walk(struct tail_file *f, void (*fn)(struct record_rec *, void *),
+          void *arg)
+{
+    struct record_part *part;
+    struct record_rec *rec;
+    uint64_t i;
+    uint32_t p;
+
+    for (p = 0, rec = f->rec; p < f->header->npart; p++) {
+        part = &f->part[p];
+        for (i = 0; i < part->nrec; i++) {
+            fn(&rec[(part->head + i) % part->nrec], arg);
+        }
+        rec += part->nrec;
+    }
+}
+
+static void
+tail_csv_rec(struct record_rec *rec, void *arg)
+{
+    printf("%"PRIu64",%"PRIu32",%"PRIu32",%"PRIu32",%"PRIu32",%"PRIu32","
+           "%"PRIu32",%"PRIu32",%s,%"PRIu16",%s,%"PRIu32",%"PRIu32"\n",
+           rec->time, rec->issue, rec->send_start, rec->send_stop,
+           rec->recv_start, rec->recv_stop, rec->conn, rec->key,
+           rec->method < REQ_MAX_TYPES ? req_type_names[rec->method] : "-",
+           rec->nkey,
+           rec->type < RSP_MAX_TYPES ? rsp_type_names[rec->type] : "-",
+           rec->req_bytes, rec->rsp_bytes);
+}
+
+static uint32_t
+tail_rsp_time(struct record_rec *rec)
+{
+    return rec->recv_start > rec->send_start ?
+           rec->recv_start - rec->send_start : 0;
+}
+
+static void
+tail_count_rec(struct record_rec *rec, void *arg)
+{
+    struct tail_times *tt = arg;
+
+    tt[REQ_MAX_TYPES].n++;
+    if (rec->method < REQ_MAX_TYPES) {
+        tt[rec->method].n++;
+    }
+}
+
+static void
+tail_times_add(struct tail_times *t, struct record_rec *rec)
+{
+    t->rsp[t->n] = tail_rsp_time(rec);
+    t->int_rsp[t->n] = rec->recv_start;
+    t->n++;
+}
+
+/* the slowest calls, sorted from the slowest down */
+static struct record_rec *slow;
+static uint32_t nslow_found;
+
+static void
+tail_slow_add(struct record_rec *rec)
+{
+    uint32_t i, time = tail_rsp_time(rec);
+
+    if (nslow_found == nslow && (nslow == 0 ||
+                                 time <= tail_rsp_time(&slow[nslow - 1]))) {
+        return;
+    }
+
+    if (nslow_found < nslow) {
+        nslow_found++;
+    }
+
+    for (i = nslow_found - 1; i > 0 && tail_rsp_time(&slow[i - 1]) < time;
+         i--) {
+        slow[i] = slow[i - 1];
+    }
+    slow[i] = *rec;
+}
+
+static void
+tail_add_rec(struct record_rec *rec, void *arg)
+{
+    struct tail_times *tt = arg;
+
+    tail_times_add(&tt[REQ_MAX_TYPES], rec);
+    if (rec->method < REQ_MAX_TYPES) {
+        tail_times_add(&tt[rec->method], rec);
+    }
+
+    tail_slow_add(rec);
+}
+
+static int
+tail_cmp(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+
+    return (x > y) - (x < y);
+}
+
+/* Return the q-quantile of the n sorted times in ms, by the nearest rank */
+static double
+tail_quantile(uint32_t *time, uint64_t n, double q)
+{
+    uint64_t rank = (uint64_t)ceil(q * (double)n);
+
+    return time[rank > 0 ? rank - 1 : 0] / 1e3;
+}
+
+static void
+tail_times_print(char *name, uint32_t *time, uint64_t n)
+{
+    double sum = 0.0, sum2 = 0.0;
+    uint64_t i;
+
+    qsort(time, n, sizeof(*time), tail_cmp);
+
+    for (i = 0; i < n; i++) {
+        sum += time[i] / 1e3;
+        sum2 += SQUARE(time[i] / 1e3);
+    }
+
+    log_stderr("%s [ms]: avg %.3f min %.3f max %.3f stddev %.3f", name,
+               sum / (double)n, time[0] / 1e3, time[n - 1] / 1e3,
+               STDDEV(sum, sum2, (double)n));
+
+    log_stderr("%s [ms]: p25 %.3f p50 %.3f p75 %.3f", name,
+               tail_quantile(time, n, 0.25), tail_quantile(time, n, 0.50),
+               tail_quantile(time, n, 0.75));
+
+    log_stderr("%s [ms]: p95 %.3f p99 %.3f p999 %.3f", name,
+               tail_quantile(time, n, 0.95), tail_quantile(time, n, 0.99),
+               tail_quantile(time, n, 0.999));
+}
+
+static void
+tail_print(struct tail_file *file, int nfile, struct tail_times *tt)
+{
+    struct tail_times *all = &tt[REQ_MAX_TYPES];
+    struct record_header *header;
+    struct record_rec *rec;
+    uint64_t ncall = 0, nsampled = 0, nrec = 0;
+    uint32_t i, nmethod;
+    char name[64];
+    int f;
+
+    for (f = 0; f < nfile; f++) {
+        header = file[f].header;
+        ncall += header->ncall;
+        nsampled += header->nsampled;
+        nrec += header->nrec;
+    }
+
+    log_stderr("Records: %"PRIu64" of %"PRIu64" sampled calls of %"PRIu64
+               " completed calls in %d files (%"PRIu64" overwritten)", nrec,
+               nsampled, ncall, nfile, nsampled - nrec);
+
+    if (nrec == 0) {
+        return;
+    }
+
+    log_stderr("");
+    tail_times_print("Response time", all->rsp, all->n);
+    tail_times_print("Response time from intended start", all->int_rsp,
+                     all->n);
+
+    for (i = 0, nmethod = 0; i < REQ_MAX_TYPES; i++) {
+        if (tt[i].n != 0) {
+            nmethod++;
+        }
+    }
+
+    for (i = 0; i < REQ_MAX_TYPES && nmethod > 1; i++) {
+        if (tt[i].n == 0) {
+            continue;
+        }
+
+        log_stderr("");
+        log_stderr("Method %s: records %"PRIu64" (%.1f%%)", req_type_names[i],
+                   tt[i].n, 100.0 * (double)tt[i].n / (double)all->n);
+
+        mcp_snprintf(name, sizeof(name), "Method %s response time",
+                     req_type_names[i]);
+        tail_times_print(name, tt[i].rsp, tt[i].n);
+
+        mcp_snprintf(name, sizeof(name), "Method %s response time from "
+                     "intended start", req_type_names[i]);
+        tail_times_print(name, tt[i].int_rsp, tt[i].n);
+    }
+
+    if (nslow_found == 0) {
+        return;
+    }
+
+    log_stderr("");
+    log_stderr("Slowest calls [ms]:");
+    for (i = 0; i < nslow_found; i++) {
+        rec = &slow[i];
+        log_stderr("  at %.6f s rsp %.3f int %.3f send %.3f c %"PRIu32" key "
+                   "%"PRIu32" %s nkey %"PRIu16" %s bytes %"PRIu32"/%"PRIu32"",
+                   (double)rec->time / 1e6, tail_rsp_time(rec) / 1e3,
+                   rec->recv_start / 1e3,
+                   (rec->send_stop - rec->send_start) / 1e3, rec->conn,
+                   rec->key,
+                   rec->method < REQ_MAX_TYPES ?
+                   req_type_names[rec->method] : "-", rec->nkey,
+                   rec->type < RSP_MAX_TYPES ? rsp_type_names[rec->type] : "-",
+                   rec->req_bytes, rec->rsp_bytes);
+    }
+}
+
+static rstatus_t
+tail_summary(struct tail_file *file, int nfile)
+{
+    struct tail_times tt[REQ_MAX_TYPES + 1];
+    rstatus_t status = MCP_OK;
+    uint32_t i;
+    int f;
+
+    memset(tt, 0, sizeof(tt));
+
+    /* size the times of every method first, then fill them in */
+    for (f = 0; f < nfile; f++) {
+        tail_walk(&file[f], tail_count_rec, tt);
+    }
+
+    for (i = 0; i <= REQ_MAX_TYPES; i++) {
+        if (tt[i].n == 0) {
+            continue;
+        }
+        tt[i].rsp = mcp_alloc(tt[i].n * sizeof(uint32_t));
+        tt[i].int_rsp = mcp_alloc(tt[i].n * sizeof(uint32_t));
+        if (tt[i].rsp == NULL || tt[i].int_rsp == NULL) {
+            status = MCP_ENOMEM;
+        }
+        tt[i].n = 0;
+    }
+
+    if (nslow != 0) {
+        slow = mcp_alloc(nslow * sizeof(*slow));
+        if (slow == NULL) {
+            status = MCP_ENOMEM;
+        }
+    }
+
+    if (status == MCP_OK) {
+        for (f = 0; f < nfile; f++) {
+            tail_walk(&file[f], tail_add_rec, tt);
+        }
+        tail_print(file, nfile, tt);
+    }
+
+    for (i = 0; i <= REQ_MAX_TYPES; i++) {
+        if (tt[i].rsp != NULL) {
+            mcp_free(tt[i].rsp);
+        }
+        if (tt[i].int_rsp != NULL) {
+            mcp_free(tt[i].int_rsp);
+        }
+    }
+    if (slow != NULL) {
+        mcp_free(slow);
+    }
+
+    return status;
+}
+
+int
+main(int argc, char **argv)
+{
+    struct tail_file *file;
+    rstatus_t status;
+    int i, nfile;
+
+    status = tail_get_options(argc, argv);
+    if (status != MCP_OK) {
+        tail_show_usage();
+        exit(1);
+    }
+
+    if (show_version) {
+        log_stderr("This is mcperf-tail-%s" CRLF, MCP_VERSION_STRING);
+        if (show_help) {
+            tail_show_usage();
+        }
+        exit(0);
+    }
+
+    if (optind == argc) {
+        log_stderr("mcperf-tail: no record files to read");
+        tail_show_usage();
+        exit(1);
+    }
+
+    status = log_init(LOG_NOTICE, NULL);
+    if (status != MCP_OK) {
+        exit(1);
+    }
+
+    nfile = argc - optind;
+    file = mcp_calloc(nfile, sizeof(*file));
+    if (file == NULL) {
+        exit(1);
+    }
+
+    for (i = 0; i < nfile; i++) {
+        status = tail_open(&file[i], argv[optind + i]);
+        if (status != MCP_OK) {
+            exit(1);
+        }
+    }
+
+    if (export_csv) {
+        printf("time,issue,send_start,send_stop,recv_start,recv_stop,conn,"
+               "key,method,nkey,type,req_bytes,rsp_bytes\n");
+        for (i = 0; i < nfile; i++) {
+            tail_walk(&file[i], tail_csv_rec, NULL);
+        }
+        if (fflush(stdout) != 0) {
+            log_stderr("mcperf-tail: write of csv failed: %s",
+                       strerror(errno));
+            status = MCP_ERROR;
+        }
+    } else {
+        status = tail_summary(file, nfile);
+    }
+
+    for (i = 0; i < nfile; i++) {
+        tail_close(&file[i]);
+    }
+    mcp_free(file);
+
+    return status == MCP_OK ? 0 : 1;
+}
@@ -21,22 +21,35 @@
 #include <mcp_core.h>
 
 /*
- * Timer wheel with TIMER_WHEEL_SIZE spokes. Each spoke represents a time
- * unit which equals TIMER_INTERVAL.
+ * Hierarchical timer wheel. Each slot on level 0 represents a time unit
+ * which equals the tick interval, while a slot on level l holds the timers
+ * expiring in a span of TIMER_WHEEL_SIZE^l ticks. A timer is put on the
+ * lowest level whose span covers its delay, in the slot indexed by its
+ * absolute expiry tick, so that schedule and cancel are O(1).
  *
- * With a 1 msec timer granularity and a wheel with 4096 spokes, it takes
- * ~4.1 seconds for the cursor to cycle back in single round.
+ * Whenever the level l-1 cursor wraps around, the timers in the next slot
+ * of level l are cascaded down to lower levels. A timer is thus moved at
+ * most TIMER_WHEEL_LEVELS - 1 times before it expires from level 0.
+ *
+ * A timer further out than the wheel spans, such as the end of a long test
+ * with usec ticks, waits on an overflow list instead, and is linked into
+ * the wheel once the top level cursor wraps around close enough to it.
+ *
+ * Every worker thread owns a private timer wheel and clock.
  */
-static struct timerhdr wheel[TIMER_WHEEL_SIZE]; /* timer wheel */
-static uint32_t widx;                           /* current timer wheel idx */
+static __thread struct timerhdr wheel[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SIZE];
+static __thread struct timerhdr overflow;      /* timers beyond the wheel */
+static __thread uint64_t wtick;                /* current timer wheel tick */
+static __thread uint32_t ntimer;               /* # scheduled timers */
 
-static uint32_t nfree_timerq;                   /* # free timer q */
-static struct timerhdr free_timerq;             /* free timer q */
+static __thread uint32_t nfree_timerq;         /* # free timer q */
+static __thread struct timerhdr free_timerq;   /* free timer q */
 
-static double now;                              /* current time in sec */
-static double next_tick;                        /* next time to tick again in sec */
+static __thread double interval;               /* tick interval in sec */
+static __thread double now;                    /* current time in sec */
+static __thread double next_tick;              /* next time to tick again in sec */
 
-static uint64_t id;                             /* unique id */
+static __thread uint64_t id;                   /* unique id */
 
 static struct timer *
 timer_get(void)
@@ -56,7 +69,7 @@ timer_get(void)
         }
     }
     t->id = ++id;
-    t->delta = 0;
+    t->expire = 0;
     t->timeout = NULL;
     t->arg = NULL;
 
@@ -95,21 +108,26 @@ timer_now(void)
 }
 
 void
-timer_init(void)
+timer_init(double tick_interval)
 {
-    uint32_t i;
+    uint32_t i, j;
 
-    for (i = 0; i < TIMER_WHEEL_SIZE; i++) {
-        LIST_INIT(&wheel[i]);
+    for (i = 0; i < TIMER_WHEEL_LEVELS; i++) {
+        for (j = 0; j < TIMER_WHEEL_SIZE; j++) {
+            LIST_INIT(&wheel[i][j]);
+        }
     }
-    widx = 0;
+    LIST_INIT(&overflow);
+    wtick = 0;
+    ntimer = 0;
+    interval = tick_interval;
 
     nfree_timerq = 0;
     LIST_INIT(&free_timerq);
 
     timer_now_update();
 
-    next_tick = timer_now() + TIMER_INTERVAL;
+    next_tick = timer_now() + interval;
 }
 
 void
@@ -117,112 +135,246 @@ timer_deinit(void)
 {
 }
 
+/*
+ * Link timer t into the slot for its expiry tick on the lowest level of
+ * the wheel that spans it, or onto the overflow list if none does.
+ */
+static void
+timer_link(struct timer *t)
+{
+    uint64_t ticks;
+    uint32_t level, sidx;
+
+    ticks = t->expire - wtick;
+
+    if (ticks > TIMER_MAX_TICKS) {
+        LIST_INSERT_HEAD(&overflow, t, tle);
+        return;
+    }
+
+    for (level = 0; level < TIMER_WHEEL_LEVELS - 1; level++) {
+        if (ticks < (1ULL << (TIMER_WHEEL_BITS * (level + 1)))) {
+            break;
+        }
+    }
+
+    sidx = (uint32_t)(t->expire >> (TIMER_WHEEL_BITS * level)) &
+           TIMER_WHEEL_MASK;
+
+    LIST_INSERT_HEAD(&wheel[level][sidx], t, tle);
+}
+
+/*
+ * Cascade the timers in the current slot of the given level down to the
+ * lower levels and return the slot index.
+ */
+static uint32_t
+timer_cascade(uint32_t level)
+{
+    struct timerhdr *slot;
+    struct timer *t;
+    uint32_t sidx;
+
+    sidx = (uint32_t)(wtick >> (TIMER_WHEEL_BITS * level)) & TIMER_WHEEL_MASK;
+    slot = &wheel[level][sidx];
+
+    while ((t = LIST_FIRST(slot)) != NULL) {
+        ASSERT(t->expire >= wtick);
+        LIST_REMOVE(t, tle);
+        timer_link(t);
+    }
+
+    return sidx;
+}
+
+/*
+ * Link the overflow timers that the wheel spans again, after the top level
+ * cursor wrapped around.
+ */
+static void
+timer_cascade_overflow(void)
+{
+    struct timerhdr list;
+    struct timer *t;
+
+    LIST_INIT(&list);
+    while ((t = LIST_FIRST(&overflow)) != NULL) {
+        LIST_REMOVE(t, tle);
+        LIST_INSERT_HEAD(&list, t, tle);
+    }
+
+    while ((t = LIST_FIRST(&list)) != NULL) {
+        ASSERT(t->expire >= wtick);
+        LIST_REMOVE(t, tle);
+        timer_link(t);
+    }
+}
+
+/*
+ * Advance the timer wheel by nticks, firing the timers that expire on
+ * the way. The clock is not consulted, which lets the wheel be driven
+ * independently of the wall clock.
+ */
 void
-timer_tick(void)
+timer_advance(uint64_t nticks)
 {
-    struct timer *t, *t_next; /* current and next timer */
+    struct timerhdr *slot;
+    struct timer *t;
+    uint32_t level;
 
-    timer_now_update();
+    next_tick += (double)nticks * interval;
 
-    while (timer_now() >= next_tick) {
+    for (; nticks > 0; nticks--) {
+        if (ntimer == 0) {
+            /* nothing to fire or cascade; jump straight ahead */
+            wtick += nticks;
+            break;
+        }
 
-        /* expire timed out timers in this slot */
-        for (t = LIST_FIRST(&wheel[widx]); t != NULL && t->delta == 0;
-             t = t_next) {
-            t_next = LIST_NEXT(t, tle);
+        if ((wtick & TIMER_WHEEL_MASK) == 0) {
+            for (level = 1; level < TIMER_WHEEL_LEVELS; level++) {
+                if (timer_cascade(level) != 0) {
+                    break;
+                }
+            }
+            if (level == TIMER_WHEEL_LEVELS && !LIST_EMPTY(&overflow)) {
+                timer_cascade_overflow();
+            }
+        }
+
+        /*
+         * Timers scheduled by a timeout handler expire a tick later at
+         * the earliest and never land in the slot being expired.
+         */
+        slot = &wheel[0][wtick & TIMER_WHEEL_MASK];
+        while ((t = LIST_FIRST(slot)) != NULL) {
+            ASSERT(t->expire == wtick);
+            LIST_REMOVE(t, tle);
+            ntimer--;
 
             log_debug(LOG_DEBUG, "fire timer %"PRIu64" '%s'", t->id, t->name);
 
             (t->timeout)(t, t->arg);
 
-            LIST_REMOVE(t, tle);
-
             timer_put(t);
         }
 
-        if (t != NULL) {
-            t->delta--;
-            log_debug(LOG_DEBUG, "decrementing timer %"PRIu64" '%s' delta to "
-                      "%"PRIu64"", t->id, t->name, t->delta);
+        wtick++;
+    }
+}
+
+void
+timer_tick(void)
+{
+    timer_now_update();
+
+    if (timer_now() >= next_tick) {
+        timer_advance((uint64_t)((timer_now() - next_tick) / interval) + 1);
+    }
+}
+
+/*
+ * Return the time in sec until the earliest scheduled timer may fire, or
+ * a negative value if no timer is scheduled. A timer on an upper level is
+ * accounted at the start of its slot, when it gets cascaded, and a timer
+ * on the overflow list at the next wrap of the top level, so the time
+ * returned is a lower bound.
+ */
+double
+timer_next(void)
+{
+    uint64_t base, tick;
+    uint32_t level, shift, first, k;
+    double delay;
+
+    if (ntimer == 0) {
+        return -1.0;
+    }
+
+    tick = UINT64_MAX;
+
+    for (level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+        shift = TIMER_WHEEL_BITS * level;
+        base = wtick >> shift;
+
+        /*
+         * The current slot of an upper level has already been cascaded,
+         * unless the cursor of the level below is about to wrap around.
+         */
+        first = ((wtick & ((1ULL << shift) - 1)) == 0) ? 0 : 1;
+
+        for (k = first; k < first + TIMER_WHEEL_SIZE; k++) {
+            if (!LIST_EMPTY(&wheel[level][(base + k) & TIMER_WHEEL_MASK])) {
+                tick = MIN(tick, (base + k) << shift);
+                break;
+            }
         }
+    }
 
-        next_tick += TIMER_INTERVAL;
-        widx = (widx + 1) % TIMER_WHEEL_SIZE;
+    /* likewise, the top level may be about to wrap around */
+    if (!LIST_EMPTY(&overflow)) {
+        shift = TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS;
+        first = ((wtick & ((1ULL << shift) - 1)) == 0) ? 0 : 1;
+        tick = MIN(tick, ((wtick >> shift) + first) << shift);
     }
+
+    ASSERT(tick != UINT64_MAX && tick >= wtick);
+
+    delay = next_tick + (double)(tick - wtick) * interval - timer_now();
+
+    return MAX(delay, 0.0);
 }
 
 struct timer *
 _timer_schedule(timeout_t timeout, void *arg, double delay, char *name)
 {
-    struct timerhdr *spoke;  /* spoke on the wheel */
-    uint32_t sidx;           /* spoke index */
-    struct timer *t, *t_new; /* current and new timer */
-    uint64_t ticks, delta;
+    struct timer *t;
+    uint64_t ticks;
     double behind;
 
-    t_new = timer_get();
-    if (t_new == NULL) {
+    t = timer_get();
+    if (t == NULL) {
         return NULL;
     }
-    t_new->timeout = timeout;
-    t_new->arg = arg;
-    t_new->name = name;
+    t->timeout = timeout;
+    t->arg = arg;
+    t->name = name;
 
     behind = (timer_now() - next_tick);
     if (behind > 0.0) {
         delay += behind;
     }
 
-    /* delay to ticks */
-    ticks = (uint64_t)((delay + (TIMER_INTERVAL / 2.0)) * TIMER_TICKS_SEC);
+    /* delay to ticks, of which a late or absurd delay has none or plenty */
+    if (delay <= 0.0) {
+        ticks = 0;
+    } else {
+        ticks = (uint64_t)MIN((delay + (interval / 2.0)) / interval,
+                              (double)(UINT64_MAX >> 1));
+    }
     if (ticks == 0) {
         ticks = 1; /* minimum delay is a tick */
     }
 
-    /* spoke for the new timer */
-    sidx = (widx + ticks) % TIMER_WHEEL_SIZE;
-    spoke = &wheel[sidx];
-
-    /* # rounds around the wheel to expire the new timer */
-    delta = ticks / TIMER_WHEEL_SIZE;
-
-    for (t = LIST_FIRST(spoke); t != NULL && delta > t->delta;
-         t = LIST_NEXT(t, tle)) {
-        delta -= t->delta;
-    }
-
-    t_new->delta = delta;
-
-    if (t == NULL) {
-        LIST_INSERT_HEAD(spoke, t_new, tle);
-    } else {
-        LIST_INSERT_AFTER(t, t_new, tle);
-    }
-
-    if (LIST_NEXT(t_new, tle) != NULL) {
-        LIST_NEXT(t_new, tle)->delta -= delta;
-    }
+    t->expire = wtick + ticks;
+    timer_link(t);
+    ntimer++;
 
     log_debug(LOG_DEBUG, "schedule timer %"PRIu64" '%s' to fire after %g s, "
-              "%"PRIu64" ticks and %"PRIu64" rounds", t_new->id, t_new->name,
-              delay, ticks, t_new->delta);
+              "%"PRIu64" ticks at tick %"PRIu64"", t->id, t->name, delay,
+              ticks, t->expire);
 
-    return t_new;
+    return t;
 }
 
 void
 _timer_cancel(struct timer *t)
 {
-    struct timer *t_next;
-
     log_debug(LOG_DEBUG, "cancel timer %"PRIu64" '%s'", t->id, t->name);
 
-    t_next = LIST_NEXT(t, tle);
-    if (t_next != NULL) {
-        t_next->delta += t->delta;
-    }
-
+    ASSERT(ntimer > 0);
     LIST_REMOVE(t, tle);
+    ntimer--;
 
     timer_put(t);
 }
@@ -25,11 +25,29 @@
  *
  * 1 tick = 1 msec
  * 1 sec = 1000 ticks
+ *
+ * With high resolution pacing the granularity is 1 usec instead, and the
+ * event loop sleeps to within TIMER_HIRES_SPIN of the next timer and spins
+ * for the rest, so that the timer fires within a few usec of its expiry.
+ * The sleep needs epoll_pwait2 (or io_uring) to end short of a msec; the
+ * loop spins all the time when timers are less than TIMER_HIRES_SPIN apart.
  */
-#define TIMER_INTERVAL      (1.0 / 1000)            /* in sec */
-#define TIMER_TICKS_SEC     (1.0 / TIMER_INTERVAL)  /* in ticks */
+#define TIMER_INTERVAL       (1.0 / 1000)            /* in sec */
+#define TIMER_HIRES_INTERVAL (1.0 / 1000000)         /* in sec */
+#define TIMER_HIRES_SPIN     (200.0 / 1000000)       /* in sec */
 
-#define TIMER_WHEEL_SIZE    4096
+/*
+ * Timers live on a hierarchical timer wheel of TIMER_WHEEL_LEVELS levels
+ * with TIMER_WHEEL_SIZE slots each. A slot on level l spans
+ * TIMER_WHEEL_SIZE^l ticks, so four levels of 256 slots cover 2^32 ticks
+ * or ~49.7 days (~71.6 minutes with high resolution pacing). Timers further
+ * out wait on an overflow list until the wheel comes around to them.
+ */
+#define TIMER_WHEEL_BITS    8
+#define TIMER_WHEEL_SIZE    (1 << TIMER_WHEEL_BITS)
+#define TIMER_WHEEL_MASK    (TIMER_WHEEL_SIZE - 1)
+#define TIMER_WHEEL_LEVELS  4
+#define TIMER_MAX_TICKS     ((1ULL << (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS)) - 1)
 
 struct timer;
 
@@ -38,7 +56,7 @@ typedef void (*timeout_t)(struct timer *t, void *arg);
 struct timer {
     uint64_t          id;      /* unique id */
     LIST_ENTRY(timer) tle;     /* link in free q / timer wheel */
-    uint64_t          delta;   /* delay to expiry as # rounds */
+    uint64_t          expire;  /* expiry as absolute tick */
     timeout_t         timeout; /* timeout handler */
     void              *arg;    /* opaque data for timeout handler */
     char              *name;   /* timeout handler name */
@@ -46,11 +64,13 @@ struct timer {
 
 LIST_HEAD(timerhdr, timer);
 
-void timer_init(void);
+void timer_init(double interval);
 void timer_deinit(void);
 
 double timer_now(void);
 void timer_tick(void);
+void timer_advance(uint64_t nticks);
+double timer_next(void);
 
 #define timer_schedule(_timeout, _arg, _delay)              \
     _timer_schedule(_timeout, _arg, _delay, #_timeout)
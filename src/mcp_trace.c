@@ -0,0 +1,116 @@
+/*
+ *  twemperf - a tool for measuring memcached server performance.
+ *  Copyright (C) 2011 Twitter, Inc.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <mcp_core.h>
+
+/*
+ * Map the trace file filename read-only into memory. The records are
+ * paged in from the file as the replay reaches them and, being backed by
+ * the file, can be dropped again under memory pressure, so that a trace
+ * of any size is replayed with bounded memory.
+ */
+rstatus_t
+trace_open(struct trace *t, char *filename)
+{
+    struct trace_header *header;
+    struct stat st;
+    int status;
+
+    t->filename = filename;
+    t->addr = MAP_FAILED;
+    t->size = 0;
+
+    t->fd = open(filename, O_RDONLY);
+    if (t->fd < 0) {
+        log_stderr("mcperf: open of trace file '%s' failed: %s", filename,
+                   strerror(errno));
+        return MCP_ERROR;
+    }
+
+    status = fstat(t->fd, &st);
+    if (status < 0) {
+        log_stderr("mcperf: stat of trace file '%s' failed: %s", filename,
+                   strerror(errno));
+        goto error;
+    }
+
+    t->size = (size_t)st.st_size;
+    if (t->size < sizeof(*header)) {
+        log_stderr("mcperf: trace file '%s' is truncated", filename);
+        goto error;
+    }
+
+    t->addr = mmap(NULL, t->size, PROT_READ, MAP_SHARED, t->fd, 0);
+    if (t->addr == MAP_FAILED) {
+        log_stderr("mcperf: mmap of trace file '%s' failed: %s", filename,
+                   strerror(errno));
+        goto error;
+    }
+
+    header = t->addr;
+    if (header->magic != TRACE_MAGIC) {
+        log_stderr("mcperf: '%s' is not a trace file, or is of another byte "
+                   "order", filename);
+        goto error;
+    }
+
+    if (header->version != TRACE_VERSION) {
+        log_stderr("mcperf: trace file '%s' is of version %"PRIu32", "
+                   "expected %d", filename, header->version, TRACE_VERSION);
+        goto error;
+    }
+
+    if (header->nrec != (t->size - sizeof(*header)) / sizeof(*t->rec) ||
+        (t->size - sizeof(*header)) % sizeof(*t->rec) != 0) {
+        log_stderr("mcperf: trace file '%s' has %"PRIu64" records in %zu "
+                   "bytes", filename, header->nrec, t->size);
+        goto error;
+    }
+
+    t->rec = (struct trace_rec *)(header + 1);
+    t->nrec = header->nrec;
+    t->nkey = header->nkey;
+    t->duration = header->duration;
+
+    /* the records are read front to back, so read ahead aggressively */
+    madvise(t->addr, t->size, MADV_SEQUENTIAL);
+
+    return MCP_OK;
+
+error:
+    trace_close(t);
+    return MCP_ERROR;
+}
+
+void
+trace_close(struct trace *t)
+{
+    if (t->addr != MAP_FAILED) {
+        munmap(t->addr, t->size);
+        t->addr = MAP_FAILED;
+    }
+
+    if (t->fd >= 0) {
+        close(t->fd);
+        t->fd = -1;
+    }
+}
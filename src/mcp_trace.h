@@ -0,0 +1,83 @@
+/*
+ *  twemperf - a tool for measuring memcached server performance.
+ *  Copyright (C) 2011 Twitter, Inc.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _MCP_TRACE_H_
+#define _MCP_TRACE_H_
+
+#define TRACE_MAGIC     0x5254504d  /* "MPTR" in little endian */
+#define TRACE_VERSION   1
+
+#define TRACE_VLEN_MAX  0xffffff    /* largest value length of a record */
+
+/*
+ * A trace file holds the requests of a captured workload in a dense
+ * binary form that mcperf replays with -F. It starts with a header of the
+ * magic, the format version and the number of records and distinct keys,
+ * followed by fixed size records in the order of their time. The key of a
+ * record is an id numbered densely from zero, in the order in which the
+ * keys first appear in the capture. Integers are written in host byte
+ * order, which the magic checks for, but for the value length of a record
+ * that is little endian.
+ */
+struct trace_header {
+    uint32_t magic;     /* TRACE_MAGIC */
+    uint32_t version;   /* TRACE_VERSION */
+    uint64_t nrec;      /* # records */
+    uint64_t nkey;      /* # distinct keys */
+    uint64_t duration;  /* usec from the first to the last record */
+};
+
+struct trace_rec {
+    uint64_t time;      /* usec since the first record */
+    uint32_t key;       /* key id */
+    uint8_t  method;    /* request type */
+    uint8_t  vlen[3];   /* value length, or delta of incr and decr */
+};
+
+/* a trace file mapped read-only in memory, shared by every worker */
+struct trace {
+    char                *filename; /* trace filename */
+    int                 fd;        /* trace file descriptor */
+    void                *addr;     /* mapping of the trace file */
+    size_t              size;      /* trace file size */
+    struct trace_rec    *rec;      /* records */
+    uint64_t            nrec;      /* # records */
+    uint64_t            nkey;      /* # distinct keys */
+    uint64_t            duration;  /* usec from the first to the last record */
+};
+
+static inline uint32_t
+trace_rec_vlen(struct trace_rec *rec)
+{
+    return (uint32_t)rec->vlen[0] | ((uint32_t)rec->vlen[1] << 8) |
+           ((uint32_t)rec->vlen[2] << 16);
+}
+
+static inline void
+trace_rec_set_vlen(struct trace_rec *rec, uint32_t vlen)
+{
+    vlen = MIN(vlen, TRACE_VLEN_MAX);
+    rec->vlen[0] = (uint8_t)vlen;
+    rec->vlen[1] = (uint8_t)(vlen >> 8);
+    rec->vlen[2] = (uint8_t)(vlen >> 16);
+}
+
+rstatus_t trace_open(struct trace *t, char *filename);
+void trace_close(struct trace *t);
+
+#endif
@@ -0,0 +1,1119 @@
+/*
+ *  twemperf - a tool for measuring memcached server performance.
+ *  Copyright (C) 2011 Twitter, Inc.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <poll.h>
+#include <time.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/epoll.h>
+
+#include <mcp_core.h>
+
+#ifdef HAVE_IO_URING
+
+#include <linux/io_uring.h>
+
+/*
+ * io_uring(7) event engine
+ *
+ * The engine talks to the kernel through the raw io_uring syscalls and
+ * completes the I/O on behalf of the conn layer:
+ *
+ * 1. Every conn has a multishot recv outstanding that picks a buffer from
+ *    a ring of provided buffers for every chunk of data it receives. The
+ *    received buffers are queued on the conn until conn_recvv copies them
+ *    out and hands them back to the kernel.
+ * 2. conn_sendv submits an asynchronous sendmsg and returns with eagain;
+ *    the completion is reported as an out event and the next conn_sendv
+ *    on the same iovec returns the result of the completed send.
+ * 3. A one-shot poll for writability stands in for the out event that
+ *    signals a completed connect.
+ *
+ * New requests are only queued on the submission ring while the event
+ * loop runs; they are submitted all at once by the io_uring_enter(2)
+ * call that also waits for the next batch of completions.
+ */
+
+#define URING_BUF_SIZE   (4 * KB)  /* size of a provided recv buffer */
+#define URING_BUF_MIN    256       /* min # provided recv buffers */
+#define URING_BUF_MAX    8192      /* max # provided recv buffers */
+#define URING_BUF_GROUP  0         /* provided recv buffer group id */
+
+#define URING_SQ_MIN     64        /* min # submission queue entries */
+#define URING_SQ_MAX     4096      /* max # submission queue entries */
+#define URING_SQ_IDLE    100       /* sqpoll thread idle time in msec */
+
+/*
+ * The user data of a request packs the conn pointer with the operation
+ * and a generation number taken from the conn id. Completions that refer
+ * to a conn that has since been closed, or closed and reused, are stale
+ * and are dropped.
+ */
+#define URING_PTR_BITS   47
+#define URING_OP_BITS    3
+#define URING_GEN_BITS   14
+#define URING_PTR_MASK   ((1ULL << URING_PTR_BITS) - 1)
+#define URING_OP_MASK    ((1ULL << URING_OP_BITS) - 1)
+#define URING_GEN_MASK   ((1ULL << URING_GEN_BITS) - 1)
+
+typedef enum uring_op {
+    URING_OP_NONE,      /* cancel and poll remove */
+    URING_OP_POLL,      /* poll for writability */
+    URING_OP_RECV,      /* multishot recv */
+    URING_OP_SEND       /* sendmsg */
+} uring_op_t;
+
+struct uring {
+    int                      fd;          /* io_uring descriptor */
+    unsigned                 flags;       /* setup flags */
+
+    void                     *sq_ring;    /* submission ring mapping */
+    size_t                   sq_ring_sz;  /* submission ring mapping size */
+    uint32_t                 *sq_khead;   /* submission ring head */
+    uint32_t                 *sq_ktail;   /* submission ring tail */
+    uint32_t                 *sq_kflags;  /* submission ring flags */
+    uint32_t                 sq_mask;     /* submission ring mask */
+    uint32_t                 sq_entries;  /* # submission ring entries */
+    uint32_t                 sq_tail;     /* local submission ring tail */
+    struct io_uring_sqe      *sqes;       /* submission queue entries */
+    size_t                   sqes_sz;     /* submission queue entries size */
+
+    void                     *cq_ring;    /* completion ring mapping */
+    size_t                   cq_ring_sz;  /* completion ring mapping size */
+    uint32_t                 *cq_khead;   /* completion ring head */
+    uint32_t                 *cq_ktail;   /* completion ring tail */
+    uint32_t                 cq_mask;     /* completion ring mask */
+    struct io_uring_cqe      *cqes;       /* completion queue entries */
+
+    struct io_uring_buf_ring *br;         /* provided buffer ring */
+    size_t                   br_sz;       /* provided buffer ring size */
+    uint16_t                 br_tail;     /* local provided buffer ring tail */
+    uint32_t                 nbuf;        /* # provided buffers */
+    uint32_t                 nbuf_free;   /* # provided buffers with the kernel */
+    char                     *buf;        /* provided buffers */
+    uint32_t                 *buf_len;    /* received length by buffer id */
+    int32_t                  *buf_next;   /* next received buffer id by buffer id */
+
+    struct conn_pendq        armq;        /* conns with requests to submit */
+    struct conn_pendq        readyq;      /* conns with received data or eof */
+};
+
+static int
+uring_setup(unsigned entries, struct io_uring_params *p)
+{
+    return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int
+uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags,
+            void *arg, size_t argsz)
+{
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete,
+                        flags, arg, argsz);
+}
+
+static int
+uring_register(int fd, unsigned opcode, void *arg, unsigned nr_args)
+{
+    return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+static uint32_t
+uring_roundup(uint32_t n, uint32_t min, uint32_t max)
+{
+    uint32_t m;
+
+    for (m = min; m < n && m < max; m <<= 1) {
+        /* do nothing */
+    }
+
+    return m;
+}
+
+static uint64_t
+uring_data(struct conn *c, uring_op_t op)
+{
+    uint64_t ptr = (uint64_t)(uintptr_t)c;
+
+    ASSERT((ptr & ~URING_PTR_MASK) == 0);
+
+    return ptr | ((uint64_t)op << URING_PTR_BITS) |
+           ((c->id & URING_GEN_MASK) << (URING_PTR_BITS + URING_OP_BITS));
+}
+
+/*
+ * Submit the queued requests and, if timeout is non-zero, wait for at
+ * least one completion or until timeout usec have elapsed.
+ */
+static rstatus_t
+uring_submit(struct context *ctx, int timeout)
+{
+    struct uring *r = ctx->uring;
+    struct io_uring_getevents_arg arg;
+    struct timespec ts;
+    unsigned to_submit, min_complete, flags;
+    int n;
+
+    __atomic_store_n(r->sq_ktail, r->sq_tail, __ATOMIC_RELEASE);
+
+    to_submit = r->sq_tail - __atomic_load_n(r->sq_khead, __ATOMIC_ACQUIRE);
+    min_complete = 0;
+    flags = 0;
+
+    if (r->flags & IORING_SETUP_SQPOLL) {
+        /* the submission thread may have gone to sleep */
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        if (__atomic_load_n(r->sq_kflags, __ATOMIC_RELAXED) &
+            IORING_SQ_NEED_WAKEUP) {
+            flags |= IORING_ENTER_SQ_WAKEUP;
+        }
+        if (to_submit == r->sq_entries) {
+            flags |= IORING_ENTER_SQ_WAIT;
+        }
+        if (flags == 0 && timeout == 0) {
+            /* submission thread is awake and picks up the new requests */
+            return MCP_OK;
+        }
+    } else if (to_submit == 0 && timeout == 0) {
+        return MCP_OK;
+    }
+
+    memset(&arg, 0, sizeof(arg));
+    if (timeout != 0) {
+        min_complete = 1;
+        flags |= IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG;
+        arg.sigmask_sz = _NSIG / 8;
+        if (timeout > 0) {
+            ts.tv_sec = timeout / 1000000;
+            ts.tv_nsec = (long)(timeout % 1000000) * 1000L;
+            arg.ts = (uint64_t)(uintptr_t)&ts;
+        }
+    }
+
+    for (;;) {
+        ctx->stats.nsys_wait++;
+
+        n = uring_enter(r->fd, to_submit, min_complete, flags, &arg,
+                        sizeof(arg));
+        if (n >= 0) {
+            return MCP_OK;
+        }
+
+        if (errno == EINTR) {
+            continue;
+        }
+
+        if (errno == ETIME || errno == EBUSY || errno == EAGAIN) {
+            /* timed out or completion ring is backed up; reap first */
+            return MCP_OK;
+        }
+
+        log_error("io_uring enter on e %d with %u requests failed: %s",
+                  r->fd, to_submit, strerror(errno));
+
+        return MCP_ERROR;
+    }
+
+    NOT_REACHED();
+}
+
+static struct io_uring_sqe *
+uring_get_sqe(struct context *ctx)
+{
+    struct uring *r = ctx->uring;
+    struct io_uring_sqe *sqe;
+    rstatus_t status;
+
+    while (r->sq_tail - __atomic_load_n(r->sq_khead, __ATOMIC_ACQUIRE) >=
+           r->sq_entries) {
+        /* submission ring is full; make room by submitting it */
+        status = uring_submit(ctx, 0);
+        if (status != MCP_OK) {
+            return NULL;
+        }
+    }
+
+    sqe = &r->sqes[r->sq_tail & r->sq_mask];
+    memset(sqe, 0, sizeof(*sqe));
+    r->sq_tail++;
+
+    return sqe;
+}
+
+static rstatus_t
+uring_prep(struct context *ctx, struct conn *c, uint8_t opcode,
+           uint64_t addr, uint64_t data)
+{
+    struct io_uring_sqe *sqe;
+
+    sqe = uring_get_sqe(ctx);
+    if (sqe == NULL) {
+        return MCP_ERROR;
+    }
+
+    sqe->opcode = opcode;
+    sqe->fd = c != NULL ? c->sd : -1;
+    sqe->addr = addr;
+    sqe->user_data = data;
+
+    return MCP_OK;
+}
+
+static void
+uring_put_buf(struct uring *r, uint16_t bid)
+{
+    struct io_uring_buf *b;
+
+    ASSERT(bid < r->nbuf);
+
+    b = &r->br->bufs[r->br_tail & (r->nbuf - 1)];
+    b->addr = (uint64_t)(uintptr_t)(r->buf + (size_t)bid * URING_BUF_SIZE);
+    b->len = URING_BUF_SIZE;
+    b->bid = bid;
+
+    r->br_tail++;
+    __atomic_store_n(&r->br->tail, r->br_tail, __ATOMIC_RELEASE);
+
+    r->nbuf_free++;
+}
+
+/*
+ * A conn is in the arm q as long as it has a poll or a recv to arm, so
+ * it must be queued before either flag is set.
+ */
+static void
+uring_arm_later(struct uring *r, struct conn *c)
+{
+    if (c->arm_poll || c->arm_recv) {
+        /* already in arm q */
+        return;
+    }
+
+    TAILQ_INSERT_TAIL(&r->armq, c, arm_tqe);
+}
+
+static void
+uring_arm_poll(struct uring *r, struct conn *c)
+{
+    uring_arm_later(r, c);
+    c->arm_poll = 1;
+}
+
+static void
+uring_arm_recv(struct uring *r, struct conn *c)
+{
+    uring_arm_later(r, c);
+    c->arm_recv = 1;
+}
+
+static void
+uring_ready(struct uring *r, struct conn *c)
+{
+    if (c->recv_queued) {
+        return;
+    }
+
+    c->recv_queued = 1;
+    TAILQ_INSERT_TAIL(&r->readyq, c, ready_tqe);
+}
+
+static void
+uring_unready(struct uring *r, struct conn *c)
+{
+    if (!c->recv_queued) {
+        return;
+    }
+
+    c->recv_queued = 0;
+    TAILQ_REMOVE(&r->readyq, c, ready_tqe);
+}
+
+/*
+ * Queue the requests of the conns in the arm q. A recv that ran out of
+ * provided buffers stays in the arm q until some buffers are returned.
+ */
+static rstatus_t
+uring_arm(struct context *ctx)
+{
+    struct uring *r = ctx->uring;
+    struct conn *c, *nc; /* current and next conn */
+    struct io_uring_sqe *sqe;
+
+    for (c = TAILQ_FIRST(&r->armq); c != NULL; c = nc) {
+        nc = TAILQ_NEXT(c, arm_tqe);
+
+        if (c->arm_poll) {
+            sqe = uring_get_sqe(ctx);
+            if (sqe == NULL) {
+                return MCP_ERROR;
+            }
+            sqe->opcode = IORING_OP_POLL_ADD;
+            sqe->fd = c->sd;
+            sqe->poll32_events = POLLOUT;
+            sqe->user_data = uring_data(c, URING_OP_POLL);
+
+            c->arm_poll = 0;
+            c->poll_inflight = 1;
+        }
+
+        if (c->arm_recv && r->nbuf_free != 0) {
+            sqe = uring_get_sqe(ctx);
+            if (sqe == NULL) {
+                return MCP_ERROR;
+            }
+            sqe->opcode = IORING_OP_RECV;
+            sqe->fd = c->sd;
+            sqe->flags = IOSQE_BUFFER_SELECT;
+            sqe->ioprio = IORING_RECV_MULTISHOT;
+            sqe->buf_group = URING_BUF_GROUP;
+            sqe->user_data = uring_data(c, URING_OP_RECV);
+
+            c->arm_recv = 0;
+            c->recv_inflight = 1;
+        }
+
+        if (!c->arm_poll && !c->arm_recv) {
+            TAILQ_REMOVE(&r->armq, c, arm_tqe);
+        }
+    }
+
+    return MCP_OK;
+}
+
+static void
+uring_mark(struct context *ctx, struct conn *c, uint32_t events, int *nevent)
+{
+    if (c->uevents == 0) {
+        ASSERT(*nevent < ctx->nevent);
+        ctx->event[*nevent].data.ptr = c;
+        (*nevent)++;
+    }
+    c->uevents |= events;
+}
+
+static void
+uring_complete(struct context *ctx, struct io_uring_cqe *cqe, int *nevent)
+{
+    struct uring *r = ctx->uring;
+    struct conn *c;
+    uring_op_t op;
+    uint64_t gen;
+    uint16_t bid;
+    uint32_t events;
+    bool stale;
+    int res = cqe->res;
+
+    c = (struct conn *)(uintptr_t)(cqe->user_data & URING_PTR_MASK);
+    op = (uring_op_t)((cqe->user_data >> URING_PTR_BITS) & URING_OP_MASK);
+    gen = cqe->user_data >> (URING_PTR_BITS + URING_OP_BITS);
+
+    if (op == URING_OP_NONE) {
+        return;
+    }
+
+    stale = (c->sd < 0 || (c->id & URING_GEN_MASK) != gen);
+
+    switch (op) {
+    case URING_OP_RECV:
+        if (cqe->flags & IORING_CQE_F_BUFFER) {
+            bid = (uint16_t)(cqe->flags >> IORING_CQE_BUFFER_SHIFT);
+
+            ASSERT(r->nbuf_free != 0);
+            r->nbuf_free--;
+
+            if (stale || res <= 0) {
+                uring_put_buf(r, bid);
+            } else {
+                r->buf_len[bid] = (uint32_t)res;
+                r->buf_next[bid] = -1;
+                if (c->rbuf_tail < 0) {
+                    c->rbuf_head = bid;
+                } else {
+                    r->buf_next[c->rbuf_tail] = bid;
+                }
+                c->rbuf_tail = bid;
+                ctx->stats.nio_recv++;
+            }
+        }
+
+        if (stale) {
+            break;
+        }
+
+        if (!(cqe->flags & IORING_CQE_F_MORE)) {
+            c->recv_inflight = 0;
+        }
+
+        if (res > 0) {
+            uring_ready(r, c);
+            if (!c->recv_inflight) {
+                uring_arm_recv(r, c);
+            }
+        } else if (res == 0) {
+            c->recv_eof = 1;
+            uring_ready(r, c);
+        } else if (res == -ENOBUFS) {
+            log_debug(LOG_VERB, "recv on c %"PRIu64" sd %d out of buffers",
+                      c->id, c->sd);
+            uring_arm_recv(r, c);
+        } else if (res != -ECANCELED) {
+            c->err = -res;
+            uring_mark(ctx, c, EPOLLERR, nevent);
+        }
+        break;
+
+    case URING_OP_POLL:
+        if (stale || res == -ECANCELED) {
+            break;
+        }
+
+        c->poll_inflight = 0;
+        c->send_active = 0;
+
+        if (res < 0) {
+            c->err = -res;
+            uring_mark(ctx, c, EPOLLERR, nevent);
+            break;
+        }
+
+        events = 0;
+        if (res & POLLOUT) {
+            events |= EPOLLOUT;
+        }
+        if (res & POLLERR) {
+            events |= EPOLLERR;
+        }
+        if (res & POLLHUP) {
+            events |= EPOLLHUP;
+        }
+        if (events != 0) {
+            uring_mark(ctx, c, events, nevent);
+        }
+        break;
+
+    case URING_OP_SEND:
+        if (stale) {
+            break;
+        }
+
+        c->send_inflight = 0;
+        c->send_done = 1;
+        c->sres = res;
+        uring_mark(ctx, c, EPOLLOUT, nevent);
+        break;
+
+    default:
+        NOT_REACHED();
+    }
+}
+
+/*
+ * Reap the completion ring into the epoll event array of the context,
+ * with one event per conn. Conns with received data that has not been
+ * consumed yet are reported again, so received data behaves as if it was
+ * level triggered.
+ */
+static int
+uring_reap(struct context *ctx)
+{
+    struct uring *r = ctx->uring;
+    struct conn *c;
+    uint32_t head, tail;
+    int i, nevent;
+
+    nevent = 0;
+
+    head = *r->cq_khead;
+    tail = __atomic_load_n(r->cq_ktail, __ATOMIC_ACQUIRE);
+    for (; head != tail && nevent < ctx->nevent; head++) {
+        uring_complete(ctx, &r->cqes[head & r->cq_mask], &nevent);
+    }
+    __atomic_store_n(r->cq_khead, head, __ATOMIC_RELEASE);
+
+    TAILQ_FOREACH(c, &r->readyq, ready_tqe) {
+        if (c->uevents == 0 && nevent == ctx->nevent) {
+            break;
+        }
+        uring_mark(ctx, c, EPOLLIN, &nevent);
+    }
+
+    for (i = 0; i < nevent; i++) {
+        c = ctx->event[i].data.ptr;
+        ctx->event[i].events = c->uevents;
+        c->uevents = 0;
+    }
+
+    return nevent;
+}
+
+static void
+uring_free(struct uring *r)
+{
+    if (r->br != NULL) {
+        munmap(r->br, r->br_sz);
+    }
+    if (r->sqes != NULL) {
+        munmap(r->sqes, r->sqes_sz);
+    }
+    if (r->cq_ring != NULL && r->cq_ring != r->sq_ring) {
+        munmap(r->cq_ring, r->cq_ring_sz);
+    }
+    if (r->sq_ring != NULL) {
+        munmap(r->sq_ring, r->sq_ring_sz);
+    }
+    if (r->fd >= 0) {
+        close(r->fd);
+    }
+    if (r->buf != NULL) {
+        mcp_free(r->buf);
+    }
+    if (r->buf_len != NULL) {
+        mcp_free(r->buf_len);
+    }
+    if (r->buf_next != NULL) {
+        mcp_free(r->buf_next);
+    }
+    mcp_free(r);
+}
+
+static int
+uring_init(struct context *ctx, int size)
+{
+    struct uring *r;
+    struct io_uring_params p;
+    struct io_uring_buf_reg reg;
+    uint32_t i, entries;
+    int status;
+    bool sqpoll = (ctx->opt.engine == EVENT_ENGINE_URING_SQPOLL);
+
+    ASSERT(ctx->nevent != 0);
+
+    r = mcp_calloc(1, sizeof(*r));
+    if (r == NULL) {
+        return -1;
+    }
+    r->fd = -1;
+    TAILQ_INIT(&r->armq);
+    TAILQ_INIT(&r->readyq);
+
+    entries = uring_roundup(2 * (uint32_t)ctx->nevent, URING_SQ_MIN,
+                            URING_SQ_MAX);
+
+    memset(&p, 0, sizeof(p));
+    p.flags = IORING_SETUP_CQSIZE;
+    p.cq_entries = 4 * entries;
+    if (sqpoll) {
+        p.flags |= IORING_SETUP_SQPOLL;
+        p.sq_thread_idle = URING_SQ_IDLE;
+    } else {
+        /* only this worker submits; no need to interrupt it on completions */
+        p.flags |= IORING_SETUP_COOP_TASKRUN | IORING_SETUP_SINGLE_ISSUER;
+    }
+
+    r->fd = uring_setup(entries, &p);
+    if (r->fd < 0 && errno == EINVAL && !sqpoll) {
+        /* older kernel; retry without the optional flags */
+        p.flags &= ~(IORING_SETUP_COOP_TASKRUN | IORING_SETUP_SINGLE_ISSUER);
+        r->fd = uring_setup(entries, &p);
+    }
+    if (r->fd < 0) {
+        log_error("io_uring setup with %"PRIu32" entries failed: %s", entries,
+                  strerror(errno));
+        goto error;
+    }
+    r->flags = p.flags;
+
+    if (!(p.features & IORING_FEAT_EXT_ARG)) {
+        log_error("io_uring on e %d lacks wait with timeout support", r->fd);
+        goto error;
+    }
+
+    r->sq_ring_sz = p.sq_off.array + p.sq_entries * sizeof(uint32_t);
+    r->cq_ring_sz = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        r->sq_ring_sz = MAX(r->sq_ring_sz, r->cq_ring_sz);
+        r->cq_ring_sz = r->sq_ring_sz;
+    }
+
+    r->sq_ring = mmap(NULL, r->sq_ring_sz, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQ_RING);
+    if (r->sq_ring == MAP_FAILED) {
+        r->sq_ring = NULL;
+        log_error("io_uring mmap of sq ring on e %d failed: %s", r->fd,
+                  strerror(errno));
+        goto error;
+    }
+
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        r->cq_ring = r->sq_ring;
+    } else {
+        r->cq_ring = mmap(NULL, r->cq_ring_sz, PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_CQ_RING);
+        if (r->cq_ring == MAP_FAILED) {
+            r->cq_ring = NULL;
+            log_error("io_uring mmap of cq ring on e %d failed: %s", r->fd,
+                      strerror(errno));
+            goto error;
+        }
+    }
+
+    r->sqes_sz = p.sq_entries * sizeof(struct io_uring_sqe);
+    r->sqes = mmap(NULL, r->sqes_sz, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQES);
+    if (r->sqes == MAP_FAILED) {
+        r->sqes = NULL;
+        log_error("io_uring mmap of sqes on e %d failed: %s", r->fd,
+                  strerror(errno));
+        goto error;
+    }
+
+    r->sq_khead = (uint32_t *)((char *)r->sq_ring + p.sq_off.head);
+    r->sq_ktail = (uint32_t *)((char *)r->sq_ring + p.sq_off.tail);
+    r->sq_kflags = (uint32_t *)((char *)r->sq_ring + p.sq_off.flags);
+    r->sq_mask = *(uint32_t *)((char *)r->sq_ring + p.sq_off.ring_mask);
+    r->sq_entries = p.sq_entries;
+    r->sq_tail = *r->sq_ktail;
+    for (i = 0; i < p.sq_entries; i++) {
+        ((uint32_t *)((char *)r->sq_ring + p.sq_off.array))[i] = i;
+    }
+
+    r->cq_khead = (uint32_t *)((char *)r->cq_ring + p.cq_off.head);
+    r->cq_ktail = (uint32_t *)((char *)r->cq_ring + p.cq_off.tail);
+    r->cq_mask = *(uint32_t *)((char *)r->cq_ring + p.cq_off.ring_mask);
+    r->cqes = (struct io_uring_cqe *)((char *)r->cq_ring + p.cq_off.cqes);
+
+    /* provided buffers for multishot recv */
+    r->nbuf = uring_roundup(2 * (uint32_t)ctx->nevent, URING_BUF_MIN,
+                            URING_BUF_MAX);
+    r->br_sz = r->nbuf * sizeof(struct io_uring_buf);
+    r->br = mmap(NULL, r->br_sz, PROT_READ | PROT_WRITE,
+                 MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+    if (r->br == MAP_FAILED) {
+        r->br = NULL;
+        log_error("io_uring mmap of %"PRIu32" buffer ring failed: %s",
+                  r->nbuf, strerror(errno));
+        goto error;
+    }
+
+    r->buf = mcp_alloc((size_t)r->nbuf * URING_BUF_SIZE);
+    r->buf_len = mcp_calloc(r->nbuf, sizeof(*r->buf_len));
+    r->buf_next = mcp_calloc(r->nbuf, sizeof(*r->buf_next));
+    if (r->buf == NULL || r->buf_len == NULL || r->buf_next == NULL) {
+        goto error;
+    }
+
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (uint64_t)(uintptr_t)r->br;
+    reg.ring_entries = r->nbuf;
+    reg.bgid = URING_BUF_GROUP;
+    status = uring_register(r->fd, IORING_REGISTER_PBUF_RING, &reg, 1);
+    if (status < 0) {
+        log_error("io_uring register of %"PRIu32" buffers on e %d failed: %s",
+                  r->nbuf, r->fd, strerror(errno));
+        goto error;
+    }
+
+    for (i = 0; i < r->nbuf; i++) {
+        uring_put_buf(r, (uint16_t)i);
+    }
+
+    ctx->event = mcp_calloc(ctx->nevent, sizeof(*ctx->event));
+    if (ctx->event == NULL) {
+        goto error;
+    }
+
+    ctx->ep = r->fd;
+    ctx->uring = r;
+
+    log_debug(LOG_DEBUG, "e %d with %"PRIu32" entries %"PRIu32" buffers "
+              "nevent %d timeout %d%s", ctx->ep, p.sq_entries, r->nbuf,
+              ctx->nevent, ctx->timeout, sqpoll ? " sqpoll" : "");
+
+    return 0;
+
+error:
+    uring_free(r);
+    return -1;
+}
+
+static void
+uring_deinit(struct context *ctx)
+{
+    ASSERT(ctx->ep > 0);
+    ASSERT(ctx->uring != NULL);
+
+    mcp_free(ctx->event);
+    ctx->event = NULL;
+
+    uring_free(ctx->uring);
+    ctx->uring = NULL;
+    ctx->ep = -1;
+}
+
+static int
+uring_add_out(struct context *ctx, struct conn *c)
+{
+    ASSERT(c->sd > 0);
+    ASSERT(c->recv_active);
+
+    if (c->send_active || c->send_inflight) {
+        /* completion of the in-flight send is reported as an out event */
+        return 0;
+    }
+
+    uring_arm_poll(ctx->uring, c);
+    c->send_active = 1;
+
+    return 0;
+}
+
+static int
+uring_del_out(struct context *ctx, struct conn *c)
+{
+    struct uring *r = ctx->uring;
+    rstatus_t status;
+
+    ASSERT(c->sd > 0);
+    ASSERT(c->recv_active);
+
+    if (!c->send_active) {
+        return 0;
+    }
+
+    if (c->arm_poll) {
+        c->arm_poll = 0;
+        if (!c->arm_recv) {
+            TAILQ_REMOVE(&r->armq, c, arm_tqe);
+        }
+    } else if (c->poll_inflight) {
+        status = uring_prep(ctx, NULL, IORING_OP_POLL_REMOVE,
+                            uring_data(c, URING_OP_POLL), 0);
+        if (status != MCP_OK) {
+            return -1;
+        }
+        c->poll_inflight = 0;
+    }
+    c->send_active = 0;
+
+    return 0;
+}
+
+static int
+uring_add_conn(struct context *ctx, struct conn *c)
+{
+    ASSERT(c->sd > 0);
+
+    /*
+     * Requests are only armed on the next event wait, after the connect
+     * has been initiated on the socket.
+     */
+    uring_arm_poll(ctx->uring, c);
+    uring_arm_recv(ctx->uring, c);
+
+    c->send_active = 1;
+    c->recv_active = 1;
+
+    return 0;
+}
+
+static int
+uring_del_conn(struct context *ctx, struct conn *c)
+{
+    struct uring *r = ctx->uring;
+    rstatus_t status;
+    int32_t bid;
+
+    ASSERT(c->sd > 0);
+
+    if (c->arm_poll || c->arm_recv) {
+        c->arm_poll = 0;
+        c->arm_recv = 0;
+        TAILQ_REMOVE(&r->armq, c, arm_tqe);
+    }
+
+    uring_unready(r, c);
+
+    /* hand the received but unconsumed buffers back to the kernel */
+    while (c->rbuf_head >= 0) {
+        bid = c->rbuf_head;
+        c->rbuf_head = r->buf_next[bid];
+        uring_put_buf(r, (uint16_t)bid);
+    }
+    c->rbuf_tail = -1;
+    c->rbuf_off = 0;
+
+    status = MCP_OK;
+    if (c->recv_inflight) {
+        status = uring_prep(ctx, NULL, IORING_OP_ASYNC_CANCEL,
+                            uring_data(c, URING_OP_RECV), 0);
+        c->recv_inflight = 0;
+    }
+    if (status == MCP_OK && c->poll_inflight) {
+        status = uring_prep(ctx, NULL, IORING_OP_POLL_REMOVE,
+                            uring_data(c, URING_OP_POLL), 0);
+        c->poll_inflight = 0;
+    }
+    if (status == MCP_OK && c->send_inflight) {
+        status = uring_prep(ctx, NULL, IORING_OP_ASYNC_CANCEL,
+                            uring_data(c, URING_OP_SEND), 0);
+        c->send_inflight = 0;
+    }
+    c->send_done = 0;
+    c->recv_eof = 0;
+
+    c->recv_active = 0;
+    c->send_active = 0;
+
+    return status == MCP_OK ? 0 : -1;
+}
+
+static int
+uring_wait(struct context *ctx, int timeout)
+{
+    struct uring *r = ctx->uring;
+    rstatus_t status;
+
+    ASSERT(ctx->ep > 0);
+    ASSERT(r != NULL);
+
+    status = uring_arm(ctx);
+    if (status != MCP_OK) {
+        return -1;
+    }
+
+    if (!TAILQ_EMPTY(&r->readyq) ||
+        *r->cq_khead != __atomic_load_n(r->cq_ktail, __ATOMIC_ACQUIRE)) {
+        timeout = 0;
+    }
+
+    status = uring_submit(ctx, timeout);
+    if (status != MCP_OK) {
+        return -1;
+    }
+
+    return uring_reap(ctx);
+}
+
+static ssize_t
+uring_sendv(struct conn *conn, struct iovec *iov, int iovcnt, size_t iov_size)
+{
+    struct context *ctx = conn->ctx;
+    struct io_uring_sqe *sqe;
+    struct iovec *siov;
+    ssize_t n;
+
+    if (conn->send_done) {
+        /* the send on this iovec has completed */
+        conn->send_done = 0;
+        n = conn->sres;
+
+        log_debug(LOG_VERB, "sendv on c %"PRIu64" sd %d %zd of %zu in "
+                  "%"PRIu32" buffers", conn->id, conn->sd, n, iov_size,
+                  iovcnt);
+
+        if (n > 0) {
+            return n;
+        }
+
+        if (n == 0) {
+            log_warn("sendv on c %"PRIu64" sd %d returned zero", conn->id,
+                     conn->sd);
+            conn->send_ready = 0;
+            return 0;
+        }
+
+        if (n != -EAGAIN && n != -EINTR) {
+            conn->send_ready = 0;
+            conn->err = (err_t)-n;
+            log_debug(LOG_ERR, "sendv on c %"PRIu64" sd %d failed: %s",
+                      conn->id, conn->sd, strerror(conn->err));
+            return MCP_EAGAIN;
+        }
+    }
+
+    conn->send_ready = 0;
+
+    if (conn->send_inflight) {
+        return MCP_EAGAIN;
+    }
+
+    if (iovcnt > conn->nsiov) {
+        siov = mcp_realloc(conn->siov, sizeof(*siov) * (size_t)iovcnt);
+        if (siov == NULL) {
+            conn->err = ENOMEM;
+            return MCP_EAGAIN;
+        }
+        conn->siov = siov;
+        conn->nsiov = iovcnt;
+    }
+
+    /* iov is owned by the caller; the kernel gets a stable copy */
+    mcp_memcpy(conn->siov, iov, sizeof(*iov) * (size_t)iovcnt);
+    memset(&conn->smsg, 0, sizeof(conn->smsg));
+    conn->smsg.msg_iov = conn->siov;
+    conn->smsg.msg_iovlen = (size_t)iovcnt;
+
+    sqe = uring_get_sqe(ctx);
+    if (sqe == NULL) {
+        conn->err = EIO;
+        return MCP_EAGAIN;
+    }
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->fd = conn->sd;
+    sqe->addr = (uint64_t)(uintptr_t)&conn->smsg;
+    sqe->len = 1;
+    sqe->msg_flags = MSG_NOSIGNAL;
+    sqe->user_data = uring_data(conn, URING_OP_SEND);
+
+    conn->send_inflight = 1;
+    ctx->stats.nio_send++;
+
+    log_debug(LOG_VERB, "sendv on c %"PRIu64" sd %d submitted %zu in "
+              "%"PRIu32" buffers", conn->id, conn->sd, iov_size, iovcnt);
+
+    return MCP_EAGAIN;
+}
+
+static ssize_t
+uring_recvv(struct conn *conn, struct iovec *iov, int iovcnt, size_t iov_size)
+{
+    struct uring *r = conn->ctx->uring;
+    size_t n, copied, off;
+    int32_t bid;
+    int i;
+
+    if (conn->send_done) {
+        /*
+         * Hold back the received data until the completed send has been
+         * accounted, as it might carry the response to the call whose
+         * send completed.
+         */
+        conn->recv_ready = 0;
+        return MCP_EAGAIN;
+    }
+
+    copied = 0;
+    i = 0;
+    off = 0;
+    while (i < iovcnt && conn->rbuf_head >= 0) {
+        bid = conn->rbuf_head;
+
+        n = MIN(r->buf_len[bid] - conn->rbuf_off, iov[i].iov_len - off);
+        if (iov[i].iov_base != NULL) {
+            mcp_memcpy((char *)iov[i].iov_base + off,
+                       r->buf + (size_t)bid * URING_BUF_SIZE + conn->rbuf_off,
+                       n);
+        }
+        copied += n;
+        conn->rbuf_off += (uint32_t)n;
+
+        off += n;
+        if (off == iov[i].iov_len) {
+            i++;
+            off = 0;
+        }
+
+        if (conn->rbuf_off == r->buf_len[bid]) {
+            conn->rbuf_head = r->buf_next[bid];
+            if (conn->rbuf_head < 0) {
+                conn->rbuf_tail = -1;
+            }
+            conn->rbuf_off = 0;
+            uring_put_buf(r, (uint16_t)bid);
+        }
+    }
+
+    log_debug(LOG_VERB, "recv on sd %d %zu of %zu in %d buffers", conn->sd,
+              copied, iov_size, iovcnt);
+
+    if (conn->rbuf_head < 0) {
+        conn->recv_ready = 0;
+        if (!conn->recv_eof || copied == 0) {
+            uring_unready(r, conn);
+        }
+    }
+
+    if (copied > 0) {
+        return (ssize_t)copied;
+    }
+
+    if (conn->recv_eof) {
+        conn->eof = 1;
+        log_debug(LOG_INFO, "recv on sd %d eof", conn->sd);
+        return 0;
+    }
+
+    log_debug(LOG_VERB, "recv on sd %d not ready - eagain", conn->sd);
+
+    return MCP_EAGAIN;
+}
+
+/*
+ * Discard received data by handing the buffers holding it back to the
+ * kernel without copying them out.
+ */
+static ssize_t
+uring_discard(struct conn *conn, size_t size)
+{
+    struct iovec iov;
+
+    iov.iov_base = NULL;
+    iov.iov_len = size;
+
+    return uring_recvv(conn, &iov, 1, size);
+}
+
+struct event_engine uring_engine = {
+    "uring",
+    uring_init,
+    uring_deinit,
+    uring_add_out,
+    uring_del_out,
+    uring_add_conn,
+    uring_del_conn,
+    uring_wait,
+    uring_sendv,
+    uring_recvv,
+    uring_discard
+};
+
+#else
+
+static int
+uring_init(struct context *ctx, int size)
+{
+    log_error("io_uring event engine is not supported on this platform");
+    return -1;
+}
+
+struct event_engine uring_engine = {
+    "uring",
+    uring_init,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL
+};
+
+#endif
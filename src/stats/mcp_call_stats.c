@@ -18,6 +18,16 @@
 
 #include <mcp_core.h>
 
+/*
+ * Return true if the call was issued before the stats were last started,
+ * that is in the warmup of the test, and is left out of the stats
+ */
+static bool
+call_stats_skip(struct stats *stats, struct call *call)
+{
+    return call->req.issue_start < stats->start_time;
+}
+
 static void
 call_created(struct context *ctx, event_type_t type, void *rarg, void *carg)
 {
@@ -27,11 +37,34 @@ call_created(struct context *ctx, event_type_t type, void *rarg, void *carg)
 static void
 call_issue_start(struct context *ctx, event_type_t type, void *rarg, void *carg)
 {
+    struct stats *stats = &ctx->stats;
     struct call *call = carg;
+    struct gen *g = &call->conn->lead->call_gen;
+    double pace_time;
 
     ASSERT(type == EVENT_CALL_ISSUE_START);
 
+    call->req.intended_start = g->tick_time;
     call->req.issue_start = timer_now();
+
+    /*
+     * A one-shot generator ticks when it is fired, so in a closed loop
+     * the intended start is the issue time, and the response time from
+     * it only exceeds the send relative one by the wait for the send.
+     */
+    if (g->oneshot) {
+        return;
+    }
+
+    ASSERT(timer_now() >= g->tick_time);
+
+    stats->npace++;
+
+    pace_time = timer_now() - g->tick_time;
+    stats->pace_sum += pace_time;
+    stats->pace_sum2 += SQUARE(pace_time);
+    stats->pace_min = MIN(pace_time, stats->pace_min);
+    stats->pace_max = MAX(pace_time, stats->pace_max);
 }
 
 static void
@@ -50,7 +83,6 @@ call_send_stop(struct context *ctx, event_type_t type, void *rarg, void *carg)
 {
     struct stats *stats = &ctx->stats;
     struct call *call = carg;
-    double req_xfer_time;
 
     ASSERT(type == EVENT_CALL_SEND_STOP);
     ASSERT(call->req.sent > 0);
@@ -59,6 +91,10 @@ call_send_stop(struct context *ctx, event_type_t type, void *rarg, void *carg)
 
     call->req.send_stop = timer_now();
 
+    if (call_stats_skip(stats, call)) {
+        return;
+    }
+
     stats->nreq++;
 
     stats->req_bytes_sent += call->req.sent;
@@ -66,11 +102,15 @@ call_send_stop(struct context *ctx, event_type_t type, void *rarg, void *carg)
     stats->req_bytes_sent_min = MIN(call->req.sent, stats->req_bytes_sent_min);
     stats->req_bytes_sent_max = MAX(call->req.sent, stats->req_bytes_sent_max);
 
-    req_xfer_time = timer_now() - call->req.send_start;
-    stats->req_xfer_sum += req_xfer_time;
-    stats->req_xfer_sum2 += SQUARE(req_xfer_time);
-    stats->req_xfer_min = MIN(req_xfer_time, stats->req_xfer_min);
-    stats->req_xfer_max = MAX(req_xfer_time, stats->req_xfer_max);
+    stats_time_add(&stats->req_xfer, timer_now() - call->req.send_start);
+
+    if (ctx->opt.nmethod > 1) {
+        stats->method[call->req.method].nreq++;
+    }
+
+    if (stats->nserver != 0) {
+        stats->server[call->conn->server].nreq++;
+    }
 }
 
 static void
@@ -78,21 +118,36 @@ call_recv_start(struct context *ctx, event_type_t type, void *rarg, void *carg)
 {
     struct stats *stats = &ctx->stats;
     struct call *call = carg;
-    double req_rsp_time;
-    long int bin;
+    struct stats_method *sm;
+    struct stats_server *ss;
+    double rsp_time, int_time;
 
     ASSERT(type == EVENT_CALL_RECV_START);
+    ASSERT(call->req.send_start >= call->req.intended_start);
 
     call->rsp.recv_start = timer_now();
-    req_rsp_time = timer_now() - call->req.send_start;
-
-    stats->req_rsp_sum += req_rsp_time;
-    stats->req_rsp_sum2 += SQUARE(req_rsp_time);
-    stats->req_rsp_min = MIN(req_rsp_time, stats->req_rsp_min);
-    stats->req_rsp_max = MAX(req_rsp_time, stats->req_rsp_max);
 
-    bin = MIN(lrint(req_rsp_time / HIST_BIN_WIDTH), HIST_NUM_BINS - 1);
-    stats->req_rsp_hist[bin]++;
+    if (call_stats_skip(stats, call)) {
+        return;
+    }
+
+    rsp_time = timer_now() - call->req.send_start;
+    int_time = timer_now() - call->req.intended_start;
+    stats_time_add(&stats->req_rsp, rsp_time);
+    stats_interval_add(stats, rsp_time);
+    stats_time_add(&stats->int_rsp, int_time);
+
+    if (ctx->opt.nmethod > 1) {
+        sm = &stats->method[call->req.method];
+        stats_time_add(&sm->req_rsp, rsp_time);
+        stats_time_add(&sm->int_rsp, int_time);
+    }
+
+    if (stats->nserver != 0) {
+        ss = &stats->server[call->conn->server];
+        stats_time_add(&ss->req_rsp, rsp_time);
+        stats_time_add(&ss->int_rsp, int_time);
+    }
 }
 
 static void
@@ -100,24 +155,36 @@ call_recv_stop(struct context *ctx, event_type_t type, void *rarg, void *carg)
 {
     struct stats *stats = &ctx->stats;
     struct call *call = carg;
-    double rsp_xfer_time;
 
     ASSERT(type == EVENT_CALL_RECV_STOP);
     ASSERT(call->rsp.type < RSP_MAX_TYPES);
 
+    if (call_stats_skip(stats, call)) {
+        return;
+    }
+
     stats->rsp_type[call->rsp.type]++;
     stats->nrsp++;
+    if (ctx->opt.nmethod > 1) {
+        stats->method[call->req.method].nrsp++;
+    }
+    if (stats->nserver != 0) {
+        stats->server[call->conn->server].nrsp++;
+    }
+
+    if (call->req.method == REQ_GET || call->req.method == REQ_GETS) {
+        stats->nget++;
+        stats->nget_key += call->req.nkey;
+        stats->nget_hit += call->rsp.parser.nvalue;
+        stats->get_value_bytes += (double)call->rsp.parser.value_bytes;
+    }
 
     stats->rsp_bytes_rcvd += call->rsp.rcvd;
     stats->rsp_bytes_rcvd2 += SQUARE(call->rsp.rcvd);
     stats->rsp_bytes_rcvd_min = MIN(call->rsp.rcvd, stats->rsp_bytes_rcvd_min);
     stats->rsp_bytes_rcvd_max = MAX(call->rsp.rcvd, stats->rsp_bytes_rcvd_max);
 
-    rsp_xfer_time = timer_now() - call->rsp.recv_start;
-    stats->rsp_xfer_sum += rsp_xfer_time;
-    stats->rsp_xfer_sum2 += SQUARE(rsp_xfer_time);
-    stats->rsp_xfer_min = MIN(rsp_xfer_time, stats->rsp_xfer_min);
-    stats->rsp_xfer_max = MAX(rsp_xfer_time, stats->rsp_xfer_max);
+    stats_time_add(&stats->rsp_xfer, timer_now() - call->rsp.recv_start);
 }
 
 static void
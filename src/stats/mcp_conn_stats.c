@@ -45,7 +45,6 @@ conn_connected(struct context *ctx, event_type_t type, void *rarg, void *carg)
 {
     struct stats *stats = &ctx->stats;
     struct conn *conn = carg;
-    double connect_time;
 
     ASSERT(type == EVENT_CONN_CONNECTED);
     ASSERT(conn->connect_start > 0.0);
@@ -54,14 +53,9 @@ conn_connected(struct context *ctx, event_type_t type, void *rarg, void *carg)
 
     stats->nconnect++;
 
-    connect_time = timer_now() - conn->connect_start;
-    stats->connect_sum += connect_time;
-    stats->connect_sum2 += SQUARE(connect_time);
-    stats->connect_min = MIN(connect_time, stats->connect_min);
-    stats->connect_max = MAX(connect_time, stats->connect_max);
+    stats_time_add(&stats->connect, timer_now() - conn->connect_start);
 
-    stats->nconn_active++;
-    stats->nconn_active_max = MAX(stats->nconn_active, stats->nconn_active_max);
+    stats_conn_active(stats, true);
 }
 
 static void
@@ -72,11 +66,15 @@ conn_destroyed(struct context *ctx, event_type_t type, void *rarg, void *carg)
 
     ASSERT(type == EVENT_CONN_DESTROYED);
 
+    /* a conn of a pool whose server failed was accounted for at the failure */
+    if (conn->sd < 0) {
+        return;
+    }
+
     if (conn->connected) {
         double connection_time;
 
-        ASSERT(stats->nconn_active > 0);
-        stats->nconn_active--;
+        stats_conn_active(stats, false);
 
         connection_time = timer_now() - conn->connect_start;
         stats->connection_sum += connection_time;
@@ -91,10 +89,14 @@ static void
 conn_timeout(struct context *ctx, event_type_t type, void *rarg, void *carg)
 {
     struct stats *stats = &ctx->stats;
+    struct conn *conn = carg;
 
     ASSERT(type == EVENT_CONN_TIMEOUT);
 
     stats->nclient_timeout++;
+    if (stats->nserver != 0) {
+        stats->server[conn->server].nerror++;
+    }
 }
 
 static void
@@ -106,6 +108,10 @@ conn_failed(struct context *ctx, event_type_t type, void *rarg, void *carg)
     ASSERT(type == EVENT_CONN_FAILED);
     ASSERT(conn->ctx == ctx);
 
+    if (stats->nserver != 0) {
+        stats->server[conn->server].nerror++;
+    }
+
     switch (conn->err) {
     case EMFILE:
         stats->nsock_fdunavail++;
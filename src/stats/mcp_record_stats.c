@@ -0,0 +1,101 @@
+/*
+ *  twemperf - a tool for measuring memcached server performance.
+ *  Copyright (C) 2011 Twitter, Inc.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <mcp_core.h>
+
+/*
+ * Write a record of every sampled call that completes into the ring of
+ * the worker. The record is filled on the stack and copied into the
+ * mapping of the record file, so that a call costs no formatting and no
+ * system call; the file is written back by the kernel.
+ */
+static void
+call_recv_stop(struct context *ctx, event_type_t type, void *rarg, void *carg)
+{
+    struct record_ring *ring = &ctx->record;
+    struct call *call = carg;
+    struct record_rec rec;
+    double start;
+
+    ASSERT(type == EVENT_CALL_RECV_STOP);
+
+    /*
+     * Calls issued in the warmup are left out, as they are of the stats;
+     * the stats start afresh at the end of the warmup
+     */
+    if ((ctx->opt.warmup > 0.0 && !ctx->warmed_up) ||
+        call->req.issue_start < ctx->stats.start_time) {
+        return;
+    }
+
+    ring->ncall++;
+
+    ring->skip--;
+    if (ring->skip != 0) {
+        return;
+    }
+    ring->skip = record_skip(ring);
+
+    start = call->req.intended_start;
+
+    rec.time = start > ring->start ?
+               (uint64_t)((start - ring->start) * 1e6 + 0.5) : 0;
+    rec.issue = record_usec(call->req.issue_start - start);
+    rec.send_start = record_usec(call->req.send_start - start);
+    rec.send_stop = record_usec(call->req.send_stop - start);
+    rec.recv_start = record_usec(call->rsp.recv_start - start);
+    rec.recv_stop = record_usec(timer_now() - start);
+    rec.conn = (uint32_t)call->conn->id;
+    rec.key = call->req.key_id;
+    rec.req_bytes = (uint32_t)call->req.sent;
+    rec.rsp_bytes = (uint32_t)call->rsp.rcvd;
+    rec.nkey = (uint16_t)MIN(call->req.nkey, UINT16_MAX);
+    rec.method = (uint8_t)call->req.method;
+    rec.type = (uint8_t)call->rsp.type;
+
+    *record_next(ring) = rec;
+}
+
+static void
+init(struct context *ctx, void *arg)
+{
+    struct opt *opt = &ctx->opt;
+
+    if (opt->record_filename == NULL) {
+        return;
+    }
+
+    record_ring_init(&ctx->record, &opt->record, ctx->id, opt->num_threads,
+                     opt->client.id * opt->num_threads + ctx->id);
+
+    ecb_register(ctx, EVENT_CALL_RECV_STOP, call_recv_stop, NULL);
+}
+
+static void
+no_op(struct context *ctx, void *arg)
+{
+    /* do nothing */
+}
+
+struct stats_collector record_stats = {
+    "record every sampled call",
+    init,
+    no_op,
+    no_op,
+    no_op
+};